@@ -107,6 +107,13 @@ def main():
     # Просим найти все записи, в заметках которых есть слова из запроса "Likes artillery" (таких записей не существует)
     PrintRecords(FindRecordsByNote(adress, 'Likes artillery'))
 
+    # Просим найти все записи с именем Александр, в заметках которых есть оба слова "senior developer", найдутся
+    # с id = 4, 5 (поиск сразу по нескольким полям: ответ - пересечение записей по каждому из заданных полей)
+    PrintRecords(FindRecords(adress, name='Александр', note='senior developer'))
+
+    # Просим найти все записи с именем Александр и фамилией Куликов (таких записей не существует)
+    PrintRecords(FindRecords(adress, name='Александр', surname='Куликов'))
+
 # Входная точка приложения клиента для телефонной книги
 if __name__ == '__main__':
     main()
\ No newline at end of file
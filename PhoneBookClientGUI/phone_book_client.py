@@ -25,6 +25,22 @@ def AddRecord(adress, name, surname, patronymic, number, note):
         # Возвращаем полученный код ответа на запрос
         return response.code
 
+# Функция запроса на пакетное добавление записей (тип M-1)
+# (принимает список кортежей (name, surname, patronymic, number, note), возвращает кортеж из списка кодов ответа
+#  по каждой записи (0 - запись с таким номером телефона уже существует, 1 - запись успешно добавлена), числа
+#  добавленных и числа отклонённых записей)
+def AddRecords(adress, records):
+
+    # Открываем соединение, отправляем поток запросов и получаем ответ
+    with grpc.insecure_channel(adress) as channel:
+        stub = connection_pb2_grpc.PhoneBookConnectionStub(channel)
+        requests = (connection_pb2.RecordRequest(name=name, surname=surname, patronymic=patronymic, number=number, note=note)
+                    for name, surname, patronymic, number, note in records)
+        response = stub.AddRecords(requests)
+
+        # Возвращаем полученные коды ответа и итоговые счётчики
+        return list(response.codes), response.added_count, response.rejected_count
+
 # Функция запроса на удаление записи по номеру/id записи (тип 1-1)
 # (возвращает код ответа: 0 - записи с таким номером/id не существует,
 #                         1 - запись успешно удалена)
@@ -76,12 +92,13 @@ def FindRecordsByName(adress, name):
     with grpc.insecure_channel(adress) as channel:
         stub = connection_pb2_grpc.PhoneBookConnectionStub(channel)
         request = connection_pb2.FindRecordsByNameRequest(name=name)
-        response = stub.FindRecordsByName(request)
+        response = stub.FindRecordsByNameBatched(request)
 
-        # Запаковываем результаты в вектор кортежей
+        # Запаковываем результаты в вектор кортежей (записи приходят пачками)
         result = []
-        for record in response:
-            result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
+        for batch in response:
+            for record in batch.records:
+                result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
 
         # Если получился пустой вектор кортежей, значит записей с таким именем не найдено, возвращаем None
         if len(result) == 0: return None
@@ -96,12 +113,13 @@ def FindRecordsBySurname(adress, surname):
     with grpc.insecure_channel(adress) as channel:
         stub = connection_pb2_grpc.PhoneBookConnectionStub(channel)
         request = connection_pb2.FindRecordsBySurnameRequest(surname=surname)
-        response = stub.FindRecordsBySurname(request)
+        response = stub.FindRecordsBySurnameBatched(request)
 
-        # Запаковываем результаты в вектор кортежей
+        # Запаковываем результаты в вектор кортежей (записи приходят пачками)
         result = []
-        for record in response:
-            result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
+        for batch in response:
+            for record in batch.records:
+                result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
 
         # Если получился пустой вектор кортежей, значит записей с такой фамилией не найдено, возвращаем None
         if len(result) == 0: return None
@@ -116,12 +134,13 @@ def FindRecordsByPatronymic(adress, patronymic):
     with grpc.insecure_channel(adress) as channel:
         stub = connection_pb2_grpc.PhoneBookConnectionStub(channel)
         request = connection_pb2.FindRecordsByPatronymicRequest(patronymic=patronymic)
-        response = stub.FindRecordsByPatronymic(request)
+        response = stub.FindRecordsByPatronymicBatched(request)
 
-        # Запаковываем результаты в вектор кортежей
+        # Запаковываем результаты в вектор кортежей (записи приходят пачками)
         result = []
-        for record in response:
-            result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
+        for batch in response:
+            for record in batch.records:
+                result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
 
         # Если получился пустой вектор кортежей, значит записей с таким отчеством не найдено, возвращаем None
         if len(result) == 0: return None
@@ -143,22 +162,79 @@ def FindRecordByNumber(adress, number):
         # А иначе запаковываем результаты в кортеж и возвращаем
         else: return (response.id, response.name, response.surname, response.patronymic, response.number, response.note)
 
+# Функция пакетного запроса на поиск записей по номерам/id записей (тип 1-1)
+# (возвращается вектор той же длины, что и ids, с кортежем найденной записи или None на месте каждого ключа)
+def FindRecordsByIds(adress, ids):
+
+    # Открываем соединение, отправляем запрос и получаем ответ
+    with grpc.insecure_channel(adress) as channel:
+        stub = connection_pb2_grpc.PhoneBookConnectionStub(channel)
+        request = connection_pb2.FindRecordsByIdsRequest(ids=ids)
+        response = stub.FindRecordsByIds(request)
+
+        # Пустая запись с id = 0 означает, что запись по соответствующему ключу не найдена
+        return [None if record.id == 0 else
+                (record.id, record.name, record.surname, record.patronymic, record.number, record.note)
+                for record in response.records]
+
+# Функция пакетного запроса на поиск записей по номерам телефонов (тип 1-1)
+# (возвращается вектор той же длины, что и numbers, с кортежем найденной записи или None на месте каждого ключа)
+def FindRecordsByNumbers(adress, numbers):
+
+    # Открываем соединение, отправляем запрос и получаем ответ
+    with grpc.insecure_channel(adress) as channel:
+        stub = connection_pb2_grpc.PhoneBookConnectionStub(channel)
+        request = connection_pb2.FindRecordsByNumbersRequest(numbers=numbers)
+        response = stub.FindRecordsByNumbers(request)
+
+        # Пустая запись с id = 0 означает, что запись по соответствующему ключу не найдена
+        return [None if record.id == 0 else
+                (record.id, record.name, record.surname, record.patronymic, record.number, record.note)
+                for record in response.records]
+
 # Функция запроса на поиск записей по заметке (тип 1-M)
-# (найденных записей может быть множество или не быть вовсе, тогда возвращается None)
-def FindRecordsByNote(adress, note):
+# (найденных записей может быть множество или не быть вовсе, тогда возвращается None; limit ограничивает ответ
+#  топом из limit самых релевантных записей, 0 - без ограничения; bm25=True включает ранжирование по BM25 с
+#  параметрами k1 и b, None - значения сервера по умолчанию)
+def FindRecordsByNote(adress, note, limit=0, bm25=False, k1=None, b=None):
 
     # Открываем соединение, отправляем запрос и получаем ответ
     with grpc.insecure_channel(adress) as channel:
         stub = connection_pb2_grpc.PhoneBookConnectionStub(channel)
-        request = connection_pb2.FindRecordsByNoteRequest(note=note)
-        response = stub.FindRecordsByNote(request)
+        request = connection_pb2.FindRecordsByNoteRequest(note=note, limit=limit,
+                                                          ranking=connection_pb2.BM25 if bm25 else connection_pb2.TF_IDF,
+                                                          bm25_k1=k1, bm25_b=b)
+        response = stub.FindRecordsByNoteBatched(request)
 
-        # Запаковываем результаты в вектор кортежей
+        # Запаковываем результаты в вектор кортежей (записи приходят пачками)
         result = []
-        for record in response:
-            result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
+        for batch in response:
+            for record in batch.records:
+                result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
 
         # Если получился пустой вектор кортежей, значит записей с указанными словами в заметке не найдено, возвращаем None
         if len(result) == 0: return None
         # А иначе возвращаем вектор кортежей
+        else: return result
+
+# Функция запроса на поиск записей сразу по нескольким полям (тип 1-M)
+# (находит записи, у которых совпадают все заданные поля и в заметке есть все слова note; поле None или пустая заметка
+#  не участвуют в поиске; найденных записей может быть множество или не быть вовсе, тогда возвращается None)
+def FindRecords(adress, name=None, surname=None, patronymic=None, note=''):
+
+    # Открываем соединение, отправляем запрос и получаем ответ
+    with grpc.insecure_channel(adress) as channel:
+        stub = connection_pb2_grpc.PhoneBookConnectionStub(channel)
+        request = connection_pb2.FindRecordsRequest(name=name, surname=surname, patronymic=patronymic, note=note)
+        response = stub.FindRecordsBatched(request)
+
+        # Запаковываем результаты в вектор кортежей (записи приходят пачками)
+        result = []
+        for batch in response:
+            for record in batch.records:
+                result.append((record.id, record.name, record.surname, record.patronymic, record.number, record.note))
+
+        # Если получился пустой вектор кортежей, значит записей с такими полями не найдено, возвращаем None
+        if len(result) == 0: return None
+        # А иначе возвращаем вектор кортежей
         else: return result
\ No newline at end of file
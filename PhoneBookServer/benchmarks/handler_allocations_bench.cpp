@@ -0,0 +1,330 @@
+// Единица трансляции handler_allocations_bench.cpp описывает бенчмарк выделений памяти в heap'е на один запрос
+// при обработке соединений handler'ами: для запросов AddRecord, FindRecordById (тип 1-1) и FindRecordsBySurname
+// (тип 1-M) повторяется жизненный цикл handler'а - получение handler'а, разбор запроса из байтов сообщения,
+// формирование ответа и его сериализация, завершение handler'а - тремя способами: с созданием handler'а через new и
+// удалением через delete на каждый запрос (как было до пула handler'ов), с пулом свободных handler'ов (HandlersPool),
+// которые перевзводятся очисткой запроса и ответа методом Clear, и с пулом handler'ов, запрос и ответ которых
+// размещаются в arena'е protobuf с начальным блоком внутри handler'а (как сейчас). Все вызовы operator new считаются
+// подменённым глобальным operator new, для каждого запроса и способа выводятся выделения памяти и байты на один
+// запрос и время запроса
+//
+// Handler здесь - модель с теми же запросом и ответом, что и у handler'ов сервера: параметры соединения ServerContext
+// и респондер принадлежат gRPC, при перевзводе они всё равно создаются заново, поэтому их собственные выделения
+// памяти (как и выделения внутри gRPC на каждое соединение) одинаковы для всех способов и в замер не входят
+//
+// Аргументы командной строки (необязательные): число запросов каждого типа (по умолчанию 100000)
+
+// Подключим библиотеку iostream для вывода результатов, библиотеку chrono для замера времени, библиотеки string и
+// vector для работы со строками и векторами, библиотеку new для исключения std::bad_alloc, библиотеку cstdlib для
+// функций malloc, free и strtoull и библиотеку cstddef для выравнивания начального блока arena'ы (std::max_align_t)
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include <cstddef>
+
+// Подключим заголовочные файлы arena'ы protobuf и контейнера сообщений protobuf, элементы которого размещаются в
+// arena'е
+#include <google/protobuf/arena.h>
+#include <google/protobuf/repeated_ptr_field.h>
+
+// Подключим заголовочный файл "connection.pb.h", сгенерированный из "connection.proto", который содержит объявления
+// классов запросов и ответов
+#include "connection.pb.h"
+
+// Подключим пространство имён std и пространство имён классов запросов и ответов
+using namespace std;
+using namespace phone_book_proto;
+
+// Счётчики вызовов глобального operator new и выделенных им байтов (бенчмарк однопоточный)
+size_t allocations_count = 0;
+size_t allocated_bytes = 0;
+
+// Подменённый глобальный operator new считает выделения памяти (operator new[] по умолчанию вызывает его же)
+void* operator new(size_t size) {
+    ++allocations_count;
+    allocated_bytes += size;
+    if (void* pointer = malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    free(pointer);
+}
+
+// Число записей в ответе на запрос FindRecordsBySurname
+const size_t SURNAME_RECORDS_COUNT = 20;
+
+// Максимальное число свободных handler'ов в пуле (как MAX_POOLED_HANDLERS_COUNT сервера)
+const size_t MAX_POOLED_HANDLERS_COUNT = 64;
+
+// Поля найденной записи (как в записи из базы данных, которую функции обработки копируют в ответ)
+const string RECORD_NAME = "Александр"s;
+const string RECORD_SURNAME = "Константинопольский"s;
+const string RECORD_PATRONYMIC = "Владимирович"s;
+const string RECORD_NUMBER = "+7 (912) 345-67-89"s;
+const string RECORD_NOTE = "Клиент VIP, не звонить после 18:00, перезвонить по договору"s;
+
+// Функция заполнения ответа record_response записью с номером/id record_id
+void FillRecordResponse(RecordResponse& record_response, uint32_t record_id) {
+    record_response.set_id(record_id);
+    record_response.set_name(RECORD_NAME);
+    record_response.set_surname(RECORD_SURNAME);
+    record_response.set_patronymic(RECORD_PATRONYMIC);
+    record_response.set_number(RECORD_NUMBER);
+    record_response.set_note(RECORD_NOTE);
+}
+
+// Модель handler'а соединения типа 1-1 с запросом и ответом в heap'е (до перехода на arena'ы)
+template <typename RequestType, typename ResponseType>
+struct HeapOneToOneHandler {
+    RequestType request_;
+    ResponseType response_;
+
+    RequestType& Request() { return request_; }
+    ResponseType& Response() { return response_; }
+
+    void Rearm() {
+        request_.Clear();
+        response_.Clear();
+    }
+};
+
+// Модель handler'а соединения типа 1-M с запросом и вектором ответов в heap'е (до перехода на arena'ы)
+template <typename RequestType, typename ResponseType>
+struct HeapOneToManyHandler {
+    RequestType request_;
+    vector<ResponseType> response_;
+
+    RequestType& Request() { return request_; }
+    vector<ResponseType>& Response() { return response_; }
+
+    void Rearm() {
+        request_.Clear();
+        response_.clear();
+    }
+};
+
+// Базовый класс моделей handler'ов с arena'ой: начальный блок arena'ы лежит внутри handler'а (размеры блоков как у
+// ARENA_INITIAL_BLOCK_SIZE и ARENA_MAX_BLOCK_SIZE сервера)
+class ArenaHandlerBase {
+protected:
+    static constexpr size_t ARENA_INITIAL_BLOCK_SIZE = 4 * 1024;
+    static constexpr size_t ARENA_MAX_BLOCK_SIZE = 64 * 1024;
+
+    static google::protobuf::ArenaOptions MakeArenaOptions(char* initial_block) {
+        google::protobuf::ArenaOptions options;
+        options.initial_block = initial_block;
+        options.initial_block_size = ARENA_INITIAL_BLOCK_SIZE;
+        options.max_block_size = ARENA_MAX_BLOCK_SIZE;
+        return options;
+    }
+
+    alignas(alignof(max_align_t)) char arena_initial_block_[ARENA_INITIAL_BLOCK_SIZE];
+    google::protobuf::Arena arena_{MakeArenaOptions(arena_initial_block_)};
+};
+
+// Модель handler'а соединения типа 1-1 с запросом и ответом в arena'е (как у handler'ов сервера)
+template <typename RequestType, typename ResponseType>
+struct ArenaOneToOneHandler : ArenaHandlerBase {
+    RequestType* request_ = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+    ResponseType* response_ = google::protobuf::Arena::CreateMessage<ResponseType>(&arena_);
+
+    RequestType& Request() { return *request_; }
+    ResponseType& Response() { return *response_; }
+
+    void Rearm() {
+        arena_.Reset();
+        request_ = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+        response_ = google::protobuf::Arena::CreateMessage<ResponseType>(&arena_);
+    }
+};
+
+// Модель handler'а соединения типа 1-M с запросом и контейнером ответов в arena'е (как у handler'ов сервера)
+template <typename RequestType, typename ResponseType>
+struct ArenaOneToManyHandler : ArenaHandlerBase {
+    using Responses = google::protobuf::RepeatedPtrField<ResponseType>;
+
+    RequestType* request_ = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+    Responses* response_ = google::protobuf::Arena::CreateMessage<Responses>(&arena_);
+
+    RequestType& Request() { return *request_; }
+    Responses& Response() { return *response_; }
+
+    void Rearm() {
+        arena_.Reset();
+        request_ = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+        response_ = google::protobuf::Arena::CreateMessage<Responses>(&arena_);
+    }
+};
+
+// Функции обработки запросов (формируют ответ так же, как функции обработки сервера)
+void ProcessRequest(const RecordRequest& request, AddRecordResponse& response) {
+    response.set_code(request.number().empty() ? 0 : 1);
+}
+
+void ProcessRequest(const FindRecordByIdRequest& request, RecordResponse& response) {
+    FillRecordResponse(response, request.id());
+}
+
+// (до перехода на arena'ы элементы ответа копировались в вектор ответов)
+void ProcessRequest(const FindRecordsBySurnameRequest&, vector<RecordResponse>& response) {
+    for (size_t i = 0; i < SURNAME_RECORDS_COUNT; ++i) {
+        RecordResponse response_element;
+        FillRecordResponse(response_element, static_cast<uint32_t>(i + 1));
+        response.push_back(response_element);
+    }
+}
+
+// (элементы ответа добавляются прямо в контейнер ответов в arena'е)
+void ProcessRequest(const FindRecordsBySurnameRequest&, google::protobuf::RepeatedPtrField<RecordResponse>& response) {
+    for (size_t i = 0; i < SURNAME_RECORDS_COUNT; ++i) {
+        FillRecordResponse(*response.Add(), static_cast<uint32_t>(i + 1));
+    }
+}
+
+// Функции сериализации ответа в буфер (как при отправке ответа клиенту; буфер заранее выделен)
+size_t SerializeResponse(const google::protobuf::MessageLite& response, vector<char>& buffer) {
+    response.SerializeToArray(buffer.data(), static_cast<int>(buffer.size()));
+    return response.ByteSizeLong();
+}
+
+template <typename Responses>
+size_t SerializeResponses(const Responses& response, vector<char>& buffer) {
+    size_t bytes = 0;
+    for (const RecordResponse& response_element : response) {
+        bytes += SerializeResponse(response_element, buffer);
+    }
+    return bytes;
+}
+
+size_t SerializeResponse(const vector<RecordResponse>& response, vector<char>& buffer) {
+    return SerializeResponses(response, buffer);
+}
+
+size_t SerializeResponse(const google::protobuf::RepeatedPtrField<RecordResponse>& response, vector<char>& buffer) {
+    return SerializeResponses(response, buffer);
+}
+
+// Структура результата замера
+struct AllocationsResult {
+    double allocations_per_request = 0.0; // Выделений памяти на запрос
+    double bytes_per_request = 0.0;       // Выделенных байтов на запрос
+    double ns_per_request = 0.0;          // Время запроса в наносекундах
+};
+
+// Функция замера requests_count запросов с байтами запроса request_bytes: при use_pool == false handler создаётся
+// через new и удаляется через delete на каждый запрос, иначе берётся из пула и возвращается в него
+template <typename HandlerType>
+AllocationsResult MeasureRequests(const string& request_bytes, size_t requests_count, bool use_pool) {
+    vector<HandlerType*> free_handlers;
+    vector<char> buffer(64 * 1024);
+    size_t serialized_bytes = 0;
+
+    const auto run_request = [&]() {
+        HandlerType* handler = nullptr;
+        if (!use_pool || free_handlers.empty()) {
+            handler = new HandlerType;
+        } else {
+            handler = free_handlers.back();
+            free_handlers.pop_back();
+            handler->Rearm();
+        }
+
+        handler->Request().ParseFromString(request_bytes);
+        ProcessRequest(handler->Request(), handler->Response());
+        serialized_bytes += SerializeResponse(handler->Response(), buffer);
+
+        if (!use_pool || free_handlers.size() >= MAX_POOLED_HANDLERS_COUNT) {
+            delete handler;
+        } else {
+            free_handlers.push_back(handler);
+        }
+    };
+
+    // Прогрев: пул заполняется, строковые поля handler'а из пула получают память
+    for (size_t i = 0; i < 1000; ++i) {
+        run_request();
+    }
+
+    const size_t allocations_before = allocations_count;
+    const size_t bytes_before = allocated_bytes;
+    const auto start = chrono::steady_clock::now();
+    for (size_t i = 0; i < requests_count; ++i) {
+        run_request();
+    }
+    const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    const AllocationsResult result = {static_cast<double>(allocations_count - allocations_before) / requests_count,
+                                      static_cast<double>(allocated_bytes - bytes_before) / requests_count,
+                                      seconds * 1e9 / requests_count};
+
+    for (HandlerType* handler : free_handlers) {
+        delete handler;
+    }
+    if (serialized_bytes == 0) {
+        cout << "[Warning: no responses were serialized]"s << endl;
+    }
+    return result;
+}
+
+// Функция замера и вывода результатов всеми способами для запроса с именем name: handler с сообщениями в heap'е
+// HeapHandlerType создаётся на каждый запрос и берётся из пула, handler с сообщениями в arena'е ArenaHandlerType
+// берётся из пула
+template <typename HeapHandlerType, typename ArenaHandlerType>
+void PrintRequestAllocations(const string& name, const string& request_bytes, size_t requests_count) {
+    const auto print_result = [](const string& mode, const AllocationsResult& result) {
+        cout << "        "s << mode << ": "s << result.allocations_per_request << " allocations/request, "s
+             << result.bytes_per_request << " bytes/request, "s << result.ns_per_request << " ns/request"s << endl;
+    };
+
+    cout << "    "s << name << ":"s << endl;
+    print_result("new/delete  "s, MeasureRequests<HeapHandlerType>(request_bytes, requests_count, false));
+    print_result("pool        "s, MeasureRequests<HeapHandlerType>(request_bytes, requests_count, true));
+    print_result("pool + arena"s, MeasureRequests<ArenaHandlerType>(request_bytes, requests_count, true));
+}
+
+int main(int argc, char* argv[]) {
+    const size_t requests_count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+
+    if (requests_count == 0) {
+        cout << "Usage: handler_allocations_bench [requests_count > 0]"s << endl;
+        return 1;
+    }
+
+    // Байты запросов в том виде, в котором их передаёт клиент
+    RecordRequest add_record_request;
+    add_record_request.set_name(RECORD_NAME);
+    add_record_request.set_surname(RECORD_SURNAME);
+    add_record_request.set_patronymic(RECORD_PATRONYMIC);
+    add_record_request.set_number(RECORD_NUMBER);
+    add_record_request.set_note(RECORD_NOTE);
+
+    FindRecordByIdRequest find_record_by_id_request;
+    find_record_by_id_request.set_id(12345);
+
+    FindRecordsBySurnameRequest find_records_by_surname_request;
+    find_records_by_surname_request.set_surname(RECORD_SURNAME);
+
+    cout << "[handler_allocations_bench: "s << requests_count << " requests of each type]"s << endl;
+    PrintRequestAllocations<HeapOneToOneHandler<RecordRequest, AddRecordResponse>,
+                            ArenaOneToOneHandler<RecordRequest, AddRecordResponse>>(
+        "AddRecord (1-1)"s, add_record_request.SerializeAsString(), requests_count);
+    PrintRequestAllocations<HeapOneToOneHandler<FindRecordByIdRequest, RecordResponse>,
+                            ArenaOneToOneHandler<FindRecordByIdRequest, RecordResponse>>(
+        "FindRecordById (1-1)"s, find_record_by_id_request.SerializeAsString(), requests_count);
+    PrintRequestAllocations<HeapOneToManyHandler<FindRecordsBySurnameRequest, RecordResponse>,
+                            ArenaOneToManyHandler<FindRecordsBySurnameRequest, RecordResponse>>(
+        "FindRecordsBySurname (1-M, "s + to_string(SURNAME_RECORDS_COUNT) + " records)"s,
+        find_records_by_surname_request.SerializeAsString(), requests_count);
+
+    return 0;
+}
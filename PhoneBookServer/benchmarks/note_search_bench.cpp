@@ -0,0 +1,234 @@
+// Единица трансляции note_search_bench.cpp описывает бенчмарк задержки поиска записей по содержанию заметок до и после
+// перехода на списки записей слов (PostingList) и плотный аккумулятор релевантности: база данных заполняется записями
+// с заметками из слов со степенным (Zipf) распределением частот, и те же заметки индексируются прежним способом -
+// словарём "Слово -> Номер/id записи -> Частота TF" из деревьев std::map с накоплением релевантности в ещё одном
+// std::map. Затем одни и те же запросы из 1, 3 и 8 слов выполняются обоими способами (топ-10 записей и все найденные
+// записи), и для каждого числа слов выводятся средняя и наибольшая задержка запроса в миллисекундах и число запросов,
+// на которые оба способа нашли одни и те же записи в одном и том же порядке
+//
+// Аргументы командной строки (необязательные): число записей в базе данных (по умолчанию 5000000) и число запросов с
+// каждым числом слов (по умолчанию 20)
+//
+// (прежний индекс из деревьев std::map на 5 миллионах записей занимает несколько гигабайт, поэтому на машинах с малым
+// объёмом памяти число записей стоит уменьшить)
+
+// Подключим библиотеку iostream для вывода результатов, библиотеку random для генерации заметок и запросов, библиотеку
+// chrono для замера времени, библиотеки string, string_view, vector и map для работы со строками и контейнерами,
+// библиотеку algorithm для функций сортировки и поиска, библиотеку cmath для логарифма, библиотеку limits для
+// числовых пределов, библиотеку optional для результатов поиска и библиотеку cstdlib для функции strtoull
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <cstdlib>
+
+// Подключим заголовочный файл базы данных для телефонной книги, заголовочный файл списка записей слова и заголовочный
+// файл функций для работы со строками
+#include "phone_book_database.h"
+#include "posting_list.h"
+#include "string_functions.h"
+
+// Подключим пространство имён std и пространство имён базы данных для телефонной книги
+using namespace std;
+using namespace phone_book_database;
+
+// Число слов в словаре заметок (частота слова с рангом r пропорциональна 1 / r)
+const size_t VOCABULARY_SIZE = 50000;
+
+// Класс прежнего индекса заметок: словарь "Слово в заметках -> Номер/id записи -> Частота TF" из деревьев std::map,
+// релевантность по TF-IDF при поиске накапливается в словаре std::map "Номер/id записи -> Релевантность", найденные
+// записи сортируются по убыванию релевантности целиком и только затем обрезаются до топа
+class MapOfMapsNoteIndex {
+public:
+    // Функция добавления заметки note записи с номером/id record_id (заметка должна жить, пока жив индекс)
+    // (частоты TF квантуются так же, как в списках записей слов базы данных, чтобы результаты обоих способов
+    //  можно было сравнить)
+    void AddNote(size_t record_id, string_view note) {
+        const vector<string_view> words = string_functions::SplitIntoWords(note);
+
+        map<string_view, size_t> word_counts;
+        for (string_view word : words) {
+            ++word_counts[word];
+        }
+        for (const auto& [word, count] : word_counts) {
+            const double term_freq = static_cast<double>(count) / static_cast<double>(words.size());
+            note_word_to_record_freqs_[word][record_id] =
+                posting_list::PostingList::DecodeFreq(posting_list::PostingList::QuantizeFreq(term_freq));
+        }
+        ++records_count_;
+    }
+
+    // Функция поиска записей по содержанию заметок (возвращает номера/id не более чем max_records_count самых
+    // релевантных записей в порядке убывания релевантности)
+    vector<size_t> FindRecordsByNote(const string& note, size_t max_records_count) const {
+        map<size_t, double> record_to_relevance;
+
+        const vector<string_view> words =
+            string_functions::SortAndRemoveDuplicates(string_functions::SplitIntoWords(note));
+        for (string_view word : words) {
+            const auto it = note_word_to_record_freqs_.find(word);
+            if (it == note_word_to_record_freqs_.end()) {
+                continue;
+            }
+
+            // Частота IDF и вклады слов вычисляются так же, как в базе данных (разность логарифмов и округление
+            // вклада до сетки), чтобы релевантности обоих способов совпадали бит в бит
+            const double inverse_record_freq =
+                log(static_cast<double>(records_count_)) - log(static_cast<double>(it->second.size()));
+            for (const auto& [record_id, term_freq] : it->second) {
+                record_to_relevance[record_id] += PhoneBookDatabase::RoundRelevance(term_freq * inverse_record_freq);
+            }
+        }
+
+        // Записи упорядочиваются так же, как в топе базы данных (при равной релевантности - по номеру/id), чтобы
+        // результаты обоих способов можно было сравнить
+        vector<pair<size_t, double>> matched_records(record_to_relevance.begin(), record_to_relevance.end());
+        sort(matched_records.begin(), matched_records.end(),
+             [](const pair<size_t, double>& lhs, const pair<size_t, double>& rhs) {
+                 return PhoneBookDatabase::HigherRelevance(lhs.first, lhs.second, rhs.first, rhs.second);
+             });
+
+        vector<size_t> result;
+        for (size_t i = 0; i < matched_records.size() && i < max_records_count; ++i) {
+            result.push_back(matched_records[i].first);
+        }
+        return result;
+    }
+
+private:
+    map<string_view, map<size_t, double>> note_word_to_record_freqs_;
+    size_t records_count_ = 0;
+};
+
+// Класс генератора слов заметок со степенным распределением частот
+class ZipfWords {
+public:
+    ZipfWords() : cumulative_weights_(VOCABULARY_SIZE) {
+        double sum = 0.0;
+        for (size_t rank = 0; rank < VOCABULARY_SIZE; ++rank) {
+            sum += 1.0 / static_cast<double>(rank + 1);
+            cumulative_weights_[rank] = sum;
+        }
+    }
+
+    // Функция получения случайного слова
+    string Next(mt19937& generator) const {
+        const double x = uniform_real_distribution<double>(0.0, cumulative_weights_.back())(generator);
+        const size_t rank = lower_bound(cumulative_weights_.begin(), cumulative_weights_.end(), x)
+                            - cumulative_weights_.begin();
+        return "слово"s + to_string(min(rank, VOCABULARY_SIZE - 1));
+    }
+
+private:
+    vector<double> cumulative_weights_;
+};
+
+// Структура задержек запросов одним способом
+struct Latencies {
+    double total_ms = 0.0; // Суммарная задержка
+    double max_ms = 0.0;   // Наибольшая задержка
+
+    void Add(double ms) {
+        total_ms += ms;
+        max_ms = max(max_ms, ms);
+    }
+};
+
+// Функция замера задержки вызова function в миллисекундах
+template <typename Function>
+double MeasureMs(Function function) {
+    const auto start = chrono::steady_clock::now();
+    function();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char* argv[]) {
+    const size_t records_count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 5000000;
+    const size_t queries_count = argc > 2 ? strtoull(argv[2], nullptr, 10) : 20;
+
+    if (records_count == 0 || queries_count == 0) {
+        cout << "Usage: note_search_bench [records_count > 0] [queries_count > 0]"s << endl;
+        return 1;
+    }
+
+    const ZipfWords words;
+    mt19937 generator(3);
+
+    // Заполняем базу данных пакетами (номера/id записей 1, 2, ...) и прежний индекс теми же заметками
+    PhoneBookDatabase database;
+    vector<string> notes(records_count);
+    MapOfMapsNoteIndex map_of_maps_index;
+    {
+        const size_t BATCH_SIZE = 65536;
+        vector<PhoneBookDatabase::Record> batch;
+        for (size_t i = 0; i < records_count; ++i) {
+            const size_t words_count = 5 + generator() % 11;
+            for (size_t j = 0; j < words_count; ++j) {
+                notes[i] += words.Next(generator);
+                notes[i] += ' ';
+            }
+            map_of_maps_index.AddNote(i + 1, notes[i]);
+
+            batch.push_back({"Имя"s + to_string(i % 1000), "Фамилия"s, "Отчество"s, "+7"s + to_string(i), notes[i]});
+            if (batch.size() == BATCH_SIZE || i + 1 == records_count) {
+                database.AddRecords(batch);
+                batch.clear();
+            }
+        }
+    }
+
+    cout << "[note_search_bench: "s << records_count << " records, "s << queries_count
+         << " queries per words count]"s << endl;
+
+    for (size_t max_records_count : {size_t{10}, numeric_limits<size_t>::max()}) {
+        for (size_t words_count : {1, 3, 8}) {
+            Latencies before;
+            Latencies after;
+            size_t same_results_count = 0;
+
+            for (size_t i = 0; i < queries_count; ++i) {
+                string query;
+                for (size_t j = 0; j < words_count; ++j) {
+                    query += words.Next(generator);
+                    query += ' ';
+                }
+
+                // Оба способа разбирают одни и те же запросы, а найденные записи берутся из базы данных: прежний
+                // индекс возвращает номера/id, и записи по ним достаются тем же пакетным поиском
+                vector<size_t> before_ids;
+                before.Add(MeasureMs([&]() {
+                    before_ids = map_of_maps_index.FindRecordsByNote(query, max_records_count);
+                    database.FindRecordsByIds(before_ids);
+                }));
+
+                optional<vector<PhoneBookDatabase::RecordWithId>> after_records;
+                after.Add(MeasureMs([&]() {
+                    after_records = database.FindRecordsByNote(query, max_records_count);
+                }));
+
+                vector<size_t> after_ids;
+                if (after_records) {
+                    for (const auto& record : *after_records) {
+                        after_ids.push_back(record.id);
+                    }
+                }
+                same_results_count += before_ids == after_ids;
+            }
+
+            cout << "    "s << words_count << " words, "s
+                 << (max_records_count == 10 ? "top 10"s : "all records"s) << ": before "s
+                 << before.total_ms / queries_count << " ms (max "s << before.max_ms << " ms), after "s
+                 << after.total_ms / queries_count << " ms (max "s << after.max_ms << " ms), same results "s
+                 << same_results_count << "/"s << queries_count << endl;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,210 @@
+// Единица трансляции phone_book_bench.cpp описывает бенчмарк пропускной способности базы данных для телефонной книги
+// при одновременной работе нескольких потоков: база данных заполняется случайными записями, после чего 1, 2, 4, 8 и 16
+// потоков в течение заданного времени выполняют смешанную нагрузку из чтений (поиск по номеру/id, по номеру телефона,
+// по фамилии и по содержанию заметок поровну) и изменений (добавление записи и удаление ранее добавленной этим же
+// потоком записи по номеру телефона, поэтому размер базы данных не меняется). Для каждого числа потоков выводятся
+// операции в секунду (всего, чтения и изменения) и ускорение относительно одного потока
+//
+// Аргументы командной строки (необязательные): число записей в базе данных (по умолчанию 100000), время одного
+// замера в секундах (по умолчанию 2) и доля чтений в процентах (по умолчанию 95)
+//
+// (ускорение ограничено числом ядер процессора, которое тоже выводится)
+
+// Подключим библиотеку iostream для вывода результатов, библиотеку random для генерации записей и операций,
+// библиотеку chrono для замера времени, библиотеки thread и atomic для потоков нагрузки и их синхронизации,
+// библиотеки string и vector для работы со строками и векторами и библиотеку cstdlib для функций strtoull и strtod
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdlib>
+
+// Подключим заголовочный файл базы данных для телефонной книги
+#include "phone_book_database.h"
+
+// Подключим пространство имён std и пространство имён базы данных для телефонной книги
+using namespace std;
+using namespace phone_book_database;
+
+// Словарь частых слов заметок (каждое встречается во многих заметках)
+const vector<string> NOTE_WORDS = {
+    "клиент"s, "должник"s, "не"s, "звонить"s, "после"s, "перезвонить"s, "оплата"s, "договор"s, "просрочка"s,
+    "работа"s, "адрес"s, "Москва"s, "менеджер"s, "встреча"s, "срочно"s, "важно"s, "счёт"s, "друг"s, "врач"s, "такси"s,
+};
+
+// Число редких слов заметок ("метка0", "метка1", ...; каждое встречается в немногих заметках)
+const size_t RARE_NOTE_WORDS_COUNT = 5000;
+
+// Числа различных имён, фамилий и отчеств в сгенерированных записях
+const size_t NAMES_COUNT = 1000;
+const size_t SURNAMES_COUNT = 10000;
+const size_t PATRONYMICS_COUNT = 100;
+
+// Функция генерации случайной записи с номером телефона number
+PhoneBookDatabase::Record GenerateRecord(string number, mt19937& generator) {
+    PhoneBookDatabase::Record record;
+    record.name = "Имя"s + to_string(generator() % NAMES_COUNT);
+    record.surname = "Фамилия"s + to_string(generator() % SURNAMES_COUNT);
+    record.patronymic = "Отчество"s + to_string(generator() % PATRONYMICS_COUNT);
+    record.number = move(number);
+
+    // Половина слов заметки - частые слова, половина - редкие
+    const size_t words_count = 3 + generator() % 8;
+    for (size_t i = 0; i < words_count; ++i) {
+        record.note += generator() % 2 == 0 ? NOTE_WORDS[generator() % NOTE_WORDS.size()]
+                                            : "метка"s + to_string(generator() % RARE_NOTE_WORDS_COUNT);
+        record.note += i + 1 < words_count ? " "s : "."s;
+    }
+    return record;
+}
+
+// Структура результата одного замера
+struct RunResult {
+    size_t reads_count = 0;  // Число выполненных чтений
+    size_t writes_count = 0; // Число выполненных изменений
+    double seconds = 0.0;    // Длительность замера
+};
+
+// Функция одного замера: threads_count потоков в течение seconds секунд выполняют смешанную нагрузку с долей чтений
+// read_percent процентов над базой данных database из records_count записей
+RunResult RunMixedWorkload(PhoneBookDatabase& database, size_t records_count, size_t threads_count, double seconds,
+                           unsigned read_percent) {
+    atomic<bool> start = false;
+    atomic<bool> stop = false;
+    atomic<size_t> ready_count = 0;
+    atomic<size_t> reads_count = 0;
+    atomic<size_t> writes_count = 0;
+
+    // Сумма найденных записей (не даёт компилятору выбросить чтения)
+    atomic<size_t> found_count = 0;
+
+    vector<thread> threads;
+    for (size_t thread_index = 0; thread_index < threads_count; ++thread_index) {
+        threads.emplace_back([&, thread_index]() {
+            mt19937 generator(static_cast<unsigned>(thread_index + 1) * 7919u + static_cast<unsigned>(threads_count));
+            size_t reads = 0;
+            size_t writes = 0;
+            size_t found = 0;
+
+            // Номер телефона добавленной потоком записи, которую нужно удалить следующим изменением (пустой - записи
+            // нет, и следующее изменение добавляет запись)
+            string added_number;
+            size_t added_count = 0;
+
+            ++ready_count;
+            while (!start.load(memory_order_acquire)) {
+                this_thread::yield();
+            }
+
+            while (!stop.load(memory_order_relaxed)) {
+                if (generator() % 100 < read_percent) {
+                    switch (generator() % 4) {
+                    case 0:
+                        found += database.FindRecordById(generator() % records_count + 1).has_value();
+                        break;
+                    case 1:
+                        found += database.FindRecordByNumber("+7"s + to_string(generator() % records_count))
+                                     .has_value();
+                        break;
+                    case 2:
+                        if (const auto records = database.FindRecordsBySurname(
+                                "Фамилия"s + to_string(generator() % SURNAMES_COUNT))) {
+                            found += records->size();
+                        }
+                        break;
+                    default:
+                        // Запрос из частого и редкого слова (топ-10 самых релевантных записей)
+                        if (const auto records = database.FindRecordsByNote(
+                                NOTE_WORDS[generator() % NOTE_WORDS.size()] + " метка"s
+                                + to_string(generator() % RARE_NOTE_WORDS_COUNT), 10)) {
+                            found += records->size();
+                        }
+                        break;
+                    }
+                    ++reads;
+                } else {
+                    if (added_number.empty()) {
+                        added_number = "+8"s + to_string(thread_index) + "-"s + to_string(added_count++);
+                        database.AddRecord(GenerateRecord(added_number, generator));
+                    } else {
+                        database.DeleteRecordByNumber(added_number);
+                        added_number.clear();
+                    }
+                    ++writes;
+                }
+            }
+
+            // Возвращаем базе данных исходный размер
+            if (!added_number.empty()) {
+                database.DeleteRecordByNumber(added_number);
+            }
+
+            reads_count += reads;
+            writes_count += writes;
+            found_count += found;
+        });
+    }
+
+    while (ready_count.load() < threads_count) {
+        this_thread::yield();
+    }
+    const auto start_time = chrono::steady_clock::now();
+    start.store(true, memory_order_release);
+    this_thread::sleep_for(chrono::duration<double>(seconds));
+    stop = true;
+    const auto stop_time = chrono::steady_clock::now();
+
+    for (thread& t : threads) {
+        t.join();
+    }
+
+    if (found_count.load() == 0) {
+        cout << "[Warning: no records were found]"s << endl;
+    }
+    return {reads_count.load(), writes_count.load(), chrono::duration<double>(stop_time - start_time).count()};
+}
+
+int main(int argc, char* argv[]) {
+    const size_t records_count = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+    const double seconds = argc > 2 ? strtod(argv[2], nullptr) : 2.0;
+    const unsigned read_percent = argc > 3 ? static_cast<unsigned>(strtoull(argv[3], nullptr, 10)) : 95;
+
+    if (records_count == 0 || seconds <= 0.0 || read_percent > 100) {
+        cout << "Usage: phone_book_bench [records_count > 0] [seconds > 0] [read_percent <= 100]"s << endl;
+        return 1;
+    }
+
+    // Заполняем базу данных одним пакетом (номера телефонов "+70", "+71", ..., номера/id записей 1, 2, ...)
+    PhoneBookDatabase database;
+    {
+        mt19937 generator(1);
+        vector<PhoneBookDatabase::Record> records;
+        records.reserve(records_count);
+        for (size_t i = 0; i < records_count; ++i) {
+            records.push_back(GenerateRecord("+7"s + to_string(i), generator));
+        }
+        database.AddRecords(records);
+    }
+
+    cout << "[phone_book_bench: "s << records_count << " records, "s << read_percent << "% reads, "s << seconds
+         << " s per run, "s << thread::hardware_concurrency() << " hardware threads]"s << endl;
+
+    double single_thread_ops = 0.0;
+    for (size_t threads_count : {1, 2, 4, 8, 16}) {
+        const RunResult result = RunMixedWorkload(database, records_count, threads_count, seconds, read_percent);
+        const double ops = (result.reads_count + result.writes_count) / result.seconds;
+        if (threads_count == 1) {
+            single_thread_ops = ops;
+        }
+
+        cout << "    "s << threads_count << " threads: "s << static_cast<size_t>(ops) << " ops/s ("s
+             << static_cast<size_t>(result.reads_count / result.seconds) << " reads/s, "s
+             << static_cast<size_t>(result.writes_count / result.seconds) << " writes/s), speedup "s
+             << ops / single_thread_ops << "x"s << endl;
+    }
+
+    return 0;
+}
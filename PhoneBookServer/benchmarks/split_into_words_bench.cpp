@@ -0,0 +1,124 @@
+// Единица трансляции split_into_words_bench.cpp описывает микробенчмарк разделения строки на слова: прежняя реализация
+// через string::find_first_of, скалярная, SSE2 и AVX2 реализации SplitIntoWords и выбранная по процессору реализация
+// разделяют на слова одни и те же заметки из русских слов (UTF-8) разной длины, для каждой реализации выводятся
+// миллионы слов в секунду и гигабайты в секунду (лучший из нескольких прогонов)
+//
+// Аргументы командной строки (необязательные): число слов во всех заметках одного прогона (по умолчанию 1600000)
+
+// Подключим библиотеку iostream для вывода результатов, библиотеку random для генерации заметок, библиотеку chrono для
+// замера времени, библиотеки string, string_view и vector для работы со строками и векторами, библиотеку utility для
+// пар, библиотеку algorithm для функции min и библиотеку cstdlib для функции strtoull
+#include <iostream>
+#include <random>
+#include <chrono>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdlib>
+
+// Подключим заголовочный файл функций для работы со строками
+#include "string_functions.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Тип функции разделения строки на слова
+using SplitFunction = vector<string_view> (*)(string_view);
+
+// Прежняя реализация разделения строки на слова через символы-сепараторы (поиск каждого следующего сепаратора через
+// find_first_of)
+vector<string_view> SplitIntoWordsFindFirstOf(string_view str) {
+    vector<string_view> words;
+    const static string separator_chars = "!?.:,;\"()[]{} "s;
+
+    while (true) {
+        size_t separator_pos = str.find_first_of(separator_chars);
+        string_view word = str.substr(0, separator_pos);
+
+        if (!word.empty()) words.push_back(word);
+        if (separator_pos == str.npos) break;
+        else str.remove_prefix(separator_pos + 1);
+    }
+
+    return words;
+}
+
+// Функция получения реализаций, доступных на этом процессоре
+vector<pair<string, SplitFunction>> AvailableImplementations() {
+    vector<pair<string, SplitFunction>> implementations = {
+        {"find_first_of"s, SplitIntoWordsFindFirstOf},
+        {"scalar"s, string_functions::detail::SplitIntoWordsScalar},
+    };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (__builtin_cpu_supports("sse2")) {
+        implementations.emplace_back("sse2"s, string_functions::detail::SplitIntoWordsSSE2);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        implementations.emplace_back("avx2"s, string_functions::detail::SplitIntoWordsAVX2);
+    }
+#endif
+    implementations.emplace_back("dispatch"s, string_functions::SplitIntoWords);
+
+    return implementations;
+}
+
+// Функция генерации заметок по words_per_note слов из словаря русских заметок (слова разделены пробелами, иногда
+// запятыми и точками), всего не меньше total_words слов
+vector<string> GenerateNotes(size_t words_per_note, size_t total_words, mt19937& generator) {
+    static const vector<string> dictionary = {
+        "клиент"s, "VIP"s, "должник"s, "не"s, "звонить"s, "после"s, "18:00"s, "перезвонить"s, "оплата"s, "договор"s,
+        "просрочка"s, "номер"s, "работа"s, "адрес"s, "Москва"s, "менеджер"s, "встреча"s, "срочно"s, "(важно)"s, "счёт"s,
+    };
+
+    vector<string> notes((total_words + words_per_note - 1) / words_per_note);
+    for (string& note : notes) {
+        for (size_t i = 0; i < words_per_note; ++i) {
+            note += dictionary[generator() % dictionary.size()];
+            const size_t separator = generator() % 10;
+            note += separator == 0 ? ", "s : separator == 1 ? ". "s : " "s;
+        }
+    }
+    return notes;
+}
+
+int main(int argc, char* argv[]) {
+    const size_t total_words = argc > 1 ? strtoull(argv[1], nullptr, 10) : 1600000;
+    const int RUNS_COUNT = 7;
+
+    const auto implementations = AvailableImplementations();
+    mt19937 generator(1);
+
+    for (size_t words_per_note : {8, 30, 150}) {
+        const vector<string> notes = GenerateNotes(words_per_note, total_words, generator);
+        size_t bytes = 0;
+        for (const string& note : notes) {
+            bytes += note.size();
+        }
+
+        cout << "[Notes of "s << words_per_note << " words ("s << notes.size() << " notes, "s
+             << bytes / notes.size() << " bytes on average)]"s << endl;
+
+        for (const auto& [name, split] : implementations) {
+            double best_seconds = 0.0;
+            size_t tokens = 0;
+
+            for (int run = 0; run < RUNS_COUNT; ++run) {
+                tokens = 0;
+                const auto start = chrono::steady_clock::now();
+                for (const string& note : notes) {
+                    tokens += split(note).size();
+                }
+                const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+                best_seconds = run == 0 ? seconds : min(best_seconds, seconds);
+            }
+
+            cout << "    "s << name << ": "s << tokens / best_seconds / 1e6 << " M tokens/s, "s
+                 << bytes / best_seconds / 1e9 << " GB/s"s << endl;
+        }
+    }
+
+    return 0;
+}
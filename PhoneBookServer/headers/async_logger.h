@@ -0,0 +1,177 @@
+// Заголовочный файл async_logger.h описывает работу асинхронного журнала (логгера) сервера для телефонной книги:
+// потоки, обрабатывающие запросы, лишь кладут сообщения в lock-free кольцевой буфер, а весь ввод-вывод выполняет
+// отдельный фоновый поток
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку atomic для атомарной работы с позициями кольцевого буфера, библиотеку array для
+// использования контейнера массива фиксированного размера, библиотеку string и string_view для работы со
+// строками, библиотеку sstream для формирования сообщений через поток вывода, библиотеку thread для работы
+// фонового потока, библиотеку chrono для работы со временем и библиотеку cstddef для типа size_t
+#include <atomic>
+#include <array>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <cstddef>
+
+// Минимальный уровень сообщений, которые вообще попадают в код (0 - DEBUG, 1 - INFO, 2 - WARNING, 3 - ERROR).
+// Вызовы макросов журнала с уровнем ниже этого раскрываются в пустую инструкцию, не вычисляя свои аргументы.
+// По умолчанию отладочные сообщения из кода исключены, включить их можно опцией CMake PHONE_BOOK_DEBUG_LOGGING
+#ifndef PHONE_BOOK_LOG_COMPILED_LEVEL
+#define PHONE_BOOK_LOG_COMPILED_LEVEL 1
+#endif
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён асинхронного журнала
+namespace async_logger {
+
+// Архитектура асинхронного журнала:
+//
+// Журнал - единственный на процесс объект Logger (доступен через Logger::Instance()). Сообщение формируется в
+// вызывающем потоке (макросы PHONE_BOOK_LOG_DEBUG/INFO/WARNING/ERROR принимают выражение для потока вывода, как
+// cout), копируется в ячейку кольцевого буфера фиксированного размера и больше ничего не делает: ни блокировок,
+// ни системных вызовов. Кольцевой буфер - ограниченная lock-free очередь на много писателей и одного читателя
+// (у каждой ячейки есть атомарный номер последовательности, писатели занимают ячейки compare-exchange'ем общей
+// позиции записи). Если буфер переполнен, сообщение отбрасывается (поток, обрабатывающий запрос, никогда не ждёт
+// журнал), а число отброшенных сообщений сообщается в журнал позже.
+//
+// Фоновый поток журнала забирает из буфера все накопившиеся сообщения, форматирует их (время, уровень, текст) в
+// одну строку и выводит её в стандартный поток вывода одной операцией записи со сбросом буфера. Если сообщений нет,
+// поток засыпает на короткое время. При уничтожении журнала (завершении процесса) фоновый поток выводит остаток
+// сообщений и завершается.
+//
+// Уровень журнала проверяется дважды: на этапе компиляции (PHONE_BOOK_LOG_COMPILED_LEVEL, сообщения ниже него
+// исключаются из кода) и во время работы (SetLevel, сообщения ниже текущего уровня не формируются).
+
+// Уровни сообщений журнала
+enum class LogLevel : int {
+    DEBUG   = 0, // Отладочные сообщения (подробности обработки каждого запроса)
+    INFO    = 1, // Информационные сообщения (запуск и остановка сервера, одна строка на каждый обработанный запрос)
+    WARNING = 2, // Предупреждения
+    ERROR   = 3  // Ошибки
+};
+
+// Класс асинхронного журнала
+class Logger final {
+private:
+    // Число ячеек кольцевого буфера (степень двойки, чтобы позиция в буфере вычислялась маской)
+    static constexpr size_t RING_SIZE = 4096;
+
+    // Максимальная длина одного сообщения (более длинные сообщения обрезаются)
+    static constexpr size_t MESSAGE_MAX_SIZE = 240;
+
+    // Время, на которое засыпает фоновый поток, если в буфере нет сообщений
+    static constexpr std::chrono::milliseconds IDLE_SLEEP_TIME{2};
+
+    // Структура ячейки кольцевого буфера
+    struct Slot {
+        // Номер последовательности ячейки: равен позиции записи, если ячейка свободна для писателя,
+        // и позиции записи + 1, если в ячейке лежит сообщение для читателя
+        std::atomic<size_t> sequence;
+
+        LogLevel level;                              // Уровень сообщения
+        std::chrono::system_clock::time_point time;  // Время формирования сообщения
+        size_t size;                                 // Длина сообщения
+        std::array<char, MESSAGE_MAX_SIZE> text;     // Текст сообщения
+    };
+
+    // Кольцевой буфер сообщений
+    std::array<Slot, RING_SIZE> ring_;
+
+    // Позиция записи (общая для всех писателей) и позиция чтения (её изменяет только фоновый поток)
+    // (разнесены по разным кэш-линиям, чтобы писатели и читатель не мешали друг другу)
+    alignas(64) std::atomic<size_t> enqueue_position_{0};
+    alignas(64) size_t dequeue_position_ = 0;
+
+    // Текущий уровень журнала
+    std::atomic<LogLevel> level_{LogLevel::INFO};
+
+    // Число отброшенных из-за переполнения буфера сообщений
+    std::atomic<size_t> dropped_count_{0};
+
+    // Флаг остановки фонового потока
+    std::atomic<bool> stop_{false};
+
+    // Фоновый поток, выводящий сообщения
+    std::thread drain_thread_;
+
+public:
+    // Функция получения журнала (единственного на процесс, создаётся при первом обращении)
+    // (определение/definition этой функции находится в async_logger.cpp)
+    static Logger& Instance();
+
+    // Функция установки текущего уровня журнала
+    // (определение/definition этой функции находится в async_logger.cpp)
+    void SetLevel(LogLevel level);
+
+    // Функция проверки, будут ли записываться сообщения уровня level
+    bool IsEnabled(LogLevel level) const {
+        return static_cast<int>(level) >= static_cast<int>(level_.load(std::memory_order_relaxed));
+    }
+
+    // Функция добавления сообщения в кольцевой буфер (никогда не блокируется и не выполняет ввод-вывод;
+    // если буфер переполнен, сообщение отбрасывается)
+    // (определение/definition этой функции находится в async_logger.cpp)
+    void Push(LogLevel level, std::string_view message);
+
+    // Деструктор останавливает фоновый поток, предварительно выведя все оставшиеся сообщения
+    // (определение/definition этой функции находится в async_logger.cpp)
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+private:
+    // Конструктор инициализирует ячейки кольцевого буфера и запускает фоновый поток
+    // (определение/definition этой функции находится в async_logger.cpp)
+    Logger();
+
+    // Функция фонового потока
+    // (определение/definition этой функции находится в async_logger.cpp)
+    void DrainLoop();
+
+    // Функция вывода всех накопившихся в буфере сообщений (возвращает число выведенных сообщений)
+    // (определение/definition этой функции находится в async_logger.cpp)
+    size_t Drain(std::string& buffer);
+};
+
+}
+
+// Макрос записи сообщения уровня level в журнал. Сообщение задаётся выражением для потока вывода, например:
+// PHONE_BOOK_LOG_INFO("Server uses "s << queues_count << " queues"s). Выражение вычисляется, только если уровень
+// включён во время работы
+#define PHONE_BOOK_LOG(level, message)                                                      \
+    do {                                                                                    \
+        if (::async_logger::Logger::Instance().IsEnabled(level)) {                          \
+            std::ostringstream phone_book_log_stream;                                       \
+            phone_book_log_stream << message;                                               \
+            ::async_logger::Logger::Instance().Push(level, phone_book_log_stream.str());    \
+        }                                                                                   \
+    } while (false)
+
+// Макросы записи сообщений каждого уровня (уровни ниже PHONE_BOOK_LOG_COMPILED_LEVEL исключаются из кода)
+#if PHONE_BOOK_LOG_COMPILED_LEVEL <= 0
+#define PHONE_BOOK_LOG_DEBUG(message) PHONE_BOOK_LOG(::async_logger::LogLevel::DEBUG, message)
+#else
+#define PHONE_BOOK_LOG_DEBUG(message) do { } while (false)
+#endif
+
+#if PHONE_BOOK_LOG_COMPILED_LEVEL <= 1
+#define PHONE_BOOK_LOG_INFO(message) PHONE_BOOK_LOG(::async_logger::LogLevel::INFO, message)
+#else
+#define PHONE_BOOK_LOG_INFO(message) do { } while (false)
+#endif
+
+#if PHONE_BOOK_LOG_COMPILED_LEVEL <= 2
+#define PHONE_BOOK_LOG_WARNING(message) PHONE_BOOK_LOG(::async_logger::LogLevel::WARNING, message)
+#else
+#define PHONE_BOOK_LOG_WARNING(message) do { } while (false)
+#endif
+
+#define PHONE_BOOK_LOG_ERROR(message) PHONE_BOOK_LOG(::async_logger::LogLevel::ERROR, message)
@@ -0,0 +1,123 @@
+// Заголовочный файл atomic_shared_ptr.h описывает умный указатель shared_ptr, который атомарно читается и заменяется
+// без блокировок (используется базой данных для телефонной книги для публикации текущей версии базы данных)
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку memory для работы умных указателей, библиотеку atomic для атомарных операций и библиотеку
+// cstdint для целых чисел фиксированной ширины
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён атомарного умного указателя
+namespace atomic_shared_ptr {
+
+// Класс умного указателя shared_ptr<T>, который читается (Load) и заменяется (Store) атомарно и без блокировок
+//
+// Стандартные std::atomic_load и std::atomic_store для shared_ptr в libstdc++ не являются lock-free: каждый вызов
+// захватывает mutex из общего на всю программу пула mutex'ов (выбирается по hash'у адреса указателя), поэтому все
+// читатели одного указателя выстраиваются в очередь к одному mutex'у, а вытесненный планировщиком владелец mutex'а
+// останавливает их всех. Здесь используется разделённый подсчёт ссылок (split reference counting):
+//
+// - текущий shared_ptr лежит в узле Node в heap'е, а указатель на узел вместе с локальным счётчиком читателей
+//   упакован в одно 64-битное атомарное слово: младшие 48 бит - адрес узла, старшие 16 бит - число читателей,
+//   которые сейчас копируют shared_ptr из этого узла;
+// - читатель одним fetch_add увеличивает локальный счётчик (после этого узел не может быть удалён), копирует
+//   shared_ptr из узла и затем уменьшает локальный счётчик через compare_exchange, если узел всё ещё текущий;
+// - писатель одним exchange подменяет слово на новый узел и переносит доставшийся ему локальный счётчик старого
+//   узла в счётчик узла released (прибавляя его). Читатель, который не успел уменьшить локальный счётчик до
+//   замены узла, вместо этого вычитает единицу из released. Кто из них доведёт released до нуля, тот и удаляет
+//   старый узел (вместе с ним отпускается и старый shared_ptr).
+//
+// Все операции читателя - это fetch_add, короткий цикл compare_exchange (повторяется, только если слово изменил
+// другой читатель или писатель) и копирование shared_ptr, поэтому ни один поток никогда не ждёт другой поток.
+//
+// Замечание: локальный счётчик ограничен 65535 читателями, одновременно находящимися внутри Load (между fetch_add
+// и compare_exchange), а адреса в heap'е должны помещаться в 48 бит (так устроены адресные пространства x86-64 и
+// AArch64)
+//
+// (поскольку класс шаблонный, его методы определены прямо в header-файле)
+template <typename T>
+class AtomicSharedPtr final {
+public:
+    // Конструктор, сохраняющий указатель value
+    explicit AtomicSharedPtr(std::shared_ptr<T> value) : word_(Pack(new Node{std::move(value)})) { }
+
+    // Деструктор отпускает текущий узел (читателей к этому моменту быть не должно)
+    ~AtomicSharedPtr() {
+        Release(word_.load(std::memory_order_acquire));
+    }
+
+    AtomicSharedPtr(const AtomicSharedPtr&) = delete;
+    AtomicSharedPtr& operator=(const AtomicSharedPtr&) = delete;
+
+    // Функция атомарного чтения указателя
+    std::shared_ptr<T> Load() const {
+        // Защищаем текущий узел от удаления, увеличив его локальный счётчик читателей
+        uint64_t expected = word_.fetch_add(ONE_READER, std::memory_order_acquire) + ONE_READER;
+        Node* const node = NodeOf(expected);
+
+        std::shared_ptr<T> result = node->value;
+
+        // Снимаем защиту: пока узел текущий, уменьшаем локальный счётчик в слове, а если писатель уже заменил
+        // узел (и перенёс локальный счётчик в released), вычитаем единицу из released
+        while (NodeOf(expected) == node) {
+            if (word_.compare_exchange_weak(expected, expected - ONE_READER, std::memory_order_release,
+                                            std::memory_order_relaxed)) {
+                return result;
+            }
+        }
+        if (node->released.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete node;
+        }
+        return result;
+    }
+
+    // Функция атомарной замены указателя на value (старый указатель отпускается, когда его отпустят читатели,
+    // которые копируют его в этот момент)
+    void Store(std::shared_ptr<T> value) {
+        Release(word_.exchange(Pack(new Node{std::move(value)}), std::memory_order_acq_rel));
+    }
+
+private:
+    // Структура узла с умным указателем и счётчиком читателей, перенесённых писателем из слова (читатели,
+    // завершившие чтение уже после замены узла, вычитают из него по единице)
+    struct Node {
+        std::shared_ptr<T> value;
+        std::atomic<int64_t> released{0};
+    };
+
+    static_assert(sizeof(void*) == sizeof(uint64_t), "AtomicSharedPtr requires 64-bit pointers");
+
+    // Число бит адреса узла в слове и единица локального счётчика читателей
+    static constexpr unsigned POINTER_BITS = 48;
+    static constexpr uint64_t ONE_READER = uint64_t{1} << POINTER_BITS;
+
+    // Функции упаковки адреса узла в слово и распаковки адреса из слова
+    static uint64_t Pack(Node* node) {
+        return reinterpret_cast<uintptr_t>(node);
+    }
+
+    static Node* NodeOf(uint64_t word) {
+        return reinterpret_cast<Node*>(static_cast<uintptr_t>(word & (ONE_READER - 1)));
+    }
+
+    // Функция отпускания узла, вынутого из слова word: локальный счётчик читателей переносится в released, и
+    // узел удаляется, если все эти читатели уже завершили чтение
+    static void Release(uint64_t word) {
+        Node* const node = NodeOf(word);
+        const int64_t readers = static_cast<int64_t>(word >> POINTER_BITS);
+        if (node->released.fetch_add(readers, std::memory_order_acq_rel) + readers == 0) {
+            delete node;
+        }
+    }
+
+    // Слово с адресом текущего узла и локальным счётчиком читателей
+    mutable std::atomic<uint64_t> word_;
+};
+
+}
@@ -0,0 +1,56 @@
+// Заголовочный файл binary_encoding.h содержит в себе функции двоичного кодирования, общие для журнала упреждающей
+// записи, двоичного файла базы данных и сериализации списков записей слов: контрольную сумму CRC-32C и запись и
+// чтение чисел фиксированной длины в порядке little-endian
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку string и string_view для работы со строками, библиотеку cstdint для целочисленных типов
+// фиксированного размера и библиотеку cstddef для типа size_t
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён функций двоичного кодирования
+namespace binary_encoding {
+
+// Пространство имён для вспомогательных объектов и функций
+namespace detail {
+
+// Функции обновления контрольной суммы CRC-32C байтами data (без начальной и конечной инверсии): скалярная (по
+// таблице) и аппаратная SSE4.2 реализации с одинаковым результатом (инструкция crc32 есть только на процессорах
+// x86-64, и вызывать эту реализацию можно, только если процессор поддерживает SSE4.2)
+uint32_t Crc32cScalar(uint32_t crc, const char* data, size_t size);
+#if defined(__GNUC__) && defined(__x86_64__)
+uint32_t Crc32cSSE42(uint32_t crc, const char* data, size_t size);
+#endif
+
+// Функция выбора реализации CRC-32C по возможностям процессора (SSE4.2, иначе скалярная)
+uint32_t (*ChooseCrc32c())(uint32_t, const char*, size_t);
+
+}
+
+// Функция подсчёта контрольной суммы CRC-32C (Castagnoli) байтов data
+// (crc - контрольная сумма предшествующих байтов, если сумма считается по частям)
+//
+// (определение/definition этой функции находится в binary_encoding.cpp)
+uint32_t Crc32c(std::string_view data, uint32_t crc = 0);
+
+// Функции дописывания в конец строки чисел по 4 и 8 байт в порядке little-endian
+//
+// (определения/definition'ы этих функций находятся в binary_encoding.cpp)
+void AppendFixed32(std::string& buffer, uint32_t value);
+void AppendFixed64(std::string& buffer, uint64_t value);
+
+// Функции чтения чисел по 4 и 8 байт в порядке little-endian из начала data (data сдвигается за прочитанное число;
+// возвращают false, если байтов не хватает)
+//
+// (определения/definition'ы этих функций находятся в binary_encoding.cpp)
+bool ReadFixed32(std::string_view& data, uint32_t& value);
+bool ReadFixed64(std::string_view& data, uint64_t& value);
+
+}
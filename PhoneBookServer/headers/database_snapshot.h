@@ -0,0 +1,254 @@
+// Заголовочный файл database_snapshot.h описывает двоичный формат файла базы данных для телефонной книги (snapshot):
+// запись файла потоком и чтение файла, отображённого в память (mmap), без разбора текста
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку string и string_view для работы со строками, библиотеку vector для использования контейнера
+// вектора, библиотеку optional для работы со случаями, когда секции в файле нет, библиотеку cstdint для целочисленных
+// типов фиксированного размера и библиотеку cstddef для типа size_t
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён двоичного формата файла базы данных
+namespace database_snapshot {
+
+// Архитектура двоичного формата файла базы данных:
+//
+// Текстовый формат (строка <id="..." name="..." ...> на запись) приходится разбирать посимвольно и выделять память
+// под каждое поле, поэтому загрузка больших баз данных занимает минуты. Двоичный файл не разбирается вовсе: он
+// отображается в память (mmap), а поля записей читаются как string_view прямо из отображённых страниц, поэтому
+// загрузка упирается в чтение страниц с диска и построение словарей базы данных, а не в разбор текста.
+//
+// Все числа хранятся в порядке little-endian. Файл состоит из:
+//
+// 1) заголовка (HEADER_SIZE байт): сигнатура "PHBOOKDB", версия формата, контрольная сумма заголовка, число записей,
+//    номер/id последней записи, положение и число элементов каталога секций и контрольная сумма каталога;
+//
+// 2) секций - непрерывных областей файла, каждая со своим типом и контрольной суммой CRC-32C:
+//    - RECORDS - таблица записей фиксированной ширины (RECORD_ENTRY_SIZE байт на запись: номер/id, смещение полей
+//      записи в секции STRINGS и длины пяти полей), поэтому i-я запись находится без просмотра предыдущих;
+//    - STRINGS - куча строк: поля всех записей подряд (имя, фамилия, отчество, номер телефона, заметка) без
+//      разделителей и экранирования;
+//    - INDEXES - сохранённые словари базы данных (по секции на базу данных или шард, формат содержимого описан в
+//      phone_book_database.h), поэтому при загрузке словари не строятся заново;
+//    - секции других типов могут добавляться после кучи строк, читатель находит их по типу (FindSection,
+//      FindSections), а секции неизвестных ему типов пропускает;
+//
+// 3) каталога секций (в конце файла): тип, контрольная сумма, смещение и длина каждой секции. Каталог пишется
+//    последним, а заголовок - после него, поэтому файл, запись которого прервалась, не проходит проверку заголовка.
+//
+// Версия формата увеличивается при любом несовместимом изменении, файл с неизвестной версией не загружается.
+// Писатель (SnapshotWriter) пишет таблицу записей и кучу строк потоком в две области файла (смещение кучи известно
+// заранее, так как ширина таблицы фиксирована), поэтому память при записи не зависит от числа записей.
+
+// Сигнатура, версия формата и размеры элементов файла
+inline constexpr std::string_view MAGIC = "PHBOOKDB";
+inline constexpr uint32_t FORMAT_VERSION = 1;
+inline constexpr size_t HEADER_SIZE = 64;
+inline constexpr size_t RECORD_ENTRY_SIZE = 40;
+inline constexpr size_t SECTION_ENTRY_SIZE = 32;
+
+// Типы секций файла
+enum class SectionType : uint32_t {
+    RECORDS = 1,
+    STRINGS = 2,
+    INDEXES = 3
+};
+
+// Структура записи, прочитанной из файла (string_view ссылаются на отображённые в память страницы файла и
+// действительны, пока жив MappedSnapshot)
+struct RecordView {
+    uint64_t id = 0;
+    std::string_view name;
+    std::string_view surname;
+    std::string_view patronymic;
+    std::string_view number;
+    std::string_view note;
+};
+
+// Класс писателя двоичного файла базы данных
+class SnapshotWriter final {
+private:
+    // Имя файла и его файловый дескриптор
+    std::string file_name_;
+    int file_descriptor_ = -1;
+
+    // Число записей, объявленное при создании писателя, и номер/id последней записи
+    uint64_t records_count_;
+    uint64_t last_record_id_;
+
+    // Число уже добавленных записей
+    uint64_t added_records_count_ = 0;
+
+    // Буферы таблицы записей и кучи строк (сбрасываются в файл по мере заполнения) и положение в файле, куда будет
+    // записан каждый из буферов
+    std::string records_buffer_;
+    std::string strings_buffer_;
+    uint64_t records_position_;
+    uint64_t strings_position_;
+
+    // Положение конца файла после кучи строк и уже записанных секций (куда пишется следующая секция)
+    uint64_t end_position_ = 0;
+
+    // Длина кучи строк и контрольные суммы таблицы записей и кучи строк (считаются по мере записи)
+    uint64_t strings_size_ = 0;
+    uint32_t records_checksum_ = 0;
+    uint32_t strings_checksum_ = 0;
+
+    // Каталог секций (заполняется по мере записи секций, пишется в Finish)
+    std::string directory_;
+    uint64_t sections_count_ = 0;
+
+    // Флаг того, что секции после кучи строк уже начаты (после этого записи добавлять нельзя)
+    bool strings_finished_ = false;
+
+public:
+    // Размер буфера, после заполнения которого он сбрасывается в файл
+    static constexpr size_t BUFFER_SIZE = size_t{1} << 20;
+
+    // Конструктор писателя принимает имя файла (файл создаётся или перезаписывается), число записей, которые будут
+    // добавлены, и номер/id последней записи
+    // (выбрасывает исключение, если файл не удалось открыть)
+    //
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    SnapshotWriter(const std::string& file_name, uint64_t records_count, uint64_t last_record_id);
+
+    // Деструктор закрывает файл (если Finish не был вызван, файл остаётся недописанным и не пройдёт проверку)
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Функция добавления записи (порядок записей в файле не важен, так как номер/id сохраняется вместе с каждой записью)
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    void AddRecord(uint64_t id, std::string_view name, std::string_view surname, std::string_view patronymic,
+                   std::string_view number, std::string_view note);
+
+    // Функция добавления секции типа type с содержимым data (после всех записей)
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    void AddSection(SectionType type, std::string_view data);
+
+    // Функция завершения файла: сбрасывает буферы, пишет каталог секций и заголовок и синхронизирует файл с диском
+    // (выбрасывает исключение, если добавлено не объявленное число записей или файл не удалось записать)
+    //
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    void Finish();
+
+private:
+    // Функция записи data в файл с положения position (выбрасывает исключение при ошибке)
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    void WriteAt(uint64_t position, std::string_view data);
+
+    // Функция сброса буфера таблицы записей и буфера кучи строк в файл
+    // (определения/definition'ы этих функций находятся в database_snapshot.cpp)
+    void FlushRecords();
+    void FlushStrings();
+
+    // Функция завершения кучи строк (вносит таблицу записей и кучу строк в каталог секций)
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    void FinishStrings();
+};
+
+// Класс файла, отображённого в память только для чтения (используется и для загрузки файла в прежнем текстовом
+// формате, который разбирается прямо из отображённых страниц)
+class MappedFile final {
+private:
+    // Отображённые в память байты файла (у пустого файла отображения нет)
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+
+public:
+    // Конструктор отображает файл file_name в память и просит ядро заранее прочитать его страницы
+    // (выбрасывает исключение, если файл не удалось открыть или отобразить)
+    //
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    explicit MappedFile(const std::string& file_name);
+
+    // Деструктор снимает отображение файла
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Функция получения байтов файла (действительны, пока жив MappedFile)
+    std::string_view Data() const {
+        return {data_, size_};
+    }
+};
+
+// Класс двоичного файла базы данных, отображённого в память
+class MappedSnapshot final {
+private:
+    // Структура элемента каталога секций
+    struct Section {
+        SectionType type;
+        std::string_view data;
+    };
+
+    // Отображённый в память файл
+    MappedFile file_;
+
+    // Число записей и номер/id последней записи
+    uint64_t records_count_ = 0;
+    uint64_t last_record_id_ = 0;
+
+    // Таблица записей и куча строк
+    std::string_view records_;
+    std::string_view strings_;
+
+    // Каталог секций
+    std::vector<Section> sections_;
+
+public:
+    // Функция проверки, записан ли файл file_name в двоичном формате (по сигнатуре в начале файла; если файла нет или
+    // он в текстовом формате, возвращает false)
+    //
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    static bool IsSnapshotFile(const std::string& file_name);
+
+    // Конструктор отображает файл file_name в память и проверяет сигнатуру, версию формата, границы и контрольные суммы
+    // заголовка, каталога и всех секций
+    // (выбрасывает исключение, если файл не удалось открыть или он повреждён)
+    //
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    explicit MappedSnapshot(const std::string& file_name);
+
+    MappedSnapshot(const MappedSnapshot&) = delete;
+    MappedSnapshot& operator=(const MappedSnapshot&) = delete;
+
+    // Функция получения числа записей
+    uint64_t RecordsCount() const {
+        return records_count_;
+    }
+
+    // Функция получения номера/id последней записи
+    uint64_t LastRecordId() const {
+        return last_record_id_;
+    }
+
+    // Функция получения записи с индексом index в таблице записей (index < RecordsCount(); выбрасывает исключение, если
+    // поля записи выходят за кучу строк)
+    //
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    RecordView GetRecord(size_t index) const;
+
+    // Функция поиска секции типа type (если её нет, возвращает nullopt)
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    std::optional<std::string_view> FindSection(SectionType type) const;
+
+    // Функция поиска всех секций типа type (в порядке каталога секций)
+    // (определение/definition этой функции находится в database_snapshot.cpp)
+    std::vector<std::string_view> FindSections(SectionType type) const;
+};
+
+}
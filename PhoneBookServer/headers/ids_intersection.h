@@ -0,0 +1,59 @@
+// Заголовочный файл ids_intersection.h содержит в себе функции пересечения отсортированных массивов номеров/id записей
+// (используется при поиске записей по нескольким полям сразу)
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку cstddef для типа size_t
+#include <cstddef>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён для функций пересечения массивов номеров/id записей
+namespace ids_intersection {
+
+// Пространство имён для вспомогательных объектов и функций
+namespace detail {
+
+// Тип функции слияния двух отсортированных массивов номеров/id в их пересечение
+using MergeFunction = size_t (*)(const size_t* lhs, size_t lhs_size, const size_t* rhs, size_t rhs_size, size_t* out);
+
+// Функции пересечения слиянием: скалярная (без ветвлений на каждую пару номеров/id) и векторная AVX2 (сравнивает
+// блоки по 4 номера/id каждый с каждым) реализации с одинаковым результатом (AVX2 есть только на процессорах x86-64,
+// и вызывать её можно, только если процессор поддерживает этот набор инструкций)
+size_t IntersectMergeScalar(const size_t* lhs, size_t lhs_size, const size_t* rhs, size_t rhs_size, size_t* out);
+#if defined(__GNUC__) && defined(__x86_64__)
+size_t IntersectMergeAVX2(const size_t* lhs, size_t lhs_size, const size_t* rhs, size_t rhs_size, size_t* out);
+#endif
+
+// Структура реализации пересечения слиянием: функция слияния и отношение размеров массивов, начиная с которого
+// меньший массив выгоднее искать в большем поиском с галопом (слияние AVX2 в несколько раз быстрее скалярного,
+// поэтому и галоп выгоден ему лишь при гораздо большем отношении)
+struct MergeImplementation {
+    MergeFunction function;
+    size_t gallop_ratio;
+};
+
+// Отношения размеров массивов для перехода к поиску с галопом (измерены на массивах до миллиона номеров/id)
+inline constexpr size_t GALLOP_RATIO_SCALAR = 16;
+inline constexpr size_t GALLOP_RATIO_AVX2 = 256;
+
+// Функция выбора реализации пересечения слиянием по возможностям процессора (AVX2, иначе скалярная)
+MergeImplementation ChooseIntersectMerge();
+
+// Функция пересечения поиском с галопом: каждый номер/id меньшего массива small ищется в большем массиве large
+// экспоненциальным шагом от места предыдущей находки, а затем бинарным поиском внутри найденного шага
+size_t IntersectGallop(const size_t* small, size_t small_size, const size_t* large, size_t large_size, size_t* out);
+
+}
+
+// Функция пересечения двух отсортированных по возрастанию массивов номеров/id без повторов lhs и rhs
+// (записывает пересечение по возрастанию в out и возвращает его размер; out может совпадать с lhs - тогда пересечение
+//  строится на месте, иначе в out должно помещаться min(lhs_size, rhs_size) номеров/id)
+//
+// Если один массив больше другого во много раз (см. MergeImplementation::gallop_ratio), меньший ищется в большем поиском
+// с галопом за O(m * log(n / m)), иначе массивы сливаются (AVX2 или скалярной реализацией, выбранной при первом вызове)
+size_t IntersectSortedIds(const size_t* lhs, size_t lhs_size, const size_t* rhs, size_t rhs_size, size_t* out);
+
+}
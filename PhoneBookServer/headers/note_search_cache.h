@@ -0,0 +1,141 @@
+// Заголовочный файл note_search_cache.h описывает кэш результатов поиска записей по содержанию заметок с
+// инвалидацией по поколениям слов запроса
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеки string и string_view для ключей кэша, библиотеки vector, list и unordered_map для использования контейнеров
+// вектора, списка и hash-таблицы, библиотеку memory для работы умных указателей, библиотеку mutex для разграничения
+// доступа к кэшу из нескольких потоков и библиотеку cstdint для счётчиков статистики
+#include <string>
+#include <string_view>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// Подключим заголовочный файл базы данных для телефонной книги (записи и параметры ранжирования)
+#include "phone_book_database.h"
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён базы данных для телефонной книги
+namespace phone_book_database {
+
+// Класс кэша результатов поиска записей по содержанию заметок
+//
+// Одни и те же запросы (например, "VIP" или "не звонить") повторяются тысячи раз, а каждый из них заново ранжирует
+// длинные списки записей слов. Кэш хранит готовые топы записей по ключу "Отсортированные различные слова запроса,
+// ограничение на число записей, параметры ранжирования" и вытесняет давно не использованные результаты (LRU), когда
+// суммарный размер результатов превышает ёмкость кэша в байтах.
+//
+// Результат поиска зависит только от списков записей слов запроса (PostingList) и, через частоты IDF и среднюю
+// длину заметки, от числа записей и суммарной длины заметок. Шардированная база данных хранит для каждого слова
+// заметок поколение - номер из общего для всех слов счётчика, который выдаётся слову заново при каждом изменении его
+// списков записей в любом из шардов (см. sharded_phone_book_database.h). Вместе с результатом кэш хранит поколения
+// слов запроса, и результат действителен, пока поколения не изменились (номера поколений не повторяются, даже если
+// слово исчезло из заметок и появилось снова). Запись, не затрагивающая слова запроса, его результат не
+// инвалидирует.
+//
+// Число записей N и суммарная длина заметок входят в IDF каждого слова и в нормировку BM25, и даже малое их изменение
+// может переставить записи с близкой релевантностью. Поэтому результат действителен, только если число записей и
+// суммарная длина заметок в точности равны значениям на момент вычисления: после любого добавления или удаления записи
+// все результаты устаревают, а кэш помогает на повторяющихся запросах между записями в базу данных.
+//
+// Все методы кэша потокобезопасны (один mutex на кэш, под ним лишь поиск в hash-таблице, сравнение версий и
+// перестановка в списке LRU, а копирование результата выполняется вызывающим после освобождения mutex'а).
+class NoteSearchCache final {
+public:
+    // Тип результата поиска, хранимого в кэше (неизменяемый, разделяется между кэшем и читателями)
+    using Records = std::vector<PhoneBookDatabase::RecordWithId>;
+
+    // Структура версии данных, по которым вычислен результат поиска
+    struct DataVersion {
+        size_t records_count = 0; // Число записей во всех шардах
+        size_t notes_length = 0;  // Суммарная длина заметок во всех шардах
+
+        // Поколения слов запроса в порядке слов (для слов, которых нет в заметках, - 0)
+        std::vector<uint64_t> word_generations;
+    };
+
+    // Структура статистики кэша
+    struct Stats {
+        uint64_t hits = 0;          // Число попаданий
+        uint64_t misses = 0;        // Число промахов (в том числе из-за устаревших результатов)
+        uint64_t invalidations = 0; // Число результатов, удалённых из-за изменения слов запроса или числа записей
+        uint64_t evictions = 0;     // Число результатов, вытесненных из-за нехватки ёмкости
+        size_t entries = 0;         // Число результатов в кэше
+        size_t bytes = 0;           // Оценка занятой результатами памяти в байтах
+        size_t capacity_bytes = 0;  // Ёмкость кэша в байтах
+    };
+
+    // Конструктор кэша принимает ёмкость в байтах (при нулевой ёмкости кэш ничего не хранит)
+    explicit NoteSearchCache(size_t capacity_bytes) : capacity_bytes_(capacity_bytes) {
+    }
+
+    // Функция построения ключа кэша по отсортированным различным словам запроса words, ограничению на число записей и
+    // параметрам ранжирования (параметры BM25 входят в ключ, только если выбрана модель BM25)
+    // (определение/definition этой функции находится в note_search_cache.cpp)
+    static std::string MakeKey(const std::vector<std::string_view>& words, size_t max_records_count,
+                               const NoteRankingParams& ranking_params);
+
+    // Функция поиска результата по ключу key, действительного для текущей версии данных version
+    // (возвращает nullptr при промахе; устаревший результат удаляется из кэша)
+    // (определение/definition этой функции находится в note_search_cache.cpp)
+    std::shared_ptr<const Records> Find(const std::string& key, const DataVersion& version);
+
+    // Функция добавления результата records, вычисленного по версии данных version, под ключом key
+    // (вытесняет давно не использованные результаты, пока не хватает ёмкости; результат больше всей ёмкости кэша
+    //  не добавляется)
+    // (определение/definition этой функции находится в note_search_cache.cpp)
+    void Insert(std::string key, DataVersion version, std::shared_ptr<const Records> records);
+
+    // Функция удаления всех результатов (например, после загрузки базы данных из файла)
+    // (определение/definition этой функции находится в note_search_cache.cpp)
+    void Clear();
+
+    // Функция получения статистики кэша
+    // (определение/definition этой функции находится в note_search_cache.cpp)
+    Stats GetStats() const;
+
+private:
+    // Структура элемента кэша
+    struct Entry {
+        std::string key;                        // Ключ результата
+        DataVersion version;                    // Версия данных, по которой вычислен результат
+        std::shared_ptr<const Records> records; // Результат поиска
+        size_t bytes = 0;                       // Оценка занятой элементом памяти в байтах
+    };
+
+    // Функция проверки, что результат, вычисленный по версии данных cached, действителен для версии current
+    // (определение/definition этой функции находится в note_search_cache.cpp)
+    static bool IsValid(const DataVersion& cached, const DataVersion& current);
+
+    // Функция оценки занятой элементом кэша памяти в байтах
+    // (определение/definition этой функции находится в note_search_cache.cpp)
+    static size_t EntryBytes(const Entry& entry);
+
+    // Функция удаления элемента по итератору в списке LRU (вызывающий метод должен захватить mutex)
+    // (определение/definition этой функции находится в note_search_cache.cpp)
+    void EraseEntry(std::list<Entry>::iterator entry);
+
+    // Ёмкость кэша в байтах
+    const size_t capacity_bytes_;
+
+    // Mutex кэша
+    mutable std::mutex mutex_;
+
+    // Список элементов от недавно использованных к давно не использованным (LRU)
+    std::list<Entry> entries_;
+
+    // Hash-таблица "Ключ -> Итератор элемента в списке LRU" (ключи string_view ссылаются на строки ключей элементов)
+    std::unordered_map<std::string_view, std::list<Entry>::iterator> index_;
+
+    // Статистика кэша
+    Stats stats_;
+};
+
+}
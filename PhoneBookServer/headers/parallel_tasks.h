@@ -0,0 +1,135 @@
+// Заголовочный файл parallel_tasks.h описывает постоянный пул рабочих потоков и параллельное выполнение независимых
+// задач в нём (используется при загрузке данных в базу из файла, параллельных запросах ко всем шардам и пакетном
+// добавлении записей в шарды)
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку vector для использования контейнера вектора, библиотеку deque для очереди задач пула,
+// библиотеку functional для хранения задач, библиотеки thread, mutex, condition_variable и atomic для рабочих потоков
+// и их синхронизации, библиотеку memory для умного указателя на общее состояние задач, библиотеку exception для
+// передачи исключения задачи вызывающему, библиотеку algorithm для функций min и max и библиотеку cstddef для типа
+// size_t
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён параллельного выполнения задач
+namespace parallel_tasks {
+
+// Класс постоянного пула рабочих потоков: потоки создаются один раз в конструкторе и до деструктора выполняют задачи из
+// общей очереди, поэтому параллельный запрос не создаёт потоков (и не может упасть на их создании), а число потоков
+// не растёт с числом одновременных запросов
+class WorkerPool final {
+public:
+    // Конструктор создаёт threads_count рабочих потоков (при нуле потоков все задачи RunInParallel выполняет
+    // вызывающий поток)
+    // (определение/definition этой функции находится в parallel_tasks.cpp)
+    explicit WorkerPool(size_t threads_count);
+
+    // Деструктор дожидается окончания задач, уже поставленных в очередь, и останавливает рабочие потоки
+    // (определение/definition этой функции находится в parallel_tasks.cpp)
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    // Функция получения числа рабочих потоков пула
+    size_t ThreadsCount() const {
+        return threads_.size();
+    }
+
+    // Функция постановки задачи task в очередь пула (задача не должна выбрасывать исключений)
+    // (определение/definition этой функции находится в parallel_tasks.cpp)
+    void Submit(std::function<void()> task);
+
+private:
+    // Функция рабочего потока: выполняет задачи из очереди, пока пул не остановлен и очередь не пуста
+    // (определение/definition этой функции находится в parallel_tasks.cpp)
+    void WorkerLoop();
+
+    // Mutex и условная переменная очереди задач, очередь задач и флаг остановки пула
+    std::mutex mutex_;
+    std::condition_variable task_added_;
+    std::deque<std::function<void()>> tasks_;
+    bool stop_ = false;
+
+    // Рабочие потоки
+    std::vector<std::thread> threads_;
+};
+
+// Функция параллельного выполнения задач function(0), ..., function(tasks_count - 1) не более чем в threads_count
+// потоках: вызывающем и рабочих потоках пула worker_pool. Задачи разбираются по одной через атомарный счётчик, и
+// вызывающий поток разбирает их наравне с рабочими, поэтому задачи выполняются, даже если все рабочие потоки заняты
+// (в том числе вложенными вызовами RunInParallel). Функция возвращается, когда выполнены все задачи, первое исключение
+// задачи передаётся вызывающему
+template <typename Function>
+void RunInParallel(WorkerPool& worker_pool, size_t tasks_count, size_t threads_count, Function function) {
+    threads_count = std::max<size_t>(std::min({threads_count, tasks_count, worker_pool.ThreadsCount() + 1}), 1);
+
+    // При одном потоке задачи выполняются в вызывающем потоке без пула
+    if (threads_count == 1) {
+        for (size_t task_index = 0; task_index < tasks_count; ++task_index) {
+            function(task_index);
+        }
+        return;
+    }
+
+    // Общее состояние задач лежит под умным указателем: рабочий поток может взяться за него уже после возврата из
+    // функции, тогда он не найдёт невыполненных задач и не обратится к function
+    struct State {
+        std::atomic<size_t> next_task{0};
+        std::mutex mutex;
+        std::condition_variable all_done;
+        size_t done_count = 0;
+        std::exception_ptr exception;
+    };
+    const auto state = std::make_shared<State>();
+
+    // Разбор задач одним потоком
+    const auto run_tasks = [state, tasks_count, function = &function]() {
+        size_t task_index;
+        while ((task_index = state->next_task.fetch_add(1)) < tasks_count) {
+            std::exception_ptr exception;
+            try {
+                (*function)(task_index);
+            } catch (...) {
+                exception = std::current_exception();
+            }
+
+            std::lock_guard lock(state->mutex);
+            if (exception && !state->exception) {
+                state->exception = exception;
+            }
+            if (++state->done_count == tasks_count) {
+                state->all_done.notify_one();
+            }
+        }
+    };
+
+    for (size_t i = 1; i < threads_count; ++i) {
+        worker_pool.Submit(run_tasks);
+    }
+    run_tasks();
+
+    // Дожидаемся задач, взятых рабочими потоками
+    std::unique_lock lock(state->mutex);
+    state->all_done.wait(lock, [&state, tasks_count]() { return state->done_count == tasks_count; });
+
+    if (state->exception) {
+        std::rethrow_exception(state->exception);
+    }
+}
+
+}
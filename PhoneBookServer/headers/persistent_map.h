@@ -0,0 +1,472 @@
+// Заголовочный файл persistent_map.h описывает неизменяемые (persistent) словарь, множество и плотный массив со
+// структурным разделением данных между версиями, которые используются базой данных для телефонной книги для хранения
+// версий (snapshot'ов) базы данных
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку memory для работы умных указателей, библиотеки vector, array, map и set для использования
+// контейнеров вектора, массива, словаря и множества, библиотеку functional для использования стандартных hash-функций,
+// библиотеку iterator для описания итератора, библиотеку type_traits для проверок типов на этапе компиляции,
+// библиотеку stdexcept для работы со стандартными исключениями и библиотеку algorithm для сортировки элементов
+// и ключей при пакетных добавлении и поиске
+#include <memory>
+#include <vector>
+#include <array>
+#include <map>
+#include <set>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <stdexcept>
+#include <algorithm>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён неизменяемых контейнеров
+namespace persistent_map {
+
+// Функция копирования при записи (copy-on-write) контейнера, лежащего под умным указателем shared_ptr<const ...>:
+// возвращает неконстантную ссылку на контейнер, которым владеет только переданный умный указатель. Если контейнер
+// разделяется с другими версиями (на него ссылается кто-то ещё), умный указатель заменяется указателем на копию
+// контейнера, а старый контейнер остаётся нетронутым. Если указатель пустой, создаётся новый пустой контейнер.
+//
+// Если же на контейнер ссылается только переданный умный указатель, то контейнер уже принадлежит строящейся (ещё не
+// опубликованной) версии, и его можно изменять на месте: никакой другой поток не может получить на него ссылку.
+// Благодаря этому многократные изменения одного и того же контейнера в рамках одной версии не приводят к его
+// многократному копированию. Снятие константности законно, так как сам контейнер всегда создаётся неконстантным.
+template <typename Container>
+Container& CopyOnWrite(std::shared_ptr<const Container>& container) {
+    if (container && container.use_count() == 1) {
+        return const_cast<Container&>(*container);
+    }
+
+    std::shared_ptr<Container> copy = container ? std::make_shared<Container>(*container) : std::make_shared<Container>();
+    Container& result = *copy;
+    container = std::move(copy);
+    return result;
+}
+
+// Класс неизменяемого контейнера со структурным разделением данных между версиями
+// Параметры шаблона: тип корзины (std::map или std::set), hash-функция для ключа, число корзин
+//
+// Контейнер разбит на корзины (bucket'ы), каждая из которых является обычным словарём std::map или множеством
+// std::set, лежащим под умным указателем shared_ptr<const ...>. Ключ попадает в корзину по значению своего hash'а.
+// Корзины, в свою очередь, сгруппированы в блоки (chunk'и) по CHUNK_SIZE корзин, которые тоже лежат под умными
+// указателями, т.е. контейнер является двухуровневым деревом "Блоки -> Корзины -> Элементы".
+//
+// Копирование контейнера копирует лишь вектор умных указателей на блоки, т.е. новая копия разделяет все блоки и
+// корзины со старой. Изменение же копии копирует только тот блок и ту корзину, в которых лежит изменяемый ключ
+// (см. CopyOnWrite). Таким образом, построение следующей версии контейнера стоит O(число блоков + CHUNK_SIZE +
+// размер одной корзины), а не O(размер контейнера). Число блоков и CHUNK_SIZE выбираются близкими к корню из
+// BucketsCount (но не меньше 32 корзин в блоке), чтобы обе первые составляющие были минимальны.
+//
+// Маленький контейнер состоит из одной корзины (чтобы множества номеров/id записей с редкими именами и т.д. не
+// занимали лишнюю память), а при превышении SPLIT_SIZE элементов однократно разбивается на BucketsCount корзин.
+//
+// Замечание: порядок обхода разбитого на корзины контейнера не совпадает с порядком ключей, так как ключи
+// упорядочены лишь внутри своих корзин
+//
+// (поскольку класс шаблонный, его методы определены прямо в header-файле)
+template <typename Bucket, typename Hash, size_t BucketsCount>
+class PersistentContainer {
+public:
+    using key_type   = typename Bucket::key_type;   // Тип ключа
+    using value_type = typename Bucket::value_type; // Тип элемента (пара "ключ, значение" для словаря, ключ для множества)
+
+    // Число корзин в одном блоке
+    // (наименьшая степень двойки, квадрат которой не меньше BucketsCount, но не меньше 32)
+    static constexpr size_t CHUNK_SIZE = [] {
+        size_t chunk_size = 32;
+        while (chunk_size * chunk_size < BucketsCount) {
+            chunk_size *= 2;
+        }
+        return BucketsCount < chunk_size ? BucketsCount : chunk_size;
+    }();
+
+    // Число элементов, при превышении которого контейнер из одной корзины разбивается на BucketsCount корзин
+    // (одна корзина не должна быть большой, иначе её копирование при записи станет дорогим)
+    static constexpr size_t SPLIT_SIZE = 64;
+
+    static_assert(BucketsCount % CHUNK_SIZE == 0, "BucketsCount must be a multiple of CHUNK_SIZE");
+
+private:
+    // Тип блока корзин (вектор умных указателей на корзины, пустой указатель соответствует пустой корзине)
+    using Chunk = std::vector<std::shared_ptr<const Bucket>>;
+
+    // Вектор умных указателей на блоки корзин
+    std::vector<std::shared_ptr<const Chunk>> chunks_;
+
+    // Число корзин в контейнере (1 до разбиения, BucketsCount после)
+    size_t buckets_count_;
+
+    // Число элементов в контейнере
+    size_t size_;
+
+public:
+    // Константный итератор по элементам контейнера (обходит корзины по порядку, а элементы внутри корзины - по
+    // возрастанию ключей)
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = typename Bucket::value_type;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const value_type*;
+        using reference         = const value_type&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return *element_; }
+        pointer operator->() const { return &*element_; }
+
+        const_iterator& operator++() {
+            ++element_;
+            SkipEmptyBuckets();
+            return *this;
+        }
+
+        const_iterator operator++(int) {
+            const_iterator result = *this;
+            ++*this;
+            return result;
+        }
+
+        bool operator==(const const_iterator& other) const {
+            return bucket_index_ == other.bucket_index_ && (bucket_index_ == container_->buckets_count_ || element_ == other.element_);
+        }
+
+        bool operator!=(const const_iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        friend class PersistentContainer;
+
+        const PersistentContainer* container_ = nullptr; // Указатель на обходимый контейнер
+        size_t bucket_index_ = 0;                        // Номер текущей корзины
+        typename Bucket::const_iterator element_;       // Итератор внутри текущей корзины
+
+        // Конструктор итератора, указывающего на начало корзины с номером bucket_index (или на конец контейнера)
+        const_iterator(const PersistentContainer* container, size_t bucket_index) : container_(container),
+                                                                                    bucket_index_(bucket_index) {
+            if (bucket_index_ < container_->buckets_count_) {
+                if (const auto& bucket = container_->BucketAt(bucket_index_)) {
+                    element_ = bucket->begin();
+                }
+                SkipEmptyBuckets();
+            }
+        }
+
+        // Функция перехода к следующей непустой корзине, если текущая корзина закончилась
+        void SkipEmptyBuckets() {
+            while (bucket_index_ < container_->buckets_count_ && (!container_->BucketAt(bucket_index_) ||
+                                                                  element_ == container_->BucketAt(bucket_index_)->end())) {
+                ++bucket_index_;
+                if (bucket_index_ < container_->buckets_count_) {
+                    if (const auto& bucket = container_->BucketAt(bucket_index_)) {
+                        element_ = bucket->begin();
+                    }
+                }
+            }
+        }
+    };
+
+    // Конструктор создаёт пустой контейнер из одной корзины
+    PersistentContainer() : chunks_(1, std::make_shared<const Chunk>(1)), buckets_count_(1), size_(0) { }
+
+    // Функция получения числа элементов в контейнере
+    size_t size() const {
+        return size_;
+    }
+
+    // Функция проверки контейнера на пустоту
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Итераторы на начало и конец контейнера
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, buckets_count_); }
+
+    // Функция обхода непустых корзин контейнера: для каждой корзины вызывает function(const Bucket&)
+    // (элементы внутри корзины упорядочены по ключу, поэтому, слив корзины через кучу, можно обойти весь контейнер
+    // по возрастанию ключей, не копируя его элементы; корзины живут, пока жив сам контейнер)
+    template <typename Function>
+    void ForEachBucket(Function function) const {
+        for (const std::shared_ptr<const Chunk>& chunk : chunks_) {
+            for (const std::shared_ptr<const Bucket>& bucket : *chunk) {
+                if (bucket && !bucket->empty()) {
+                    function(*bucket);
+                }
+            }
+        }
+    }
+
+    // Функция получения числа элементов с указанным ключом (0 или 1)
+    size_t count(const key_type& key) const {
+        const std::shared_ptr<const Bucket>& bucket = BucketAt(BucketIndex(key));
+        return bucket ? bucket->count(key) : 0;
+    }
+
+    // Функция поиска элемента по ключу (возвращает указатель на элемент или nullptr, если ключа нет в контейнере;
+    // в отличие от пары count и at корзина ищется и обходится лишь однократно)
+    const value_type* Find(const key_type& key) const {
+        const std::shared_ptr<const Bucket>& bucket = BucketAt(BucketIndex(key));
+
+        if (!bucket) {
+            return nullptr;
+        }
+
+        auto it = bucket->find(key);
+        return it != bucket->end() ? &*it : nullptr;
+    }
+
+    // Функция пакетного поиска ключей вектора keys: для каждого ключа вызывает function(size_t key_index,
+    // const value_type* element), где key_index - номер ключа в векторе keys, а element - указатель на найденный
+    // элемент или nullptr, если ключа нет в контейнере. Ключи вначале упорядочиваются по номеру корзины и ключу, поэтому
+    // блоки и корзины читаются по порядку, каждая корзина - лишь однократно, а поиск соседних ключей в ней идёт по уже
+    // прогретым кэшем узлам дерева (функция вызывается в порядке корзин, а не в порядке ключей вектора)
+    template <typename Function>
+    void FindBatch(const std::vector<key_type>& keys, Function function) const {
+
+        // Упорядочиваем номера ключей по номеру корзины и ключу
+        std::vector<std::pair<size_t, size_t>> sorted_keys;
+        sorted_keys.reserve(keys.size());
+        for (size_t i = 0; i < keys.size(); ++i) {
+            sorted_keys.emplace_back(BucketIndex(keys[i]), i);
+        }
+
+        std::sort(sorted_keys.begin(), sorted_keys.end(), [&keys](const auto& lhs, const auto& rhs) {
+            return lhs.first != rhs.first ? lhs.first < rhs.first
+                                          : typename Bucket::key_compare{}(keys[lhs.second], keys[rhs.second]);
+        });
+
+        // Ищем ключи по корзинам
+        for (size_t begin = 0, end = 0; begin < sorted_keys.size(); begin = end) {
+            const size_t bucket_index = sorted_keys[begin].first;
+            const std::shared_ptr<const Bucket>& bucket = BucketAt(bucket_index);
+
+            for (end = begin; end < sorted_keys.size() && sorted_keys[end].first == bucket_index; ++end) {
+                const value_type* element = nullptr;
+
+                if (bucket) {
+                    auto it = bucket->find(keys[sorted_keys[end].second]);
+                    if (it != bucket->end()) {
+                        element = &*it;
+                    }
+                }
+
+                function(sorted_keys[end].second, element);
+            }
+        }
+    }
+
+    // Функция получения константной ссылки на значение по ключу (только для словаря)
+    // (если ключа нет в словаре, выдаёт exception std::out_of_range, как и std::map::at)
+    const auto& at(const key_type& key) const {
+        const std::shared_ptr<const Bucket>& bucket = BucketAt(BucketIndex(key));
+
+        if (!bucket) {
+            throw std::out_of_range("PersistentContainer::at");
+        }
+
+        return bucket->at(key);
+    }
+
+    // Функция получения неконстантной ссылки на значение по ключу (только для словаря; если ключа нет в словаре, он
+    // добавляется со значением по умолчанию). Блок и корзина с ключом при необходимости копируются, поэтому функцию
+    // можно вызывать только у ещё не опубликованной версии контейнера
+    auto& operator[](const key_type& key) {
+        SplitIfNeeded(size_ + 1);
+
+        auto [it, inserted] = MutableBucket(BucketIndex(key)).try_emplace(key);
+
+        if (inserted) {
+            ++size_;
+        }
+
+        return it->second;
+    }
+
+    // Функция добавления элемента (блок и корзина с ключом при необходимости копируются)
+    void insert(const value_type& value) {
+        SplitIfNeeded(size_ + 1);
+
+        if (MutableBucket(BucketIndex(KeyOf(value))).insert(value).second) {
+            ++size_;
+        }
+    }
+
+    // Функция пакетного добавления элементов вектора values (как и у insert, элементы с уже существующими ключами не
+    // добавляются). Элементы вначале упорядочиваются по номеру корзины и ключу, после чего каждая затронутая корзина
+    // копируется при записи лишь однократно, а элементы вставляются в неё подряд с подсказкой позиции (вставка
+    // упорядоченных ключей с подсказкой, например, новых номеров/id, больших всех существующих, стоит O(1))
+    void InsertBatch(const std::vector<value_type>& values) {
+        SplitIfNeeded(size_ + values.size());
+
+        // Упорядочиваем указатели на элементы по номеру корзины и ключу
+        std::vector<std::pair<size_t, const value_type*>> sorted_values;
+        sorted_values.reserve(values.size());
+        for (const value_type& value : values) {
+            sorted_values.emplace_back(BucketIndex(KeyOf(value)), &value);
+        }
+
+        std::sort(sorted_values.begin(), sorted_values.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.first != rhs.first ? lhs.first < rhs.first
+                                          : typename Bucket::key_compare{}(KeyOf(*lhs.second), KeyOf(*rhs.second));
+        });
+
+        // Вставляем элементы по корзинам
+        for (size_t begin = 0, end = 0; begin < sorted_values.size(); begin = end) {
+            const size_t bucket_index = sorted_values[begin].first;
+            Bucket& bucket = MutableBucket(bucket_index);
+            const size_t old_bucket_size = bucket.size();
+
+            // Следующий элемент корзины больше предыдущего, поэтому подсказкой служит позиция за предыдущим элементом
+            auto hint = bucket.end();
+            for (end = begin; end < sorted_values.size() && sorted_values[end].first == bucket_index; ++end) {
+                hint = std::next(bucket.insert(hint, *sorted_values[end].second));
+            }
+
+            size_ += bucket.size() - old_bucket_size;
+        }
+    }
+
+    // Функция удаления элемента по ключу (блок и корзина с ключом при необходимости копируются)
+    void erase(const key_type& key) {
+        const size_t bucket_index = BucketIndex(key);
+
+        if (!count(key)) {
+            return;
+        }
+
+        Bucket& bucket = MutableBucket(bucket_index);
+        bucket.erase(key);
+        --size_;
+
+        // Опустевшую корзину освобождаем
+        if (bucket.empty()) {
+            CopyOnWrite(chunks_[bucket_index / CHUNK_SIZE])[bucket_index % CHUNK_SIZE].reset();
+        }
+    }
+
+    // Функция замены ключа элемента на равный ему ключ (нужна, чтобы перевесить string_view ключа на другую строку
+    // с таким же содержимым, не трогая значение элемента)
+    void ReplaceKey(const key_type& key, const key_type& new_key) {
+        Bucket& bucket = MutableBucket(BucketIndex(key));
+
+        auto node_handler = bucket.extract(key);
+        SetNodeKey(node_handler, new_key);
+        bucket.insert(std::move(node_handler));
+    }
+
+private:
+    // Функция вычисления номера корзины для ключа
+    size_t BucketIndex(const key_type& key) const {
+        return buckets_count_ == 1 ? 0 : Hash{}(key) % buckets_count_;
+    }
+
+    // Функция получения константной ссылки на умный указатель на корзину по её номеру
+    const std::shared_ptr<const Bucket>& BucketAt(size_t bucket_index) const {
+        return (*chunks_[bucket_index / CHUNK_SIZE])[bucket_index % CHUNK_SIZE];
+    }
+
+    // Функция получения неконстантной ссылки на корзину по её номеру (блок и корзина при необходимости копируются)
+    Bucket& MutableBucket(size_t bucket_index) {
+        return CopyOnWrite(CopyOnWrite(chunks_[bucket_index / CHUNK_SIZE])[bucket_index % CHUNK_SIZE]);
+    }
+
+    // Функция получения ключа элемента
+    static const key_type& KeyOf(const key_type& key) { return key; }
+
+    template <typename Pair>
+    static const key_type& KeyOf(const Pair& element) { return element.first; }
+
+    // Функция изменения ключа у вынутого из корзины узла (у узлов словаря и множества разные методы доступа к ключу)
+    template <typename NodeHandler>
+    static void SetNodeKey(NodeHandler& node_handler, const key_type& new_key) {
+        if constexpr (std::is_same_v<typename Bucket::key_type, typename Bucket::value_type>) {
+            node_handler.value() = new_key;
+        }
+        else {
+            node_handler.key() = new_key;
+        }
+    }
+
+    // Функция разбиения контейнера из одной корзины на BucketsCount корзин, если число элементов превысит SPLIT_SIZE
+    void SplitIfNeeded(size_t new_size) {
+        if (buckets_count_ != 1 || new_size <= SPLIT_SIZE || BucketsCount == 1) {
+            return;
+        }
+
+        // Удерживаем единственную корзину, пока её элементы раскладываются по новым корзинам
+        const std::shared_ptr<const Bucket> old_bucket = BucketAt(0);
+
+        buckets_count_ = BucketsCount;
+        chunks_.assign(BucketsCount / CHUNK_SIZE, nullptr);
+        for (std::shared_ptr<const Chunk>& chunk : chunks_) {
+            chunk = std::make_shared<const Chunk>(CHUNK_SIZE);
+        }
+
+        if (old_bucket) {
+            for (const value_type& element : *old_bucket) {
+                MutableBucket(BucketIndex(KeyOf(element))).insert(element);
+            }
+        }
+    }
+};
+
+// Неизменяемый словарь (по умолчанию на 256 корзин)
+template <typename Key, typename Value, typename Hash = std::hash<Key>, size_t BucketsCount = 256>
+using PersistentMap = PersistentContainer<std::map<Key, Value>, Hash, BucketsCount>;
+
+// Неизменяемое множество (по умолчанию на 256 корзин)
+template <typename Key, typename Hash = std::hash<Key>, size_t BucketsCount = 256>
+using PersistentSet = PersistentContainer<std::set<Key>, Hash, BucketsCount>;
+
+// Класс неизменяемого плотного массива со структурным разделением данных между версиями
+// Параметры шаблона: тип элемента (небольшой тривиальный тип, например, целое число), размер блока
+//
+// Массив индексируется целым числом (например, номером/id записи) и разбит на блоки по ChunkSize элементов, лежащие
+// под умными указателями shared_ptr<const ...>. Копирование массива копирует лишь вектор умных указателей на блоки,
+// а изменение элемента копирует только его блок (см. CopyOnWrite). Элементы, которые ещё ни разу не задавались,
+// равны значению по умолчанию (нулю), а их блоки не выделяются вовсе. В отличие от словаря, чтение элемента - это
+// два обращения к памяти без поиска ключа, поэтому массив подходит для значений, которые читаются на каждую запись
+// при обходе больших выборок.
+//
+// (поскольку класс шаблонный, его методы определены прямо в header-файле)
+template <typename T, size_t ChunkSize = 4096>
+class PersistentArray {
+public:
+    // Функция получения элемента с индексом index (если элемент не задавался - значение по умолчанию)
+    T Get(size_t index) const {
+        const size_t chunk_index = index / ChunkSize;
+
+        if (chunk_index >= chunks_.size() || !chunks_[chunk_index]) {
+            return T();
+        }
+
+        return (*chunks_[chunk_index])[index % ChunkSize];
+    }
+
+    // Функция задания элемента с индексом index (массив при необходимости удлиняется)
+    void Set(size_t index, T value) {
+        const size_t chunk_index = index / ChunkSize;
+
+        if (chunk_index >= chunks_.size()) {
+            chunks_.resize(chunk_index + 1);
+        }
+
+        CopyOnWrite(chunks_[chunk_index])[index % ChunkSize] = value;
+    }
+
+private:
+    // Тип блока (make_shared создаёт блок, заполненный значениями по умолчанию)
+    using Chunk = std::array<T, ChunkSize>;
+
+    // Вектор умных указателей на блоки (пустой указатель - блок, элементы которого ещё не задавались)
+    std::vector<std::shared_ptr<const Chunk>> chunks_;
+};
+
+}
@@ -7,12 +7,35 @@
 
 // Подключим библиотеку optional для работы со случаями, когда результатом запроса к базе данных
 // может быть пустой ответ, библиотеку string для работы со строками, библиотеки vector, map и set
-// для использования контейнеров вектора, словаря и множества
+// для использования контейнеров вектора, словаря и множества, библиотеку memory для работы умных
+// указателей, библиотеку mutex для разграничения доступа к базе данных из нескольких потоков, библиотеку limits
+// для значения "без ограничения" числа записей в топе поиска по заметкам, библиотеку string_view для ссылок на строки
+// записей, а также библиотеку cstdint для целых чисел фиксированной ширины (длины заметок)
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <set>
+#include <memory>
+#include <mutex>
+#include <limits>
+#include <cstdint>
+
+// Подключим заголовочный файл неизменяемого словаря, в котором хранятся версии базы данных
+#include "persistent_map.h"
+
+// Подключим заголовочный файл неизменяемого списка записей слова для поиска записей по содержанию заметок
+#include "posting_list.h"
+
+// Подключим заголовочный файл двоичного формата файла базы данных (записи и словари сохраняются через его писателя)
+#include "database_snapshot.h"
+
+// Подключим заголовочный файл пула рабочих потоков и параллельного выполнения задач (загрузка данных из файла)
+#include "parallel_tasks.h"
+
+// Подключим заголовочный файл атомарного умного указателя без блокировок (публикация текущей версии базы данных)
+#include "atomic_shared_ptr.h"
 
 // Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
 // приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
@@ -28,67 +51,199 @@ namespace phone_book_database {
 // с помощью структуры Record, а структура RecordWithId используется лишь для возврата результатов
 // запросов из функций поиска записей по какому-либо критерию.
 //
-// Физически данные хранятся в словаре (map'е) "Номер/id записи -> записи":
-//    map<size_t, Record> records_;
+// Все данные базы хранятся в неизменяемой версии (snapshot'е) базы данных - структуре Snapshot. Физически
+// записи хранятся в словаре (map'е) "Номер/id записи -> записи", причём каждая запись лежит в heap'е под
+// умным указателем shared_ptr, поэтому одна и та же запись разделяется всеми версиями базы данных, где она есть:
+//    PersistentMap<size_t, shared_ptr<const Record>> records;
 //
 // Также для быстрого поиска записей по имени/фамилии/отчеству/номеру телефона введены следующие словари:
 //
 // 1) Словарь "Имя -> Номер/id записи":
-//    map<string_view, set<size_t>> name_to_records_;
+//    PersistentMap<string_view, PersistentSet<size_t>> name_to_records;
 //
 // 2) Словарь "Фамилия -> Номер/id записи":
-//    map<string_view, set<size_t>> surname_to_records_;
+//    PersistentMap<string_view, PersistentSet<size_t>> surname_to_records;
 //
 // 3) Словарь "Отчество -> Номер/id записи":
-//    map<string_view, set<size_t>> patronymic_to_records_;
+//    PersistentMap<string_view, PersistentSet<size_t>> patronymic_to_records;
 //
 // 4) Словарь "Номер телефона -> Номер/id записи":
-//    map<string_view, size_t> number_to_record_;
+//    PersistentMap<string_view, size_t> number_to_record;
 //
 // Ключами во всех этих словарях (map'ах) являются не строки (string'и), а ссылки на строки (string_view),
-// которые физически хранятся в контейнере records_, что уменьшает объём используемой базой данной оперативной
-// памяти. Необходимо следить за тем, чтобы string_view при инициализации ссылались именно на строки из
-// контейнера records_, а при удалении записей, вначале необходимо удалять содержимое контейнеров, где
-// ключами являются именно string_view, а потом уже удалять содержимое контейнера records_, иначе произойдёт
-// инвалидация ссылок на строки. Также при удалении записи через методы DeleteRecordById и DeleteRecordByNumber
-// необходимо перевешивать string_view в ключах и значениях на string'и других записей, иначе также произойдёт
-// инвалидация ссылок на строки. 
+// которые физически хранятся в записях контейнера records, что уменьшает объём используемой базой данной
+// оперативной памяти. Необходимо следить за тем, чтобы string_view при инициализации ссылались именно на
+// строки из записей контейнера records той же версии базы данных. Запись, удалённая из новой версии, может
+// продолжать жить в старых версиях, которые ещё читаются другими потоками, однако после их освобождения она
+// будет удалена из heap'а, поэтому при удалении записи через методы DeleteRecordById и DeleteRecordByNumber
+// необходимо перевешивать string_view в ключах и значениях на string'и других записей, иначе произойдёт
+// инвалидация ссылок на строки.
 //
 // Замечание: возможно, в некоторых случаях можно (стоит) использовать не std::map, реализованный на основе
 // бинарного дерева поиска, а std::unordered_map, реализованный на основе hash-таблицы.
 //
-// Замечание: в случае реализации параллельной работы handler'ов, обрабатывающих соединения с клиентами
-// (например, с помощью Thread Pool'а), необходимо огородить участки работы с контейнерами mutex'ами,
-// чтобы избежать состояния гонки. 
+// Сервер обрабатывает соединения с клиентами параллельно в нескольких потоках, поэтому доступ к базе данных
+// организован по принципу MVCC/RCU (multiversion concurrency control/read-copy-update). Текущая версия базы
+// данных публикуется через умный указатель shared_ptr<const Snapshot> snapshot_, который читается и заменяется
+// атомарно и без блокировок (AtomicSharedPtr, см. atomic_shared_ptr.h: std::atomic_load и std::atomic_store для
+// shared_ptr в libstdc++ захватывают общий mutex, и все читатели выстраивались бы к нему в очередь). Константные методы
+// (поиск записей, сохранение в файл) одной атомарной загрузкой получают указатель на текущую версию и дальше работают
+// только с ней, никогда не ожидая писателей и не блокируя их. Методы, изменяющие базу данных (добавление и удаление
+// записей, загрузка из файла), захватывают mutex писателей writer_mutex_ (писатели выполняются строго по одному),
+// строят копию текущей версии, изменяют её и атомарно публикуют как новую текущую версию. Старая версия удаляется из
+// heap'а автоматически, когда её отпустит последний читающий её поток (подсчёт ссылок shared_ptr выполняет роль
+// механизма отложенного освобождения памяти вместо epoch'ей или hazard pointer'ов).
+//
+// Для того, чтобы копирование версии было дешёвым, все словари версии и вложенные в них контейнеры (множества
+// номеров/id записей, словари частот TF) являются неизменяемыми словарями PersistentMap и множествами PersistentSet
+// (см. persistent_map.h), разбитыми на корзины, а сами записи лежат под умными указателями shared_ptr<const Record>.
+// Новая версия разделяет с предыдущей (structural sharing) все корзины и записи, а копируются только те корзины,
+// которые писатель изменяет (copy-on-write), поэтому стоимость записи почти не зависит от размера базы данных.
+// Порядок обхода таких контейнеров не совпадает с порядком ключей, поэтому результаты поиска по имени/фамилии/отчеству
+// выдаются курсором RecordsCursor, который сливает корзины множества номеров/id через кучу и обходит записи по
+// возрастанию номера/id, ничего не копируя.
+//
+// Поиск по нескольким полям сразу (метод OpenRecordsByQuery, например, имя "Иван", отчество "Петрович" и фамилия
+// "Сидоров") пересекает множества номеров/id записей всех условий запроса прямо в базе данных, не выдавая клиенту
+// результаты каждого условия целиком. Источники номеров/id (множества номеров/id из словарей 1)-3) и списки записей
+// слов заметки из словаря 5)) упорядочиваются по размеру, наименьший собирается в отсортированный массив номеров/id
+// кандидатов, и кандидаты по очереди отсеиваются остальными источниками, от меньших к большим (пересечение никогда
+// не больше наименьшего источника, а пустое пересечение прекращает поиск). Источник, который во много раз больше
+// кандидатов, не обходится целиком: множество номеров/id проверяется поиском каждого кандидата в его корзине, а
+// список записей слова - переходом курсора к каждому кандидату по указателям пропуска (NextGEQ). Источник сравнимого
+// с кандидатами размера собирается в отсортированный массив и пересекается с кандидатами слиянием блоков номеров/id
+// через AVX2 или поиском с галопом (см. ids_intersection.h). Пересечение выдаётся тем же курсором RecordsCursor,
+// который в этом случае идёт по вектору найденных номеров/id.
+//
+// Приватные методы (AddRecordById, AddRecordsByIds, EraseRecordById) изменяют переданную им ещё не опубликованную версию базы данных и рассчитывают
+// на то, что вызывающий метод уже захватил mutex писателей.
 //
 // Для поиска записей по содержимому заметки будем использовать механизм ранжирования записей по TF-IDF
 // (TF - Term Frequency, IDF - Inverse Document Frequency), выдавая в качестве ответа на запрос набор
 // записей, отсортированных по уменьшению релевантности TF-IDF. Для хранения значений TF будем использовать
 // два словаря:
 //
-// 5) Словарь "Слово в заметках -> Номер/id записи -> Частота TF":
-//    map<string_view, map<size_t, double>> note_word_to_record_freqs_;
+// 5) Словарь "Слово в заметках -> Список записей слова (номера/id записей и частоты TF)":
+//    PersistentMap<string_view, shared_ptr<const PostingList>> note_word_to_postings;
 //
-// 6) Словарь "Номер/id записи -> Слова в заметках"
-//    map<size_t, set<string_view>> record_to_note_words_;
+// 6) Словарь "Номер/id записи -> Слова в заметках" (различные слова заметки по возрастанию)
+//    PersistentMap<size_t, shared_ptr<const vector<string_view>>> record_to_note_words;
 //
 // Статья про статистическую меру TF-IDF: https://ru.wikipedia.org/wiki/TF-IDF
 //
+// Список записей слова PostingList (см. posting_list.h) хранит номера/id записей и частоты TF по возрастанию
+// номера/id в сжатых блоках по 128 записей (разности номеров/id упакованы по ширине наибольшей разности блока,
+// частоты TF квантованы в 16 бит) с указателями пропуска и лежит под умным указателем, поэтому изменение списка
+// заново упаковывает лишь его затронутый блок. Каждое слово запроса ищется в словаре 5) лишь однократно, дальше поиск работает
+// только с найденными списками.
+//
+// Частое слово (например, "работа") может встречаться в заметках миллионов записей, а клиенту обычно нужен лишь топ
+// из нескольких самых релевантных записей, поэтому поиск по заметкам принимает ограничение на число записей в ответе
+// и отбирает топ по алгоритму MaxScore с досрочным отсечением. Каждый список хранит верхнюю границу частоты TF по
+// всем своим записям, значит вклад слова в релевантность любой записи не превышает IDF * max TF. Списки слов
+// запроса обходятся одновременно по возрастанию номера/id (document-at-a-time) окнами по WINDOW_SIZE номеров/id:
+// релевантности записей окна накапливаются в плотном массиве окна, а затронутые записи отмечаются в битовой маске
+// (вместо словаря "Номер/id записи -> Релевантность"). Слова с наименьшими границами, сумма которых уже не догоняет
+// k-ю релевантность топа (порог), становятся необязательными: их списки не обходятся целиком, а лишь досчитывают
+// записи окна, которые ещё могут попасть в топ, переходом курсора к нужному номеру/id (NextGEQ). Топ из k записей
+// собирается в ограниченной куче, и в запись RecordWithId (с копированием строк) превращаются только k победителей.
+//
 // Вспомогательные словари 1)-4) и 5)-6) дополняются информацией в момент добавлений новой записи через метод
 // AddRecord. В момент удаления записи через методы DeleteRecordById и DeleteRecordByNumber данные, касающиеся
 // удаляемой записи, удаляются и из вспомогательных словарей 1)-4) и 5)-6). Значение IDF будет вычисляться в
-// момент поиска записей по содержанию заметок через метод FindRecordsByNote.
+// момент поиска записей по содержанию заметок через метод FindRecordsByNote, но без логарифма на каждое слово:
+// IDF = log(N / df) = log(N) - log(df), где логарифм документной частоты df хранится в списке записей слова и
+// пересчитывается только при изменении этого списка (для слов, затронутых добавлением или удалением записи, один раз
+// на операцию или пакет), а логарифм числа записей N вычисляется один раз на запрос. Поэтому запись в базу данных
+// не требует пересчёта частот IDF всех слов, а частота IDF слова при поиске - это одна загрузка и одно вычитание.
+//
+// Помимо TF-IDF поиск по заметкам умеет ранжировать записи по модели Okapi BM25 (выбирается в параметрах запроса
+// NoteRankingParams вместе с параметрами k1 и b). TF-IDF завышает релевантность очень коротких заметок (заметка из
+// одного слова получает TF = 1), а BM25 насыщает вклад частоты слова и нормализует его по длине заметки:
+//
+// BM25 = IDF * c * (k1 + 1) / (c + k1 * (1 - b + b * Длина заметки / Средняя длина заметки)),
 //
-// У каждой записи есть её уникальный номер/id, который служит ключом в контейнере records_. Также, вообще
+// где c - число вхождений слова в заметку, IDF = log(1 + (N - df + 0.5) / (df + 0.5)). Так как c = TF * Длина заметки,
+// после деления числителя и знаменателя на длину заметки формула считается по уже хранимой в списке записей слова
+// частоте TF: IDF * (k1 + 1) * TF / (TF + k1 * (1 - b) / Длина заметки + k1 * b / Средняя длина заметки). Длина заметки
+// каждой записи хранится один раз в плотном массиве версии note_lengths (2 байта на запись, чтение без поиска ключа),
+// а суммарная и наибольшая длины заметок - в полях версии. Вклад слова в BM25 растёт и по TF, и по длине заметки,
+// поэтому верхняя граница вклада слова для алгоритма MaxScore получается подстановкой наибольшей частоты TF списка
+// слова и наибольшей длины заметки, и досрочное отсечение работает для BM25 так же, как и для TF-IDF.
+//
+// Пакетное добавление записей (метод AddRecords, например, при массовой загрузке записей через клиентский поток
+// сервера) захватывает mutex писателей и копирует версию базы данных один раз на весь пакет, проверяет уникальность
+// номеров телефонов всех записей пакета за один проход, а записи вспомогательных словарей 1)-3) и 5) вначале
+// группирует по ключам, чтобы каждый ключ искался в словаре версии (и его вложенный контейнер копировался) лишь
+// однократно на пакет, а не на каждую запись. Элементы же вставляются в словари пакетно (PersistentContainer::InsertBatch):
+// упорядоченными по корзинам и ключам, поэтому каждая корзина копируется при записи один раз на пакет.
+//
+// У каждой записи есть её уникальный номер/id, который служит ключом в контейнере records. Также, вообще
 // говоря, уникальным идентификатором является и телефонный номер, который не может повторяться у двух
 // разных записей (он сам по себе уже мог бы быть хорошим hash'ом, если бы мы использовали unordered_map'ы).
-// Для контроля выдачи уникальных номеров/id добавляемым записям есть поле last_record_id_, которое
-// содержит значение номера/id последнего добавленного документа и инкрементируется при добавлении нового
-// документа в базу данных.
+// Для контроля выдачи уникальных номеров/id добавляемым записям в версии базы данных есть поле last_record_id,
+// которое содержит значение номера/id последнего добавленного документа и инкрементируется при добавлении
+// нового документа в базу данных.
 //
 // Для хранения состояния базы данных в перерывах между перезапусками сервера реализованы методы загрузки
 // данных в базу из файла (LoadFromFile) и сохранения данных из базы в файл (SaveToFile). Значение поля
-// last_record_id_ также будет храниться в файле.
+// last_record_id также будет храниться в файле. Файл сохраняется в двоичном формате (см. database_snapshot.h), который
+// загружается без разбора текста, а файл в прежнем текстовом формате по-прежнему загружается (формат определяется по
+// сигнатуре в начале файла).
+//
+// Загрузка выполняется параллельно в load_threads_count потоках (вызывающем и рабочих потоках постоянного пула базы
+// данных, см. parallel_tasks.h). Текстовый файл отображается в память и делится на части по границам строк, каждая
+// часть разбирается в своём потоке без выделения памяти под промежуточные строки (ParseTextFile). Затем в порядке файла
+// отбрасываются записи с повторяющимся номером телефона или номером/id, и версия базы данных строится целиком
+// (AddRecordsInParallel): вначале параллельно по частям записей создаются записи в heap'е и вычисляются частоты TF слов
+// их заметок, затем каждый словарь версии строится в своём потоке (словари - разные члены версии, поэтому не
+// пересекаются).
+//
+// Чтобы при перезапуске сервера словари не строились заново (в том числе без повторного разделения каждой заметки на
+// слова), SaveToFile сохраняет в двоичный файл вместе с записями и словари версии - секцию INDEXES (по секции на базу
+// данных или шард, см. CapturedSnapshot::SerializeIndexes). Строки в секции не хранятся: ключи и слова заметок
+// задаются индексом записи в таблице записей файла и смещением в её поле, поэтому после загрузки string_view снова
+// ссылаются на строки записей в heap'е. Секция содержит:
+//
+// - заголовок: версию формата секции INDEXES_FORMAT_VERSION, число шардов и номер шарда сохранившей базы данных,
+//   индекс первой записи и число записей (записи базы данных/шарда идут в таблице записей подряд) и смещения частей;
+// - для словарей 1)-3): группы "индекс записи с ключом, индексы записей группы";
+// - словарь терминов для словаря 5): слово (индекс записи, смещение в её заметке, длина) и его список записей слова
+//   в сжатых блоках как есть (см. PostingList::Serialize);
+// - для словаря 6) и массива длин заметок: длину заметки каждой записи и пары "номер слова в словаре терминов,
+//   смещение слова в заметке записи".
+//
+// Словарь 4) отображает каждую запись в её номер телефона один к одному и строится прямо из записей. Секцию защищает
+// контрольная сумма файла, а при загрузке (AddRecordsFromIndexes) она ещё и сверяется с записями: границы, совпадение
+// ключей и слов со строками записей, вхождение каждой записи ровно в одну группу, совпадение списков записей слов с
+// записями, в заметках которых встречается слово, уникальность номеров/id (не сверяются только частоты TF и длины
+// заметок, которые влияют лишь на порядок ранжирования). Если секции нет (файл сохранён до её появления), она
+// сохранена для другого числа шардов, её формат устарел (например, изменились правила разделения заметки на слова -
+// тогда увеличивается INDEXES_FORMAT_VERSION) или она не соответствует записям, словари строятся заново
+// (AddRecordsInParallel).
+
+// Модель ранжирования записей при поиске по содержанию заметок
+enum class NoteRanking {
+	TF_IDF, // TF-IDF: сумма TF * IDF слов запроса (модель по умолчанию)
+	BM25    // Okapi BM25: частота слова с насыщением (параметр k1) и нормализацией по длине заметки (параметр b)
+};
+
+// Структура параметров ранжирования записей при поиске по содержанию заметок
+struct NoteRankingParams {
+	NoteRanking ranking = NoteRanking::TF_IDF; // Модель ранжирования
+	double bm25_k1 = 1.2;                      // Параметр насыщения частоты слова BM25 (k1 >= 0)
+	double bm25_b = 0.75;                      // Параметр нормализации по длине заметки BM25 (0 <= b <= 1)
+};
+
+// Структура запроса на поиск записей по нескольким полям сразу: найдутся записи, удовлетворяющие всем заданным
+// условиям (незаданное поле может быть любым, а в заметке должно встречаться каждое слово note; запрос без условий
+// не находит ни одной записи)
+struct RecordsQuery {
+	std::optional<std::string> name;       // Имя
+	std::optional<std::string> surname;    // Фамилия
+	std::optional<std::string> patronymic; // Отчество
+	std::string note;                      // Слова заметки (пустая строка или одни сепараторы - любая заметка)
+};
 
 // Класс базы данных для телефонной книги
 class PhoneBookDatabase final {
@@ -114,46 +269,186 @@ public:
 		std::string number;     // Телефонный номер
 		std::string note;       // Заметка
 	};
+
+	// Структура счётчиков слов в заметках одной версии базы данных (нужна шардированной базе данных для построения
+	// глобальной таблицы слов заметок по всем шардам сразу)
+	struct NoteWordsCounts {
+		size_t records_count = 0; // Число записей
+		size_t notes_length = 0;  // Суммарная длина заметок записей в словах
+
+		// Вектор пар "Слово в заметках, число записей, где встречается слово" для всех слов заметок версии
+		std::vector<std::pair<std::string, size_t>> word_records_counts;
+	};
 	
 private:
-    // Имя файла с базой данных телефонной книги
-    std::string database_file_name_;
+	// Неизменяемый словарь для словарей версии базы данных (на 16384 корзины в 128 блоках, так как словари версии
+	// могут содержать по элементу на каждую запись в базе данных: при 1024 корзинах корзина словаря на 100 тысяч
+	// записей содержала около сотни узлов, и каждое добавление или удаление записи копировало по такой корзине в
+	// каждом из словарей)
+	template <typename Key, typename Value, typename Hash = std::hash<Key>>
+	using IndexMap = persistent_map::PersistentMap<Key, Value, Hash, 16384>;
+
+	// Число подряд идущих номеров/id записей, попадающих в одну корзину словарей с ключом номером/id
+	static constexpr size_t RECORD_IDS_RUN = 64;
+
+	// Hash-функция для номеров/id записей в словарях версии базы данных: номера/id выдаются подряд, поэтому они
+	// группируются в корзины отрезками по RECORD_IDS_RUN номеров/id. Пакет новых записей при этом копирует при
+	// записи лишь около (размер пакета / RECORD_IDS_RUN) корзин, а не по корзине на каждую запись, как при
+	// std::hash<size_t>, раскладывающей соседние номера/id по соседним корзинам (на базе данных больше 16384 *
+	// RECORD_IDS_RUN записей номеров/id в корзине столько же, сколько и при std::hash<size_t>, а на меньшей - не
+	// больше RECORD_IDS_RUN, поэтому добавление и удаление одиночных записей заметно не дорожает)
+	struct RecordIdHash {
+		size_t operator()(size_t record_id) const {
+			return record_id / RECORD_IDS_RUN;
+		}
+	};
+
+	// Наибольшая хранимая длина заметки в словах (более длинные заметки при ранжировании по BM25 считаются заметками
+	// этой длины)
+	static constexpr size_t MAX_NOTE_LENGTH = std::numeric_limits<uint16_t>::max();
+
+	// Структура неизменяемой версии (snapshot'а) базы данных
+	// (после публикации версия никогда не изменяется, поэтому её можно читать из любого числа потоков без блокировок)
+	struct Snapshot {
+		// Словарь "Номер/id записи -> записи"
+		// (именно в записях этого контейнера хранятся строковые данные, в остальных лишь ссылки (string_view))
+		IndexMap<size_t, std::shared_ptr<const Record>, RecordIdHash> records;
 
-	// Словарь "Номер/id записи -> записи"
-	// (именно в этом контейнере хранятся строковые данные, в остальных лишь ссылки (string_view))
-	std::map<size_t, Record> records_;
+		// Словарь "Имя -> Номер/id записи"
+		// (используется для быстрого поиска записей по имени)
+		IndexMap<std::string_view, persistent_map::PersistentSet<size_t>> name_to_records;
 
-	// Словарь "Имя -> Номер/id записи"
-	// (используется для быстрого поиска записей по имени)
-	std::map<std::string_view, std::set<size_t>> name_to_records_;
+		// Словарь "Фамилия -> Номер/id записи"
+		// (используется для быстрого поиска записей по фамилии)
+		IndexMap<std::string_view, persistent_map::PersistentSet<size_t>> surname_to_records;
 
-	// Словарь "Фамилия -> Номер/id записи"
-	// (используется для быстрого поиска записей по фамилии)
-	std::map<std::string_view, std::set<size_t>> surname_to_records_;
+		// Словарь "Отчество -> Номер/id записи"
+		// (используется для быстрого поиска записей по отчеству)
+		IndexMap<std::string_view, persistent_map::PersistentSet<size_t>> patronymic_to_records;
 
-	// Словарь "Отчество -> Номер/id записи"
-	// (используется для быстрого поиска записей по отчеству)
-	std::map<std::string_view, std::set<size_t>> patronymic_to_records_;
+		// Словарь "Номер телефона -> Номер/id записи"
+		// (используется для быстрого поиска записей по номеру телефона)
+		IndexMap<std::string_view, size_t> number_to_record;
 
-	// Словарь "Номер телефона -> Номер/id записи"
-	// (используется для быстрого поиска записей по номеру телефона)
-	std::map<std::string_view, size_t> number_to_record_;
+		// Словарь "Слово в заметках -> Список записей слова (номера/id записей и частоты TF по возрастанию номера/id)"
+		// (используется для быстрого поиска записей по содержимому заметки и получения выборки, ранжированной по TF-IDF;
+		//  список лежит под умным указателем, чтобы копирование корзины словаря при записи не копировало списки)
+		IndexMap<std::string_view, std::shared_ptr<const posting_list::PostingList>> note_word_to_postings;
+
+		// Словарь "Номер/id записи -> Слова в заметках"
+		// (используется для быстрого поиска записей по содержимому заметки и получения выборки, ранжированной по TF-IDF)
+		IndexMap<size_t, std::shared_ptr<const std::vector<std::string_view>>, RecordIdHash> record_to_note_words;
+
+		// Массив "Номер/id записи -> Длина заметки в словах" (длина ограничена MAX_NOTE_LENGTH словами)
+		// (используется для нормализации по длине заметки при ранжировании по BM25)
+		persistent_map::PersistentArray<uint16_t> note_lengths;
+
+		// Суммарная длина заметок всех записей в словах (для средней длины заметки при ранжировании по BM25)
+		size_t notes_length = 0;
+
+		// Верхняя граница длины заметки записи в словах (при удалении записей не уменьшается, оставаясь верной)
+		uint16_t max_note_length = 0;
+
+		// Номер/id последней записи
+		size_t last_record_id = 0;
+	};
+
+public:
+	// Класс курсора по записям с указанным именем/фамилией/отчеством
+	//
+	// Курсор удерживает версию базы данных, из которой он открыт, и лениво обходит множество номеров/id найденных
+	// записей по возрастанию номера/id: корзины множества (внутри каждой номера/id упорядочены) сливаются через
+	// кучу из итераторов по корзинам. Ни записи, ни номера/id не копируются, поэтому открытие курсора и переход к
+	// следующей записи стоят O(число корзин) памяти и не зависят от числа найденных записей.
+	//
+	// Курсор поиска по нескольким полям сразу вместо кучи корзин идёт по отсортированному вектору номеров/id
+	// пересечения (записи по-прежнему не копируются, а читаются из удерживаемой версии по одной).
+	//
+	// Записи, добавленные или удалённые после открытия курсора, в нём не видны (курсор читает свою версию)
+	class RecordsCursor {
+	public:
+		// Конструктор пустого курсора (записей нет)
+		RecordsCursor() = default;
 
-	// Словарь "Слово в заметках -> Номер/id записи -> Частота TF"
-	// (используется для быстрого поиска записей по содержимому заметки и получения выборки, ранжированной по TF-IDF)
-	std::map<std::string_view, std::map<size_t, double>> note_word_to_record_freqs_;
+		// Функция проверки, указывает ли курсор на запись (false, если записи закончились)
+		bool HasRecord() const {
+			return !buckets_heap_.empty() || position_ < records_ids_.size();
+		}
 
-	// Словарь "Номер/id записи -> Слова в заметках"
-	// (используется для быстрого поиска записей по содержимому заметки и получения выборки, ранжированной по TF-IDF)
-	std::map<size_t, std::set<std::string_view>> record_to_note_words_;
+		// Функция получения номера/id текущей записи (курсор должен указывать на запись)
+		size_t RecordId() const {
+			return buckets_heap_.empty() ? records_ids_[position_] : *buckets_heap_.front().first;
+		}
 
-	// Номер/id последней записи
-	size_t last_record_id_;
+		// Функция получения константной ссылки на текущую запись (курсор должен указывать на запись; ссылка
+		// действительна, пока жив курсор)
+		// (определение/definition этой функции находится в phone_book_database.cpp)
+		const Record& CurrentRecord() const;
+
+		// Функция перехода к следующей записи (курсор должен указывать на запись)
+		// (определение/definition этой функции находится в phone_book_database.cpp)
+		void Next();
+
+	private:
+		friend class PhoneBookDatabase;
+
+		// Тип пары итераторов "Текущий номер/id, конец корзины" внутри одной корзины множества номеров/id
+		using BucketRange = std::pair<std::set<size_t>::const_iterator, std::set<size_t>::const_iterator>;
+
+		// Конструктор курсора по множеству номеров/id records_ids, принадлежащему версии snapshot
+		// (определение/definition этой функции находится в phone_book_database.cpp)
+		RecordsCursor(std::shared_ptr<const Snapshot> snapshot, const persistent_map::PersistentSet<size_t>& records_ids);
+
+		// Конструктор курсора по отсортированному вектору номеров/id records_ids записей версии snapshot
+		// (определение/definition этой функции находится в phone_book_database.cpp)
+		RecordsCursor(std::shared_ptr<const Snapshot> snapshot, std::vector<size_t> records_ids);
+
+		// Функция сравнения корзин для кучи (на вершине кучи корзина с наименьшим текущим номером/id)
+		static bool BucketGreater(const BucketRange& lhs, const BucketRange& rhs) {
+			return *lhs.first > *rhs.first;
+		}
+
+		// Удерживаемая курсором версия базы данных (в ней живут корзины и записи)
+		std::shared_ptr<const Snapshot> snapshot_;
+
+		// Куча из непустых остатков корзин множества номеров/id
+		std::vector<BucketRange> buckets_heap_;
+
+		// Отсортированный вектор номеров/id и позиция текущей записи в нём (для курсора поиска по нескольким полям
+		// сразу; куча корзин при этом пуста)
+		std::vector<size_t> records_ids_;
+		size_t position_ = 0;
+	};
+
+private:
+    // Имя файла с базой данных телефонной книги
+    std::string database_file_name_;
+
+    // Число потоков загрузки данных в базу из файла
+    size_t load_threads_count_ = 1;
+
+    // Пул рабочих потоков загрузки данных (load_threads_count_ - 1 рабочих потоков, ещё один поток загрузки -
+    // вызывающий; у шардов ShardedPhoneBookDatabase рабочих потоков нет)
+    parallel_tasks::WorkerPool worker_pool_;
+
+	// Умный указатель на текущую версию базы данных
+	// (читается и заменяется только атомарно и без блокировок через Load и Store)
+	atomic_shared_ptr::AtomicSharedPtr<const Snapshot> snapshot_;
+
+	// Mutex писателей, выстраивающий методы, изменяющие базу данных, в очередь
+	// (читатели его никогда не захватывают)
+	std::mutex writer_mutex_;
 	
 public:
-    // Конструктор базы данных принимает имя файла (полное имя с путём до файла) с базой данных телефонной книги
+    // Конструктор базы данных принимает имя файла (полное имя с путём до файла) с базой данных телефонной книги и число
+    // потоков загрузки данных из файла (0 - по числу ядер процессора)
+    // (определение/definition этой функции находится в phone_book_database.cpp)
+    explicit PhoneBookDatabase(const std::string& database_file_name, size_t load_threads_count = 0);
+
+    // Конструктор пустой базы данных без файла (используется для шардов ShardedPhoneBookDatabase, загрузкой
+    // и сохранением данных которых занимается сама шардированная база данных)
     // (определение/definition этой функции находится в phone_book_database.cpp)
-    explicit PhoneBookDatabase(const std::string& database_file_name);
+    PhoneBookDatabase();
 
     // Функция загрузки данных в базу из файла
     // (определение/definition этой функции находится в phone_book_database.cpp)
@@ -163,6 +458,86 @@ public:
     // (определение/definition этой функции находится в phone_book_database.cpp)
     void SaveToFile() const;
 
+    // Структура записей файла в прежнем текстовом формате
+    struct TextFileRecords {
+        size_t last_record_id = 0;                          // Номер/id последней записи из первой строки файла
+        std::vector<std::pair<size_t, Record>> records;     // Номера/id и записи в порядке файла
+    };
+
+    // Функция параллельного разбора файла file_name в прежнем текстовом формате в потоках пула worker_pool (файл
+    // отображается в память и делится на части по границам строк; строки не в формате записи пропускаются)
+    // (возвращает nullopt, если файл не удалось открыть; используется и шардированной базой данных)
+    //
+    // (определение/definition этой функции находится в phone_book_database.cpp)
+    static std::optional<TextFileRecords> ParseTextFile(const std::string& file_name,
+                                                        parallel_tasks::WorkerPool& worker_pool);
+
+	// Версия формата секции INDEXES с сохранёнными словарями
+	static constexpr uint32_t INDEXES_FORMAT_VERSION = 1;
+
+	// Структура расположения словарей, сохранённых в секции INDEXES файла
+	struct IndexesPlacement {
+		size_t shards_count = 1;       // Число шардов сохранившей базы данных (1 - база данных без шардов)
+		size_t shard_index = 0;        // Номер шарда
+		size_t first_record_index = 0; // Индекс первой записи базы данных/шарда в таблице записей файла
+		size_t records_count = 0;      // Число записей базы данных/шарда (идут в таблице записей подряд)
+	};
+
+	// Функция чтения расположения словарей из заголовка секции indexes (возвращает nullopt, если секция короче
+	// заголовка или её формат устарел)
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static std::optional<IndexesPlacement> ReadIndexesPlacement(std::string_view indexes);
+
+	// Класс зафиксированной версии базы данных для сохранения в файл: удерживает версию, поэтому записи и словари
+	// сохраняются из одной и той же версии, даже если писатели публикуют новые версии во время сохранения
+	class CapturedSnapshot {
+	public:
+		// Функция получения числа записей версии
+		size_t RecordsCount() const {
+			return snapshot_->records.size();
+		}
+
+		// Функция получения номера/id последней записи версии
+		size_t LastRecordId() const {
+			return snapshot_->last_record_id;
+		}
+
+		// Функция добавления всех записей версии в писатель файла writer (в порядке обхода словаря записей - в этом
+		// же порядке записи перечисляются и в секции словарей)
+		// (определение/definition этой функции находится в phone_book_database.cpp)
+		void WriteRecords(database_snapshot::SnapshotWriter& writer) const;
+
+		// Функция сериализации словарей версии в содержимое секции INDEXES (shards_count и shard_index - число шардов
+		// и номер шарда, first_record_index - индекс первой записи версии в таблице записей файла)
+		// (выбрасывает исключение, если записей или слов заметок больше, чем помещается в 32-битные индексы)
+		//
+		// (определение/definition этой функции находится в phone_book_database.cpp)
+		std::string SerializeIndexes(size_t shards_count, size_t shard_index, size_t first_record_index) const;
+
+	private:
+		friend class PhoneBookDatabase;
+
+		// Конструктор принимает фиксируемую версию базы данных
+		explicit CapturedSnapshot(std::shared_ptr<const Snapshot> snapshot) : snapshot_(std::move(snapshot)) {
+		}
+
+		// Удерживаемая версия базы данных
+		std::shared_ptr<const Snapshot> snapshot_;
+	};
+
+	// Функция фиксации текущей версии базы данных для сохранения в файл (одна атомарная загрузка умного указателя)
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	CapturedSnapshot CaptureSnapshot() const;
+
+	// Функция загрузки в базу данных записей records из файла (номера телефонов и номера/id которых уже проверены на
+	// уникальность, в порядке таблицы записей файла) вместе с сохранёнными словарями indexes: заменяет данные базы
+	// данных целиком, записи перемещаются в heap, а если словарей нет или они не соответствуют записям, словари
+	// строятся заново
+	// (возвращает true, если словари загружены из indexes; используется шардированной базой данных)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	bool LoadFileRecords(std::vector<std::pair<size_t, Record>>& records, std::optional<std::string_view> indexes);
+
     // Функция добавления записи
     // (возвращает код ответа: 0 - запись с таким номером телефона уже существует,
     //                         1 - запись успешно добавлена)
@@ -170,6 +545,16 @@ public:
     // (определение/definition этой функции находится в phone_book_database.cpp)
 	size_t AddRecord(const Record& record);
 
+    // Функция пакетного добавления записей (mutex писателей захватывается, а версия базы данных копируется и
+    // публикуется один раз на весь пакет; уникальность номеров телефонов проверяется за один проход, а записи
+    // индексов группируются по ключам)
+    // (возвращает вектор кодов ответа в порядке записей: 0 - запись с таким номером телефона уже существует в базе
+    //                                                        данных или раньше в этом же пакете,
+    //                                                    1 - запись успешно добавлена)
+    //
+    // (определение/definition этой функции находится в phone_book_database.cpp)
+	std::vector<size_t> AddRecords(const std::vector<Record>& records);
+
 	// Функция удаления записи по её номеру/id
     // (возвращает код ответа: 0 - записи с таким номером/id не существует,
     //                         1 - запись успешно удалена)
@@ -214,25 +599,259 @@ public:
     // (определение/definition этой функции находится в phone_book_database.cpp)
 	std::optional<RecordWithId> FindRecordByNumber(const std::string& number) const;
 
+	// Функции пакетного поиска записей по номерам/id и по номерам телефонов (все записи берутся из одной версии базы
+	// данных, ключи ищутся в словарях пакетно - см. PersistentContainer::FindBatch)
+	// (возвращают вектор найденных записей в порядке ключей, для ненайденных ключей - nullopt)
+	//
+	// (определения/definition'ы этих функций находятся в phone_book_database.cpp)
+	std::vector<std::optional<RecordWithId>> FindRecordsByIds(const std::vector<size_t>& ids) const;
+	std::vector<std::optional<RecordWithId>> FindRecordsByNumbers(const std::vector<std::string>& numbers) const;
+
 	// Функция поиска записей по содержанию заметок
-	// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+	// (возвращает топ из не более чем max_records_count самых релевантных записей, отсортированных по убыванию
+	//  релевантности; найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
 	//
     // (определение/definition этой функции находится в phone_book_database.cpp)
-	std::optional<std::vector<RecordWithId>> FindRecordsByNote(const std::string& note) const;
+	std::optional<std::vector<RecordWithId>> FindRecordsByNote(
+		const std::string& note, size_t max_records_count = std::numeric_limits<size_t>::max(),
+		const NoteRankingParams& ranking_params = NoteRankingParams()) const;
+
+	// Функции открытия курсора по записям с указанным именем/фамилией/отчеством (записи выдаются по возрастанию
+	// номера/id; если записей нет, курсор сразу пуст)
+	//
+	// (определения/definition'ы этих функций находятся в phone_book_database.cpp)
+	RecordsCursor OpenRecordsByName(const std::string& name) const;
+	RecordsCursor OpenRecordsBySurname(const std::string& surname) const;
+	RecordsCursor OpenRecordsByPatronymic(const std::string& patronymic) const;
+
+	// Функция поиска записей по нескольким полям сразу
+	// (записи по возрастанию номера/id, удовлетворяющие всем условиям запроса query; найденных записей может быть
+	//  множество или не быть вовсе, тогда возвращает nullopt)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	std::optional<std::vector<RecordWithId>> FindRecordsByQuery(const RecordsQuery& query) const;
+
+	// Функция открытия курсора по записям, удовлетворяющим всем условиям запроса query (пересечение множеств номеров/id
+	// записей вычисляется при открытии, а записи выдаются по возрастанию номера/id; если записей нет, курсор сразу пуст)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	RecordsCursor OpenRecordsByQuery(const RecordsQuery& query) const;
+
+	// Функция добавления записи с заданным снаружи номером/id
+	// (используется шардированной базой данных, которая сама выдаёт номера/id записям всех шардов;
+	//  возвращает код ответа: 0 - запись с таким номером телефона или номером/id уже существует,
+	//                         1 - запись успешно добавлена)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	size_t AddRecordWithId(size_t record_id, const Record& record);
+
+	// Функция пакетного добавления записей с заданными снаружи номерами/id
+	// (принимает вектор пар "Номер/id записи, указатель на запись", используется шардированной базой данных;
+	//  возвращает вектор кодов ответа в порядке записей: 0 - запись с таким номером телефона или номером/id уже
+	//                                                        существует,
+	//                                                    1 - запись успешно добавлена)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	std::vector<size_t> AddRecordsWithIds(const std::vector<std::pair<size_t, const Record*>>& records);
+
+	// Функция подсчёта числа записей в базе данных, суммарной длины их заметок и числа записей, где встречается
+	// каждое из слов заметок
+	// (все значения берутся из одной версии базы данных; нужна шардированной базе данных, чтобы построить глобальную
+	//  таблицу слов заметок после загрузки, дальше таблица обновляется при каждом изменении)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	NoteWordsCounts CountNoteWords() const;
+
+	// Функция разбора заметки note на различные слова (отсортированные по возрастанию) так же, как при добавлении
+	// записи в базу данных, с вычислением длины заметки в словах note_length, ограниченной так же, как в массиве длин
+	// заметок (нужна шардированной базе данных, чтобы обновлять глобальную таблицу слов заметок при изменениях)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static std::vector<std::string_view> SplitNoteWords(std::string_view note, size_t& note_length);
+
+	// Функция ранжирования записей по содержанию заметок с заданными снаружи частотами IDF слов
+	// (принимает вектор пар "Слово, частота IDF", ограничение на число записей, параметры ранжирования и среднюю
+	//  длину заметки по всем шардам (нужна только для BM25), возвращает топ в виде вектора пар "Запись,
+	//  релевантность", отсортированного по убыванию релевантности, или пустой вектор, если записей не найдено)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	std::vector<std::pair<RecordWithId, double>> RankRecordsByNoteWords(
+		const std::vector<std::pair<std::string_view, double>>& words_inverse_freqs, size_t max_records_count,
+		const NoteRankingParams& ranking_params, double average_note_length) const;
+
+	// Функция вычисления частоты IDF слова по логарифму числа записей в базе данных log_records_count (вычисляется
+	// один раз на запрос) и логарифму числа записей, где слово встречается в заметке, log_word_records_count (хранится
+	// в списке записей слова, а у шардированной базы данных - в глобальной таблице слов заметок)
+	// (нужна для работы функции поиска записей по содержанию заметок; используется и шардированной базой данных)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static double ComputeWordInverseDocumentFreq(double log_records_count, double log_word_records_count);
+
+	// Функция вычисления частоты IDF слова для BM25 по числу записей records_count и числу записей, где слово
+	// встречается в заметке, word_records_count (используется и шардированной базой данных с глобальными числами)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static double ComputeWordBM25InverseDocumentFreq(size_t records_count, size_t word_records_count);
+
+	// Шаг сетки, к которому округляется вклад каждого слова в релевантность записи (2^-32): релевантность - сумма
+	// вкладов слов, а порядок сложения зависит от того, какие слова алгоритм MaxScore обошёл целиком, а какие досчитал
+	// точечно (и от шарда). Суммы кратных шагу чисел (меньших 2^21) вычисляются в double точно, поэтому релевантность
+	// записи не зависит от порядка сложения, и релевантности можно сравнивать на точное равенство
+	static constexpr double RELEVANCE_GRID_STEP = 1.0 / 4294967296.0;
+
+	// Функция округления вклада слова в релевантность relevance до сетки с шагом RELEVANCE_GRID_STEP
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static double RoundRelevance(double relevance);
+
+	// Функция сравнения записей в топе поиска по содержанию заметок: запись с номером/id lhs_id и релевантностью
+	// lhs_relevance идёт раньше записи rhs_id с релевантностью rhs_relevance, если её релевантность больше, а при
+	// равной релевантности - если её номер/id меньше (строгий слабый порядок для куч и сортировок; используется и
+	// шардированной базой данных при слиянии топов шардов, чтобы топ не зависел ни от порядка обхода, ни от числа
+	// шардов)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static bool HigherRelevance(size_t lhs_id, double lhs_relevance, size_t rhs_id, double rhs_relevance);
 
 private:
-	// Функция добавления записи с фиксированным номером/id
+	// Функция добавления записи с фиксированным номером/id в ещё не опубликованную версию базы данных
     // (возвращает код ответа: 0 - запись с таким номером телефона уже существует,
     //                         1 - запись успешно добавлена)
     //
     // (определение/definition этой функции находится в phone_book_database.cpp)
-	size_t AddRecordById(size_t record_id, const Record& record);
+	static size_t AddRecordById(Snapshot& snapshot, size_t record_id, const Record& record);
 
-	// Функция вычисления частоты IDF слова
-	// (нужна для работы функции поиска записей по содержанию заметок)
+	// Функция удаления записи по её номеру/id из ещё не опубликованной версии базы данных
+	// (возвращает код ответа: 0 - записи с таким номером/id не существует,
+	//                         1 - запись успешно удалена)
 	//
 	// (определение/definition этой функции находится в phone_book_database.cpp)
-    double ComputeWordInverseDocumentFreq(std::string_view word) const;
+	static size_t EraseRecordById(Snapshot& snapshot, size_t record_id);
+
+	// Функция вычисления частот TF всех различных слов в заметке note
+	// (возвращает словарь "Слово в заметке -> Частота TF", string_view ссылаются на строку note, а в note_length
+	//  записывает длину заметки в словах)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static std::map<std::string_view, double> ComputeNoteWordsFreqs(std::string_view note, size_t& note_length);
+
+	// Функция внесения длины заметки note_length записи с номером/id record_id в версию базы данных (в массив длин
+	// заметок и суммарную и наибольшую длины заметок)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static void AddNoteLength(Snapshot& snapshot, size_t record_id, size_t note_length);
+
+	// Функция проверки уникальности номеров телефонов пакета добавляемых записей за один проход
+	// (возвращает вектор кодов ответа в порядке записей: 0 - номер телефона уже есть в версии snapshot или
+	//  раньше в этом же пакете, 1 - запись можно добавить)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static std::vector<size_t> CheckNewNumbers(const Snapshot& snapshot, const std::vector<const Record*>& records);
+
+	// Функция пакетного добавления уже проверенных записей с фиксированными номерами/id в ещё не опубликованную
+	// версию базы данных
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static void AddRecordsByIds(Snapshot& snapshot, const std::vector<std::pair<size_t, const Record*>>& records);
+
+	// Функция построения ещё не опубликованной пустой версии базы данных из записей records (номера телефонов и
+	// номера/id которых уже проверены на уникальность, в порядке таблицы записей файла) в потоках пула worker_pool:
+	// записи перемещаются в heap, а словари загружаются из сохранённых словарей indexes или строятся заново
+	// (возвращает true, если словари загружены из indexes)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static bool BuildSnapshot(Snapshot& snapshot, std::vector<std::pair<size_t, Record>>& records,
+	                          std::optional<std::string_view> indexes, parallel_tasks::WorkerPool& worker_pool);
+
+	// Функция построения словарей ещё не опубликованной пустой версии базы данных по уже созданным в heap'е записям
+	// records в потоках пула worker_pool (заметки всех записей разделяются на слова)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static void AddRecordsInParallel(Snapshot& snapshot,
+	                                 const std::vector<std::pair<size_t, std::shared_ptr<const Record>>>& records,
+	                                 parallel_tasks::WorkerPool& worker_pool);
+
+	// Функция загрузки словарей ещё не опубликованной пустой версии базы данных из сохранённых словарей indexes по уже
+	// созданным в heap'е записям records (в порядке таблицы записей файла) в потоках пула worker_pool
+	// (возвращает false, если словари не соответствуют записям, тогда версия остаётся недостроенной)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static bool AddRecordsFromIndexes(Snapshot& snapshot,
+	                                  const std::vector<std::pair<size_t, std::shared_ptr<const Record>>>& records,
+	                                  std::string_view indexes, parallel_tasks::WorkerPool& worker_pool);
+
+	// Функция загрузки в базу данных записей records из файла (в порядке файла) с номером/id последней записи
+	// last_record_id и сохранёнными словарями indexes: отбрасывает записи с повторяющимся номером телефона или
+	// номером/id (принимается первая), строит новую версию базы данных и публикует её (вызывающий метод должен
+	// захватить mutex писателей)
+	// (возвращает true, если словари загружены из indexes)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	bool LoadRecords(std::vector<std::pair<size_t, Record>>& records, size_t last_record_id,
+	                 std::optional<std::string_view> indexes);
+
+	// Функция пакетного поиска записей по номерам/id в версии snapshot (для ненайденных номеров/id - nullopt)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static std::vector<std::optional<RecordWithId>> CollectRecordsByIds(const Snapshot& snapshot, const std::vector<size_t>& ids);
+
+	// Функция публикации новой версии базы данных
+	// (вызывающий метод должен захватить mutex писателей)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	void PublishSnapshot(std::shared_ptr<const Snapshot> snapshot);
+
+	// Функция получения текущей версии базы данных
+	// (одна атомарная загрузка умного указателя, никогда не блокируется писателями)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	std::shared_ptr<const Snapshot> CurrentSnapshot() const;
+
+	// Структура оценки вклада слова в релевантность записи с частотой TF слова в заметке, общая для всех слов запроса:
+	// для TF-IDF вклад равен IDF * TF, а для BM25 - IDF * saturation * TF / (TF + length_weight / Длина заметки +
+	// average_weight), т.е. все константы BM25 вычисляются один раз на запрос
+	struct NoteScoring {
+		bool bm25 = false;            // Ранжирование по BM25 (иначе по TF-IDF)
+		double saturation = 1.0;      // k1 + 1
+		double length_weight = 0.0;   // k1 * (1 - b)
+		double average_weight = 0.0;  // k1 * b / Средняя длина заметки
+		double max_note_length = 1.0; // Наибольшая длина заметки (для верхних границ вклада слов)
+	};
+
+	// Функция построения оценки вклада слов по параметрам ранжирования ranking_params, средней длине заметки
+	// average_note_length и наибольшей длине заметки max_note_length (параметры k1 и b приводятся к допустимым
+	// значениям)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static NoteScoring MakeNoteScoring(const NoteRankingParams& ranking_params, double average_note_length,
+	                                   size_t max_note_length);
+
+	// Функция отбора топа из не более чем max_records_count записей версии базы данных по содержанию заметок
+	// (принимает вектор пар "Список записей слова, частота IDF" для уже найденных в словаре версии слов и оценку
+	//  вклада слов; общая часть FindRecordsByNote и RankRecordsByNoteWords, алгоритм MaxScore)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static std::vector<std::pair<RecordWithId, double>> RankRecords(
+		const Snapshot& snapshot, const std::vector<std::pair<const posting_list::PostingList*, double>>& postings_inverse_freqs,
+		size_t max_records_count, const NoteScoring& scoring);
+
+	// Функция открытия курсора по записям, у которых в словаре index версии snapshot есть ключ key
+	// (index - указатель на член-словарь версии: name_to_records, surname_to_records или patronymic_to_records)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static RecordsCursor OpenRecords(std::shared_ptr<const Snapshot> snapshot,
+	                                 IndexMap<std::string_view, persistent_map::PersistentSet<size_t>> Snapshot::* index,
+	                                 std::string_view key);
+
+	// Функция пересечения множеств номеров/id записей версии snapshot по всем условиям запроса query
+	// (возвращает отсортированный вектор номеров/id найденных записей)
+	//
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static std::vector<size_t> IntersectRecordsIds(const Snapshot& snapshot, const RecordsQuery& query);
+
+	// Функция сбора всех записей курсора в вектор (если курсор пуст, возвращает nullopt)
+	// (определение/definition этой функции находится в phone_book_database.cpp)
+	static std::optional<std::vector<RecordWithId>> CollectRecords(RecordsCursor cursor);
 };
 
-}
\ No newline at end of file
+}
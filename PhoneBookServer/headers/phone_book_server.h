@@ -3,27 +3,46 @@
 // Header guard (предотвращает повторное включение заголовочного файла)
 #pragma once
 
-// Подключим библиотеку iostream для работы стандартного потока вывода в консоль для отображения статуса
-// работы сервера, библиотеку memory работы умных указателей, библиотеку string для работы со строками,
-// библиотеку vector и для использования контейнера вектора, а также библиотеку thread для работы с потоками
-#include <iostream>
+// Подключим библиотеку memory работы умных указателей, библиотеку string для работы со строками,
+// библиотеку vector и для использования контейнера вектора, библиотеку thread для работы с потоками,
+// библиотеку atomic для атомарного доступа к статусу сервера из нескольких потоков, а также библиотеку
+// optional для пересоздания параметров соединения и респондера при повторном использовании handler'а,
+// библиотеку cstddef для выравнивания начального блока arena'ы (std::max_align_t) и библиотеку chrono
+// для замера времени обработки соединений (статус работы сервера выводится через асинхронный журнал), а также
+// библиотеку type_traits для определения типа курсора ответов, возвращаемого функцией обработки соединения типа 1-M,
+// и библиотеки limits и algorithm для ограничения размера пачек записей, а также библиотеку exception для перехвата
+// исключений, выброшенных при обработке запросов
 #include <memory>
 #include <string>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <optional>
+#include <cstddef>
+#include <chrono>
+#include <type_traits>
+#include <limits>
+#include <algorithm>
+#include <exception>
 
 // Подключим заголовочные файлы с объявлениями функционала gRPC
 #include <grpc/support/log.h>
 #include <grpcpp/grpcpp.h>
 
+// Подключим заголовочный файл arena'ы protobuf (общая область памяти для запросов и ответов handler'а)
+#include <google/protobuf/arena.h>
+
 // Подключим заголовочный файл "connection.grpc.pb.h", сгенерированный из "connection.proto", который содержит 
 // объявление gRPC-сервиса связи между клиентом и сервером телефонной книги. Также он внутри себя подключает
 // заголовочный файл "connection.pb.h", аналогично сгенерированный из "connection.proto", который содержит
 // объявления типов запросов (request'ов) и ответов (rsponse'ов) для gRPC-сервиса
 #include "connection.grpc.pb.h"
 
-// Подключим заголовочный файл базы данных для телефонной книги
-#include "phone_book_database.h"
+// Подключим заголовочный файл шардированной базы данных для телефонной книги
+#include "sharded_phone_book_database.h"
+
+// Подключим заголовочный файл асинхронного журнала
+#include "async_logger.h"
 
 // Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
 // приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
@@ -37,6 +56,7 @@ namespace phone_book_server {
 
 // Будем использовать инструменты gRPC без префикса "grpc::"
 using grpc::Server;
+using grpc::ServerAsyncReader;
 using grpc::ServerAsyncWriter;
 using grpc::ServerAsyncResponseWriter;
 using grpc::ServerBuilder;
@@ -57,6 +77,7 @@ using AsyncService = PhoneBookConnection::AsyncService;
 using phone_book_proto::RecordRequest;
 using phone_book_proto::RecordResponse;
 using phone_book_proto::AddRecordResponse;
+using phone_book_proto::AddRecordsResponse;
 using phone_book_proto::DeleteRecordResponse;
 using phone_book_proto::DeleteRecordByIdRequest;
 using phone_book_proto::DeleteRecordByNumberRequest;
@@ -66,14 +87,19 @@ using phone_book_proto::FindRecordsBySurnameRequest;
 using phone_book_proto::FindRecordsByPatronymicRequest;
 using phone_book_proto::FindRecordsByPatronymicRequest;
 using phone_book_proto::FindRecordByNumberRequest;
+using phone_book_proto::FindRecordsByIdsRequest;
+using phone_book_proto::FindRecordsByNumbersRequest;
 using phone_book_proto::FindRecordsByNoteRequest;
+using phone_book_proto::FindRecordsRequest;
+using phone_book_proto::RecordBatch;
+using phone_book_proto::BatchLimits;
 
-// Будем использовать класс базы данных для телефонной книги без префикса "phone_book_database::"
-using phone_book_database::PhoneBookDatabase;
+// Будем использовать класс шардированной базы данных для телефонной книги без префикса "phone_book_database::"
+using phone_book_database::ShardedPhoneBookDatabase;
 
 // Архитектура кода сервера:
 //
-// Наш gRPC-сервис связи между клиентом и сервером телефонной книги использует два типа соединений:
+// Наш gRPC-сервис связи между клиентом и сервером телефонной книги использует три типа соединений:
 //
 // 1) Соединение типа 1-1 (one to one) для стандартных случаев
 //    (например, в результате поиска по номеру телефона может найтись не более одной записи в телефонной книге):
@@ -86,14 +112,21 @@ using phone_book_database::PhoneBookDatabase;
 //
 //    rpc ИМЯ_СОЕДИНЕНИЯ (ТИП_ЗАПРОСА) returns (stream ТИП_ОТВЕТА);
 //
-// Соединения типа M-1 (many to one) и M-M (many to many) не нужны для функционала нашего сервера телефонной книги.
+// 3) Соединение типа M-1 (many to one) для случаев, когда клиенту необходимо отправить серверу массив данных
+//    (например, массовая загрузка сотен тысяч записей в телефонную книгу одним соединением вместо сотен тысяч
+//    отдельных запросов):
+//
+//    rpc ИМЯ_СОЕДИНЕНИЯ (stream ТИП_ЗАПРОСА) returns (ТИП_ОТВЕТА);
+//
+// Соединения типа M-M (many to many) не нужны для функционала нашего сервера телефонной книги.
 //
-// Для обработки этих двух типов соединений реализуем базовый абстрактный класс BaseConnectionHandler, в
-// котором будет чисто виртуальная функция Proceed, имплементация которой будет реализована в двух наследниках
-// класса - OneToOneConnectionHandler, обрабатывающем соединения типа 1-1, и OneToManyConnectionHandler,
-// обрабатывающем соединения типа 1-M. Далее будем называть такие классы handler'ами.
+// Для обработки этих трёх типов соединений реализуем базовый абстрактный класс BaseConnectionHandler, в
+// котором будет чисто виртуальная функция Proceed, имплементация которой будет реализована в трёх наследниках
+// класса - OneToOneConnectionHandler, обрабатывающем соединения типа 1-1, OneToManyConnectionHandler,
+// обрабатывающем соединения типа 1-M, и ManyToOneConnectionHandler, обрабатывающем соединения типа M-1. Далее
+// будем называть такие классы handler'ами.
 //
-// Оба эти класса будут шаблонные. В качестве шаблонных параметров они будут принимать тип запроса,
+// Все эти классы будут шаблонные. В качестве шаблонных параметров они будут принимать тип запроса,
 // тип ответа, указатель на функцию из функционала gRPC для инициализации соединения (регистрации
 // handler'а в очереди handler'ов) и указатель на функцию, обрабатывающую соединение (эта функция будет
 // обрабатывать входящий запрос и формировать ответ, содержа в себе логику формирования ответа, обращаясь
@@ -107,19 +140,41 @@ using phone_book_database::PhoneBookDatabase;
 // 1) Вначале handler создаётся, имея статус CREATED. Затем он получает статус LISTENING и становится на прослушивание
 //    порта в ожидании появления входящего запроса.
 //
-// 2) В какой-то момент придёт запрос, типу которого соответствует наш handler. Тогда он создаст в heap'е handler
-//    своего же типа со статусом CREATED и поставит его в очередь на прослушивание порта со статусом LISTENING.
+// 2) В какой-то момент придёт запрос, типу которого соответствует наш handler. Тогда он возьмёт из пула (или создаст
+//    в heap'е) handler своего же типа со статусом CREATED и поставит его в очередь на прослушивание порта со статусом LISTENING.
 //    Наш же handler перейдёт в статус PROCESSING и займётся обработкой поступившего запроса.
 //
 // 3) Перейдя в статус PROCESSING, handler для соединения типа 1-1 сразу обработает пришедший запрос с помощью функции,
 //    указанной в параметре шаблона, сформирует при помощи неё ответ и отправит его клиенту, а затем перейдёт в
-//    статус FINISHED. А вот handler для соединения типа 1-M, перейдя в статус PROCESSING, сформирует ответ на запрос
-//    в виде вектора ответов (response'ов), которые нужно будет отправить по одному, находясь в статусе PROCESSING.
-//    Только после полной отправки ответа (отправки последнего элемента вектора) такой handler перейдёт в статус
-//    FINISHED.
+//    статус FINISHED. А вот handler для соединения типа 1-M, перейдя в статус PROCESSING, получит от функции обработки
+//    курсор ответов (response'ов) и будет отправлять ответы по одному, находясь в статусе PROCESSING: каждый очередной
+//    ответ заполняется из курсора непосредственно перед его отправкой в одно и то же сообщение (gRPC сериализует
+//    сообщение уже внутри вызова Write, поэтому после него сообщение можно переиспользовать). Поиск по имени/фамилии/
+//    отчеству при этом вообще не собирает найденные записи в вектор, а лениво читает их курсором базы данных, поэтому
+//    первая запись уходит клиенту сразу, а память handler'а не зависит от числа найденных записей. Только после
+//    отправки последнего ответа такой handler перейдёт в статус FINISHED. Handler для соединения типа M-1, перейдя в
+//    статус PROCESSING, получит от функции обработки накопитель запросов и будет читать запросы клиента по одному в
+//    одно и то же сообщение, передавая каждый прочитанный запрос накопителю (накопитель добавления записей собирает
+//    записи в пачки и добавляет в базу данных целой пачкой). Когда клиент закончит поток запросов, накопитель
+//    дозаполнит ответ, handler отправит его клиенту и перейдёт в статус FINISHED.
 //
-// 4) Перейдя в статус FINISHED, handler вызывает необходимые процедуры для закрытия соединения, а затем удаляется
-//    из динамической памяти (heap'а).
+// 4) Перейдя в статус FINISHED, handler вызывает необходимые процедуры для закрытия соединения, а затем возвращается
+//    в пул свободных handler'ов своего типа (HandlersPool).
+//
+// Чтобы не выделять и не освобождать память под handler (вместе с параметрами соединения, запросом и ответом) на каждый
+// запрос, в шаге 2) handler на замену берётся из пула свободных handler'ов того же типа и перевзводится: параметры
+// соединения ServerContext и респондер создаются заново на том же месте (gRPC запрещает переиспользовать ServerContext
+// между соединениями), запрос и ответ очищаются методом Clear (строковые поля сохраняют уже выделенную память), статус
+// возвращается в CREATED. Лишь если пул пуст, handler создаётся в heap'е. Пул свой у каждого потока (thread_local),
+// поэтому обходится без блокировок; поток обслуживает только одну очередь handler'ов одного сервера, так что handler'ы
+// из его пула всегда относятся к той же очереди. Размер пула ограничен, лишние handler'ы удаляются из heap'а, а при
+// завершении потока пул удаляет все свои handler'ы.
+//
+// Запрос и ответ каждого handler'а размещаются в его собственной arena'е protobuf (google::protobuf::Arena), поэтому их
+// строковые поля берут память не из общего heap'а, а последовательно из блоков arena'ы, а память никогда не
+// освобождается чужим потоком. Начальный блок arena'ы лежит внутри
+// самого handler'а, при перевзводе handler'а arena очищается целиком (Reset), сохраняя начальный блок, и запрос с ответом
+// создаются в ней заново.
 //
 // Вначале создадим в heap'е по одному handler'у для каждого типа соединения и зарегистрируем их в очереди, поставив
 // на прослушивание порта, на котором будет работать сервер. Затем запустим цикл, в котором будем по кругу итерироваться
@@ -127,14 +182,29 @@ using phone_book_database::PhoneBookDatabase;
 // случае upcats'им void*-указатель на него до указателя на базовый класс BaseConnectionHandler и вызываем функцию
 // Proceed. Благодаря механизму динамического полиморфизма будет вызвана функция наследника, соответствующая стратегии
 // обработки соединения определённого типа. Именно в функции Proceed и будет реализован жизненный цикл handler'а
-// 1)->2)->3)->4), описанный выше.
+// 1)->2)->3)->4), описанный выше. Вместе с handler'ом очередь сообщает флаг успешности события (event_ok), который
+// handler'ы соединения типа M-1 используют, чтобы отличить очередной прочитанный запрос от окончания потока запросов
+// клиента, поэтому цикл вызывает Proceed через функцию ProceedEvent, предварительно запоминающую этот флаг.
+//
+// Для того, чтобы сервер мог использовать несколько ядер процессора, очередей handler'ов может быть несколько (их число
+// задаётся в конструкторе сервера). Каждая очередь регистрируется за gRPC-сервером, получает свой собственный набор
+// handler'ов (по одному на каждый тип соединения) и обслуживается своими потоками (их число на одну очередь также
+// задаётся в конструкторе сервера), каждый из которых крутит цикл HandlerQueueLoop по своей очереди. gRPC сам
+// распределяет входящие запросы между handler'ами, стоящими на прослушивании в разных очередях, поэтому запросы
+// обрабатываются параллельно. Handler на замену всегда создаётся в той же очереди, что и handler, принявший запрос,
+// поэтому набор handler'ов в каждой очереди остаётся полным.
+//
+// Если одну очередь обслуживают несколько потоков, то очередное событие handler'а может быть обработано другим
+// потоком сразу после того, как handler поставил асинхронную операцию (Write, Finish и т.д.) в очередь. Поэтому
+// handler обязан обновлять свой статус и счётчики до вызова асинхронной операции и не обращаться к своим полям
+// после него. Одновременно же у одного handler'а в очереди не бывает больше одного события, поэтому сама функция
+// Proceed для одного handler'а никогда не выполняется параллельно в двух потоках.
 //
-// Теоретически также можно реализовать и многопоточный подход, когда обработкой handler'ов из очереди будут заниматься
-// несколько потоков из Thread Pool'а. Можно, например, для каждого типа соединения выделить отдельный Thread Pool.
-// Возможен и более простой вариант с запуском на отдельном потоке лишь функции обработки и формирования ответа, которая
-// непосредственно обращается к базе данных телефонной книги, тогда можно воспользоваться функционалом std::async.
-// В любой из подобных реализаций следует подумать о механизме синхронизации через join'ы или другие механизмы, а также
-// об ограждении участков работы с контейнерами в базе данных телефонной книги mutex'ами, чтобы избежать состояния гонки.
+// Статус сервера читается всеми потоками, поэтому он хранится в std::atomic. База данных телефонной книги сама
+// обеспечивает одновременный доступ из разных потоков по принципу MVCC: поиск записей без блокировок работает с
+// атомарно загруженной неизменяемой версией (snapshot'ом) базы данных, а писатели строят копию версии, разделяющую
+// с прежней всё, кроме изменённых частей (copy-on-write), и атомарно публикуют её. Поэтому функции обработки
+// соединений могут вызываться из разных потоков одновременно, и чтения никогда не ждут записей.
 //
 // Идея и пример асинхронной реализаций с разными типами соединений взяты из статьи: https://habr.com/ru/articles/340758/
 
@@ -148,41 +218,205 @@ namespace connection_processing_functions {
 // Функция обработки запроса на добавление записи (тип 1-1)
 // (клиент получает код ответа: 0 - запись с таким номером телефона уже существует,
 //                              1 - запись успешно добавлена)
-void AddRecordProcessingFunction(PhoneBookDatabase&, RecordRequest*, AddRecordResponse*, const void*);
+void AddRecordProcessingFunction(ShardedPhoneBookDatabase&, RecordRequest*, AddRecordResponse*, const void*);
+
+// Функции обработки запросов типа M-1 вызываются один раз при открытии соединения и возвращают накопитель запросов -
+// объект с функцией void Add(RequestType* request, ResponseType* response), которая получает каждый прочитанный запрос
+// потока клиента (после неё сообщение запроса переиспользуется для чтения следующего, поэтому данные из него можно
+// забирать перемещением), и функцией void Finish(ResponseType* response), которая вызывается после окончания потока и
+// дозаполняет ответ. Handler соединения типа M-1 хранит накопитель до окончания потока запросов. Если соединение
+// разорвано или Add выбросил исключение, Finish не вызывается, и накопитель просто уничтожается (поэтому накопленные,
+// но ещё не применённые к базе данных запросы в этом случае должны отбрасываться)
+
+// Накопитель запросов на пакетное добавление записей: собирает записи в пачки по BATCH_SIZE записей и добавляет каждую
+// пачку в базу данных одним вызовом AddRecords (mutex'ы захватываются, а версии базы данных копируются и публикуются
+// один раз на пачку, а не на каждую запись), а коды ответа пачки сразу дописывает в ответ
+class AddRecordsAccumulator {
+public:
+    // Число записей в пачке, добавляемой в базу данных одним вызовом. Пачка затрагивает многие корзины словарей шарда
+    // и копирует их при записи, поэтому чем больше пачка, тем дешевле это копирование в пересчёте на одну запись, но
+    // Flush выполняется в потоке очереди завершения gRPC и на время добавления пачки останавливает обработку всех
+    // соединений этого потока: пачка из 65536 записей добавляется почти секунду, а пачка из 4096 записей - около 0,1
+    // секунды даже на одном ядре процессора (ценой примерно в 2,5 раза меньшей пропускной способности)
+    static constexpr size_t BATCH_SIZE = 4096;
+
+    // Конструктор принимает неконстантную ссылку на базу данных телефонной книги и void*-указатель на handler (для журнала)
+    AddRecordsAccumulator(ShardedPhoneBookDatabase& database, const void* handler_tag) : database_(database),
+                                                                                         handler_tag_(handler_tag) { }
+
+    // Функция приёма очередного запроса (забирает строки запроса перемещением; при заполнении пачки добавляет её в
+    // базу данных)
+    // (определение/definition этой функции находится в phone_book_server.cpp)
+    void Add(RecordRequest* request, AddRecordsResponse* response);
+
+    // Функция окончания потока запросов (добавляет в базу данных последнюю неполную пачку; при разрыве соединения не
+    // вызывается, и неполная пачка отбрасывается вместе с накопителем)
+    // (определение/definition этой функции находится в phone_book_server.cpp)
+    void Finish(AddRecordsResponse* response);
+
+private:
+    // Функция добавления накопленной пачки записей в базу данных и дописывания её кодов ответа в ответ
+    // (определение/definition этой функции находится в phone_book_server.cpp)
+    void Flush(AddRecordsResponse* response);
+
+    ShardedPhoneBookDatabase& database_;                   // Неконстантная ссылка на базу данных телефонной книги
+    const void* handler_tag_;                              // void*-указатель на handler (для журнала)
+    std::vector<ShardedPhoneBookDatabase::Record> records_; // Накопленная пачка записей
+};
+
+// Функция обработки запроса на пакетное добавление записей (тип M-1)
+// (клиент получает коды ответа по каждой записи: 0 - запись с таким номером телефона уже существует,
+//                                                1 - запись успешно добавлена,
+//  а также число добавленных и число отклонённых записей)
+AddRecordsAccumulator AddRecordsProcessingFunction(ShardedPhoneBookDatabase&, const void*);
 
 // Функция обработки запроса на удаление записи по номеру записи (тип 1-1)
 // (клиент получает код ответа: 0 - записи с таким номером/id не существует,
 //                              1 - запись успешно удалена)
-void DeleteRecordByIdProcessingFunction(PhoneBookDatabase&, DeleteRecordByIdRequest*, DeleteRecordResponse*, const void*);
+void DeleteRecordByIdProcessingFunction(ShardedPhoneBookDatabase&, DeleteRecordByIdRequest*, DeleteRecordResponse*, const void*);
 
 // Функция обработки запроса на удаление записи по номеру телефона (тип 1-1)
 // (клиент получает код ответа: 0 - записи с таким номером телефона не существует,
 //                              1 - запись успешно удалена)
-void DeleteRecordByNumberProcessingFunction(PhoneBookDatabase&, DeleteRecordByNumberRequest*, DeleteRecordResponse*, const void*);
+void DeleteRecordByNumberProcessingFunction(ShardedPhoneBookDatabase&, DeleteRecordByNumberRequest*, DeleteRecordResponse*, const void*);
 
 // Функция обработки запроса на поиск записи по номеру/id записи (тип 1-1)
 // (найденная запись может быть только одна или её может не быть вовсе, тогда формируем пустой ответ с id = 0)
-void FindRecordByIdProcessingFunction(PhoneBookDatabase&, FindRecordByIdRequest*, RecordResponse*, const void*);
+void FindRecordByIdProcessingFunction(ShardedPhoneBookDatabase&, FindRecordByIdRequest*, RecordResponse*, const void*);
+
+// Функции обработки запросов типа 1-M не формируют все ответы заранее, а возвращают курсор ответов - объект с
+// функцией bool Next(ResponseType* response), которая заполняет очередной ответ непосредственно перед его отправкой
+// клиенту и возвращает false, когда ответы закончились. Handler соединения типа 1-M хранит курсор до конца отправки
+
+// Курсор ответов по общему неизменяемому вектору записей (поиск по заметке, где записи необходимо вначале
+// ранжировать по релевантности, и небольшие результаты поиска по имени/фамилии/отчеству): один и тот же вектор
+// разделяется между всеми handler'ами одинаковых одновременных запросов (см. ShardedPhoneBookDatabase::ShareRecordsByNote),
+// поэтому строки записей копируются в ответы, а не перемещаются
+class RecordsVectorResponses {
+public:
+    // Конструктор принимает умный указатель на общий вектор найденных записей (nullptr - записей не найдено)
+    explicit RecordsVectorResponses(ShardedPhoneBookDatabase::SharedRecords records = nullptr) : records_(std::move(records)) { }
+
+    // Функция заполнения очередного ответа (возвращает false, если записи закончились)
+    // (определение/definition этой функции находится в phone_book_server.cpp)
+    bool Next(RecordResponse* response);
+
+private:
+    ShardedPhoneBookDatabase::SharedRecords records_; // Общий вектор найденных записей
+    size_t position_ = 0;                             // Номер очередной записи для отправки
+};
+
+// Курсор ответов по записям, которые лениво читаются из курсора базы данных (поиск по имени/фамилии/отчеству):
+// ни записи, ни ответы не собираются в вектор, поэтому память не зависит от числа найденных записей. Небольшой
+// результат (не более ShardedPhoneBookDatabase::MAX_SHARED_RECORDS записей) вместо курсора берётся из общего вектора
+// записей, который один раз собирается для всех одинаковых одновременных запросов
+class RecordsCursorResponses {
+public:
+    // Конструктор принимает курсор базы данных по найденным записям
+    explicit RecordsCursorResponses(ShardedPhoneBookDatabase::RecordsCursor cursor) : cursor_(std::move(cursor)) { }
+
+    // Конструктор принимает умный указатель на общий вектор найденных записей
+    explicit RecordsCursorResponses(ShardedPhoneBookDatabase::SharedRecords records) : shared_records_(std::move(records)) { }
+
+    // Функция заполнения очередного ответа (возвращает false, если записи закончились)
+    // (определение/definition этой функции находится в phone_book_server.cpp)
+    bool Next(RecordResponse* response);
+
+private:
+    // Курсор базы данных по найденным записям (пуст, если записи взяты из общего вектора)
+    ShardedPhoneBookDatabase::RecordsCursor cursor_;
+
+    // Ответы по общему вектору найденных записей (пусты, если записи читаются курсором)
+    RecordsVectorResponses shared_records_;
+};
+
+// Курсор пачек ответов (для пакетных вариантов запросов на поиск записей): собирает ответы курсора RecordResponses в
+// пачки RecordBatch, пока пачка не достигнет запрошенного клиентом ограничения по числу записей или размеру в байтах.
+// Handler соединения типа 1-M перед каждой отправкой очищает пачку, а очищенные элементы пачки protobuf оставляет за
+// собой и переиспользует, поэтому память handler'а ограничена размером одной пачки
+//
+// (поскольку класс шаблонный, его методы определены прямо в header-файле)
+template <typename RecordResponses>
+class RecordBatchResponses {
+public:
+    // Размер пачки по умолчанию и наибольший допустимый размер пачки в байтах (gRPC по умолчанию не принимает
+    // сообщения больше 4 МБ)
+    static constexpr size_t DEFAULT_MAX_BATCH_BYTES = 64 * 1024;
+    static constexpr size_t MAX_BATCH_BYTES = 1024 * 1024;
+
+    // Число байт, которое занимает в пачке заголовок одной записи (тег поля и длина вложенного сообщения)
+    static constexpr size_t RECORD_HEADER_BYTES = 4;
+
+    // Конструктор принимает курсор ответов по одной записи и запрошенные клиентом ограничения на размер пачки
+    RecordBatchResponses(RecordResponses responses, const BatchLimits& limits) :
+        responses_(std::move(responses)),
+        max_records_(limits.max_records() == 0 ? std::numeric_limits<size_t>::max() : limits.max_records()),
+        max_bytes_(limits.max_bytes() == 0 ? DEFAULT_MAX_BATCH_BYTES : std::min<size_t>(limits.max_bytes(), MAX_BATCH_BYTES)) { }
+
+    // Функция заполнения очередной пачки (возвращает false, если записи закончились). Ограничение по размеру мягкое:
+    // запись, на которой пачка превысила ограничение, остаётся в пачке, поэтому в пачке всегда есть хотя бы одна запись
+    bool Next(RecordBatch* batch) {
+        size_t batch_bytes = 0;
+
+        while (static_cast<size_t>(batch->records_size()) < max_records_ && batch_bytes < max_bytes_) {
+            RecordResponse* record = batch->add_records();
+
+            // Если записи закончились, убираем добавленный пустой элемент (он остаётся в пачке для переиспользования)
+            if (!responses_.Next(record)) {
+                batch->mutable_records()->RemoveLast();
+                break;
+            }
+
+            batch_bytes += record->ByteSizeLong() + RECORD_HEADER_BYTES;
+        }
+
+        return batch->records_size() > 0;
+    }
+
+private:
+    RecordResponses responses_; // Курсор ответов по одной записи
+    size_t max_records_;        // Максимальное число записей в пачке
+    size_t max_bytes_;          // Максимальный размер пачки в байтах
+};
 
 // Функция обработки запроса на поиск записей по имени (тип 1-M)
-// (найденных записей может быть множество или не быть вовсе, тогда формируем пустой вектор ответов)
-void FindRecordsByNameProcessingFunction(PhoneBookDatabase&, FindRecordsByNameRequest*, std::vector<RecordResponse>*, const void*);
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsCursorResponses FindRecordsByNameProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsByNameRequest*, const void*);
 
 // Функция обработки запроса на поиск записей по фамилии (тип 1-M)
-// (найденных записей может быть множество или не быть вовсе, тогда формируем пустой вектор ответов)
-void FindRecordsBySurnameProcessingFunction(PhoneBookDatabase&, FindRecordsBySurnameRequest*, std::vector<RecordResponse>*, const void*);
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsCursorResponses FindRecordsBySurnameProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsBySurnameRequest*, const void*);
 
 // Функция обработки запроса на поиск записей по отчеству (тип 1-M)
-// (найденных записей может быть множество или не быть вовсе, тогда формируем пустой вектор ответов)
-void FindRecordsByPatronymicProcessingFunction(PhoneBookDatabase&, FindRecordsByPatronymicRequest*, std::vector<RecordResponse>*, const void*);
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsCursorResponses FindRecordsByPatronymicProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsByPatronymicRequest*, const void*);
 
 // Функция обработки запроса на поиск записи по номеру телефона (тип 1-1)
 // (найденная запись может быть только одна или её может не быть вовсе, тогда формируем пустой ответ с id = 0)
-void FindRecordByNumberProcessingFunction(PhoneBookDatabase&, FindRecordByNumberRequest*, RecordResponse*, const void*);
+void FindRecordByNumberProcessingFunction(ShardedPhoneBookDatabase&, FindRecordByNumberRequest*, RecordResponse*, const void*);
 
 // Функция обработки запроса на поиск записей по заметке (тип 1-M)
-// (найденных записей может быть множество или не быть вовсе, тогда формируем пустой вектор ответов)
-void FindRecordsByNoteProcessingFunction(PhoneBookDatabase&, FindRecordsByNoteRequest*, std::vector<RecordResponse>*, const void*);
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsVectorResponses FindRecordsByNoteProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsByNoteRequest*, const void*);
+
+// Функция обработки запроса на поиск записей по нескольким полям сразу (тип 1-M)
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsCursorResponses FindRecordsProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsRequest*, const void*);
+
+// Функции обработки запросов на пакетный поиск записей по номерам/id записей и по номерам телефонов (тип 1-1)
+// (ответ содержит по одной записи на каждый ключ запроса в порядке ключей, для ненайденного ключа - пустую запись с id = 0)
+void FindRecordsByIdsProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsByIdsRequest*, RecordBatch*, const void*);
+void FindRecordsByNumbersProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsByNumbersRequest*, RecordBatch*, const void*);
+
+// Функции обработки пакетных вариантов запросов на поиск записей по имени/фамилии/отчеству/заметке (тип 1-M)
+// (записи те же, что и у обычных вариантов, но отправляются пачками RecordBatch с ограничениями из batch_limits запроса)
+RecordBatchResponses<RecordsCursorResponses> FindRecordsByNameBatchedProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsByNameRequest*, const void*);
+RecordBatchResponses<RecordsCursorResponses> FindRecordsBySurnameBatchedProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsBySurnameRequest*, const void*);
+RecordBatchResponses<RecordsCursorResponses> FindRecordsByPatronymicBatchedProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsByPatronymicRequest*, const void*);
+RecordBatchResponses<RecordsVectorResponses> FindRecordsByNoteBatchedProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsByNoteRequest*, const void*);
+
+// Функция обработки пакетного варианта запроса на поиск записей по нескольким полям сразу (тип 1-M)
+RecordBatchResponses<RecordsCursorResponses> FindRecordsBatchedProcessingFunction(ShardedPhoneBookDatabase&, FindRecordsRequest*, const void*);
 
 }
 
@@ -196,9 +430,12 @@ private:
     // (при вызове деструктора сервера для телефонной книги объект также будет уничтожен)
     std::unique_ptr<Server> server_;
 
-    // Умный указатель на объект очереди handler'ов соединений
-    // (при вызове деструктора сервера для телефонной книги объект также будет уничтожен)
-    std::unique_ptr<ServerCompletionQueue> handlers_queue_;
+    // Вектор умных указателей на объекты очередей handler'ов соединений
+    // (при вызове деструктора сервера для телефонной книги объекты также будут уничтожены)
+    std::vector<std::unique_ptr<ServerCompletionQueue>> handlers_queues_;
+
+    size_t queues_count_;            // Число очередей handler'ов
+    size_t threads_per_queue_count_; // Число потоков, обслуживающих одну очередь handler'ов
 
     // Сервис асинхронной gRPC-коммуникации
     AsyncService service_;
@@ -212,21 +449,23 @@ private:
     }; 
 
     // Статус сервера
-    ServerStatus server_status_;
+    // (читается потоками всех очередей handler'ов, поэтому атомарный)
+    std::atomic<ServerStatus> server_status_;
 
-    // Указатель на поток выполнения сервера
-    std::thread* server_thread_;
+    // Потоки выполнения сервера (потоки, обслуживающие очереди handler'ов)
+    std::vector<std::thread> server_threads_;
 
     // Неконстантая ссылка на базу данных телефонной книги
-    PhoneBookDatabase& database_;
+    ShardedPhoneBookDatabase& database_;
 
 public:
-    // Конструктор сервера принимает IP-адрес сервера, порт для работы сервера и неконстантную ссылку на базу
-    // данных телефонной книги, инициализирует nullptr'ом указатель на поток выполнения сервера и 
+    // Конструктор сервера принимает IP-адрес сервера, порт для работы сервера, неконстантную ссылку на базу
+    // данных телефонной книги, число очередей handler'ов и число потоков, обслуживающих одну очередь, и
     // устанавливает статус сервера в CREATED
     //
     // (определение/definition этой функции находится в phone_book_server.cpp)
-    explicit PhoneBookServer(const std::string& ip, uint16_t port, PhoneBookDatabase& database);
+    explicit PhoneBookServer(const std::string& ip, uint16_t port, ShardedPhoneBookDatabase& database,
+                             size_t queues_count = 1, size_t threads_per_queue_count = 1);
 
     // Деструктор сервера
     // (определение/definition этой функции находится в phone_book_server.cpp)
@@ -243,11 +482,74 @@ public:
 private:
     // Функция инициализации очереди handler'ов
     // (определение/definition этой функции находится в cpp-файле)
-    void HandlerQueueInitialization();
+    void HandlerQueueInitialization(ServerCompletionQueue* handlers_queue);
 
     // Функция циклического итерирования по очереди handler'ов (основной цикл сервера)
     // (определение/definition этой функции находится в cpp-файле)
-    void HandlerQueueLoop();
+    void HandlerQueueLoop(ServerCompletionQueue* handlers_queue);
+
+    // Максимальное число свободных handler'ов одного типа в пуле одного потока
+    // (лишние handler'ы после всплеска нагрузки удаляются из heap'а)
+    static constexpr size_t MAX_POOLED_HANDLERS_COUNT = 64;
+
+    // Размер начального блока arena'ы handler'а (лежит внутри handler'а и переживает очистку arena'ы) и максимальный
+    // размер блоков, которыми arena растёт при больших ответах
+    static constexpr size_t ARENA_INITIAL_BLOCK_SIZE = 4 * 1024;
+    static constexpr size_t ARENA_MAX_BLOCK_SIZE = 64 * 1024;
+
+    // Класс пула (free list'а) свободных handler'ов одного типа
+    // Параметр шаблона: тип handler'а (OneToOneConnectionHandler, OneToManyConnectionHandler или ManyToOneConnectionHandler
+    // с подставленными шаблонными параметрами), который должен иметь конструктор handler'а и функцию перевзвода Rearm
+    //
+    // (поскольку класс шаблонный, поместим definition'ы его методов прямо в header-файле)
+    template <typename HandlerType>
+    class HandlersPool {
+    public:
+        // Функция получения пула handler'ов текущего потока
+        // (у каждого потока свой пул, поэтому работа с ним не требует блокировок)
+        static HandlersPool& ForCurrentThread() {
+            static thread_local HandlersPool pool;
+            return pool;
+        }
+
+        // Функция запуска handler'а на прослушивание порта: берёт свободный handler из пула и перевзводит его или,
+        // если пул пуст, создаёт новый handler в heap'е (в обоих случаях handler сразу регистрируется в очереди)
+        void Acquire(AsyncService* service,
+                     ServerCompletionQueue* handlers_queue,
+                     const std::atomic<ServerStatus>& server_status,
+                     ShardedPhoneBookDatabase& database) {
+            if (free_handlers_.empty()) {
+                new HandlerType(service, handlers_queue, server_status, database);
+                return;
+            }
+
+            HandlerType* handler = free_handlers_.back();
+            free_handlers_.pop_back();
+            handler->Rearm(handlers_queue);
+        }
+
+        // Функция возврата завершившего работу handler'а в пул
+        // (если пул заполнен, handler удаляется из heap'а)
+        void Release(HandlerType* handler) {
+            if (free_handlers_.size() >= MAX_POOLED_HANDLERS_COUNT) {
+                delete handler;
+                return;
+            }
+
+            free_handlers_.push_back(handler);
+        }
+
+        // Деструктор (вызывается при завершении потока) удаляет из heap'а все свободные handler'ы пула
+        ~HandlersPool() {
+            for (HandlerType* handler : free_handlers_) {
+                delete handler;
+            }
+        }
+
+    private:
+        // Вектор сырых указателей на свободные handler'ы
+        std::vector<HandlerType*> free_handlers_;
+    };
 
     // Базовый абстрактный класс handler'а соединения
     class BaseConnectionHandler {
@@ -257,12 +559,12 @@ private:
         // и создаёт handler со статусом CREATED
         BaseConnectionHandler(AsyncService* service,
                               ServerCompletionQueue* handlers_queue,
-                              const ServerStatus& server_status,
-                              PhoneBookDatabase& database) : service_(service),
-                                                             handlers_queue_(handlers_queue),
-                                                             server_status_(server_status),
-                                                             database_(database),
-                                                             status_(ConnectionStatus::CREATED) { }
+                              const std::atomic<ServerStatus>& server_status,
+                              ShardedPhoneBookDatabase& database) : service_(service),
+                                                                    handlers_queue_(handlers_queue),
+                                                                    server_status_(server_status),
+                                                                    database_(database),
+                                                                    status_(ConnectionStatus::CREATED) { }
 
         // Публичный виртуальный деструктор необходим для корректного удаления наследников
         virtual ~BaseConnectionHandler() { }
@@ -270,7 +572,63 @@ private:
         // Чисто виртуальная функция обработки запроса handler'ом, её имплементацию требуется определить в наследниках
         virtual void Proceed() = 0;
 
+        // Функция обработки события handler'а из очереди handler'ов: запоминает флаг успешности события и вызывает
+        // функцию обработки запроса handler'ом
+        void ProceedEvent(bool event_ok) {
+            event_ok_ = event_ok;
+            Proceed();
+        }
+
     protected:
+        // Функция подготовки handler'а к повторному использованию: заново создаёт параметры соединения на том же месте
+        // (ServerContext нельзя переиспользовать между соединениями), очищает arena'у (все созданные в ней запрос и
+        // ответ уничтожаются, начальный блок сохраняется) и возвращает handler в статус CREATED
+        // (респондер наследника, ссылающийся на параметры соединения, должен быть уничтожен до вызова этой функции, а
+        // запрос и ответ после неё необходимо создать в arena'е заново)
+        void ResetConnection(ServerCompletionQueue* handlers_queue) {
+            handlers_queue_ = handlers_queue;
+            ctx_.emplace();
+            arena_.Reset();
+            status_ = ConnectionStatus::CREATED;
+        }
+
+        // Функция формирования параметров arena'ы handler'а с начальным блоком initial_block
+        static google::protobuf::ArenaOptions MakeArenaOptions(char* initial_block) {
+            google::protobuf::ArenaOptions options;
+            options.initial_block = initial_block;
+            options.initial_block_size = ARENA_INITIAL_BLOCK_SIZE;
+            options.max_block_size = ARENA_MAX_BLOCK_SIZE;
+            return options;
+        }
+
+        // Функция записи в журнал итоговой строки обработки соединения (уровень INFO, одна строка на каждый запрос):
+        // типы запроса и ответа, тип соединения, число отправленных ответов, время формирования ответа, время отправки
+        // ответа и полное время обработки соединения в микросекундах (отсчитывается от момента приёма запроса)
+        void LogConnectionFinished(const std::string& request_name, const std::string& response_name,
+                                   const char* connection_type, size_t responses_count) const {
+            // Для удобства подключим внутри функции пространство имён std
+            using namespace std;
+
+            const chrono::steady_clock::time_point finished_time = chrono::steady_clock::now();
+
+            PHONE_BOOK_LOG_INFO("rpc="s << request_name << " response="s << response_name << " type="s << connection_type << " handler="s << this <<
+                                " responses="s << responses_count <<
+                                " processing_us="s << chrono::duration_cast<chrono::microseconds>(processed_time_ - received_time_).count() <<
+                                " sending_us="s << chrono::duration_cast<chrono::microseconds>(finished_time - processed_time_).count() <<
+                                " total_us="s << chrono::duration_cast<chrono::microseconds>(finished_time - received_time_).count());
+        }
+
+        // Функция формирования статуса ошибки для исключения e, выброшенного при обработке запроса (например,
+        // неисправным журналом упреждающей записи): записывает ошибку в журнал и возвращает статус INTERNAL, с которым
+        // handler закрывает соединение, - клиент получает ошибку, а исключение не доходит до потока очереди handler'ов
+        Status ErrorStatus(const std::exception& e, const char* connection_type) const {
+            // Для удобства подключим внутри функции пространство имён std
+            using namespace std;
+
+            PHONE_BOOK_LOG_ERROR("["s << connection_type << " handler #"s << this << "]: Request has failed: "s << e.what());
+            return Status(grpc::StatusCode::INTERNAL, e.what());
+        }
+
         // Возможные статусы (состояния) handler'а
         enum class ConnectionStatus {
             CREATED,    // Подключение создано
@@ -282,11 +640,23 @@ private:
 
         AsyncService* service_;                 // Сырой указатель на сервис асинхронной gRPC-коммуникации
         ServerCompletionQueue* handlers_queue_; // Сырой указатель на очередь handler'ов
-        ServerContext ctx_;                     // Параметры соединения
         ConnectionStatus status_;               // Статус handler'а
+        bool event_ok_ = true;                  // Флаг успешности последнего события handler'а (false у операции чтения
+                                                // означает, что клиент закончил поток запросов)
+
+        // Моменты приёма запроса и окончания формирования ответа (для итоговой строки журнала)
+        std::chrono::steady_clock::time_point received_time_;
+        std::chrono::steady_clock::time_point processed_time_;
+
+        // Параметры соединения (пересоздаются на том же месте при повторном использовании handler'а)
+        std::optional<ServerContext> ctx_{std::in_place};
 
-        const ServerStatus& server_status_;     // Константная ссылка на статус сервера
-        PhoneBookDatabase& database_;           // Неконстантная ссылка на базу данных телефонной книги
+        // Начальный блок arena'ы и сама arena, в которой наследники размещают запрос и ответ
+        alignas(alignof(std::max_align_t)) char arena_initial_block_[ARENA_INITIAL_BLOCK_SIZE];
+        google::protobuf::Arena arena_{MakeArenaOptions(arena_initial_block_)};
+
+        const std::atomic<ServerStatus>& server_status_; // Константная ссылка на статус сервера
+        ShardedPhoneBookDatabase& database_;             // Неконстантная ссылка на базу данных телефонной книги
     };
 
     // Класс handler'а соединения типа 1-1, наследуется от базового класса handler'а
@@ -308,10 +678,13 @@ private:
 
     class OneToOneConnectionHandler : public BaseConnectionHandler {
     private:
-        RequestType  request_;  // Запрос (вместо RequestType  будет подставлен тип запроса)
-        ResponseType response_; // Ответ  (вместо ResponseType будет подставлен тип ответа )
+        // Запрос и ответ, размещённые в arena'е handler'а (вместо RequestType и ResponseType будут подставлены типы
+        // запроса и ответа)
+        RequestType*  request_  = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+        ResponseType* response_ = google::protobuf::Arena::CreateMessage<ResponseType>(&arena_);
 
-        ServerAsyncResponseWriter<ResponseType> responder_; // Асинхронный респондер для соединения типа 1-1
+        // Асинхронный респондер для соединения типа 1-1 (пересоздаётся на том же месте при повторном использовании handler'а)
+        std::optional<ServerAsyncResponseWriter<ResponseType>> responder_;
 
     public:
         // Конструктор принимает сырые указатели на сервис асинхронной gRPC-коммуникации и очередь handler'ов, а также
@@ -321,12 +694,12 @@ private:
         // handler'ом
         OneToOneConnectionHandler(AsyncService* service,
                                   ServerCompletionQueue* handlers_queue,
-                                  const ServerStatus& server_status,
-                                  PhoneBookDatabase& database) : BaseConnectionHandler(service,
-                                                                                       handlers_queue,
-                                                                                       server_status,
-                                                                                       database),
-                                                                 responder_(&ctx_) {
+                                  const std::atomic<ServerStatus>& server_status,
+                                  ShardedPhoneBookDatabase& database) : BaseConnectionHandler(service,
+                                                                                              handlers_queue,
+                                                                                              server_status,
+                                                                                              database),
+                                                                        responder_(std::in_place, &*ctx_) {
 
             // В результате первого вызова функции обработки запроса handler'ом, наш handler получит статус LISTENING, будет
             // добавлен в очередь handler'ов и поставлен на прослушивание порта в ожидании появления входящего соединения,
@@ -360,49 +733,60 @@ private:
             // Если handler только что создан и имеет статус CREATED
             if (status_ == ConnectionStatus::CREATED) {
 
-                // Информируем в консоль о создании нового handler'а для соединения типа 1-1
-                cout << "[1-1 handler #"s << this << "]: New handler for 1-1 connection"s << endl;
+                // Записываем в журнал сообщение о создании нового handler'а для соединения типа 1-1
+                PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << this << "]: New handler for 1-1 connection"s);
                 
-                // Регистрируем handler в очереди handler'ов с помощью переданной по указателю в параметрах шаблона функции
-                // из функционала gRPC, передавая ей в качестве уникального идентификатора handler'а void*-указатель на него
-                (service_->*ConnectionRegistrationFunction)(&ctx_, &request_, &responder_, handlers_queue_, handlers_queue_, this);
-
                 // Переводим handler в статус LISTENING, обработка соединения handler'ом начнётся, когда до этого handler'а
                 // дойдёт очередь на следующем проходе по очереди handler'ов в функции HandlerQueueLoop (функция циклического
-                // итерирования по очереди handler'ов)
+                // итерирования по очереди handler'ов). Статус меняется до регистрации, так как сразу после неё событие
+                // handler'а может быть обработано другим потоком, обслуживающим ту же очередь handler'ов
                 status_ = ConnectionStatus::LISTENING;
+
+                // Регистрируем handler в очереди handler'ов с помощью переданной по указателю в параметрах шаблона функции
+                // из функционала gRPC, передавая ей в качестве уникального идентификатора handler'а void*-указатель на него
+                (service_->*ConnectionRegistrationFunction)(&*ctx_, request_, &*responder_, handlers_queue_, handlers_queue_, this);
             }
             // Если handler в процессе обработки соединения и имеет статус LISTENING
             else if (status_ == ConnectionStatus::LISTENING) {
 
-                // Информируем в консоль о том, что наш handler увидел входящий запрос, соответствующего ему типа, открыл
+                // Записываем в журнал сообщение о том, что наш handler увидел входящий запрос, соответствующего ему типа, открыл
                 // соединение и принял этот запрос
-                cout << "[1-1 handler #"s << this << "]: Handler has opened 1-1 connection and received the request ("s << sizeof(request_) << " bytes)"s << endl;
+                PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << this << "]: Handler has opened 1-1 connection and received the request ("s << sizeof(*request_) << " bytes)"s);
 
-                // Переводим наш handler в статус PROCESSING
+                // Запоминаем момент приёма запроса и переводим наш handler в статус PROCESSING
+                received_time_ = chrono::steady_clock::now();
                 status_ = ConnectionStatus::PROCESSING;
 
-                // Создаём в heap'е handler такого же типа (он сразу же в вызове конструктора будет зарегистрирован в очереди
-                // handler'ов и поставлен на прослушивание порта, получив вначале статус CREATED, а затем LISTENING), который
-                // сменит наш handler на посту и будет находиться в ожидании появления нового входящего соединения,
+                // Берём из пула (или, если пул пуст, создаём в heap'е) handler такого же типа (он сразу же будет зарегистрирован
+                // в очереди handler'ов и поставлен на прослушивание порта, получив вначале статус CREATED, а затем LISTENING),
+                // который сменит наш handler на посту и будет находиться в ожидании появления нового входящего соединения,
                 // соответствующему типу нашего handler'a. Наш же handler далее займётся обработкой текущего соединения
-                new OneToOneConnectionHandler<RequestType,
-                                              ResponseType,
-                                              ConnectionRegistrationFunction,
-                                              ConnectionProcessingFunction>(service_,
-                                                                            handlers_queue_,
-                                                                            server_status_,
-                                                                            database_);
+                HandlersPool<OneToOneConnectionHandler>::ForCurrentThread().Acquire(service_,
+                                                                                    handlers_queue_,
+                                                                                    server_status_,
+                                                                                    database_);
 
                 // Вызываем функцию обработки соединения, переданную в параметрах шаблона. Эта функция будет осуществлять
-                // обработку входящего запроса и формировать ответ, обращаясь к базе данных телефонной книги
-                ConnectionProcessingFunction(database_, &request_, &response_, this);
+                // обработку входящего запроса и формировать ответ, обращаясь к базе данных телефонной книги (если она
+                // выбросит исключение, клиент вместо ответа получит статус ошибки)
+                Status status = Status::OK;
+                try {
+                    ConnectionProcessingFunction(database_, request_, response_, this);
+                } catch (const exception& e) {
+                    status = ErrorStatus(e, "1-1");
+                }
+                processed_time_ = chrono::steady_clock::now();
+
+                // Записываем в журнал сообщение о том, что наш handler сформировал ответ и начал его отправку клиенту
+                PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << this << "]: Sending response ... ("s << sizeof(*response_) << " bytes)"s);
+
+                // Переводим handler в статус FINISHED до отправки ответа: событие о завершении отправки может быть
+                // обработано другим потоком, обслуживающим ту же очередь handler'ов, ещё до возврата из Finish
+                status_ = ConnectionStatus::FINISHED;
 
-                // Информируем в консоль о том, что наш handler сформировал ответ и начал его отправку клиенту
-                cout << "[1-1 handler #"s << this << "]: Sending response ... ("s << sizeof(response_) << " bytes)"s << endl;
-                
                 // Отправляем сформированный ответ клиенту и снимаем responder нашего handler'а с соединения, закрывая его
-                responder_.Finish(response_, Status::OK, this);
+                // (после этого вызова обращаться к полям handler'а уже нельзя, он может быть удалён другим потоком)
+                responder_->Finish(*response_, status, this);
 
                 // Замечание: здесь можно выдать exception в случае неуспешной отправки ответа клиенту. При выдачи exception'а
                 // начнётся раскрутка stack'а до ближайшего catch'а, куда будет передана информация о выданном exception'е. В
@@ -416,12 +800,6 @@ private:
                 // рискует упасть. Возможно, фреймворк gRPC сам генерирует в таком случае exception'ы и/или купирует подобные
                 // ситуации. Также стоит задуматься над нестандартными ситуациями и их купированием и в других местах, где ведётся
                 // работа с соединением.
-                
-                // Информируем в консоль о том, что наш handler успешно отправил ответ клиенту
-                cout << "[1-1 handler #"s << this << "]: Response has been sent ("s << sizeof(response_) << " bytes)"s << endl;
-
-                // Переводим handler в статус FINISHED
-                status_ = ConnectionStatus::FINISHED;
             }
             // В остальных случаях handler завершил работу и имеет статус FINISHED
             else {
@@ -429,21 +807,41 @@ private:
                 // Проверяем, что handler действительно имеет статус FINISHED
                 GPR_ASSERT(status_ == ConnectionStatus::FINISHED);
 
-                // Информируем в консоль о завершении работы handler'а для соединения типа 1-1
-                cout << "[1-1 handler #"s << this << "]: Handler for 1-1 connection has finished"s << endl;
+                // Записываем в журнал сообщение о том, что наш handler успешно отправил ответ клиенту
+                PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << this << "]: Response has been sent ("s << sizeof(*response_) << " bytes)"s);
 
-                // Удаляем handler из heap'а и завершаем обработку
-                delete this; return;
+                // Записываем в журнал сообщение о завершении работы handler'а для соединения типа 1-1
+                PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << this << "]: Handler for 1-1 connection has finished"s);
+
+                // Записываем в журнал итоговую строку обработки соединения
+                LogConnectionFinished(RequestType::descriptor()->name(), ResponseType::descriptor()->name(), "1-1", 1);
+
+                // Возвращаем handler в пул свободных handler'ов и завершаем обработку
+                HandlersPool<OneToOneConnectionHandler>::ForCurrentThread().Release(this); return;
             }
         }
 
-        // Деструктор информирует в консоль об удалении handler'а из heap'а
+        // Функция перевзвода handler'а, взятого из пула свободных handler'ов: пересоздаёт параметры соединения и
+        // респондер, очищает arena'у, заново создаёт в ней запрос и ответ и вызывает функцию обработки запроса
+        // handler'ом, которая поставит handler на прослушивание порта
+        void Rearm(ServerCompletionQueue* handlers_queue) {
+            responder_.reset();
+            ResetConnection(handlers_queue);
+            responder_.emplace(&*ctx_);
+
+            request_  = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+            response_ = google::protobuf::Arena::CreateMessage<ResponseType>(&arena_);
+
+            Proceed();
+        }
+
+        // Деструктор записывает в журнал сообщение об удалении handler'а из heap'а
         ~OneToOneConnectionHandler() {
             // Для удобства подключим внутри функции пространство имён std
             using namespace std;
 
-            // Информируем в консоль об удалении handler'а из heap'а
-            cout << "[1-1 handler #"s << this << "]: Handler for 1-1 connection was deleted from heap"s << endl;
+            // Записываем в журнал сообщение об удалении handler'а из heap'а
+            PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << this << "]: Handler for 1-1 connection was deleted from heap"s);
         }
     };
 
@@ -466,12 +864,22 @@ private:
 
     class OneToManyConnectionHandler : public BaseConnectionHandler{
     private:
-        RequestType request_;                // Запрос         (вместо RequestType  будет подставлен тип запроса)
-        std::vector<ResponseType> response_; // Вектор ответов (вместо ResponseType будет подставлен тип ответа )
+        // Тип курсора ответов, возвращаемого функцией обработки соединения
+        using ResponsesCursor = std::invoke_result_t<decltype(ConnectionProcessingFunction),
+                                                     ShardedPhoneBookDatabase&, RequestType*, const void*>;
 
-        ServerAsyncWriter<ResponseType> responder_; // Асинхронный респондер для соединения типа 1-M
+        // Запрос и ответ, размещённые в arena'е handler'а (вместо RequestType и ResponseType будут подставлены типы
+        // запроса и ответа; ответ один на все отправки, перед каждой отправкой он очищается и заполняется из курсора)
+        RequestType*  request_  = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+        ResponseType* response_ = google::protobuf::Arena::CreateMessage<ResponseType>(&arena_);
 
-        size_t responder_counter_; // Счётчик для итерации по вектору ответов при отправке оного клиенту
+        // Курсор ответов (существует с момента обработки запроса до окончания отправки ответов)
+        std::optional<ResponsesCursor> responses_cursor_;
+
+        // Асинхронный респондер для соединения типа 1-M (пересоздаётся на том же месте при повторном использовании handler'а)
+        std::optional<ServerAsyncWriter<ResponseType>> responder_;
+
+        size_t responder_counter_; // Счётчик отправленных клиенту ответов
         size_t bytes_counter_;     // Счётчик отправленных клиенту байт
 
     public:
@@ -479,18 +887,18 @@ private:
         // константную ссылку на статус сервера и неконстантную ссылку на базу данных телефонной книги. Конструктор вызывает
         // конструктор базового класса, который создаёт hanlder со статусом CREATED, затем конструктор связывает асинхронный
         // респондер и параметры соединения (в нашем случае дефолтные), после чего конструктор устанавливает на ноль счётчик
-        // итераций по вектору ответов при отправке оного клиенту, устанавливает на ноль счётчик отправленных клиенту байт и,
-        // наконец, вызывает функцию обработки запроса handler'ом
+        // отправленных клиенту ответов, устанавливает на ноль счётчик отправленных клиенту байт и, наконец, вызывает функцию
+        // обработки запроса handler'ом
         OneToManyConnectionHandler(AsyncService* service,
                                    ServerCompletionQueue* handlers_queue,
-                                   const ServerStatus& server_status,
-                                   PhoneBookDatabase& database) : BaseConnectionHandler(service,
-                                                                                        handlers_queue,
-                                                                                        server_status,
-                                                                                        database),
-                                                                  responder_(&ctx_),
-                                                                  responder_counter_(0),
-                                                                  bytes_counter_(0) {
+                                   const std::atomic<ServerStatus>& server_status,
+                                   ShardedPhoneBookDatabase& database) : BaseConnectionHandler(service,
+                                                                                               handlers_queue,
+                                                                                               server_status,
+                                                                                               database),
+                                                                         responder_(std::in_place, &*ctx_),
+                                                                         responder_counter_(0),
+                                                                         bytes_counter_(0) {
 
             // В результате первого вызова функции обработки запроса handler'ом, наш handler получит статус LISTENING, будет
             // добавлен в очередь handler'ов и поставлен на прослушивание порта в ожидании появления входящего соединения,
@@ -523,17 +931,18 @@ private:
 
             // Если handler только что создан и имеет статус CREATED
             if (status_ == ConnectionStatus::CREATED) {
-                // Информируем в консоль о создании нового handler'а для соединения типа 1-M
-                cout << "[1-M handler #"s << this << "]: New handler for 1-M connection"s << endl;
-
-                // Регистрируем handler в очереди handler'ов с помощью переданной по указателю в параметрах шаблона функции
-                // из функционала gRPC, передавая ей в качестве уникального идентификатора handler'а void*-указатель на него
-                (service_->*ConnectionRegistrationFunction)(&ctx_, &request_, &responder_, handlers_queue_, handlers_queue_, this);
+                // Записываем в журнал сообщение о создании нового handler'а для соединения типа 1-M
+                PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << this << "]: New handler for 1-M connection"s);
 
                 // Переводим handler в статус LISTENING, обработка соединения handler'ом начнётся, когда до этого handler'а
                 // дойдёт очередь на следующем проходе по очереди handler'ов в функции HandlerQueueLoop (функция циклического
-                // итерирования по очереди handler'ов)
+                // итерирования по очереди handler'ов). Статус меняется до регистрации, так как сразу после неё событие
+                // handler'а может быть обработано другим потоком, обслуживающим ту же очередь handler'ов
                 status_ = ConnectionStatus::LISTENING;
+
+                // Регистрируем handler в очереди handler'ов с помощью переданной по указателю в параметрах шаблона функции
+                // из функционала gRPC, передавая ей в качестве уникального идентификатора handler'а void*-указатель на него
+                (service_->*ConnectionRegistrationFunction)(&*ctx_, request_, &*responder_, handlers_queue_, handlers_queue_, this);
             }
             // Если handler в процессе обработки соединения и имеет статус LISTENING или PROCESSING
             else if (status_ == ConnectionStatus::LISTENING || status_ == ConnectionStatus::PROCESSING) {
@@ -544,74 +953,86 @@ private:
                 // будет обрабатывать текущее соединение
                 if(status_ == ConnectionStatus::LISTENING) {
 
-                    // Информируем в консоль о том, что наш handler увидел входящий запрос, соответствующего ему типа, открыл
+                    // Записываем в журнал сообщение о том, что наш handler увидел входящий запрос, соответствующего ему типа, открыл
                     // соединение и принял этот запрос
-                    cout << "[1-M handler #"s << this << "]: Handler has opened 1-M connection and received the request ("s << sizeof(request_) << " bytes)"s << endl;
+                    PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << this << "]: Handler has opened 1-M connection and received the request ("s << sizeof(*request_) << " bytes)"s);
 
-                    // Переводим наш handler в статус PROCESSING
+                    // Запоминаем момент приёма запроса и переводим наш handler в статус PROCESSING
+                    received_time_ = chrono::steady_clock::now();
                     status_ = ConnectionStatus::PROCESSING;
 
-                    // Создаём в heap'е handler такого же типа (он сразу же в вызове конструктора будет зарегистрирован в очереди
-                    // handler'ов и поставлен на прослушивание порта, получив вначале статус CREATED, а затем LISTENING), который
-                    // сменит наш handler на посту и будет находиться в ожидании появления нового входящего соединения,
+                    // Берём из пула (или, если пул пуст, создаём в heap'е) handler такого же типа (он сразу же будет зарегистрирован
+                    // в очереди handler'ов и поставлен на прослушивание порта, получив вначале статус CREATED, а затем LISTENING),
+                    // который сменит наш handler на посту и будет находиться в ожидании появления нового входящего соединения,
                     // соответствующему типу нашего handler'a. Наш же handler далее займётся обработкой текущего соединения
-                    new OneToManyConnectionHandler<RequestType,
-                                                   ResponseType,
-                                                   ConnectionRegistrationFunction,
-                                                   ConnectionProcessingFunction>(service_,
-                                                                                 handlers_queue_,
-                                                                                 server_status_,
-                                                                                 database_);
+                    HandlersPool<OneToManyConnectionHandler>::ForCurrentThread().Acquire(service_,
+                                                                                         handlers_queue_,
+                                                                                         server_status_,
+                                                                                         database_);
 
                     // После перевода нашего handler'а в статус PROCESSING мы уже не попадём в этот блок, поэтому handler на замену
                     // будет создан лишь однократно
 
                     // Вызываем функцию обработки соединения, переданную в параметрах шаблона. Эта функция будет осуществлять
-                    // обработку входящего запроса и, обращаясь к базе данных телефонной книги, формировать вектор ответов,
-                    // элементы которого будут последовательно отправляться клиенту
-                    ConnectionProcessingFunction(database_, &request_, &response_, this);
+                    // обработку входящего запроса и, обращаясь к базе данных телефонной книги, возвращать курсор ответов,
+                    // из которого ответы будут по одному заполняться и отправляться клиенту (если она выбросит исключение,
+                    // соединение сразу закрывается со статусом ошибки)
+                    try {
+                        responses_cursor_.emplace(ConnectionProcessingFunction(database_, request_, this));
+                    } catch (const exception& e) {
+                        processed_time_ = chrono::steady_clock::now();
+                        status_ = ConnectionStatus::FINISHED;
+                        responder_->Finish(ErrorStatus(e, "1-M"), this);
+                        return;
+                    }
+                    processed_time_ = chrono::steady_clock::now();
 
                     // Так как статус нашего handler'а переведён в PROCESSING, и мы уже не попадём в этот блок, функция
-                    // обработки соединения, формирующая вектор ответов, будет вызвана лишь однократно
+                    // обработки соединения, возвращающая курсор ответов, будет вызвана лишь однократно
                 }
 
-                // После того, как вектор ответов сформирован, необходимо последовательно отправить все его элементы клиенту.
-                // Будем отправлять очередной элемент каждый раз, когда до нашего handler'а будет доходить очередь на очередном
-                // проходе по очереди handler'ов в функции HandlerQueueLoop (функция циклического итерирования по очереди handler'ов).
-                // Для этого будем использовать счётчик отправок, который при создании handler'а инициализируется нулём, а при каждой
-                // отправке очередного элемента вектора ответов клиенту будет инкрементироваться до тех пор, пока не дойдёт до размера
-                // вектора ответов, после чего отправка завершится.
-                
-                // Если счётчик отправок меньше размера вектора ответов, необходимо отправить клиенту очередной элемент вектора ответов
-                if(responder_counter_ < response_.size()) {
+                // После того, как курсор ответов получен, необходимо последовательно отправить все ответы клиенту. Будем
+                // отправлять очередной ответ каждый раз, когда до нашего handler'а будет доходить очередь на очередном проходе
+                // по очереди handler'ов в функции HandlerQueueLoop (функция циклического итерирования по очереди handler'ов).
+                // Очередной ответ заполняется из курсора непосредственно перед отправкой в одно и то же сообщение response_,
+                // а когда курсор исчерпается, отправка завершится.
+                response_->Clear();
 
-                    // Информируем в консоль о том, что наш handler отправляет клиенту очередной элемент вектора ответов
-                    cout << "[1-M handler #"s << this << "]: Sending response (part "s << responder_counter_ + 1 << "/"s << response_.size() << ")"s << endl;
+                // Если в курсоре есть очередной ответ, необходимо отправить его клиенту
+                if(responses_cursor_->Next(response_)) {
 
-                    // Отправляем очередной элемент вектора ответов клиенту
-                    responder_.Write(response_[responder_counter_], this);
+                    // Записываем в журнал сообщение о том, что наш handler отправляет клиенту очередной ответ
+                    PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << this << "]: Sending response (part "s << responder_counter_ + 1 << ")"s);
 
-                    // Замечание: здесь можно выдать exception в случае неуспешной отправки очередного элемента вектора ответов клиенту
+                    // Добавляем число отправляемых байт к счётчику байт
+                    bytes_counter_ += sizeof(*response_);
 
-                    // Инкрементируем счётчик счётчик отправок
+                    // Инкрементируем счётчик отправок до вызова Write: событие о завершении отправки может быть
+                    // обработано другим потоком, обслуживающим ту же очередь handler'ов, ещё до возврата из Write
                     ++responder_counter_;
 
-                    // Добавляем число отправленных байт к счётчику байт
-                    bytes_counter_ += sizeof(response_[responder_counter_]);
+                    // Отправляем очередной ответ клиенту (Write сериализует сообщение сразу, поэтому на следующем шаге
+                    // его можно очистить и заполнить заново)
+                    responder_->Write(*response_, this);
+
+                    // Замечание: здесь можно выдать exception в случае неуспешной отправки очередного ответа клиенту
                 }
-                // Иначе счётчик отправок достиг размера вектора ответов, необходимо завершить отправку клиенту вектора ответов
+                // Иначе курсор исчерпан, необходимо завершить отправку клиенту ответов
                 else {
 
-                    // Информируем в консоль о том, что наш handler успешно завершил отправку клиенту вектора ответов
-                    cout << "[1-M handler #"s << this << "]: Response has been fully sent ("s << bytes_counter_ << " bytes)"s << endl;
+                    // Записываем в журнал сообщение о том, что наш handler успешно завершил отправку клиенту ответов
+                    PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << this << "]: Response has been fully sent ("s << responder_counter_ << " parts, "s << bytes_counter_ << " bytes)"s);
+
+                    // Освобождаем курсор ответов (а вместе с ним и удерживаемые им версии базы данных)
+                    responses_cursor_.reset();
+
+                    // Переводим handler в статус FINISHED до закрытия соединения (по той же причине, что и выше)
+                    status_ = ConnectionStatus::FINISHED;
 
                     // Cнимаем responder нашего handler'а с соединения, закрывая текущее соединение
-                    responder_.Finish(Status(), this);
+                    responder_->Finish(Status(), this);
 
                     // Замечание: здесь можно выдать exception в случае неуспешной попытки закрыть соединение
-
-                    // Переводим handler в статус FINISHED
-                    status_ = ConnectionStatus::FINISHED;
                 }
             }
             // В остальных случаях handler завершил работу и имеет статус FINISHED
@@ -620,23 +1041,271 @@ private:
                 // Проверяем, что handler действительно имеет статус FINISHED
                 GPR_ASSERT(status_ == ConnectionStatus::FINISHED);
 
-                // Информируем в консоль о завершении работы handler'а для соединения типа 1-M
-                cout << "[1-M handler #"s << this << "]: Handler for 1-M connection has finished"s << endl;
+                // Записываем в журнал сообщение о завершении работы handler'а для соединения типа 1-M
+                PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << this << "]: Handler for 1-M connection has finished"s);
+
+                // Записываем в журнал итоговую строку обработки соединения
+                LogConnectionFinished(RequestType::descriptor()->name(), ResponseType::descriptor()->name(), "1-M", responder_counter_);
+
+                // Возвращаем handler в пул свободных handler'ов и завершаем обработку
+                HandlersPool<OneToManyConnectionHandler>::ForCurrentThread().Release(this); return;
+            }
+        }
+
+        // Функция перевзвода handler'а, взятого из пула свободных handler'ов: пересоздаёт параметры соединения и
+        // респондер, очищает arena'у, заново создаёт в ней запрос и ответ, обнуляет счётчики и вызывает функцию
+        // обработки запроса handler'ом, которая поставит handler на прослушивание порта
+        void Rearm(ServerCompletionQueue* handlers_queue) {
+            responder_.reset();
+            responses_cursor_.reset();
+            ResetConnection(handlers_queue);
+            responder_.emplace(&*ctx_);
+
+            request_  = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+            response_ = google::protobuf::Arena::CreateMessage<ResponseType>(&arena_);
+
+            responder_counter_ = 0;
+            bytes_counter_ = 0;
+
+            Proceed();
+        }
+
+        // Деструктор записывает в журнал сообщение об удалении handler'а из heap'а
+        ~OneToManyConnectionHandler() {
+            // Для удобства подключим внутри функции пространство имён std
+            using namespace std;
+
+            // Записываем в журнал сообщение об удалении handler'а из heap'а
+            PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << this << "]: Handler for 1-M connection was deleted from heap"s);
+        }
+    };
+
+    // Класс handler'а соединения типа M-1, наследуется от базового класса handler'а
+    // Параметры шаблона: тип запроса (request'а), тип ответа (response'а), указатель на функцию инициализации соединения,
+    // указатель на функцию обработки соединения
+    //
+    // (поскольку класс шаблонный, поместим definition'ы его методов прямо в header-файле, иначе возникнет ошибка при
+    // инстанцировании с определёнными шаблонными параметрами, что приведёт к ошибкам на этапе линкови - definition'ы
+    // функций с нужными подставленными шаблонными параметрами не будут найдены ни в одной единице трансляции)
+
+    template <typename RequestType,   // Тип запроса (request'а)
+              typename ResponseType,  // Тип ответа  (response'а)
+              auto ConnectionRegistrationFunction, // Указатель на функцию инициализации соединения из функционала gRPC
+                                                   // (эта функция осуществляет регистрацию handler'а в очереди handler'ов)
+              auto ConnectionProcessingFunction>   // Указатель на функцию обработки соединения типа M-1
+                                                   // (эта функция возвращает накопитель запросов, который обрабатывает
+                                                   // входящие запросы и формирует ответ, обращаясь к базе данных
+                                                   // телефонной книги)
+
+    class ManyToOneConnectionHandler : public BaseConnectionHandler {
+    private:
+        // Тип накопителя запросов, возвращаемого функцией обработки соединения
+        using RequestsAccumulator = std::invoke_result_t<decltype(ConnectionProcessingFunction),
+                                                         ShardedPhoneBookDatabase&, const void*>;
+
+        // Запрос и ответ, размещённые в arena'е handler'а (запрос один на все чтения, перед каждым чтением он очищается)
+        RequestType*  request_  = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+        ResponseType* response_ = google::protobuf::Arena::CreateMessage<ResponseType>(&arena_);
+
+        // Накопитель запросов (существует с момента открытия соединения до окончания потока запросов)
+        std::optional<RequestsAccumulator> requests_accumulator_;
+
+        // Асинхронный респондер для соединения типа M-1 (пересоздаётся на том же месте при повторном использовании handler'а)
+        std::optional<ServerAsyncReader<ResponseType, RequestType>> responder_;
+
+        size_t requests_counter_; // Счётчик прочитанных запросов клиента
+
+        // Признак того, что чтение потока запросов закончилось и handler ждёт подтверждения, что соединение живо
+        // (см. обработку статуса PROCESSING)
+        bool requests_received_;
+
+    public:
+        // Конструктор принимает сырые указатели на сервис асинхронной gRPC-коммуникации и очередь handler'ов, а также
+        // константную ссылку на статус сервера и неконстантную ссылку на базу данных телефонной книги. Конструктор вызывает
+        // конструктор базового класса, который создаёт hanlder со статусом CREATED, затем конструктор связывает асинхронный
+        // респондер и параметры соединения, устанавливает на ноль счётчик прочитанных запросов и вызывает функцию
+        // обработки запроса handler'ом
+        ManyToOneConnectionHandler(AsyncService* service,
+                                   ServerCompletionQueue* handlers_queue,
+                                   const std::atomic<ServerStatus>& server_status,
+                                   ShardedPhoneBookDatabase& database) : BaseConnectionHandler(service,
+                                                                                               handlers_queue,
+                                                                                               server_status,
+                                                                                               database),
+                                                                         responder_(std::in_place, &*ctx_),
+                                                                         requests_counter_(0),
+                                                                         requests_received_(false) {
+
+            // В результате первого вызова функции обработки запроса handler'ом, наш handler получит статус LISTENING, будет
+            // добавлен в очередь handler'ов и поставлен на прослушивание порта в ожидании появления входящего соединения,
+            // соответствующему типу handler'a
+            Proceed();
+        }
+
+        // Имплементация функции обработки запроса handler'ом для соединения типа M-1
+        virtual void Proceed() override {
+            // Для удобства подключим внутри функции пространство имён std
+            using namespace std;
+
+            // Если сервер находится не в состоянии RUNNING, а handler в состоянии CREATED или LISTENING, т.е. сервер
+            // находится в  процессе остановки, а handler в состоянии ожидания запроса, то переводим handler в статус
+            // ABORTED и завершаем обработку соединения, дабы высвободить все возможные ресурсы при остановке сервера
+            if (server_status_ != ServerStatus::RUNNING && (status_ == ConnectionStatus::CREATED ||
+                                                            status_ == ConnectionStatus::LISTENING)) {
+                status_ = ConnectionStatus::ABORTED;
 
                 // Удаляем handler из heap'а и завершаем обработку
                 delete this; return;
             }
+
+            // Если handler только что создан и имеет статус CREATED
+            if (status_ == ConnectionStatus::CREATED) {
+                // Записываем в журнал сообщение о создании нового handler'а для соединения типа M-1
+                PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << this << "]: New handler for M-1 connection"s);
+
+                // Переводим handler в статус LISTENING до регистрации (по той же причине, что и у остальных handler'ов)
+                status_ = ConnectionStatus::LISTENING;
+
+                // Регистрируем handler в очереди handler'ов с помощью переданной по указателю в параметрах шаблона функции
+                // из функционала gRPC (у соединения типа M-1 запросы читаются уже после открытия соединения, поэтому
+                // запрос при регистрации не передаётся)
+                (service_->*ConnectionRegistrationFunction)(&*ctx_, &*responder_, handlers_queue_, handlers_queue_, this);
+            }
+            // Если handler только что открыл соединение и имеет статус LISTENING
+            else if (status_ == ConnectionStatus::LISTENING) {
+
+                // Записываем в журнал сообщение о том, что наш handler открыл соединение типа M-1
+                PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << this << "]: Handler has opened M-1 connection"s);
+
+                // Запоминаем момент открытия соединения и переводим наш handler в статус PROCESSING
+                received_time_ = chrono::steady_clock::now();
+                status_ = ConnectionStatus::PROCESSING;
+
+                // Берём из пула (или, если пул пуст, создаём в heap'е) handler такого же типа, который сменит наш handler на
+                // посту и будет находиться в ожидании появления нового входящего соединения
+                HandlersPool<ManyToOneConnectionHandler>::ForCurrentThread().Acquire(service_,
+                                                                                     handlers_queue_,
+                                                                                     server_status_,
+                                                                                     database_);
+
+                // Вызываем функцию обработки соединения, переданную в параметрах шаблона, и получаем накопитель запросов
+                requests_accumulator_.emplace(ConnectionProcessingFunction(database_, this));
+
+                // Читаем первый запрос клиента (событие о завершении чтения может быть обработано другим потоком ещё до
+                // возврата из Read, поэтому после этого вызова обращаться к полям handler'а уже нельзя)
+                responder_->Read(request_, this);
+            }
+            // Если handler читает поток запросов и имеет статус PROCESSING
+            else if (status_ == ConnectionStatus::PROCESSING) {
+
+                // Если накопитель выбросит исключение, чтение потока запросов прекращается, и соединение закрывается со
+                // статусом ошибки
+                Status status = Status::OK;
+                try {
+                    // Если поток запросов ещё читается
+                    if (!requests_received_) {
+
+                        // Если чтение успешно, передаём прочитанный запрос накопителю и читаем следующий запрос в то же
+                        // сообщение
+                        if (event_ok_) {
+                            ++requests_counter_;
+                            requests_accumulator_->Add(request_, response_);
+                            request_->Clear();
+
+                            responder_->Read(request_, this);
+                            return;
+                        }
+
+                        // Иначе клиент закончил поток запросов или соединение разорвано (отменено клиентом, истёк
+                        // deadline и т.д.), но по неудачному чтению эти случаи не различить. Поэтому, прежде чем
+                        // накопитель добавит в базу данных последнюю неполную пачку, отправляем клиенту начальные
+                        // метаданные: отправка завершится успешно, только если соединение ещё живо (поле handler'а
+                        // меняем до вызова по той же причине, что и у Read)
+                        requests_received_ = true;
+                        responder_->SendInitialMetadata(this);
+                        return;
+                    }
+
+                    // Если соединение живо, клиент штатно закончил поток запросов, необходимо дозаполнить и отправить
+                    // ответ. Записываем в журнал сообщение о том, что наш handler прочитал весь поток запросов
+                    if (event_ok_) {
+                        PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << this << "]: All requests have been received ("s <<
+                                             requests_counter_ << " parts)"s);
+
+                        // Дозаполняем ответ
+                        requests_accumulator_->Finish(response_);
+                    }
+                    // Иначе соединение разорвано, и последняя неполная пачка не добавляется в базу данных: накопитель
+                    // уничтожается ниже без вызова Finish (пачки, добавленные до разрыва, остаются в базе данных, а
+                    // клиент, не получивший ответа, может повторить весь поток - записи с уже существующими номерами
+                    // телефонов будут просто отклонены)
+                    else {
+                        PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << this << "]: Stream has been interrupted after "s <<
+                                             requests_counter_ << " parts, the last incomplete batch is dropped"s);
+
+                        status = Status(grpc::StatusCode::CANCELLED, "AddRecords stream has been interrupted");
+                    }
+                } catch (const exception& e) {
+                    status = ErrorStatus(e, "M-1");
+                }
+
+                // Освобождаем накопитель запросов (вместе с недобавленной пачкой, если поток был прерван или
+                // накопитель выбросил исключение)
+                requests_accumulator_.reset();
+                processed_time_ = chrono::steady_clock::now();
+
+                // Переводим handler в статус FINISHED до отправки ответа (по той же причине, что и выше)
+                status_ = ConnectionStatus::FINISHED;
+
+                // Отправляем сформированный ответ (или статус ошибки) клиенту и закрываем соединение
+                responder_->Finish(*response_, status, this);
+            }
+            // В остальных случаях handler завершил работу и имеет статус FINISHED
+            else {
+
+                // Проверяем, что handler действительно имеет статус FINISHED
+                GPR_ASSERT(status_ == ConnectionStatus::FINISHED);
+
+                // Записываем в журнал сообщение о завершении работы handler'а для соединения типа M-1
+                PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << this << "]: Handler for M-1 connection has finished"s);
+
+                // Записываем в журнал итоговую строку обработки соединения (время формирования ответа включает чтение
+                // всего потока запросов)
+                LogConnectionFinished(RequestType::descriptor()->name(), ResponseType::descriptor()->name(), "M-1", 1);
+
+                // Возвращаем handler в пул свободных handler'ов и завершаем обработку
+                HandlersPool<ManyToOneConnectionHandler>::ForCurrentThread().Release(this); return;
+            }
         }
 
-        // Деструктор информирует в консоль об удалении handler'а из heap'а
-        ~OneToManyConnectionHandler() {
+        // Функция перевзвода handler'а, взятого из пула свободных handler'ов: пересоздаёт параметры соединения и
+        // респондер, очищает arena'у, заново создаёт в ней запрос и ответ, обнуляет счётчик и признак окончания чтения
+        // потока запросов и вызывает функцию обработки запроса handler'ом, которая поставит handler на прослушивание
+        // порта
+        void Rearm(ServerCompletionQueue* handlers_queue) {
+            responder_.reset();
+            requests_accumulator_.reset();
+            ResetConnection(handlers_queue);
+            responder_.emplace(&*ctx_);
+
+            request_  = google::protobuf::Arena::CreateMessage<RequestType>(&arena_);
+            response_ = google::protobuf::Arena::CreateMessage<ResponseType>(&arena_);
+
+            requests_counter_ = 0;
+            requests_received_ = false;
+
+            Proceed();
+        }
+
+        // Деструктор записывает в журнал сообщение об удалении handler'а из heap'а
+        ~ManyToOneConnectionHandler() {
             // Для удобства подключим внутри функции пространство имён std
             using namespace std;
 
-            // Информируем в консоль об удалении handler'а из heap'а
-            cout << "[1-M handler #"s << this << "]: Handler for 1-M connection was deleted from heap"s << endl;
+            // Записываем в журнал сообщение об удалении handler'а из heap'а
+            PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << this << "]: Handler for M-1 connection was deleted from heap"s);
         }
     };
 };
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,302 @@
+// Заголовочный файл posting_list.h описывает неизменяемый список записей слова (posting list) для поиска записей
+// по содержанию заметок: упорядоченные по номеру/id записи номера/id и частоты TF слова в заметках этих записей
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку memory для работы умных указателей, библиотеки vector и array для использования контейнеров
+// вектора и массива, библиотеку optional для результата поиска записи в списке, библиотеки string и string_view для
+// сериализации списка и библиотеки cstddef и cstdint для типов size_t и целых чисел фиксированной ширины
+#include <memory>
+#include <vector>
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstdint>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён списков записей слов
+namespace posting_list {
+
+// Класс неизменяемого списка записей слова со структурным разделением данных между версиями
+//
+// Список хранит пары "Номер/id записи, частота TF слова в заметке записи" по возрастанию номера/id записи в
+// сжатых блоках (не более BLOCK_SIZE пар в блоке, формат как у SIMD-BP128/PFor без исключений):
+//
+// - в блоке хранится первый номер/id, а остальные номера/id - разностями (delta) с предыдущим номером/id за
+//   вычетом единицы, упакованными подряд по delta_bits бит, где delta_bits - число бит наибольшей разности блока
+//   (у слова, которое встречается в заметках почти всех записей, разности близки к нулю и занимают 0-2 бита);
+// - частота TF квантуется в 16 бит (FREQ_SCALE частей единицы, частота TF не превышает единицы) и хранится
+//   сразу после разностей по 4 частоты на 64-битное слово.
+//
+// Блок целиком лежит в одном векторе 64-битных слов, поэтому запись списка в среднем занимает 2-3 байта вместо
+// 8 байт номера/id и 4 байт частоты. Курсор распаковывает номера/id блока целиком в свой массив при переходе к нему
+// (полный блок - развёрнутым кодом, отдельным для каждой ширины разностей, со сдвигами и масками, известными при
+// компиляции), а частоты TF не распаковывает вовсе: частота текущей записи читается прямо из упакованных слов блока
+// одним сдвигом, только когда она нужна. Рядом с каждым вектором блоков хранится вектор наибольших номеров/id его
+// блоков (указатели пропуска, skip pointers): по нему бинарным поиском находится блок с нужным номером/id, не
+// распаковывая остальные блоки.
+//
+// Блоки лежат под умными указателями shared_ptr<const ...> и сгруппированы в сегменты не более чем по SEGMENT_SIZE
+// блоков, которые тоже лежат под умными указателями, т.е. список является двухуровневым деревом "Сегменты -> Блоки ->
+// Пары" (как и корзины в PersistentContainer, см. persistent_map.h). Копирование списка копирует лишь векторы
+// указателей на сегменты и наибольших номеров/id сегментов, т.е. новая копия разделяет все сегменты и блоки со старой,
+// а изменение копии копирует только тот сегмент и заново упаковывает только тот блок, в котором лежит изменяемая
+// запись. Поэтому изменение списка слова, которое встречается в заметках почти всех записей, стоит O(число записей /
+// (BLOCK_SIZE * SEGMENT_SIZE) + SEGMENT_SIZE + BLOCK_SIZE), а не копирует указатели на все его блоки. Номера/id новых
+// записей почти всегда больше всех номеров/id в списке, поэтому добавление обычно дописывает пару в конец последнего
+// блока (или начинает новый блок), а вставка в середину переполненного блока делит его пополам (переполненный
+// сегмент так же делится пополам).
+//
+// Для каждого списка хранится также верхняя граница квантованной частоты TF по всем его записям (MaxFreq), которая
+// нужна для досрочного отсечения при отборе топа записей, и логарифм числа записей в списке (LogSize), т.е.
+// логарифм документной частоты слова: IDF = log(Число записей в базе данных) - LogSize, поэтому при поиске частота
+// IDF слова вычисляется одним вычитанием, а логарифм пересчитывается только при изменении списка (один раз на
+// операцию, а не на каждую запись пакета). При добавлении записей граница только растёт, а при удалении не
+// уменьшается - устаревшая граница остаётся верной, хоть и менее точной.
+//
+// Список сериализуется (Serialize) вместе со сжатыми блоками как есть, поэтому восстановление списка из файла базы
+// данных (Deserialize) лишь копирует слова блоков и не упаковывает номера/id и частоты заново.
+//
+// Замечание: при удалении записей блоки и сегменты не сливаются, поэтому после массового удаления они могут оказаться
+// неполными
+class PostingList final {
+public:
+    // Максимальное число пар в одном блоке
+    static constexpr size_t BLOCK_SIZE = 128;
+
+    // Максимальное число блоков в одном сегменте
+    static constexpr size_t SEGMENT_SIZE = 64;
+
+    // Масштаб квантования частоты TF: частота хранится как целое число FREQ_SCALE-х долей единицы
+    static constexpr uint32_t FREQ_SCALE = 65535;
+
+    // Функция восстановления частоты TF по квантованной частоте
+    static double DecodeFreq(uint16_t quantized_freq) {
+        return quantized_freq * (1.0 / FREQ_SCALE);
+    }
+
+    // Функция квантования частоты TF (ненулевая частота не обращается в ноль)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    static uint16_t QuantizeFreq(double term_freq);
+
+private:
+    // Структура сжатого блока: первый номер/id, число пар, ширина упакованных разностей номеров/id и вектор
+    // 64-битных слов с упакованными разностями номеров/id, за которыми идут квантованные частоты TF
+    struct Block {
+        size_t first_record_id = 0;
+        uint8_t size = 0;
+        uint8_t delta_bits = 0;
+        std::vector<uint64_t> words;
+    };
+
+    // Структура сегмента: умные указатели на подряд идущие блоки (не более SEGMENT_SIZE, сегмент не бывает пустым)
+    // и наибольшие номера/id записей каждого из этих блоков (указатели пропуска)
+    struct Segment {
+        std::vector<std::shared_ptr<const Block>> blocks;
+        std::vector<size_t> blocks_last_ids;
+    };
+
+    // Наибольшая ширина разностей номеров/id, для которой у полного блока есть развёрнутый код распаковки (разности
+    // шире 2^32 на практике не встречаются, и такие блоки распаковываются общим циклом)
+    static constexpr size_t MAX_UNROLLED_DELTA_BITS = 32;
+
+    // Типы массивов распакованных номеров/id и квантованных частот одного блока
+    using RecordsIds = std::array<size_t, BLOCK_SIZE + 1>;
+    using Freqs = std::array<uint16_t, BLOCK_SIZE + 1>;
+
+public:
+    // Класс курсора по списку записей слова: обходит записи по возрастанию номера/id
+    //
+    // Курсор не удерживает список, поэтому список (а значит, и версия базы данных, в которой он лежит) должен жить,
+    // пока используется курсор
+    class Cursor {
+    public:
+        // Конструктор пустого курсора (записей нет)
+        Cursor() = default;
+
+        // Функция проверки, указывает ли курсор на запись (false, если записи закончились)
+        bool HasPosting() const {
+            return position_ < block_size_;
+        }
+
+        // Функция получения номера/id текущей записи (курсор должен указывать на запись)
+        size_t RecordId() const {
+            return records_ids_[position_];
+        }
+
+        // Функция получения частоты TF слова в заметке текущей записи (курсор должен указывать на запись)
+        double Freq() const {
+            return DecodeFreq(PackedFreq(freqs_words_, position_));
+        }
+
+        // Функция перехода к следующей записи (курсор должен указывать на запись)
+        void Next() {
+            if (++position_ == block_size_) {
+                SetBlock(segment_index_, block_index_ + 1);
+            }
+        }
+
+        // Функция перехода к первой записи с номером/id не меньше record_id (курсор только продвигается вперёд:
+        // блоки с меньшими номерами/id пропускаются по указателям пропуска, не читая их)
+        // (определение/definition этой функции находится в posting_list.cpp)
+        void NextGEQ(size_t record_id);
+
+    private:
+        friend class PostingList;
+
+        // Конструктор курсора, указывающего на первую запись списка list
+        explicit Cursor(const PostingList* list) : list_(list) {
+            SetBlock(0, 0);
+        }
+
+        // Функция перехода к началу блока с номером block_index в сегменте с номером segment_index с его распаковкой
+        // (номер блока, равный числу блоков сегмента, означает первый блок следующего сегмента; если такого блока
+        // нет - переход в конец списка)
+        // (определение/definition этой функции находится в posting_list.cpp)
+        void SetBlock(size_t segment_index, size_t block_index);
+
+        const PostingList* list_ = nullptr;     // Список, по которому идёт курсор
+        size_t segment_index_ = 0;              // Номер текущего сегмента
+        size_t block_index_ = 0;                // Номер текущего блока в сегменте
+        size_t position_ = 0;                   // Позиция текущей записи в блоке
+        size_t block_size_ = 0;                 // Число пар в текущем блоке (0, если записи закончились)
+        const uint64_t* freqs_words_ = nullptr; // Упакованные квантованные частоты TF текущего блока (в самом блоке)
+        RecordsIds records_ids_;                // Распакованные номера/id текущего блока
+    };
+
+    // Функция получения числа записей в списке
+    size_t size() const {
+        return size_;
+    }
+
+    // Функция проверки списка на пустоту
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Функция получения верхней границы частоты TF по всем записям списка
+    double MaxFreq() const {
+        return DecodeFreq(max_freq_);
+    }
+
+    // Функция получения логарифма числа записей в списке (документной частоты слова; для пустого списка - 0)
+    double LogSize() const {
+        return log_size_;
+    }
+
+    // Функция получения наименьшего номера/id записи в списке (список не должен быть пустым)
+    size_t FirstRecordId() const {
+        return segments_.front()->blocks.front()->first_record_id;
+    }
+
+    // Функция открытия курсора, указывающего на первую запись списка
+    Cursor OpenCursor() const {
+        return Cursor(this);
+    }
+
+    // Функция поиска частоты TF слова в заметке записи с номером/id record_id (если записи нет в списке, возвращает
+    // nullopt)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    std::optional<double> Find(size_t record_id) const;
+
+    // Функция добавления записи в список (если запись уже есть в списке, её частота TF заменяется)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    void Insert(size_t record_id, double term_freq);
+
+    // Функция пакетного добавления записей в список (принимает вектор пар "Номер/id записи, частота TF" в любом
+    // порядке; пары упорядочиваются по номеру/id, и записи, которые дописываются в конец списка, упаковываются
+    // сразу целыми блоками)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    void InsertBatch(std::vector<std::pair<size_t, double>> postings);
+
+    // Функция удаления записи из списка (если записи нет в списке, ничего не делает)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    void Erase(size_t record_id);
+
+    // Функция дописывания сериализованного списка в конец буфера buffer (числа в порядке little-endian: число записей,
+    // граница частоты TF, число блоков, затем для каждого блока первый и наибольший номера/id, число пар, ширина
+    // разностей и 64-битные слова блока)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    void Serialize(std::string& buffer) const;
+
+    // Функция восстановления списка из начала сериализованных данных data (data сдвигается за прочитанный список;
+    // возвращает nullopt, если данные не являются сериализованным списком, например, блоки не упорядочены или их
+    // слов не хватает для числа пар и ширины разностей)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    static std::optional<PostingList> Deserialize(std::string_view& data);
+
+private:
+    // Функция поиска номеров сегмента и блока в нём, в котором лежит (или должна лежать) запись с номером/id record_id:
+    // первый блок, наибольший номер/id которого не меньше record_id (если такого блока нет, возвращает число сегментов
+    // в качестве номера сегмента)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    std::pair<size_t, size_t> BlockPosition(size_t record_id) const;
+
+    // Функция добавления записи с уже квантованной частотой в список без пересчёта логарифма числа записей
+    // (общая часть Insert и InsertBatch)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    void InsertQuantized(size_t record_id, uint16_t quantized_freq);
+
+    // Функция пересчёта логарифма числа записей в списке (вызывается в конце каждой изменяющей список операции)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    void UpdateLogSize();
+
+    // Функция упаковки size пар (номера/id по возрастанию и квантованные частоты) в новый сжатый блок
+    // (определение/definition этой функции находится в posting_list.cpp)
+    static std::shared_ptr<const Block> EncodeBlock(const size_t* records_ids, const uint16_t* freqs, size_t size);
+
+    // Функция распаковки номеров/id сжатого блока в массив records_ids (в массиве должно быть место для BLOCK_SIZE + 1
+    // номеров/id: распаковка полного блока пишет лишний номер/id за последним)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    static void DecodeRecordsIds(const Block& block, size_t* records_ids);
+
+    // Функция получения указателя на упакованные квантованные частоты TF сжатого блока (идут сразу после разностей)
+    static const uint64_t* FreqsWords(const Block& block) {
+        return block.words.data() + ((block.size - 1) * block.delta_bits + 63) / 64;
+    }
+
+    // Функция чтения квантованной частоты TF пары с позицией position в блоке из его упакованных частот freqs_words
+    static uint16_t PackedFreq(const uint64_t* freqs_words, size_t position) {
+        return static_cast<uint16_t>(freqs_words[position / 4] >> (position % 4 * 16));
+    }
+
+    // Функция распаковки сжатого блока в массивы номеров/id и квантованных частот (возвращает число пар; нужна
+    // изменяющим список операциям, которые упаковывают блок заново)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    static size_t DecodeBlock(const Block& block, size_t* records_ids, uint16_t* freqs);
+
+    // Функция дописывания блока block с наибольшим номером/id last_record_id в конец списка (последний сегмент
+    // копируется при записи, а заполненный сегмент не изменяется - начинается новый сегмент)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    void AppendBlock(std::shared_ptr<const Block> block, size_t last_record_id);
+
+    // Функция замены блока с номером block_index в сегменте с номером segment_index на блоки, упакованные из size пар
+    // (размер блока при этом может вырасти до BLOCK_SIZE + 1 пары - тогда он делится пополам - или стать нулевым -
+    // тогда блок удаляется; сегмент копируется при записи, а переполненный сегмент делится пополам)
+    // (определение/definition этой функции находится в posting_list.cpp)
+    void ReplaceBlock(size_t segment_index, size_t block_index, const size_t* records_ids, const uint16_t* freqs,
+                      size_t size);
+
+    // Вектор умных указателей на сегменты (сегменты и блоки в них упорядочены по номерам/id записей и не бывают
+    // пустыми)
+    std::vector<std::shared_ptr<const Segment>> segments_;
+
+    // Вектор наибольших номеров/id записей каждого сегмента (указатели пропуска по сегментам)
+    std::vector<size_t> segments_last_ids_;
+
+    // Число записей в списке
+    size_t size_ = 0;
+
+    // Логарифм числа записей в списке
+    double log_size_ = 0.0;
+
+    // Верхняя граница квантованной частоты TF по всем записям списка
+    uint16_t max_freq_ = 0;
+};
+
+}
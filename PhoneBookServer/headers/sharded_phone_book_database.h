@@ -0,0 +1,727 @@
+// Заголовочный файл sharded_phone_book_database.h описывает работу шардированной базы данных для телефонной
+// книги, которая разбивает записи на несколько независимых баз данных (шардов) PhoneBookDatabase и
+// предоставляет серверу тот же функционал по хранению, изменению и поиску данных
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку optional для работы со случаями, когда результатом запроса к базе данных
+// может быть пустой ответ, библиотеки string и string_view для работы со строками, библиотеки vector и unordered_map
+// для использования контейнеров вектора и hash-таблицы, библиотеку memory для работы умных указателей,
+// библиотеку shared_mutex для разграничения доступа к словарям номеров телефонов и к таблице слов заметок, библиотеку
+// atomic для атомарной выдачи номеров/id записей, библиотеку type_traits для определения типа результата запроса к
+// шарду, а также библиотеки mutex, condition_variable, thread и chrono для фонового потока сохранения базы данных в
+// файл
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <shared_mutex>
+#include <atomic>
+#include <type_traits>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+
+// Подключим заголовочный файл базы данных для телефонной книги (из них состоят шарды)
+#include "phone_book_database.h"
+
+// Подключим заголовочный файл кэша результатов поиска записей по содержанию заметок
+#include "note_search_cache.h"
+
+// Подключим заголовочный файл объединения одинаковых одновременно выполняющихся запросов
+#include "single_flight.h"
+
+// Подключим заголовочный файл журнала упреждающей записи
+#include "write_ahead_log.h"
+
+// Подключим заголовочный файл пула рабочих потоков и параллельного выполнения задач (запросы ко всем шардам)
+#include "parallel_tasks.h"
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён базы данных для телефонной книги
+namespace phone_book_database {
+
+// Архитектура кода шардированной базы данных:
+//
+// Записи распределяются по N независимым шардам - базам данных PhoneBookDatabase без собственного файла - по
+// номеру/id записи: запись с номером/id id лежит в шарде с индексом id % N. У каждого шарда свой mutex писателей и
+// свои версии словарей (см. phone_book_database.h), поэтому писатели разных шардов больше не выстраиваются в одну
+// очередь, а копирование версии при записи затрагивает словари лишь одного шарда, в N раз меньшие.
+//
+// Номера/id выдаются всем шардам из одного атомарного счётчика last_record_id_, поэтому они остаются уникальными
+// в пределах всей базы данных и последовательно распределяются по шардам.
+//
+// Номер телефона должен быть уникален во всей базе данных, а шард записи определяется её номером/id, поэтому
+// поверх шардов хранится глобальный словарь "Номер телефона -> Номер/id записи", разбитый на N полос (lock
+// striping) по hash'у номера телефона. У каждой полосы свой shared_mutex: добавление и удаление записи
+// захватывают на запись только полосу своего номера телефона (и держат её, пока изменяют шард, поэтому проверка
+// уникальности номера и изменение шарда атомарны), а поиск по номеру телефона захватывает полосу на чтение.
+// Пакетное добавление записей (AddRecords) захватывает все затронутые полосы в порядке возрастания их индексов, но
+// держит их только на время проверки уникальности номеров телефонов и внесения их в полосы: добавление записей в
+// шарды (самая долгая часть пакета) идёт уже без полос, а номера/id такого пакета числятся добавляемыми. Удаление по
+// номеру телефона, нашедшее в полосе запись ещё не добавленного в шард пакета, дожидается её добавления
+// (WaitForPendingRecord), а поиск по номеру телефона до этого момента просто не находит её в шарде. Удаление по
+// номеру/id тоже дожидается конца добавления пакета, поэтому удаление записи всегда вносится в таблицу слов заметок
+// (см. 4) после её добавления.
+//
+// Запросы распределяются следующим образом:
+//
+// 1) FindRecordById - в один шард id % N;
+//
+// 2) FindRecordByNumber - в одну полосу словаря номеров телефонов, а затем в один шард по найденному номеру/id;
+//
+// 3) FindRecordsByName, FindRecordsBySurname, FindRecordsByPatronymic - параллельно во все шарды, результаты
+//    объединяются и упорядочиваются по номеру/id записи (OpenRecordsByName, OpenRecordsBySurname,
+//    OpenRecordsByPatronymic вместо этого открывают курсоры во всех шардах и лениво сливают их по номеру/id записи);
+//
+// 3') FindRecordsByQuery, OpenRecordsByQuery (поиск по нескольким полям сразу) - параллельно во все шарды: каждый шард
+//    пересекает множества номеров/id своих записей по всем условиям запроса (запись целиком лежит в одном шарде,
+//    поэтому пересечение всей базы данных - это объединение пересечений шардов), а курсоры шардов по пересечениям
+//    лениво сливаются по номеру/id записи так же, как в 3);
+//
+// 4) FindRecordsByNote - в два этапа: вначале из глобальной таблицы слов заметок (см. ниже) читаются число записей
+//    базы данных, суммарная длина заметок и для каждого слова запроса - число записей, где оно встречается (вместе с
+//    логарифмом этого числа), из них вычисляются глобальные частоты IDF (такие же, как у одной нешардированной базы
+//    данных, для TF-IDF или BM25) и средняя длина заметки (для BM25), затем каждый шард отбирает свой топ из k записей
+//    по выбранной модели ранжирования с этими значениями (глобальный топ из k записей целиком состоит из записей топов
+//    шардов) параллельно во всех шардах, и отсортированные по убыванию релевантности топы шардов сливаются через кучу
+//    (k-way merge), которая останавливается после первых k записей.
+//
+//    Глобальная таблица слов заметок "Слово -> Число записей, логарифм этого числа, поколение" разбита на N полос
+//    по hash'у слова, как и словарь номеров телефонов, и обновляется изменениями записей после того, как шард
+//    опубликовал изменение. Каждое изменение слова выдаёт ему новое поколение из общего счётчика (поколения не
+//    повторяются), а слово, которого не осталось ни в одной заметке, удаляется из таблицы.
+//
+//    Готовые топы хранятся в кэше результатов NoteSearchCache (см. note_search_cache.h) вместе с поколениями слов
+//    запроса, числом записей и суммарной длиной заметок, прочитанными на первом этапе. Если на первом этапе
+//    следующего такого же запроса всё это совпало, второй этап не выполняется: повторный запрос стоит лишь первого
+//    этапа и копирования топа. Результат кладётся в кэш с версией первого этапа без повторного чтения: если слова
+//    запроса изменились во время второго этапа, их поколения в таблице уже другие, и такой топ из кэша не отдаётся.
+//
+// Одинаковые одновременные запросы поиска (например, сотни клиентов, приславших один и тот же запрос во время
+// инцидента) объединяются (single flight, см. single_flight.h): запрос выполняется один раз, а все, кто прислал его во
+// время выполнения, получают один и тот же неизменяемый результат - умный указатель на общий вектор записей
+// (функции ShareRecordsByNote, ShareRecordsByName, ShareRecordsBySurname, ShareRecordsByPatronymic). Поиск по заметке
+// объединяется целиком (вместе с проверкой кэша результатов). Поиск по имени/фамилии/отчеству обычно отдаётся
+// курсором, который не собирает записи в вектор, поэтому объединяется только небольшой результат (не более
+// MAX_SHARED_RECORDS записей): для большего результата общий вектор не строится, и каждый запрос открывает свой
+// курсор.
+//
+// Замечание: результаты разных шардов берутся из независимых версий шардов, поэтому поиск по всем шардам не
+// является единым snapshot'ом всей базы данных - запись, добавленная во время поиска, может попасть в результат
+// из одного шарда и ещё не попасть в частоты IDF глобальной таблицы слов заметок.
+//
+// Загрузка данных из файла и сохранение данных в файл выполняются самой шардированной базой данных, формат
+// файла совпадает с форматом PhoneBookDatabase, поэтому файл одной базы данных можно загрузить в шардированную
+// с любым числом шардов и наоборот.
+//
+// Файл сохраняется в двоичном формате (см. database_snapshot.h) и при загрузке отображается в память без разбора
+// текста, а шарды и полосы словаря номеров телефонов строятся параллельно: вначале каждая полоса (в своём потоке)
+// принимает номера телефонов своих записей в порядке файла (из записей с одинаковым номером телефона принимается
+// первая), затем каждый шард (в своём потоке) добавляет свои принятые записи одним пакетом - одной новой версией
+// шарда. Файл в прежнем текстовом формате по-прежнему загружается (формат определяется по сигнатуре в начале файла) и
+// при следующем сохранении заменяется двоичным: он разбирается параллельно по частям
+// (PhoneBookDatabase::ParseTextFile), а затем шарды строятся из разобранных записей так же, как из двоичного файла.
+//
+// Записи каждого шарда сохраняются в таблицу записей файла подряд, а за ними - словари каждого шарда отдельной
+// секцией INDEXES (см. phone_book_database.h) с числом шардов и номером шарда. При загрузке шард, записи которого
+// лежат в файле на месте, указанном в его секции, загружает словари из неё, а шард без подходящей секции (файл
+// сохранён базой данных с другим числом шардов или до появления секций, часть его записей отброшена) строит
+// словари заново.
+//
+// Если задан журнал упреждающей записи (см. write_ahead_log.h), каждое изменение базы данных дописывается в него кадром:
+// добавление записи - вместе с выданным ей номером/id и всеми полями, удаление записи (по номеру/id или по номеру
+// телефона) - номером/id удалённой записи. Кадр дописывается в буфер журнала до изменения шарда, пока захвачена
+// полоса словаря номеров телефонов, поэтому изменения записей с одним номером телефона идут в журнале в том же порядке,
+// что и в базе данных, а долговечности кадра писатель дожидается уже после освобождения полосы (group commit объединяет
+// писателей всех полос). Если журнал неисправен (после ошибки ввода-вывода), Append выбрасывает исключение, и изменение
+// не публикуется вовсе, поэтому читатели не видят изменений, которые не могут стать долговечными. Если же ошибка
+// случилась при записи уже опубликованного изменения (в Commit), изменение остаётся видимым, но метод выбрасывает
+// исключение, и клиент получает ошибку вместо подтверждения - сервер превращает такие исключения в статус ошибки gRPC.
+//
+// При загрузке базы данных поверх данных из файла воспроизводятся кадры журнала. Воспроизведение идемпотентно:
+// добавление записи, номер/id или номер телефона которой уже есть в базе данных, и удаление несуществующей записи
+// пропускаются, а номера/id никогда не выдаются повторно. Поэтому при сохранении в файл журнал переходит к новому
+// сегменту до сбора записей шардов, а сохранение дожидается публикации всех изменений, кадры которых успели попасть в
+// прежние сегменты (изменение считается выполняющимся от дописывания кадра до изменения шарда, см. MutationGuard):
+// тогда изменения прежних сегментов уже внесены в шарды и попадут в файл, а изменения, сделанные во время сохранения,
+// останутся в новом сегменте, даже если какие-то из них тоже попали в файл. Прежние сегменты удаляются, только когда
+// файл сохранён и синхронизирован с диском.
+//
+// Чтобы журнал (а с ним и воспроизведение при запуске) не рос неограниченно, база данных может сохраняться в файл в
+// фоне (checkpoint) каждые CheckpointOptions::interval. Сохранение не останавливает ни читателей, ни писателей: версии
+// шардов неизменяемы (copy-on-write), поэтому фиксация версии шарда - лишь атомарная загрузка умного указателя, а
+// изменения после неё создают новые версии, не трогая зафиксированную. На пути запросов остаются только переход журнала
+// к новому сегменту (писатели в это время ждут на mutex'е журнала) и фиксация версий шардов - эта пауза, длительность
+// сохранения и объём записанного файла попадают в статистику сохранений (GetCheckpointStats). Затем записи и словари
+// зафиксированных версий пишутся во временный файл в фоновом потоке, файл заменяет прежний переименованием, и прежние
+// сегменты журнала удаляются - так же, как при вызове SaveToFile (сохранения выполняются по одному).
+
+// Структура параметров фонового сохранения базы данных в файл (checkpoint)
+struct CheckpointOptions {
+    // Период фонового сохранения (0 - база данных сохраняется в файл только вызовом SaveToFile)
+    std::chrono::milliseconds interval{0};
+
+    // Наименьший объём кадров в байтах, дописанных в журнал упреждающей записи с прошлого сохранения, при котором
+    // фоновое сохранение выполняется, иначе оно пропускается, чтобы не перезаписывать файл неизменившейся базы данных
+    // (если журнал не ведётся, база данных сохраняется каждый период)
+    size_t min_log_bytes = 1;
+};
+
+// Класс шардированной базы данных для телефонной книги
+class ShardedPhoneBookDatabase final {
+public:
+	// Структуры записи в телефонной книге (те же, что и у PhoneBookDatabase)
+	using Record = PhoneBookDatabase::Record;
+	using RecordWithId = PhoneBookDatabase::RecordWithId;
+
+	// Тип общего неизменяемого результата поиска (разделяется между всеми одинаковыми одновременными запросами)
+	using SharedRecords = std::shared_ptr<const std::vector<RecordWithId>>;
+
+	// Тип группы объединяемых одинаковых одновременных запросов поиска (ключ - строка запроса)
+	using SearchFlights = single_flight::SingleFlight<std::string, SharedRecords>;
+
+	// Структура статистики сохранений базы данных в файл (фоновых и вызовов SaveToFile): число успешных, неудачных и
+	// пропущенных фоновых сохранений (база данных не изменилась), длительность последнего сохранения, пауза на пути
+	// запросов последнего и самого долгого сохранения (переход журнала к новому сегменту и фиксация версий шардов) и
+	// объём файла последнего и всех сохранений в байтах
+	struct CheckpointStats {
+		size_t checkpoints = 0;
+		size_t failures = 0;
+		size_t skipped = 0;
+		std::chrono::microseconds last_duration{0};
+		std::chrono::microseconds last_pause{0};
+		std::chrono::microseconds max_pause{0};
+		size_t last_bytes = 0;
+		size_t total_bytes = 0;
+	};
+
+	// Класс курсора по записям с указанным именем/фамилией/отчеством (или удовлетворяющим запросу на поиск по
+	// нескольким полям сразу) во всех шардах
+	//
+	// Объединяет курсоры шардов (каждый выдаёт записи своего шарда по возрастанию номера/id) через кучу из номеров
+	// шардов, поэтому тоже выдаёт записи по возрастанию номера/id, а памяти занимает O(число шардов * число корзин)
+	// независимо от числа найденных записей (курсоры поиска по нескольким полям сразу - ещё и по 8 байт на номер/id
+	// найденной записи)
+	class RecordsCursor {
+	public:
+		// Конструктор пустого курсора (записей нет)
+		RecordsCursor() = default;
+
+		// Функция проверки, указывает ли курсор на запись (false, если записи закончились)
+		bool HasRecord() const {
+			return !shards_heap_.empty();
+		}
+
+		// Функция получения номера/id текущей записи (курсор должен указывать на запись)
+		size_t RecordId() const {
+			return shards_cursors_[shards_heap_.front()].RecordId();
+		}
+
+		// Функция получения константной ссылки на текущую запись (курсор должен указывать на запись; ссылка
+		// действительна, пока жив курсор)
+		const Record& CurrentRecord() const {
+			return shards_cursors_[shards_heap_.front()].CurrentRecord();
+		}
+
+		// Функция перехода к следующей записи (курсор должен указывать на запись)
+		// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+		void Next();
+
+	private:
+		friend class ShardedPhoneBookDatabase;
+
+		// Конструктор курсора, объединяющего курсоры шардов
+		// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+		explicit RecordsCursor(std::vector<PhoneBookDatabase::RecordsCursor> shards_cursors);
+
+		// Функция сравнения номеров курсоров шардов для кучи (на вершине кучи курсор с наименьшим номером/id записи)
+		bool ShardGreater(size_t lhs, size_t rhs) const {
+			return shards_cursors_[lhs].RecordId() > shards_cursors_[rhs].RecordId();
+		}
+
+		// Курсоры шардов
+		std::vector<PhoneBookDatabase::RecordsCursor> shards_cursors_;
+
+		// Куча из номеров курсоров шардов, в которых ещё остались записи
+		std::vector<size_t> shards_heap_;
+	};
+
+private:
+	// Структура полосы глобального словаря "Номер телефона -> Номер/id записи"
+	struct NumberStripe {
+		// Mutex полосы (на запись захватывается добавлением и удалением записи, на чтение - поиском по номеру телефона)
+		mutable std::shared_mutex mutex;
+
+		// Словарь "Номер телефона -> Номер/id записи" для номеров телефонов этой полосы
+		std::unordered_map<std::string, size_t> number_to_record;
+	};
+
+	// Структура счётчиков слова в глобальной таблице слов заметок
+	struct NoteWordStats {
+		// Число записей во всех шардах, где слово встречается в заметке
+		size_t records_count = 0;
+
+		// Логарифм числа записей со словом (пересчитывается при изменении, а не при каждом запросе) и поколение слова -
+		// номер из счётчика note_words_generation_, выдаваемый слову заново при каждом изменении
+		double log_records_count = 0.0;
+		uint64_t generation = 0;
+	};
+
+	// Структура слова в глобальной таблице слов заметок: само слово (на него ссылается ключ таблицы) и его счётчики
+	struct NoteWordEntry {
+		std::string word;
+		NoteWordStats stats;
+	};
+
+	// Структура полосы глобальной таблицы слов заметок
+	struct NoteWordStripe {
+		// Mutex полосы (на запись захватывается при изменении записей, на чтение - поиском по содержанию заметок)
+		mutable std::shared_mutex mutex;
+
+		// Словарь "Слово в заметках -> Слово со счётчиками" для слов этой полосы (ключ ссылается на строку слова в
+		// элементе, который лежит в куче и не перемещается)
+		std::unordered_map<std::string_view, std::unique_ptr<NoteWordEntry>> word_to_entry;
+	};
+
+    // Имя файла с базой данных телефонной книги
+    std::string database_file_name_;
+
+	// Шарды базы данных (PhoneBookDatabase нельзя перемещать из-за mutex'а, поэтому шарды лежат под умными указателями)
+	std::vector<std::unique_ptr<PhoneBookDatabase>> shards_;
+
+	// Полосы глобального словаря "Номер телефона -> Номер/id записи" (по одной на шард)
+	std::vector<std::unique_ptr<NumberStripe>> number_stripes_;
+
+	// Полосы глобальной таблицы слов заметок (по одной на шард), число записей и суммарная длина заметок во всех
+	// шардах и счётчик поколений слов заметок
+	std::vector<std::unique_ptr<NoteWordStripe>> note_word_stripes_;
+	std::atomic<size_t> note_records_count_{0};
+	std::atomic<size_t> notes_length_{0};
+	std::atomic<uint64_t> note_words_generation_{0};
+
+	// Постоянный пул рабочих потоков для параллельных запросов ко всем шардам, пакетного добавления записей в шарды и
+	// загрузки данных из файла (рабочих потоков на один меньше, чем шардов или ядер процессора, - ещё одним потоком
+	// работает вызывающий)
+	mutable parallel_tasks::WorkerPool worker_pool_;
+
+	// Номер/id последней записи (общий для всех шардов)
+	std::atomic<size_t> last_record_id_{0};
+
+	// Кэш результатов поиска записей по содержанию заметок (изменяется и константным методом поиска, сам
+	// потокобезопасен)
+	mutable NoteSearchCache note_search_cache_;
+
+	// Группы объединяемых одинаковых одновременных запросов поиска по заметке, имени, фамилии и отчеству
+	mutable SearchFlights note_flights_;
+	mutable SearchFlights name_flights_;
+	mutable SearchFlights surname_flights_;
+	mutable SearchFlights patronymic_flights_;
+
+	// Журнал упреждающей записи (nullptr, если журнал не ведётся)
+	std::unique_ptr<write_ahead_log::WriteAheadLog> wal_;
+
+	// Номер текущей эпохи изменений и счётчики изменений, выполняющихся в чётной и нечётной эпохах (см. MutationGuard)
+	mutable std::atomic<uint64_t> mutations_epoch_{0};
+	mutable std::atomic<size_t> mutations_in_flight_[2]{};
+
+	// Диапазоны номеров/id [первый, последний + 1) пакетов AddRecords, которые уже внесли номера телефонов в полосы и
+	// освободили их, но ещё добавляют записи в шарды, mutex диапазонов и условная переменная окончания добавления
+	// пакета
+	mutable std::mutex pending_batches_mutex_;
+	mutable std::condition_variable pending_batch_added_;
+	std::vector<std::pair<size_t, size_t>> pending_batches_;
+
+	// Параметры фонового сохранения базы данных в файл
+	CheckpointOptions checkpoint_options_;
+
+	// Mutex сохранения базы данных в файл (фоновые сохранения и вызовы SaveToFile пишут один и тот же временный файл,
+	// поэтому выполняются по одному)
+	mutable std::mutex save_mutex_;
+
+	// Mutex статистики сохранений (защищает поля ниже; удерживается недолго, поэтому статистику можно получить и во
+	// время сохранения), условная переменная и флаг остановки фонового потока сохранения
+	mutable std::mutex checkpoint_mutex_;
+	std::condition_variable checkpoint_stop_requested_;
+	bool checkpoint_stop_ = false;
+
+	// Статистика сохранений, объём кадров, дописанных в журнал упреждающей записи, на момент последнего сохранения и
+	// флаг того, что при загрузке из журнала воспроизведены изменения, ещё не сохранённые в файл
+	mutable CheckpointStats checkpoint_stats_;
+	mutable size_t checkpoint_log_bytes_ = 0;
+	mutable bool log_replayed_ = false;
+
+	// Фоновый поток сохранения (работает, только если задан период сохранения)
+	std::thread checkpoint_thread_;
+
+public:
+	// Ёмкость кэша результатов поиска записей по содержанию заметок по умолчанию в байтах
+	static constexpr size_t DEFAULT_NOTE_SEARCH_CACHE_CAPACITY = size_t{64} << 20;
+
+	// Наибольшее число записей результата поиска по имени/фамилии/отчеству, который собирается в общий вектор для
+	// одинаковых одновременных запросов
+	static constexpr size_t MAX_SHARED_RECORDS = 1024;
+
+    // Конструктор шардированной базы данных принимает имя файла (полное имя с путём до файла) с базой данных
+    // телефонной книги, число шардов, ёмкость кэша результатов поиска по заметкам в байтах (0 - без кэша), параметры
+    // журнала упреждающей записи (по умолчанию журнал не ведётся) и параметры фонового сохранения в файл (по умолчанию
+    // база данных в фоне не сохраняется)
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+    explicit ShardedPhoneBookDatabase(const std::string& database_file_name, size_t shards_count = 1,
+                                      size_t note_search_cache_capacity = DEFAULT_NOTE_SEARCH_CACHE_CAPACITY,
+                                      const write_ahead_log::Options& wal_options = write_ahead_log::Options(),
+                                      const CheckpointOptions& checkpoint_options = CheckpointOptions());
+
+    // Деструктор останавливает фоновый поток сохранения (дожидаясь окончания начатого им сохранения)
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+    ~ShardedPhoneBookDatabase();
+
+    ShardedPhoneBookDatabase(const ShardedPhoneBookDatabase&) = delete;
+    ShardedPhoneBookDatabase& operator=(const ShardedPhoneBookDatabase&) = delete;
+
+    // Функция загрузки данных в базу из файла (в двоичном или прежнем текстовом формате) и воспроизведения поверх них
+    // журнала упреждающей записи
+    // (в отличие от PhoneBookDatabase заменяет шарды целиком, поэтому не должна вызываться параллельно с другими
+    //  методами, вызывается в конструкторе; выбрасывает исключение, если двоичный файл или не последний сегмент
+    //  журнала повреждён, чтобы сервер не начал работу с неполной базой данных и не затёр ею файл при сохранении)
+    //
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+    void LoadFromFile();
+
+    // Функция сохранения данных из базы в файл в двоичном формате
+    // (файл записывается во временный файл и заменяет прежний переименованием, после чего удаляются сегменты журнала
+    //  упреждающей записи, изменения которых попали в файл; не останавливает читателей и писателей, но ждёт окончания
+    //  начатого фонового сохранения)
+    //
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+    void SaveToFile() const;
+
+    // Функция добавления записи
+    // (возвращает код ответа: 0 - запись с таким номером телефона уже существует,
+    //                         1 - запись успешно добавлена;
+    //  как и остальные изменяющие функции, выбрасывает исключение, если журнал упреждающей записи неисправен)
+    //
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	size_t AddRecord(const Record& record);
+
+    // Функция пакетного добавления записей (все затронутые полосы словаря номеров телефонов захватываются один
+    // раз на пакет и только до внесения в них номеров телефонов, номера/id выдаются одним блоком, а записи
+    // добавляются в шарды параллельно, по одному пакету на шард)
+    // (возвращает вектор кодов ответа в порядке записей: 0 - запись с таким номером телефона уже существует в базе
+    //                                                        данных или раньше в этом же пакете,
+    //                                                    1 - запись успешно добавлена)
+    //
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	std::vector<size_t> AddRecords(const std::vector<Record>& records);
+
+	// Функция удаления записи по её номеру/id
+    // (возвращает код ответа: 0 - записи с таким номером/id не существует,
+    //                         1 - запись успешно удалена)
+    //
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	size_t DeleteRecordById(size_t record_id);
+
+    // Функция удаления записи по номеру телефона
+    // (возвращает код ответа: 0 - записи с таким номером телефона не существует,
+    //                         1 - запись успешно удалена)
+    //
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	size_t DeleteRecordByNumber(const std::string& number);
+
+    // Функция поиска записи по номеру/id записи (запрос в один шард)
+    // (найденная запись может быть только одна или её может не быть вовсе, тогда возвращает nullopt)
+    //
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	std::optional<RecordWithId> FindRecordById(size_t id) const;
+
+    // Функция поиска записей по имени (запрос во все шарды параллельно)
+	// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+	//
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	std::optional<std::vector<RecordWithId>> FindRecordsByName(const std::string& name) const;
+
+	// Функция поиска записей по фамилии (запрос во все шарды параллельно)
+	// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+	//
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	std::optional<std::vector<RecordWithId>> FindRecordsBySurname(const std::string& surname) const;
+
+	// Функция поиска записей по отчеству (запрос во все шарды параллельно)
+	// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+	//
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	std::optional<std::vector<RecordWithId>> FindRecordsByPatronymic(const std::string& patronymic) const;
+
+	// Функция поиска записи по номеру телефона (запрос в одну полосу словаря номеров телефонов и один шард)
+	// (найденная запись может быть только одна или её может не быть вовсе, тогда возвращает nullopt)
+	//
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	std::optional<RecordWithId> FindRecordByNumber(const std::string& number) const;
+
+	// Функции пакетного поиска записей по номерам/id (ключи группируются по шардам, в каждый шард - один запрос) и по
+	// номерам телефонов (ключи группируются по полосам словаря номеров телефонов, каждая полоса захватывается на чтение
+	// один раз, затем найденные номера/id ищутся по шардам)
+	// (возвращают вектор найденных записей в порядке ключей, для ненайденных ключей - nullopt)
+	//
+	// (определения/definition'ы этих функций находятся в sharded_phone_book_database.cpp)
+	std::vector<std::optional<RecordWithId>> FindRecordsByIds(const std::vector<size_t>& ids) const;
+	std::vector<std::optional<RecordWithId>> FindRecordsByNumbers(const std::vector<std::string>& numbers) const;
+
+	// Функция поиска записей по содержанию заметок (запрос во все шарды параллельно с глобальными частотами IDF,
+	// повторные запросы обслуживаются кэшем результатов, пока не изменились списки записей их слов, число записей и
+	// суммарная длина заметок)
+	// (возвращает топ из не более чем max_records_count самых релевантных записей; найденных записей может быть
+	//  множество или не быть вовсе, тогда возвращает nullopt)
+	//
+    // (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	std::optional<std::vector<RecordWithId>> FindRecordsByNote(
+		const std::string& note, size_t max_records_count = std::numeric_limits<size_t>::max(),
+		const NoteRankingParams& ranking_params = NoteRankingParams()) const;
+
+	// Функции открытия курсора по записям с указанным именем/фамилией/отчеством во всех шардах (записи выдаются по
+	// возрастанию номера/id, не копируясь и не собираясь в вектор; если записей нет, курсор сразу пуст)
+	//
+	// (определения/definition'ы этих функций находятся в sharded_phone_book_database.cpp)
+	RecordsCursor OpenRecordsByName(const std::string& name) const;
+	RecordsCursor OpenRecordsBySurname(const std::string& surname) const;
+	RecordsCursor OpenRecordsByPatronymic(const std::string& patronymic) const;
+
+	// Функция поиска записей по нескольким полям сразу (запрос во все шарды параллельно)
+	// (записи по возрастанию номера/id, удовлетворяющие всем условиям запроса query; найденных записей может быть
+	//  множество или не быть вовсе, тогда возвращает nullopt)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	std::optional<std::vector<RecordWithId>> FindRecordsByQuery(const RecordsQuery& query) const;
+
+	// Функция открытия курсора по записям, удовлетворяющим всем условиям запроса query, во всех шардах (шарды
+	// пересекают множества номеров/id своих записей параллельно; если записей нет, курсор сразу пуст)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	RecordsCursor OpenRecordsByQuery(const RecordsQuery& query) const;
+
+	// Функция поиска записей по содержанию заметок с объединением одинаковых одновременных запросов
+	// (возвращает общий топ из не более чем max_records_count самых релевантных записей или nullptr, если записей не
+	//  найдено)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	SharedRecords ShareRecordsByNote(const std::string& note, size_t max_records_count = std::numeric_limits<size_t>::max(),
+	                                 const NoteRankingParams& ranking_params = NoteRankingParams()) const;
+
+	// Функции поиска записей по имени/фамилии/отчеству с объединением одинаковых одновременных запросов
+	// (возвращают общий вектор записей по возрастанию номера/id (пустой, если записей нет) или nullptr, если записей
+	//  больше MAX_SHARED_RECORDS - тогда записи нужно читать своим курсором OpenRecordsByName и т.д.)
+	//
+	// (определения/definition'ы этих функций находятся в sharded_phone_book_database.cpp)
+	SharedRecords ShareRecordsByName(const std::string& name) const;
+	SharedRecords ShareRecordsBySurname(const std::string& surname) const;
+	SharedRecords ShareRecordsByPatronymic(const std::string& patronymic) const;
+
+	// Функция получения статистики кэша результатов поиска записей по содержанию заметок (попадания, промахи,
+	// инвалидации, вытеснения и занятая память)
+	NoteSearchCache::Stats GetNoteSearchCacheStats() const {
+		return note_search_cache_.GetStats();
+	}
+
+	// Функция получения статистики объединения одинаковых одновременных запросов поиска (суммарно по заметке, имени,
+	// фамилии и отчеству)
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	SearchFlights::Stats GetSearchFlightsStats() const;
+
+	// Функция получения статистики журнала упреждающей записи (нулевая, если журнал не ведётся)
+	write_ahead_log::WriteAheadLog::Stats GetWriteAheadLogStats() const {
+		return wal_ ? wal_->GetStats() : write_ahead_log::WriteAheadLog::Stats();
+	}
+
+	// Функция получения статистики сохранений базы данных в файл
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	CheckpointStats GetCheckpointStats() const;
+
+private:
+	// Класс охраны изменения базы данных: от дописывания кадров изменения в журнал упреждающей записи до изменения
+	// шарда (и словаря номеров телефонов) изменение числится выполняющимся в текущей эпохе. Писатели не ждут ни друг
+	// друга, ни сохранения, а лишь увеличивают и уменьшают счётчик своей эпохи
+	class MutationGuard {
+	public:
+		// Конструктор относит изменение к текущей эпохе
+		// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+		explicit MutationGuard(const ShardedPhoneBookDatabase& database);
+
+		// Деструктор отмечает конец изменения (изменение опубликовано или отвергнуто)
+		// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+		~MutationGuard();
+
+		MutationGuard(const MutationGuard&) = delete;
+		MutationGuard& operator=(const MutationGuard&) = delete;
+
+	private:
+		// Счётчик изменений эпохи, к которой отнесено изменение
+		std::atomic<size_t>* in_flight_ = nullptr;
+	};
+
+	// Функция ожидания публикации изменений, начатых до её вызова: начинает новую эпоху изменений и ждёт, пока
+	// закончатся изменения прежней эпохи (вызывается сохранением после перехода журнала к новому сегменту, поэтому
+	// кадры любого неопубликованного изменения прежних сегментов принадлежат прежней эпохе)
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void WaitForMutations() const;
+
+	// Функция ожидания добавления в шард записи с номером/id record_id, если её пакет AddRecords уже освободил полосы
+	// словаря номеров телефонов, но ещё добавляет записи в шарды (иначе сразу возвращается)
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void WaitForPendingRecord(size_t record_id) const;
+
+	// Функция получения шарда, в котором лежит запись с номером/id record_id
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	PhoneBookDatabase& ShardByRecordId(size_t record_id) const;
+
+	// Функция получения полосы глобального словаря номеров телефонов, в которой лежит номер телефона number
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	NumberStripe& StripeByNumber(const std::string& number) const;
+
+	// Функция получения индекса полосы глобального словаря номеров телефонов, в которой лежит номер телефона number
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	size_t StripeIndexByNumber(std::string_view number) const;
+
+	// Функция загрузки данных в базу из файла в двоичном формате (выбрасывает исключение, если файл повреждён)
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void LoadFromSnapshotFile();
+
+	// Функция загрузки в базу данных records_count записей из файла с номером/id последней записи last_record_id и
+	// секциями сохранённых словарей indexes_sections (шарды и полосы словаря номеров телефонов строятся параллельно;
+	// принимает функцию вида database_snapshot::RecordView(size_t index), возвращающую запись с индексом index в
+	// порядке файла)
+	// (возвращает число шардов, словари которых загружены из секций; шаблонная функция, используется только в
+	//  sharded_phone_book_database.cpp, поэтому определена там же)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	template <typename GetRecord>
+	size_t LoadRecords(size_t records_count, size_t last_record_id, const std::vector<std::string_view>& indexes_sections,
+	                   GetRecord get_record);
+
+	// Функции дописывания в журнал упреждающей записи кадров добавления записей records (номер/id и запись) и удаления
+	// записи с номером/id record_id (вызываются под полосой словаря номеров телефонов до изменения шарда; возвращают
+	// LSN для CommitLog, 0 - если журнал не ведётся, и выбрасывают исключение, если журнал неисправен)
+	//
+	// (определения/definition'ы этих функций находятся в sharded_phone_book_database.cpp)
+	size_t LogAddedRecords(const std::vector<std::pair<size_t, const Record*>>& records);
+	size_t LogDeletedRecord(size_t record_id);
+
+	// Функция ожидания долговечности кадров журнала упреждающей записи до позиции lsn (вызывается после освобождения
+	// полосы словаря номеров телефонов; выбрасывает исключение, если кадры не удалось записать)
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void CommitLog(size_t lsn);
+
+	// Функция воспроизведения журнала упреждающей записи поверх загруженных из файла данных
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void ReplayWriteAheadLog();
+
+	// Функция фонового потока сохранения: каждые checkpoint_options_.interval сохраняет базу данных в файл, если с
+	// прошлого сохранения в журнал упреждающей записи дописано не меньше checkpoint_options_.min_log_bytes байт
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void CheckpointLoop();
+
+	// Функция применения к базе данных одного кадра журнала упреждающей записи с содержимым payload (идемпотентна:
+	// уже применённые изменения пропускаются; добавляемые записи откладываются в added_records, чтобы добавить их в шарды
+	// пакетами, - по одной новой версии шарда на пакет, а не на каждую запись)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void ApplyLogEntry(std::string_view payload, std::vector<std::pair<size_t, Record>>& added_records);
+
+	// Функция добавления отложенных при воспроизведении журнала упреждающей записи записей added_records в шарды
+	// (по одному пакету на шард; вектор очищается)
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void ApplyAddedRecords(std::vector<std::pair<size_t, Record>>& added_records);
+
+	// Функция поиска записей по содержанию заметок по отсортированным различным словам запроса words (сначала в кэше
+	// результатов по ключу cache_key, затем в шардах; общая часть FindRecordsByNote и ShareRecordsByNote, которую
+	// выполняет лишь один из одинаковых одновременных запросов)
+	// (возвращает общий топ записей или nullptr, если записей не найдено)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	SharedRecords ComputeRecordsByNote(const std::vector<std::string_view>& words, std::string cache_key,
+	                                   size_t max_records_count, const NoteRankingParams& ranking_params) const;
+
+	// Функция поиска записей по ключу key курсором open_records (OpenRecordsByName и т.д.) с объединением одинаковых
+	// одновременных запросов группы flights (общая часть ShareRecordsByName, ShareRecordsBySurname и
+	// ShareRecordsByPatronymic)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	SharedRecords ShareRecords(SearchFlights& flights, const std::string& key,
+	                           RecordsCursor (ShardedPhoneBookDatabase::*open_records)(const std::string&) const) const;
+
+	// Функция чтения из глобальной таблицы слов заметок числа записей, суммарной длины заметок и счётчиков каждого из
+	// слов words (каждое слово ищется один раз в одной полосе, шарды не опрашиваются; возвращает версию данных для кэша
+	// результатов поиска, а счётчики слов записывает в words_stats - для слов, которых нет в заметках, нулевые)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	NoteSearchCache::DataVersion ReadNoteWordsStats(const std::vector<std::string_view>& words,
+	                                                std::vector<NoteWordStats>& words_stats) const;
+
+	// Функция внесения в глобальную таблицу слов заметок notes добавленных (added = true) или удалённых записей
+	// (вызывается после изменения шардов, чтобы результат поиска, вычисленный по более новым данным шардов, чем
+	//  прочитанные из таблицы поколения, никогда не выдавался из кэша после обновления таблицы)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void UpdateNoteWordsStats(const std::vector<const std::string*>& notes, bool added);
+
+	// Функция построения глобальной таблицы слов заметок по шардам (после загрузки данных из файла и воспроизведения
+	// журнала упреждающей записи)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	void BuildNoteWordsStats();
+
+	// Функция получения полосы глобальной таблицы слов заметок для слова word
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	NoteWordStripe& StripeByNoteWord(std::string_view word) const;
+
+	// Функция параллельного выполнения запроса function во всех шардах
+	// (принимает функцию вида Result(const PhoneBookDatabase& shard), возвращает вектор результатов по шардам)
+	template <typename Function>
+	auto FanOut(Function function) const;
+
+	// Функция объединения результатов поиска по шардам в один вектор, упорядоченный по номеру/id записи
+	// (если записей не найдено ни в одном шарде, возвращает nullopt)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	static std::optional<std::vector<RecordWithId>> MergeById(std::vector<std::optional<std::vector<RecordWithId>>> shards_records);
+
+	// Функция слияния отсортированных по убыванию релевантности результатов ранжирования шардов в глобальный
+	// топ из не более чем max_records_count записей (k-way merge через кучу)
+	//
+	// (определение/definition этой функции находится в sharded_phone_book_database.cpp)
+	static std::vector<RecordWithId> MergeByRelevance(std::vector<std::vector<std::pair<RecordWithId, double>>> shards_records,
+	                                                  size_t max_records_count);
+};
+
+// Функция параллельного выполнения запроса function во всех шардах
+// (шаблонная функция, поэтому определена в заголовочном файле)
+template <typename Function>
+auto ShardedPhoneBookDatabase::FanOut(Function function) const {
+
+	// Тип результата запроса к одному шарду
+	using Result = std::invoke_result_t<Function&, const PhoneBookDatabase&>;
+
+	// Запросы к шардам выполняются в постоянном пуле рабочих потоков и в вызывающем потоке (при одном шарде пул не
+	// используется), каждый шард пишет результат на своё место
+	std::vector<std::optional<Result>> shards_results(shards_.size());
+	parallel_tasks::RunInParallel(worker_pool_, shards_.size(), shards_.size(), [&](size_t shard_index) {
+		shards_results[shard_index].emplace(function(static_cast<const PhoneBookDatabase&>(*shards_[shard_index])));
+	});
+
+	// Вектор результатов по шардам
+	std::vector<Result> results;
+	results.reserve(shards_.size());
+	for (std::optional<Result>& shard_result : shards_results) {
+		results.push_back(std::move(*shard_result));
+	}
+
+	return results;
+}
+
+}
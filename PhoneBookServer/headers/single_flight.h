@@ -0,0 +1,109 @@
+// Заголовочный файл single_flight.h описывает объединение одинаковых одновременно выполняющихся запросов (single
+// flight): запрос выполняется один раз, а его общий результат получают все, кто запросил его во время выполнения
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку unordered_map для использования контейнера hash-таблицы, библиотеку future для передачи
+// результата ожидающим потокам, библиотеку mutex для разграничения доступа к таблице выполняющихся запросов,
+// библиотеку atomic для счётчиков статистики, библиотеку exception для передачи исключения ожидающим потокам и
+// библиотеку cstdint для целых чисел фиксированной ширины
+#include <unordered_map>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <exception>
+#include <cstdint>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён объединения одновременных запросов
+namespace single_flight {
+
+// Класс группы объединяемых запросов с ключом типа Key и результатом типа Value
+//
+// Первый поток, запросивший ключ (ведущий), выполняет запрос сам, а на время выполнения кладёт в таблицу
+// выполняющихся запросов shared_future его результата. Потоки, запросившие тот же ключ, пока запрос выполняется
+// (ведомые), не выполняют его повторно, а дожидаются результата ведущего. Когда сотни клиентов одновременно присылают
+// один и тот же запрос, он выполняется один раз вместо сотен. После выполнения ключ убирается из таблицы, поэтому
+// результат не кэшируется: запрос, пришедший после выполнения, выполняется заново и видит свежие данные.
+//
+// Результат отдаётся всем потокам копией Value, поэтому Value должен быть дешёвым в копировании и неизменяемым
+// (обычно умный указатель shared_ptr<const ...> на общий результат). Исключение ведущего получают и все ведомые.
+//
+// Ведомый поток блокируется до окончания запроса ведущего. Ведущий выполняет запрос в своём потоке и ничего не
+// ждёт, поэтому взаимная блокировка невозможна, если функция запроса сама не обращается к той же группе.
+//
+// (поскольку класс шаблонный, его методы определены прямо в header-файле)
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class SingleFlight final {
+public:
+    // Структура статистики группы
+    struct Stats {
+        uint64_t executed = 0;  // Число выполненных запросов (ведущих)
+        uint64_t coalesced = 0; // Число запросов, получивших результат чужого выполнения (ведомых)
+    };
+
+    // Функция выполнения запроса с ключом key функцией function вида Value() (или ожидания результата уже
+    // выполняющегося запроса с тем же ключом)
+    template <typename Function>
+    Value Do(const Key& key, Function function) {
+        std::promise<Value> promise;
+
+        {
+            std::unique_lock<std::mutex> guard(mutex_);
+
+            // Запрос с таким ключом уже выполняется - дожидаемся его результата вне mutex'а
+            if (auto it = in_flight_.find(key); it != in_flight_.end()) {
+                std::shared_future<Value> result = it->second;
+                guard.unlock();
+
+                coalesced_.fetch_add(1, std::memory_order_relaxed);
+                return result.get();
+            }
+
+            // Иначе становимся ведущим
+            in_flight_.emplace(key, promise.get_future().share());
+        }
+
+        executed_.fetch_add(1, std::memory_order_relaxed);
+
+        // Выполняем запрос и передаём результат (или исключение) ведомым, после чего убираем ключ из таблицы
+        try {
+            Value value = function();
+            Finish(key);
+            promise.set_value(value);
+            return value;
+        } catch (...) {
+            Finish(key);
+            promise.set_exception(std::current_exception());
+            throw;
+        }
+    }
+
+    // Функция получения статистики группы
+    Stats GetStats() const {
+        return {executed_.load(std::memory_order_relaxed), coalesced_.load(std::memory_order_relaxed)};
+    }
+
+private:
+    // Функция удаления ключа выполненного запроса из таблицы (ведомые, уже получившие shared_future, дождутся
+    // результата, а новые потоки выполнят запрос заново)
+    void Finish(const Key& key) {
+        std::lock_guard<std::mutex> guard(mutex_);
+        in_flight_.erase(key);
+    }
+
+    // Mutex таблицы выполняющихся запросов
+    std::mutex mutex_;
+
+    // Таблица "Ключ -> Будущий результат" выполняющихся запросов
+    std::unordered_map<Key, std::shared_future<Value>, Hash> in_flight_;
+
+    // Счётчики статистики
+    std::atomic<uint64_t> executed_{0};
+    std::atomic<uint64_t> coalesced_{0};
+};
+
+}
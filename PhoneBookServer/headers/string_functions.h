@@ -27,6 +27,18 @@ std::string ConverteAmpersandSequencesToQuotes(std::string_view str);
 // Функция преобразования кавычек в "&quot;" в строке
 std::string ConverteQuotesToAmpersandSequences(std::string_view str);
 
+// Функции разделения строки на слова через символы-сепараторы: скалярная и векторные (SSE2 и AVX2) реализации
+// SplitIntoWords с одинаковым результатом (SSE2 и AVX2 есть только на процессорах x86, и вызывать их можно, только если
+// процессор поддерживает эти наборы инструкций)
+std::vector<std::string_view> SplitIntoWordsScalar(std::string_view str);
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+std::vector<std::string_view> SplitIntoWordsSSE2(std::string_view str);
+std::vector<std::string_view> SplitIntoWordsAVX2(std::string_view str);
+#endif
+
+// Функция выбора реализации SplitIntoWords по возможностям процессора (AVX2, затем SSE2, иначе скалярная)
+std::vector<std::string_view> (*ChooseSplitIntoWords())(std::string_view);
+
 }
 
 // Функция разделения строки на слова через символы-сепараторы
@@ -49,6 +61,30 @@ std::pair<size_t, size_t> ParseInfoStringFromFile(std::string_view str);
 std::tuple<size_t, std::string, std::string, 
                    std::string, std::string, std::string> ParseRecordStringFromFile(std::string_view str);
 
+// Структура полей строки с записью для базы данных (string_view ссылаются на разобранную строку, последовательности
+// "&quot;" в полях ещё не заменены на кавычки)
+struct RecordStringFields {
+    size_t id = 0;
+    std::string_view name;
+    std::string_view surname;
+    std::string_view patronymic;
+    std::string_view number;
+    std::string_view note;
+};
+
+// Функция парсинга строки с записью для базы данных без выделения памяти: номер/id разбирается через from_chars, а
+// поля возвращаются string_view-срезами строки (используется при параллельной загрузке данных из файла в базу данных)
+// (возвращает false, если строка не является строкой с записью)
+bool ParseRecordStringView(std::string_view str, RecordStringFields& fields);
+
+// Функция получения значения поля строки с записью: заменяет "&quot;" на кавычки, только если в поле есть символ '&'
+// (иначе просто копирует поле)
+std::string UnescapeRecordField(std::string_view field);
+
+// Функция разделения текста на не более чем chunks_count частей примерно равной длины по границам строк (каждая
+// часть, кроме, возможно, последней, заканчивается символом '\n'; string_view ссылаются на text)
+std::vector<std::string_view> SplitIntoLineChunks(std::string_view text, size_t chunks_count);
+
 // Функция упаковки строки с информацией о числе записей в базе данных и номере/id последней записи
 // (используется при сохранении данных из базы в файл)
 std::string PackInfoStringForFile(size_t records_count, size_t last_record_id);
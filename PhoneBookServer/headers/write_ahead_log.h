@@ -0,0 +1,238 @@
+// Заголовочный файл write_ahead_log.h описывает работу журнала упреждающей записи (write-ahead log, WAL) базы
+// данных для телефонной книги: каждое изменение базы данных дописывается в конец файла журнала, поэтому после
+// аварийного завершения сервера изменения, сделанные после последнего сохранения базы данных в файл, не теряются
+
+// Header guard (предотвращает повторное включение заголовочного файла)
+#pragma once
+
+// Подключим библиотеку string и string_view для работы со строками, библиотеку mutex и condition_variable для
+// синхронизации писателей, библиотеку thread для работы фонового потока синхронизации, библиотеку chrono для работы
+// со временем, библиотеку functional для передачи функции обработки кадров, библиотеку vector для использования
+// контейнера вектора, библиотеку cstdint для целочисленных типов фиксированного размера и библиотеку cstddef для
+// типа size_t
+#include <string>
+#include <string_view>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Не будем использовать using-директивы в глобальной области видимости заголовочного файла, так как это
+// приведёт к попаданию этих using-директив во все области видимости, куда будет включён заголовочный файл
+
+// Пространство имён журнала упреждающей записи
+namespace write_ahead_log {
+
+// Архитектура журнала упреждающей записи:
+//
+// Журнал хранит последовательность кадров (frame). Кадр - это заголовок из 8 байт (длина содержимого и контрольная
+// сумма CRC-32C длины и содержимого, оба числа по 4 байта в порядке little-endian) и само содержимое - произвольные
+// байты, которые формирует база данных (журнал не знает, что в них лежит). Длина входит в контрольную сумму, чтобы
+// заполненный нулями хвост файла не читался как последовательность пустых кадров. При чтении журнал проверяет длину
+// и контрольную сумму каждого кадра и останавливается на первом обрезанном или повреждённом кадре: так отбрасывается
+// кадр, который сервер не успел дописать целиком перед аварийным завершением.
+//
+// Журнал разбит на сегменты - файлы "<имя журнала>.<номер сегмента>". Кадры дописываются в последний сегмент, а при
+// сохранении базы данных в файл (checkpoint) журнал переходит к новому сегменту (StartNewSegment): все изменения из
+// прежних сегментов уже попали в сохранённый файл, поэтому после его сохранения прежние сегменты удаляются
+// (RemoveSegmentsBefore). При запуске сервера база данных загружается из файла, а затем поверх неё воспроизводятся
+// (Replay) кадры всех оставшихся сегментов по порядку.
+//
+// Писатель дописывает кадры в два этапа. Append лишь дописывает уже упакованные кадры в буфер в памяти (под mutex'ом
+// журнала, без ввода-вывода) и возвращает позицию конца этих кадров в журнале (LSN, log sequence number). Commit
+// дожидается, пока кадры до этой позиции будут записаны в файл (и синхронизированы с диском, если этого требует режим
+// долговечности). Запись выполняет один из ожидающих писателей (лидер): он забирает весь накопившийся буфер, то есть
+// кадры всех писателей, успевших сделать Append, и записывает их одним системным вызовом write, а затем синхронизирует
+// файл одним вызовом fdatasync (group commit). Остальные писатели в это время ждут на условной переменной, а их кадры
+// либо уже попали в запись лидера, либо будут записаны следующим лидером одной пачкой.
+//
+// Режимы долговечности (Durability):
+//
+// 1) NONE - Commit дожидается только записи кадров в файл (в page cache операционной системы), синхронизация с диском
+//    выполняется лишь при переходе к новому сегменту и закрытии журнала. Изменения переживают аварийное завершение
+//    процесса сервера (в том числе kill -9), но не сбой операционной системы или питания;
+//
+// 2) BATCHED - как NONE, но фоновый поток синхронизирует файл с диском каждые sync_interval, если с прошлой
+//    синхронизации были записаны кадры. При сбое питания теряются изменения не более чем за sync_interval;
+//
+// 3) PER_REQUEST - Commit дожидается синхронизации кадров с диском (ответ клиенту уходит только после fdatasync),
+//    одновременные писатели объединяются в один вызов fdatasync.
+//
+// Ошибка ввода-вывода при записи или синхронизации журнала необратима (после неудачного fdatasync нельзя знать, какие
+// данные дошли до диска), поэтому журнал запоминает её, и все последующие Append и Commit выбрасывают исключение с её
+// текстом - в том числе после ошибки фоновой синхронизации в режиме BATCHED, которую не ждал ни один писатель (сама
+// ошибка при этом пишется в журнал сервера).
+//
+// При воспроизведении повреждённым может оказаться только хвост последнего сегмента (кадр, который не успели
+// дописать). Повреждение прежнего сегмента означает потерю подтверждённых изменений, и Replay выбрасывает исключение
+// вместо того, чтобы применить следующие сегменты поверх пропуска.
+
+// Режимы долговечности журнала (см. выше)
+enum class Durability {
+    NONE,
+    BATCHED,
+    PER_REQUEST
+};
+
+// Структура параметров журнала
+struct Options {
+    // Имя журнала (полное имя с путём, к нему добавляется номер сегмента; пустое имя - журнал не ведётся)
+    std::string file_name;
+
+    // Режим долговечности
+    Durability durability = Durability::BATCHED;
+
+    // Период фоновой синхронизации файла журнала с диском в режиме BATCHED
+    std::chrono::milliseconds sync_interval{10};
+};
+
+// Класс журнала упреждающей записи
+class WriteAheadLog final {
+public:
+    // Размер заголовка кадра (длина содержимого и контрольная сумма)
+    static constexpr size_t FRAME_HEADER_SIZE = 8;
+
+    // Структура статистики журнала (сколько раз писатели дописывали кадры, сколько байт и сколько раз журнал
+    // записывал в файл и синхронизировал с диском; отношение appends к writes и syncs показывает выигрыш group commit)
+    struct Stats {
+        size_t appends = 0;
+        size_t bytes = 0;
+        size_t writes = 0;
+        size_t syncs = 0;
+    };
+
+private:
+    // Параметры журнала
+    Options options_;
+
+    // Файловый дескриптор последнего сегмента и его номер
+    int file_descriptor_ = -1;
+    uint64_t segment_ = 0;
+
+    // Mutex журнала (защищает все поля ниже) и условная переменная, на которой писатели ждут записи своих кадров
+    mutable std::mutex mutex_;
+    std::condition_variable flushed_;
+
+    // Упакованные кадры, дописанные писателями, но ещё не записанные в файл
+    std::string pending_;
+
+    // Позиции в журнале (LSN, число байт всех кадров с момента открытия журнала): конец дописанных писателями кадров,
+    // конец кадров, записанных в файл, и конец кадров, синхронизированных с диском
+    size_t appended_lsn_ = 0;
+    size_t written_lsn_ = 0;
+    size_t synced_lsn_ = 0;
+
+    // Флаг того, что лидер сейчас записывает кадры (в файл пишет только один поток)
+    bool flushing_ = false;
+
+    // Флаг того, что ожидающий поток просит синхронизировать файл с диском (следующий лидер синхронизирует файл, даже
+    // если его писателям синхронизация не нужна, - иначе при постоянном потоке писателей фоновый поток синхронизации
+    // мог бы подолгу не становиться лидером)
+    bool sync_requested_ = false;
+
+    // Флаг необратимой ошибки ввода-вывода и текст первой такой ошибки (его получают все последующие Append и Commit)
+    bool failed_ = false;
+    std::string failure_;
+
+    // Статистика журнала
+    Stats stats_;
+
+    // Флаг остановки фонового потока синхронизации и сам поток (работает только в режиме BATCHED)
+    bool stop_ = false;
+    std::condition_variable stop_requested_;
+    std::thread sync_thread_;
+
+public:
+    // Конструктор журнала принимает параметры журнала, находит его сегменты, отрезает от последнего из них обрезанный
+    // или повреждённый хвост (или создаёт первый сегмент) и открывает его для дописывания кадров
+    // (выбрасывает исключение, если файл журнала не удалось открыть)
+    //
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    explicit WriteAheadLog(const Options& options);
+
+    // Деструктор записывает и синхронизирует с диском оставшиеся кадры, останавливает фоновый поток и закрывает файл
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Функция упаковки кадра с содержимым payload в конец буфера frames (кадры упаковываются писателем до Append, вне
+    // mutex'а журнала)
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    static void AppendFrame(std::string& frames, std::string_view payload);
+
+    // Функция воспроизведения журнала: вызывает function(payload) для содержимого каждого целого кадра всех сегментов
+    // по порядку до первого обрезанного или повреждённого кадра (возвращает число кадров; выбрасывает исключение,
+    // если повреждён не последний сегмент)
+    //
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    size_t Replay(const std::function<void(std::string_view)>& function) const;
+
+    // Функция дописывания упакованных кадров frames в буфер журнала (без ввода-вывода; возвращает LSN конца кадров,
+    // который нужно передать в Commit, и выбрасывает исключение, если журнал неисправен)
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    size_t Append(std::string_view frames);
+
+    // Функция ожидания долговечности кадров до позиции lsn по режиму долговечности журнала (записи в файл для NONE и
+    // BATCHED, синхронизации с диском для PER_REQUEST; если никто не записывает кадры, записывает их сама)
+    //
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    void Commit(size_t lsn);
+
+    // Функция перехода к новому сегменту: записывает и синхронизирует с диском все дописанные кадры, закрывает
+    // последний сегмент и открывает следующий (возвращает номер нового сегмента - все кадры, дописанные до вызова,
+    // лежат в сегментах с меньшими номерами)
+    //
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    uint64_t StartNewSegment();
+
+    // Функция удаления сегментов с номерами меньше segment (вызывается, когда их изменения сохранены в файл базы данных)
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    void RemoveSegmentsBefore(uint64_t segment);
+
+    // Функция получения статистики журнала
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    Stats GetStats() const;
+
+private:
+    // Функция записи кадров до позиции lsn (и их синхронизации с диском, если sync): ждёт текущего лидера или сама
+    // становится лидером, пока кадры до lsn не будут записаны (и синхронизированы); lock - захваченный mutex журнала
+    //
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    void Flush(std::unique_lock<std::mutex>& lock, size_t lsn, bool sync);
+
+    // Функция фонового потока синхронизации (режим BATCHED)
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    void SyncLoop();
+
+    // Функция получения имени файла сегмента с номером segment
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    std::string SegmentFileName(uint64_t segment) const;
+
+    // Функция получения отсортированных по возрастанию номеров всех сегментов журнала на диске
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    std::vector<uint64_t> ListSegments() const;
+
+    // Функция открытия сегмента с номером segment для дописывания кадров (создаёт файл, если его нет)
+    // (определение/definition этой функции находится в write_ahead_log.cpp)
+    void OpenSegment(uint64_t segment);
+};
+
+// Функция синхронизации с диском файла или каталога с именем file_name (используется и базой данных, чтобы сохранённый
+// файл базы данных был на диске раньше, чем будут удалены сегменты журнала с его изменениями)
+// (выбрасывает исключение, если файл не удалось открыть или синхронизировать)
+//
+// (определение/definition этой функции находится в write_ahead_log.cpp)
+void SyncFile(const std::string& file_name);
+
+// Функция получения имени каталога, в котором лежит файл file_name (для синхронизации каталога после создания,
+// переименования или удаления файла)
+// (определение/definition этой функции находится в write_ahead_log.cpp)
+std::string DirectoryOf(const std::string& file_name);
+
+}
@@ -0,0 +1,161 @@
+// Единица трансляции async_logger.cpp описывает работу асинхронного журнала (логгера) сервера для телефонной книги
+
+// Подключим библиотеку iostream для работы стандартного потока вывода, библиотеку algorithm для
+// использования стандартных алгоритмов, библиотеку ctime для перевода времени в календарное и
+// библиотеку cstdio для форматирования времени
+#include <iostream>
+#include <algorithm>
+#include <ctime>
+#include <cstdio>
+
+// Подключим заголовочный файл асинхронного журнала
+#include "async_logger.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён асинхронного журнала
+namespace async_logger {
+
+// Функция получения журнала (единственного на процесс, создаётся при первом обращении)
+Logger& Logger::Instance() {
+    static Logger logger;
+    return logger;
+}
+
+// Конструктор инициализирует ячейки кольцевого буфера (ячейка i свободна для записи с позиции i)
+// и запускает фоновый поток
+Logger::Logger() {
+    for (size_t i = 0; i < RING_SIZE; ++i) {
+        ring_[i].sequence.store(i, memory_order_relaxed);
+    }
+
+    drain_thread_ = thread(&Logger::DrainLoop, this);
+}
+
+// Деструктор останавливает фоновый поток, предварительно выведя все оставшиеся сообщения
+Logger::~Logger() {
+    stop_ = true;
+    drain_thread_.join();
+}
+
+// Функция установки текущего уровня журнала
+void Logger::SetLevel(LogLevel level) {
+    level_.store(level, memory_order_relaxed);
+}
+
+// Функция добавления сообщения в кольцевой буфер (никогда не блокируется и не выполняет ввод-вывод;
+// если буфер переполнен, сообщение отбрасывается)
+void Logger::Push(LogLevel level, string_view message) {
+
+    // Пытаемся занять ячейку по текущей позиции записи
+    size_t position = enqueue_position_.load(memory_order_relaxed);
+    Slot* slot;
+
+    while (true) {
+        slot = &ring_[position & (RING_SIZE - 1)];
+        const size_t sequence = slot->sequence.load(memory_order_acquire);
+
+        // Ячейка свободна для этой позиции записи - пытаемся занять её, сдвинув позицию записи
+        if (sequence == position) {
+            if (enqueue_position_.compare_exchange_weak(position, position + 1, memory_order_relaxed)) {
+                break;
+            }
+        }
+        // Ячейка ещё не прочитана фоновым потоком с прошлого круга - буфер переполнен, отбрасываем сообщение
+        else if (sequence < position) {
+            dropped_count_.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        // Ячейку уже занял другой писатель - перечитываем позицию записи
+        else {
+            position = enqueue_position_.load(memory_order_relaxed);
+        }
+    }
+
+    // Заполняем занятую ячейку (длинные сообщения обрезаем)
+    slot->level = level;
+    slot->time = chrono::system_clock::now();
+    slot->size = min(message.size(), MESSAGE_MAX_SIZE);
+    copy_n(message.data(), slot->size, slot->text.data());
+
+    // Публикуем сообщение для фонового потока
+    slot->sequence.store(position + 1, memory_order_release);
+}
+
+// Функция фонового потока
+void Logger::DrainLoop() {
+
+    // Буфер для форматирования сообщений (переиспользуется между проходами)
+    string buffer;
+
+    // Пока журнал не остановлен, выводим накопившиеся сообщения, а если их нет - ненадолго засыпаем
+    while (!stop_) {
+        if (Drain(buffer) == 0) {
+            this_thread::sleep_for(IDLE_SLEEP_TIME);
+        }
+    }
+
+    // Выводим оставшиеся сообщения
+    Drain(buffer);
+}
+
+// Функция вывода всех накопившихся в буфере сообщений (возвращает число выведенных сообщений)
+size_t Logger::Drain(string& buffer) {
+
+    // Названия уровней сообщений
+    static const char* const LEVEL_NAMES[] = {"DEBUG", "INFO", "WARNING", "ERROR"};
+
+    buffer.clear();
+    size_t messages_count = 0;
+
+    // Забираем сообщения, пока очередная ячейка опубликована писателем
+    while (true) {
+        Slot& slot = ring_[dequeue_position_ & (RING_SIZE - 1)];
+        if (slot.sequence.load(memory_order_acquire) != dequeue_position_ + 1) {
+            break;
+        }
+
+        // Форматируем время сообщения: "ГГГГ-ММ-ДД ЧЧ:ММ:СС.мммммм"
+        const time_t seconds = chrono::system_clock::to_time_t(slot.time);
+        const long microseconds = static_cast<long>(chrono::duration_cast<chrono::microseconds>(
+            slot.time.time_since_epoch()).count() % 1000000);
+
+        tm calendar_time;
+        localtime_r(&seconds, &calendar_time);
+
+        char time_text[32];
+        const size_t time_size = strftime(time_text, sizeof(time_text), "%Y-%m-%d %H:%M:%S", &calendar_time);
+        snprintf(time_text + time_size, sizeof(time_text) - time_size, ".%06ld", microseconds);
+
+        // Добавляем строку "[время] [уровень] сообщение"
+        buffer += '[';
+        buffer += time_text;
+        buffer += "] ["s;
+        buffer += LEVEL_NAMES[static_cast<int>(slot.level)];
+        buffer += "] "s;
+        buffer.append(slot.text.data(), slot.size);
+        buffer += '\n';
+
+        // Освобождаем ячейку для писателя следующего круга
+        slot.sequence.store(dequeue_position_ + RING_SIZE, memory_order_release);
+        ++dequeue_position_;
+        ++messages_count;
+    }
+
+    // Сообщаем о сообщениях, отброшенных из-за переполнения буфера
+    const size_t dropped_count = dropped_count_.exchange(0, memory_order_relaxed);
+    if (dropped_count > 0) {
+        buffer += "[WARNING] "s + to_string(dropped_count) + " log message(s) dropped: ring buffer is full\n"s;
+    }
+
+    // Выводим все сообщения одной операцией записи со сбросом буфера
+    if (!buffer.empty()) {
+        cout.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+        cout.flush();
+    }
+
+    return messages_count;
+}
+
+}
@@ -0,0 +1,135 @@
+// Единица трансляции binary_encoding.cpp описывает функции двоичного кодирования: контрольную сумму CRC-32C и запись
+// и чтение чисел фиксированной длины в порядке little-endian
+
+// Подключим библиотеку array для таблицы CRC-32C и библиотеку cstring для копирования байтов
+#include <array>
+#include <cstring>
+
+// Подключим заголовочный файл с intrinsic-функциями SSE4.2 (только для процессоров x86-64, сама функция компилируется
+// для своего набора инструкций через атрибут target и вызывается, только если процессор его поддерживает)
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+// Подключим заголовочный файл функций двоичного кодирования
+#include "binary_encoding.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён функций двоичного кодирования
+namespace binary_encoding {
+
+// Пространство имён для вспомогательных объектов и функций
+namespace detail {
+
+// Функция построения таблицы CRC-32C (остаток от деления каждого байта на отражённый полином Castagnoli 0x82F63B78)
+static constexpr array<uint32_t, 256> MakeCrc32cTable() {
+    array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : crc >> 1;
+        }
+        table[i] = crc;
+    }
+    return table;
+}
+
+// Таблица CRC-32C (строится на этапе компиляции)
+static constexpr array<uint32_t, 256> CRC32C_TABLE = MakeCrc32cTable();
+
+// Функция обновления контрольной суммы CRC-32C по таблице (по одному байту)
+uint32_t Crc32cScalar(uint32_t crc, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        crc = CRC32C_TABLE[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+// Функция обновления контрольной суммы CRC-32C инструкцией crc32 SSE4.2 (по 8 байт, остаток - по одному байту)
+__attribute__((target("sse4.2")))
+uint32_t Crc32cSSE42(uint32_t crc, const char* data, size_t size) {
+    uint64_t crc64 = crc;
+    for (; size >= 8; data += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+
+    crc = static_cast<uint32_t>(crc64);
+    for (; size > 0; ++data, --size) {
+        crc = _mm_crc32_u8(crc, static_cast<unsigned char>(*data));
+    }
+    return crc;
+}
+
+#endif
+
+// Функция выбора реализации CRC-32C по возможностям процессора (SSE4.2, иначе скалярная)
+uint32_t (*ChooseCrc32c())(uint32_t, const char*, size_t) {
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse4.2")) {
+        return Crc32cSSE42;
+    }
+#endif
+    return Crc32cScalar;
+}
+
+}
+
+// Функция подсчёта контрольной суммы CRC-32C (Castagnoli) байтов data
+uint32_t Crc32c(string_view data, uint32_t crc) {
+
+    // Реализация выбирается один раз при первом вызове
+    static const auto crc32c = detail::ChooseCrc32c();
+
+    return ~crc32c(~crc, data.data(), data.size());
+}
+
+// Функция дописывания в конец строки числа из 4 байт в порядке little-endian
+void AppendFixed32(string& buffer, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        buffer.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Функция дописывания в конец строки числа из 8 байт в порядке little-endian
+void AppendFixed64(string& buffer, uint64_t value) {
+    for (int i = 0; i < 8; ++i) {
+        buffer.push_back(static_cast<char>(value >> (8 * i)));
+    }
+}
+
+// Функция чтения числа из 4 байт в порядке little-endian из начала data
+bool ReadFixed32(string_view& data, uint32_t& value) {
+    if (data.size() < 4) {
+        return false;
+    }
+
+    value = 0;
+    for (int i = 0; i < 4; ++i) {
+        value |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    data.remove_prefix(4);
+    return true;
+}
+
+// Функция чтения числа из 8 байт в порядке little-endian из начала data
+bool ReadFixed64(string_view& data, uint64_t& value) {
+    if (data.size() < 8) {
+        return false;
+    }
+
+    value = 0;
+    for (int i = 0; i < 8; ++i) {
+        value |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    data.remove_prefix(8);
+    return true;
+}
+
+}
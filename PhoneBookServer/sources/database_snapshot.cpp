@@ -0,0 +1,407 @@
+// Единица трансляции database_snapshot.cpp описывает запись и чтение двоичного формата файла базы данных для
+// телефонной книги (snapshot)
+
+// Подключим библиотеку fstream для проверки сигнатуры файла, библиотеку limits для работы с предельными значениями
+// типов, библиотеку cstring для сравнения байтов, библиотеку cerrno для кодов ошибок системных вызовов и библиотеку
+// stdexcept для исключений
+#include <fstream>
+#include <limits>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+// Подключим заголовочные файлы POSIX для работы с файловыми дескрипторами (open, pwrite, fsync, close), размером
+// файла (fstat) и отображением файла в память (mmap, madvise, munmap)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+// Подключим заголовочный файл двоичного формата файла базы данных
+#include "database_snapshot.h"
+
+// Подключим заголовочный файл функций двоичного кодирования (контрольная сумма CRC-32C и функции записи и чтения чисел
+// фиксированной длины)
+#include "binary_encoding.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён двоичного формата файла базы данных
+namespace database_snapshot {
+
+using binary_encoding::AppendFixed32;
+using binary_encoding::AppendFixed64;
+using binary_encoding::ReadFixed32;
+using binary_encoding::ReadFixed64;
+using binary_encoding::Crc32c;
+
+// Число полей записи, хранящихся в куче строк
+static constexpr size_t RECORD_FIELDS_COUNT = 5;
+
+// Смещение в заголовке, с которого начинается часть заголовка, покрытая его контрольной суммой
+static constexpr size_t HEADER_CHECKSUM_START = 16;
+
+// Функция дописывания в конец каталога секций элемента каталога
+static void AppendSectionEntry(string& directory, SectionType type, uint32_t checksum, uint64_t offset, uint64_t size) {
+    AppendFixed32(directory, static_cast<uint32_t>(type));
+    AppendFixed32(directory, checksum);
+    AppendFixed64(directory, offset);
+    AppendFixed64(directory, size);
+    AppendFixed64(directory, 0);
+}
+
+// Конструктор писателя открывает (создаёт или обрезает) файл
+SnapshotWriter::SnapshotWriter(const string& file_name, uint64_t records_count, uint64_t last_record_id)
+    : file_name_(file_name),
+      records_count_(records_count),
+      last_record_id_(last_record_id),
+      records_position_(HEADER_SIZE) {
+
+    // Таблица записей должна помещаться в файл, чтобы смещение кучи строк не переполнилось
+    if (records_count > (numeric_limits<uint64_t>::max() - HEADER_SIZE) / RECORD_ENTRY_SIZE) {
+        throw length_error("Too many records for snapshot file"s);
+    }
+    strings_position_ = HEADER_SIZE + records_count * RECORD_ENTRY_SIZE;
+
+    file_descriptor_ = open(file_name_.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (file_descriptor_ < 0) {
+        throw runtime_error("Can't open snapshot file \""s + file_name_ + "\": "s + strerror(errno));
+    }
+
+    records_buffer_.reserve(BUFFER_SIZE + RECORD_ENTRY_SIZE);
+}
+
+// Деструктор закрывает файл
+SnapshotWriter::~SnapshotWriter() {
+    if (file_descriptor_ >= 0) {
+        close(file_descriptor_);
+    }
+}
+
+// Функция добавления записи
+void SnapshotWriter::AddRecord(uint64_t id, string_view name, string_view surname, string_view patronymic,
+                               string_view number, string_view note) {
+
+    if (strings_finished_ || added_records_count_ >= records_count_) {
+        throw logic_error("More records are added to snapshot file than declared"s);
+    }
+
+    const string_view fields[RECORD_FIELDS_COUNT] = {name, surname, patronymic, number, note};
+
+    // Элемент таблицы записей: номер/id, смещение полей в куче строк, длины полей и зарезервированное поле
+    AppendFixed64(records_buffer_, id);
+    AppendFixed64(records_buffer_, strings_size_);
+    for (const string_view field : fields) {
+        if (field.size() > numeric_limits<uint32_t>::max()) {
+            throw length_error("Record field is too large for snapshot file"s);
+        }
+        AppendFixed32(records_buffer_, static_cast<uint32_t>(field.size()));
+        strings_buffer_.append(field);
+        strings_size_ += field.size();
+    }
+    AppendFixed32(records_buffer_, 0);
+
+    ++added_records_count_;
+
+    // Сбрасываем заполнившиеся буферы в файл
+    if (records_buffer_.size() >= BUFFER_SIZE) {
+        FlushRecords();
+    }
+    if (strings_buffer_.size() >= BUFFER_SIZE) {
+        FlushStrings();
+    }
+}
+
+// Функция добавления секции
+void SnapshotWriter::AddSection(SectionType type, string_view data) {
+    FinishStrings();
+
+    WriteAt(end_position_, data);
+    AppendSectionEntry(directory_, type, Crc32c(data), end_position_, data.size());
+    ++sections_count_;
+    end_position_ += data.size();
+}
+
+// Функция завершения файла
+void SnapshotWriter::Finish() {
+    FinishStrings();
+
+    // Каталог секций пишем в конец файла
+    const uint64_t directory_offset = end_position_;
+    WriteAt(directory_offset, directory_);
+
+    // Заголовок пишем последним, поэтому недописанный файл не пройдёт проверку сигнатуры и контрольной суммы заголовка
+    string header;
+    header.reserve(HEADER_SIZE);
+    header.append(MAGIC);
+    AppendFixed32(header, FORMAT_VERSION);
+    AppendFixed32(header, 0);
+    AppendFixed64(header, records_count_);
+    AppendFixed64(header, last_record_id_);
+    AppendFixed64(header, directory_offset);
+    AppendFixed64(header, sections_count_);
+    AppendFixed32(header, Crc32c(directory_));
+    header.resize(HEADER_SIZE, '\0');
+
+    // Контрольная сумма заголовка покрывает всё после сигнатуры, версии и самой контрольной суммы
+    string checksum;
+    AppendFixed32(checksum, Crc32c(string_view(header).substr(HEADER_CHECKSUM_START)));
+    header.replace(12, 4, checksum);
+
+    WriteAt(0, header);
+
+    // Синхронизируем файл с диском и закрываем его
+    if (fsync(file_descriptor_) != 0) {
+        throw runtime_error("Can't sync snapshot file \""s + file_name_ + "\": "s + strerror(errno));
+    }
+    const int file_descriptor = file_descriptor_;
+    file_descriptor_ = -1;
+    if (close(file_descriptor) != 0) {
+        throw runtime_error("Can't close snapshot file \""s + file_name_ + "\": "s + strerror(errno));
+    }
+}
+
+// Функция записи data в файл с положения position (повторяет pwrite после частичной записи и прерывания сигналом)
+void SnapshotWriter::WriteAt(uint64_t position, string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = pwrite(file_descriptor_, data.data(), data.size(), static_cast<off_t>(position));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw runtime_error("Can't write snapshot file \""s + file_name_ + "\": "s + strerror(errno));
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+        position += static_cast<uint64_t>(written);
+    }
+}
+
+// Функция сброса буфера таблицы записей в файл
+void SnapshotWriter::FlushRecords() {
+    WriteAt(records_position_, records_buffer_);
+    records_checksum_ = Crc32c(records_buffer_, records_checksum_);
+    records_position_ += records_buffer_.size();
+    records_buffer_.clear();
+}
+
+// Функция сброса буфера кучи строк в файл
+void SnapshotWriter::FlushStrings() {
+    WriteAt(strings_position_, strings_buffer_);
+    strings_checksum_ = Crc32c(strings_buffer_, strings_checksum_);
+    strings_position_ += strings_buffer_.size();
+    strings_buffer_.clear();
+}
+
+// Функция завершения кучи строк
+void SnapshotWriter::FinishStrings() {
+    if (strings_finished_) {
+        return;
+    }
+
+    if (added_records_count_ != records_count_) {
+        throw logic_error("Fewer records are added to snapshot file than declared"s);
+    }
+
+    FlushRecords();
+    FlushStrings();
+
+    const uint64_t strings_offset = HEADER_SIZE + records_count_ * RECORD_ENTRY_SIZE;
+    AppendSectionEntry(directory_, SectionType::RECORDS, records_checksum_, HEADER_SIZE,
+                       records_count_ * RECORD_ENTRY_SIZE);
+    AppendSectionEntry(directory_, SectionType::STRINGS, strings_checksum_, strings_offset, strings_size_);
+    sections_count_ += 2;
+
+    end_position_ = strings_offset + strings_size_;
+    strings_finished_ = true;
+}
+
+// Функция проверки, записан ли файл в двоичном формате
+bool MappedSnapshot::IsSnapshotFile(const string& file_name) {
+    ifstream database_file(file_name, ios::binary);
+    string magic(MAGIC.size(), '\0');
+    return database_file.read(magic.data(), magic.size()) && magic == MAGIC;
+}
+
+// Конструктор отображает файл в память
+MappedFile::MappedFile(const string& file_name) {
+
+    const int file_descriptor = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file_descriptor < 0) {
+        throw runtime_error("Can't open \""s + file_name + "\": "s + strerror(errno));
+    }
+
+    struct stat file_status;
+    if (fstat(file_descriptor, &file_status) != 0) {
+        const int error = errno;
+        close(file_descriptor);
+        throw runtime_error("Can't stat \""s + file_name + "\": "s + strerror(error));
+    }
+
+    // Пустой файл отобразить нельзя, его байты - пустая строка
+    if (file_status.st_size == 0) {
+        close(file_descriptor);
+        return;
+    }
+
+    // Отображаем файл в память (после mmap файловый дескриптор больше не нужен) и просим ядро заранее прочитать его
+    // страницы, так как загрузка читает файл целиком
+    const size_t size = static_cast<size_t>(file_status.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    const int error = errno;
+    close(file_descriptor);
+    if (data == MAP_FAILED) {
+        throw runtime_error("Can't map \""s + file_name + "\": "s + strerror(error));
+    }
+    madvise(data, size, MADV_WILLNEED);
+
+    data_ = static_cast<const char*>(data);
+    size_ = size;
+}
+
+// Деструктор снимает отображение файла
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+}
+
+// Конструктор отображает файл в память и проверяет его
+MappedSnapshot::MappedSnapshot(const string& file_name) : file_(file_name) {
+
+    const string_view file = file_.Data();
+    const size_t file_size = file.size();
+    const auto damaged = [&file_name](const string& reason) {
+        return runtime_error("Snapshot file \""s + file_name + "\" is damaged: "s + reason);
+    };
+
+    if (file_size < HEADER_SIZE) {
+        throw damaged("it is shorter than its header"s);
+    }
+
+    // Проверяем сигнатуру, версию формата и контрольную сумму заголовка
+    string_view header = file.substr(0, HEADER_SIZE);
+    if (header.substr(0, MAGIC.size()) != MAGIC) {
+        throw damaged("wrong signature"s);
+    }
+    header.remove_prefix(MAGIC.size());
+
+    uint32_t version = 0, header_checksum = 0;
+    ReadFixed32(header, version);
+    ReadFixed32(header, header_checksum);
+    if (version != FORMAT_VERSION) {
+        throw runtime_error("Snapshot file \""s + file_name + "\" has unsupported format version "s
+                            + to_string(version));
+    }
+    if (Crc32c(file.substr(HEADER_CHECKSUM_START, HEADER_SIZE - HEADER_CHECKSUM_START)) != header_checksum) {
+        throw damaged("header checksum mismatch"s);
+    }
+
+    uint64_t directory_offset = 0, sections_count = 0;
+    uint32_t directory_checksum = 0;
+    ReadFixed64(header, records_count_);
+    ReadFixed64(header, last_record_id_);
+    ReadFixed64(header, directory_offset);
+    ReadFixed64(header, sections_count);
+    ReadFixed32(header, directory_checksum);
+
+    // Проверяем границы и контрольную сумму каталога секций
+    if (directory_offset > file_size || sections_count > (file_size - directory_offset) / SECTION_ENTRY_SIZE) {
+        throw damaged("section directory is out of file bounds"s);
+    }
+    string_view directory = file.substr(directory_offset, sections_count * SECTION_ENTRY_SIZE);
+    if (Crc32c(directory) != directory_checksum) {
+        throw damaged("section directory checksum mismatch"s);
+    }
+
+    // Проверяем границы и контрольную сумму каждой секции
+    sections_.reserve(sections_count);
+    for (uint64_t i = 0; i < sections_count; ++i) {
+        uint32_t type = 0, checksum = 0;
+        uint64_t offset = 0, size = 0, reserved = 0;
+        ReadFixed32(directory, type);
+        ReadFixed32(directory, checksum);
+        ReadFixed64(directory, offset);
+        ReadFixed64(directory, size);
+        ReadFixed64(directory, reserved);
+
+        if (offset > file_size || size > file_size - offset) {
+            throw damaged("section "s + to_string(type) + " is out of file bounds"s);
+        }
+        const string_view section_data = file.substr(offset, size);
+        if (Crc32c(section_data) != checksum) {
+            throw damaged("section "s + to_string(type) + " checksum mismatch"s);
+        }
+        sections_.push_back({static_cast<SectionType>(type), section_data});
+    }
+
+    // Таблица записей и куча строк обязательны, длина таблицы должна соответствовать числу записей
+    const optional<string_view> records = FindSection(SectionType::RECORDS);
+    const optional<string_view> strings = FindSection(SectionType::STRINGS);
+    if (!records || !strings) {
+        throw damaged("records table or strings heap is missing"s);
+    }
+    if (records_count_ > records->size() / RECORD_ENTRY_SIZE
+        || records->size() != records_count_ * RECORD_ENTRY_SIZE) {
+        throw damaged("records table size doesn't match records count"s);
+    }
+    records_ = *records;
+    strings_ = *strings;
+}
+
+// Функция получения записи из таблицы записей
+RecordView MappedSnapshot::GetRecord(size_t index) const {
+    if (index >= records_count_) {
+        throw out_of_range("Snapshot record index is out of range"s);
+    }
+
+    string_view entry = records_.substr(index * RECORD_ENTRY_SIZE, RECORD_ENTRY_SIZE);
+
+    RecordView record;
+    uint64_t offset = 0;
+    uint32_t lengths[RECORD_FIELDS_COUNT];
+    ReadFixed64(entry, record.id);
+    ReadFixed64(entry, offset);
+    uint64_t total_length = 0;
+    for (uint32_t& length : lengths) {
+        ReadFixed32(entry, length);
+        total_length += length;
+    }
+
+    // Поля записи должны лежать внутри кучи строк (контрольная сумма защищает от порчи, но не от ошибки писателя)
+    if (offset > strings_.size() || total_length > strings_.size() - offset) {
+        throw runtime_error("Snapshot record "s + to_string(index) + " is out of strings heap bounds"s);
+    }
+
+    string_view* fields[RECORD_FIELDS_COUNT] = {&record.name, &record.surname, &record.patronymic, &record.number,
+                                                &record.note};
+    for (size_t i = 0; i < RECORD_FIELDS_COUNT; ++i) {
+        *fields[i] = strings_.substr(offset, lengths[i]);
+        offset += lengths[i];
+    }
+
+    return record;
+}
+
+// Функция поиска секции
+optional<string_view> MappedSnapshot::FindSection(SectionType type) const {
+    for (const Section& section : sections_) {
+        if (section.type == type) {
+            return section.data;
+        }
+    }
+    return nullopt;
+}
+
+// Функция поиска всех секций типа type
+vector<string_view> MappedSnapshot::FindSections(SectionType type) const {
+    vector<string_view> sections;
+    for (const Section& section : sections_) {
+        if (section.type == type) {
+            sections.push_back(section.data);
+        }
+    }
+    return sections;
+}
+
+}
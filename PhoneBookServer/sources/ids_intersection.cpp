@@ -0,0 +1,165 @@
+// Единица трансляции ids_intersection.cpp содержит в себе функции пересечения отсортированных массивов номеров/id
+// записей
+
+// Подключим библиотеку algorithm для использования стандартных алгоритмов (бинарный поиск lower_bound)
+#include <algorithm>
+
+// Подключим заголовочный файл с intrinsic-функциями AVX2 (только для процессоров x86-64, сама функция компилируется
+// для своего набора инструкций через атрибут target и вызывается, только если процессор его поддерживает)
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Подключим заголовочный файл с функциями пересечения массивов номеров/id записей
+#include "ids_intersection.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён для функций пересечения массивов номеров/id записей
+namespace ids_intersection {
+
+// Пространство имён для вспомогательных объектов и функций
+namespace detail {
+
+// Функция пересечения слиянием без ветвлений на каждую пару номеров/id: текущий номер/id lhs записывается в out
+// всегда, а счётчик пересечения и позиции в массивах сдвигаются результатами сравнений (запись в out никогда не
+// обгоняет чтение lhs, поэтому out может совпадать с lhs)
+size_t IntersectMergeScalar(const size_t* lhs, size_t lhs_size, const size_t* rhs, size_t rhs_size, size_t* out) {
+    size_t i = 0, j = 0, count = 0;
+
+    while (i < lhs_size && j < rhs_size) {
+        const size_t lhs_id = lhs[i];
+        const size_t rhs_id = rhs[j];
+
+        out[count] = lhs_id;
+        count += lhs_id == rhs_id;
+        i += lhs_id <= rhs_id;
+        j += rhs_id <= lhs_id;
+    }
+
+    return count;
+}
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+// Функция пересечения слиянием блоков по 4 номера/id через AVX2
+//
+// Блок lhs сравнивается с блоком rhs и тремя его циклическими сдвигами (4 сравнения по 4 номера/id - каждый с каждым),
+// совпадения накапливаются в 4-битной маске блока lhs, затем сдвигается блок с меньшим последним номером/id (или оба).
+// Блок lhs может встретить совпадения в нескольких блоках rhs, поэтому его номера/id записываются в out по маске лишь
+// при переходе к следующему блоку lhs. Остаток массивов короче блока досчитывается скалярным слиянием
+__attribute__((target("avx2")))
+size_t IntersectMergeAVX2(const size_t* lhs, size_t lhs_size, const size_t* rhs, size_t rhs_size, size_t* out) {
+    static_assert(sizeof(size_t) == sizeof(long long), "IntersectMergeAVX2 compares 64-bit record ids");
+
+    size_t i = 0, j = 0, count = 0;
+
+    // Маска совпадений текущего блока lhs с уже пройденными блоками rhs
+    unsigned matches = 0;
+
+    while (i + 4 <= lhs_size && j + 4 <= rhs_size) {
+        const __m256i lhs_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lhs + i));
+        const __m256i rhs_block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rhs + j));
+
+        __m256i equal = _mm256_cmpeq_epi64(lhs_block, rhs_block);
+        equal = _mm256_or_si256(equal, _mm256_cmpeq_epi64(lhs_block, _mm256_permute4x64_epi64(rhs_block, _MM_SHUFFLE(0, 3, 2, 1))));
+        equal = _mm256_or_si256(equal, _mm256_cmpeq_epi64(lhs_block, _mm256_permute4x64_epi64(rhs_block, _MM_SHUFFLE(1, 0, 3, 2))));
+        equal = _mm256_or_si256(equal, _mm256_cmpeq_epi64(lhs_block, _mm256_permute4x64_epi64(rhs_block, _MM_SHUFFLE(2, 1, 0, 3))));
+        matches |= static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(equal)));
+
+        const size_t lhs_last = lhs[i + 3];
+        const size_t rhs_last = rhs[j + 3];
+
+        // Блок lhs пройден - записываем его совпавшие номера/id (запись не обгоняет чтение, out может совпадать с lhs)
+        if (lhs_last <= rhs_last) {
+            for (unsigned mask = matches; mask != 0; mask &= mask - 1) {
+                out[count++] = lhs[i + __builtin_ctz(mask)];
+            }
+            matches = 0;
+            i += 4;
+        }
+        if (rhs_last <= lhs_last) {
+            j += 4;
+        }
+    }
+
+    // Совпадения недописанного блока lhs меньше всех оставшихся номеров/id rhs, поэтому записываем их и пропускаем
+    // блок lhs до последнего совпадения (номера/id блока до него без совпадений тоже меньше оставшихся номеров/id rhs)
+    if (matches != 0) {
+        for (unsigned mask = matches; mask != 0; mask &= mask - 1) {
+            out[count++] = lhs[i + __builtin_ctz(mask)];
+        }
+        i += 32 - __builtin_clz(matches);
+    }
+
+    return count + IntersectMergeScalar(lhs + i, lhs_size - i, rhs + j, rhs_size - j, out + count);
+}
+
+#endif
+
+// Функция выбора реализации пересечения слиянием по возможностям процессора
+MergeImplementation ChooseIntersectMerge() {
+#if defined(__GNUC__) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {IntersectMergeAVX2, GALLOP_RATIO_AVX2};
+    }
+#endif
+    return {IntersectMergeScalar, GALLOP_RATIO_SCALAR};
+}
+
+// Функция пересечения поиском с галопом (найденный номер/id записывается в out не дальше места, где он найден, поэтому
+// out может совпадать как с small, так и с large)
+size_t IntersectGallop(const size_t* small, size_t small_size, const size_t* large, size_t large_size, size_t* out) {
+    size_t count = 0;
+
+    // Начало ещё не пройденной части массива large
+    size_t low = 0;
+
+    for (size_t s = 0; s < small_size && low < large_size; ++s) {
+        const size_t id = small[s];
+
+        // Удваиваем шаг, пока номер/id на его конце меньше искомого (после цикла искомый номер/id лежит между
+        // половиной шага и его концом)
+        size_t bound = 1;
+        while (low + bound < large_size && large[low + bound] < id) {
+            bound *= 2;
+        }
+
+        const size_t* found = lower_bound(large + low + bound / 2, large + min(low + bound + 1, large_size), id);
+        low = static_cast<size_t>(found - large);
+
+        if (low < large_size && *found == id) {
+            out[count++] = id;
+            ++low;
+        }
+    }
+
+    return count;
+}
+
+}
+
+// Функция пересечения двух отсортированных по возрастанию массивов номеров/id без повторов
+size_t IntersectSortedIds(const size_t* lhs, size_t lhs_size, const size_t* rhs, size_t rhs_size, size_t* out) {
+    if (lhs_size == 0 || rhs_size == 0) {
+        return 0;
+    }
+
+    // Реализация слияния выбирается один раз при первом вызове
+    static const detail::MergeImplementation merge = detail::ChooseIntersectMerge();
+
+    // Массивы сильно различаются по размеру - ищем меньший в большем с галопом
+    if (lhs_size / merge.gallop_ratio >= rhs_size) {
+        return detail::IntersectGallop(rhs, rhs_size, lhs, lhs_size, out);
+    }
+    if (rhs_size / merge.gallop_ratio >= lhs_size) {
+        return detail::IntersectGallop(lhs, lhs_size, rhs, rhs_size, out);
+    }
+
+    // Иначе сливаем массивы
+    return merge.function(lhs, lhs_size, rhs, rhs_size, out);
+}
+
+}
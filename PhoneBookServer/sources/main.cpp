@@ -1,11 +1,14 @@
 // Единица трансляции main.cpp содержит входную точку программы и реализует интерфейс
 
 // Подключим библиотеку iostream для работы стандартного потока вывода в консоль для
-// отображения статуса работы сервера, библиотеку string для работы со строками и
-// библиотеку chrono для работы со временем
+// отображения статуса работы сервера, библиотеку string для работы со строками,
+// библиотеку chrono для работы со временем, библиотеку thread для определения числа ядер процессора и
+// библиотеку algorithm для использования стандартных алгоритмов
 #include <iostream>
 #include <string>
 #include <chrono>
+#include <thread>
+#include <algorithm>
 
 // Подключим заголовочный файл с функцией getch для Linux
 #include "linux_getch_function.h"
@@ -13,9 +16,9 @@
 // Подключим заголовочный файл сервера для телефонной книги
 #include "phone_book_server.h"
 
-// Подключим заголовочный файл базы данных для телефонной книги
+// Подключим заголовочный файл шардированной базы данных для телефонной книги
 // (вообще говоря, он подключен внутри phone_book_server.h, поэтому необязательно)
-#include "phone_book_database.h"
+#include "sharded_phone_book_database.h"
 
 // Подключим пространства имён std и chrono_literals
 using namespace std;
@@ -33,11 +36,39 @@ int main(int argc, char** argv) {
     // Порт для работы сервера телефонной книги
     const uint16_t server_port = 50051; 
 
-    // Создаём базу данных телефонной книги, загружая данные из файла
-    phone_book_database::PhoneBookDatabase database(database_name);
+    // Число очередей handler'ов сервера телефонной книги (по одной на каждое ядро процессора) и число
+    // потоков, обслуживающих каждую очередь
+    const size_t server_queues_count = max(thread::hardware_concurrency(), 1u);
+    const size_t server_threads_per_queue_count = 1;
 
-    // Создаём сервер телефонной книги, передавая ему IP-адрес и порт
-    phone_book_server::PhoneBookServer server(server_ip, server_port, database);
+    // Число шардов базы данных телефонной книги (по одному на каждое ядро процессора, чтобы поиск по всем
+    // шардам выполнялся параллельно на всех ядрах)
+    const size_t database_shards_count = max(thread::hardware_concurrency(), 1u);
+
+    // Ёмкость кэша результатов поиска записей по содержанию заметок в байтах
+    const size_t database_note_search_cache_capacity = phone_book_database::ShardedPhoneBookDatabase::DEFAULT_NOTE_SEARCH_CACHE_CAPACITY;
+
+    // Параметры журнала упреждающей записи базы данных: имя журнала (сегменты лежат рядом с файлом базы данных),
+    // режим долговечности (NONE - изменения переживают аварийное завершение процесса сервера, BATCHED - ещё и сбой
+    // питания, кроме изменений за последний период синхронизации, PER_REQUEST - ответ клиенту только после
+    // синхронизации с диском) и период фоновой синхронизации для BATCHED
+    const write_ahead_log::Options database_wal_options{database_name + ".wal"s, write_ahead_log::Durability::BATCHED, 10ms};
+
+    // Параметры фонового сохранения базы данных в файл: период сохранения и наименьший объём кадров, дописанных в
+    // журнал упреждающей записи с прошлого сохранения (журнал меньшего объёма воспроизводится при запуске быстро,
+    // поэтому файл почти не изменившейся базы данных не перезаписывается)
+    const phone_book_database::CheckpointOptions database_checkpoint_options{60s, size_t{1} << 20};
+
+    // Создаём шардированную базу данных телефонной книги, загружая данные из файла и воспроизводя поверх них журнал
+    // упреждающей записи
+    phone_book_database::ShardedPhoneBookDatabase database(database_name, database_shards_count,
+                                                           database_note_search_cache_capacity, database_wal_options,
+                                                           database_checkpoint_options);
+
+    // Создаём сервер телефонной книги, передавая ему IP-адрес, порт, число очередей handler'ов и число
+    // потоков на одну очередь
+    phone_book_server::PhoneBookServer server(server_ip, server_port, database,
+                                              server_queues_count, server_threads_per_queue_count);
 
     // Запускаем сервер в отдельном потоке
     server.RunInNewThread();
@@ -49,8 +80,10 @@ int main(int argc, char** argv) {
     // остановки работы сервера, заблокировав выполнение потока функцией getch
     char interruption_key; while(true) {
 
-        // Информируем в консоль, что для остановки работы сервера необходимо нажать ESC или пробел
-        cout << "[To shutdown the server press ESC or SPACE]" << endl;
+        // Информируем в консоль, что для остановки работы сервера необходимо нажать ESC или пробел, а для вывода
+        // статистики поиска (кэша результатов поиска по заметкам и объединения одинаковых запросов), журнала
+        // упреждающей записи и сохранений в файл - S
+        cout << "[To shutdown the server press ESC or SPACE, to show search statistics press S]" << endl;
 
         // Замечание: может получиться так, что сервер, работающий на параллельном потоке, выведет
         // в консоль что-либо в момент, когда функция getch изменит параметры ввода-вывода в терминал.
@@ -62,6 +95,31 @@ int main(int argc, char** argv) {
         if (interruption_key == 27 || interruption_key == 32) {
             break;
         }
+
+        // Если была нажата кнопка S, выводим в консоль статистику кэша результатов поиска по заметкам, объединения
+        // одинаковых одновременных запросов поиска, журнала упреждающей записи и сохранений базы данных в файл
+        if (interruption_key == 's' || interruption_key == 'S') {
+            const auto stats = database.GetNoteSearchCacheStats();
+            cout << "[Note search cache: hits="s << stats.hits << ", misses="s << stats.misses
+                 << ", invalidations="s << stats.invalidations << ", evictions="s << stats.evictions
+                 << ", entries="s << stats.entries << ", bytes="s << stats.bytes << "/"s << stats.capacity_bytes << "]"s << endl;
+
+            const auto flights_stats = database.GetSearchFlightsStats();
+            cout << "[Coalesced search requests: executed="s << flights_stats.executed
+                 << ", coalesced="s << flights_stats.coalesced << "]"s << endl;
+
+            const auto wal_stats = database.GetWriteAheadLogStats();
+            cout << "[Write-ahead log: appends="s << wal_stats.appends << ", bytes="s << wal_stats.bytes
+                 << ", writes="s << wal_stats.writes << ", syncs="s << wal_stats.syncs << "]"s << endl;
+
+            const auto checkpoint_stats = database.GetCheckpointStats();
+            cout << "[Checkpoints: saved="s << checkpoint_stats.checkpoints << ", failed="s << checkpoint_stats.failures
+                 << ", skipped="s << checkpoint_stats.skipped << ", last duration="s
+                 << checkpoint_stats.last_duration.count() / 1000 << " ms, last pause="s
+                 << checkpoint_stats.last_pause.count() << " us, max pause="s << checkpoint_stats.max_pause.count()
+                 << " us, last bytes="s << checkpoint_stats.last_bytes << ", total bytes="s
+                 << checkpoint_stats.total_bytes << "]"s << endl;
+        }
     }
 
     // Информируем в консоль о том, что была нажата кнопка ESC или пробел
@@ -0,0 +1,161 @@
+// Единица трансляции note_search_cache.cpp описывает работу кэша результатов поиска записей по содержанию заметок
+
+// Подключим библиотеку iterator для использования prev
+#include <iterator>
+
+// Подключим заголовочный файл кэша результатов поиска записей по содержанию заметок
+#include "note_search_cache.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён базы данных для телефонной книги
+namespace phone_book_database {
+
+// Функция дописывания байтов значения value в конец строки key
+template <typename Value>
+static void AppendBytes(string& key, const Value& value) {
+    key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// Функция построения ключа кэша по отсортированным различным словам запроса, ограничению на число записей и
+// параметрам ранжирования
+string NoteSearchCache::MakeKey(const vector<string_view>& words, size_t max_records_count,
+                                const NoteRankingParams& ranking_params) {
+    string key;
+
+    // Вначале идут байты параметров фиксированной длины: модель ранжирования, параметры BM25 (только для BM25, чтобы
+    // одинаковые запросы по TF-IDF с разными k1 и b попадали в один результат) и ограничение на число записей
+    AppendBytes(key, ranking_params.ranking);
+    if (ranking_params.ranking == NoteRanking::BM25) {
+        AppendBytes(key, ranking_params.bm25_k1);
+        AppendBytes(key, ranking_params.bm25_b);
+    }
+    AppendBytes(key, max_records_count);
+
+    // Затем слова запроса через пробел (слова заметок не содержат пробелов, так как пробел - символ-сепаратор)
+    for (string_view word : words) {
+        key.push_back(' ');
+        key.append(word);
+    }
+
+    return key;
+}
+
+// Функция проверки, что результат, вычисленный по версии данных cached, действителен для версии current
+bool NoteSearchCache::IsValid(const DataVersion& cached, const DataVersion& current) {
+    return cached.records_count == current.records_count &&
+           cached.notes_length == current.notes_length &&
+           cached.word_generations == current.word_generations;
+}
+
+// Функция оценки занятой элементом кэша памяти в байтах
+size_t NoteSearchCache::EntryBytes(const Entry& entry) {
+
+    // Строка занимает память в куче, только если её содержимое не поместилось в сам объект строки (small string
+    // optimization)
+    static const size_t inline_capacity = string().capacity();
+    const auto string_bytes = [](const string& str) {
+        return str.capacity() > inline_capacity ? str.capacity() + 1 : size_t{0};
+    };
+
+    // Элемент списка LRU и элемент hash-таблицы с указателями узлов, ключ и поколения слов запроса
+    size_t bytes = sizeof(Entry) + 2 * sizeof(void*) + sizeof(pair<string_view, list<Entry>::iterator>) + 2 * sizeof(void*);
+    bytes += string_bytes(entry.key);
+    bytes += entry.version.word_generations.capacity() * sizeof(uint64_t);
+
+    // Записи результата со строками
+    bytes += sizeof(Records) + entry.records->capacity() * sizeof(PhoneBookDatabase::RecordWithId);
+    for (const PhoneBookDatabase::RecordWithId& record : *entry.records) {
+        bytes += string_bytes(record.name) + string_bytes(record.surname) + string_bytes(record.patronymic) +
+                 string_bytes(record.number) + string_bytes(record.note);
+    }
+
+    return bytes;
+}
+
+// Функция удаления элемента по итератору в списке LRU (вызывающий метод должен захватить mutex)
+void NoteSearchCache::EraseEntry(list<Entry>::iterator entry) {
+    stats_.bytes -= entry->bytes;
+    index_.erase(entry->key);
+    entries_.erase(entry);
+}
+
+// Функция поиска результата по ключу key, действительного для текущей версии данных version
+shared_ptr<const NoteSearchCache::Records> NoteSearchCache::Find(const string& key, const DataVersion& version) {
+    lock_guard<mutex> guard(mutex_);
+
+    // Результата с таким ключом нет - промах
+    auto it = index_.find(key);
+    if (it == index_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+
+    // Результат устарел (изменились поколения слов запроса, число записей или суммарная длина заметок) - удаляем
+    // его из кэша, это тоже промах
+    auto entry = it->second;
+    if (!IsValid(entry->version, version)) {
+        EraseEntry(entry);
+        ++stats_.invalidations;
+        ++stats_.misses;
+        return nullptr;
+    }
+
+    // Попадание: переносим элемент в начало списка LRU (недавно использованный)
+    entries_.splice(entries_.begin(), entries_, entry);
+    ++stats_.hits;
+    return entry->records;
+}
+
+// Функция добавления результата records, вычисленного по версии данных version, под ключом key
+void NoteSearchCache::Insert(string key, DataVersion version, shared_ptr<const Records> records) {
+    if (capacity_bytes_ == 0) {
+        return;
+    }
+
+    // Строим элемент и оцениваем его размер до захвата mutex'а (результат больше всей ёмкости кэша не добавляем)
+    Entry new_entry{move(key), move(version), move(records), 0};
+    new_entry.bytes = EntryBytes(new_entry);
+    if (new_entry.bytes > capacity_bytes_) {
+        return;
+    }
+
+    lock_guard<mutex> guard(mutex_);
+
+    // Результат с таким ключом мог успеть добавить другой поток - заменяем его более свежим
+    if (auto it = index_.find(new_entry.key); it != index_.end()) {
+        EraseEntry(it->second);
+    }
+
+    // Добавляем элемент в начало списка LRU (ключ hash-таблицы ссылается на строку ключа внутри элемента списка,
+    // которая не перемещается, пока элемент в списке)
+    entries_.push_front(move(new_entry));
+    index_.emplace(entries_.front().key, entries_.begin());
+    stats_.bytes += entries_.front().bytes;
+
+    // Вытесняем давно не использованные результаты, пока не хватает ёмкости
+    while (stats_.bytes > capacity_bytes_) {
+        EraseEntry(prev(entries_.end()));
+        ++stats_.evictions;
+    }
+}
+
+// Функция удаления всех результатов
+void NoteSearchCache::Clear() {
+    lock_guard<mutex> guard(mutex_);
+    index_.clear();
+    entries_.clear();
+    stats_.bytes = 0;
+}
+
+// Функция получения статистики кэша
+NoteSearchCache::Stats NoteSearchCache::GetStats() const {
+    lock_guard<mutex> guard(mutex_);
+    Stats stats = stats_;
+    stats.entries = entries_.size();
+    stats.capacity_bytes = capacity_bytes_;
+    return stats;
+}
+
+}
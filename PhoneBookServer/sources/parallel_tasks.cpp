@@ -0,0 +1,60 @@
+// Единица трансляции parallel_tasks.cpp описывает работу постоянного пула рабочих потоков
+
+// Подключим заголовочный файл пула рабочих потоков и параллельного выполнения задач
+#include "parallel_tasks.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён параллельного выполнения задач
+namespace parallel_tasks {
+
+// Конструктор пула создаёт threads_count рабочих потоков
+WorkerPool::WorkerPool(size_t threads_count) {
+    threads_.reserve(threads_count);
+    for (size_t i = 0; i < threads_count; ++i) {
+        threads_.emplace_back([this]() { WorkerLoop(); });
+    }
+}
+
+// Деструктор пула дожидается окончания поставленных задач и останавливает рабочие потоки
+WorkerPool::~WorkerPool() {
+    {
+        lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    task_added_.notify_all();
+
+    for (thread& worker : threads_) {
+        worker.join();
+    }
+}
+
+// Функция постановки задачи в очередь пула
+void WorkerPool::Submit(function<void()> task) {
+    {
+        lock_guard lock(mutex_);
+        tasks_.push_back(move(task));
+    }
+    task_added_.notify_one();
+}
+
+// Функция рабочего потока
+void WorkerPool::WorkerLoop() {
+    while (true) {
+        function<void()> task;
+        {
+            unique_lock lock(mutex_);
+            task_added_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+            if (tasks_.empty()) {
+                return;
+            }
+            task = move(tasks_.front());
+            tasks_.pop_front();
+        }
+
+        task();
+    }
+}
+
+}
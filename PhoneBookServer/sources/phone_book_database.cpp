@@ -4,12 +4,26 @@
 
 // Подключим библиотеку iostream для работы стандартного потока вывода в консоль для отображения статуса
 // работы базы данных, библиотеку fstream для работы с потоком ввода-вывода в файл, библиотеку cmath для
-// использования математических функций (требуется функция логарифма) и библиотеку algorithm для
-// использования стандартных алгоритмов
+// использования математических функций (требуется функция логарифма), библиотеку algorithm для
+// использования стандартных алгоритмов, библиотеку mutex для работы с блокировками mutex'ов, библиотеки
+// unordered_map и unordered_set для группировки записей пакета при пакетном добавлении, библиотеку cstdint для
+// битовой маски окна при поиске записей по содержанию заметок, библиотеку filesystem для замены файла базы данных
+// сохранённым временным файлом, библиотеку thread для числа ядер процессора (потоков загрузки данных из файла), а также
+// библиотеки array и stdexcept для частей секции сохранённых словарей и исключений при их сериализации и библиотеку
+// numeric для нумерации записей при сверке сохранённых словарей
 #include <iostream>
 #include <fstream>
 #include <cmath>
 #include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <filesystem>
+#include <thread>
+#include <array>
+#include <stdexcept>
+#include <numeric>
 
 // Подключим заголовочный файл базы данных для телефонной книги
 #include "phone_book_database.h"
@@ -17,174 +31,929 @@
 // Подключаем заголовочный файл с функциями для работы со строками
 #include "string_functions.h"
 
+// Подключаем заголовочный файл с функциями пересечения отсортированных массивов номеров/id записей
+#include "ids_intersection.h"
+
+// Подключим заголовочный файл двоичного формата файла базы данных
+#include "database_snapshot.h"
+
+// Подключим заголовочный файл функций двоичного кодирования (функции записи и чтения чисел фиксированной длины для
+// секции сохранённых словарей)
+#include "binary_encoding.h"
+
 // Подключим пространство имён std
 using namespace std;
 
 // Пространство имён базы данных для телефонной книги
 namespace phone_book_database {
 
+using binary_encoding::AppendFixed32;
+using binary_encoding::AppendFixed64;
+using binary_encoding::ReadFixed32;
+using binary_encoding::ReadFixed64;
+
+// Число частей секции сохранённых словарей (словари имён, фамилий и отчеств, словарь терминов и слова заметок записей)
+// и длина её заголовка (версия формата, зарезервированное поле, расположение словарей и смещения частей)
+static constexpr size_t INDEXES_PARTS_COUNT = 5;
+static constexpr size_t INDEXES_HEADER_SIZE = 2 * 4 + 4 * 8 + INDEXES_PARTS_COUNT * 8;
+
+// Тип частей секции сохранённых словарей
+using IndexesParts = array<string_view, INDEXES_PARTS_COUNT>;
+
+// Функция деления секции сохранённых словарей indexes на части по смещениям из заголовка (возвращает nullopt, если
+// смещения не упорядочены или выходят за секцию)
+static optional<IndexesParts> SplitIndexesParts(string_view indexes) {
+    if (indexes.size() < INDEXES_HEADER_SIZE) {
+        return nullopt;
+    }
+
+    string_view offsets_data = indexes.substr(INDEXES_HEADER_SIZE - INDEXES_PARTS_COUNT * 8);
+    array<uint64_t, INDEXES_PARTS_COUNT + 1> offsets;
+    for (size_t i = 0; i < INDEXES_PARTS_COUNT; ++i) {
+        ReadFixed64(offsets_data, offsets[i]);
+    }
+    offsets[INDEXES_PARTS_COUNT] = indexes.size();
+
+    if (offsets[0] < INDEXES_HEADER_SIZE) {
+        return nullopt;
+    }
+
+    IndexesParts parts;
+    for (size_t i = 0; i < INDEXES_PARTS_COUNT; ++i) {
+        if (offsets[i] > offsets[i + 1]) {
+            return nullopt;
+        }
+        parts[i] = indexes.substr(offsets[i], offsets[i + 1] - offsets[i]);
+    }
+
+    return parts;
+}
+
 // Конструктор базы данных принимает имя файла (полное имя с путём до файла) с базой данных телефонной книги,
-// запоминает это имя и загружает данные в базу из файла
-PhoneBookDatabase::PhoneBookDatabase(const string& database_file_name) : database_file_name_(database_file_name) {
+// запоминает это имя, публикует пустую версию базы данных и загружает данные в базу из файла
+PhoneBookDatabase::PhoneBookDatabase(const string& database_file_name, size_t load_threads_count) :
+    database_file_name_(database_file_name),
+    load_threads_count_(load_threads_count ? load_threads_count : max<size_t>(thread::hardware_concurrency(), 1)),
+    worker_pool_(load_threads_count_ - 1),
+    snapshot_(make_shared<const Snapshot>()) {
     LoadFromFile();
 }
 
+// Конструктор пустой базы данных без файла публикует пустую версию базы данных
+// (используется для шардов ShardedPhoneBookDatabase)
+PhoneBookDatabase::PhoneBookDatabase() : worker_pool_(0), snapshot_(make_shared<const Snapshot>()) {
+}
+
+// Функция публикации новой версии базы данных
+// (вызывающий метод должен захватить mutex писателей)
+void PhoneBookDatabase::PublishSnapshot(shared_ptr<const Snapshot> snapshot) {
+    snapshot_.Store(move(snapshot));
+}
+
+// Функция получения текущей версии базы данных
+// (атомарная загрузка умного указателя без блокировок, никогда не ожидает ни писателей, ни других читателей)
+shared_ptr<const PhoneBookDatabase::Snapshot> PhoneBookDatabase::CurrentSnapshot() const {
+    return snapshot_.Load();
+}
+
 // Функция загрузки данных в базу из файла
 void PhoneBookDatabase::LoadFromFile() {
 
+    // Захватываем mutex писателей
+    lock_guard lock(writer_mutex_);
+
     // Информируем в консоль о начале загрузке данных в базу из файла
-    cout << "[Starting loading data from \""s << database_file_name_ << "\" into the database ...]"s << endl;
+    cout << "[Starting loading data from \""s << database_file_name_ << "\" into the database ("s
+         << load_threads_count_ << " threads) ...]"s << endl;
+
+    // Файл в двоичном формате загружаем без разбора текста: отображаем его в память (конструктор выбрасывает
+    // исключение, если файл повреждён) и копируем поля записей прямо из отображённых страниц (параллельно, по равной
+    // части таблицы записей на поток)
+    if (database_snapshot::MappedSnapshot::IsSnapshotFile(database_file_name_)) {
+        const database_snapshot::MappedSnapshot mapped_snapshot(database_file_name_);
+
+        const size_t records_count = mapped_snapshot.RecordsCount();
+        vector<pair<size_t, Record>> records(records_count);
+        parallel_tasks::RunInParallel(worker_pool_, load_threads_count_, load_threads_count_, [&](size_t task_index) {
+            const size_t begin = records_count * task_index / load_threads_count_;
+            const size_t end = records_count * (task_index + 1) / load_threads_count_;
+            for (size_t i = begin; i < end; ++i) {
+                const database_snapshot::RecordView record = mapped_snapshot.GetRecord(i);
+                records[i] = {record.id, Record{string(record.name), string(record.surname), string(record.patronymic),
+                                                string(record.number), string(record.note)}};
+            }
+        });
+
+        // Сохранённые словари подходят, только если они сохранены базой данных без шардов для всех записей файла
+        optional<string_view> indexes;
+        for (const string_view section : mapped_snapshot.FindSections(database_snapshot::SectionType::INDEXES)) {
+            const optional<IndexesPlacement> placement = ReadIndexesPlacement(section);
+            if (placement && placement->shards_count == 1 && placement->first_record_index == 0
+                && placement->records_count == records_count) {
+                indexes = section;
+            }
+        }
+
+        if (!LoadRecords(records, mapped_snapshot.LastRecordId(), indexes)) {
+            cout << "[Indexes in \""s << database_file_name_ << "\" are missing or stale, they have been rebuilt]"s
+                 << endl;
+        }
+
+        // Информируем в консоль об успешной загрузке данных в базу из файла
+        cout << "[Data from \""s << database_file_name_ << "\" has been loaded into the database]"s << endl;
+        return;
+    }
 
-    // Открываем файл для чтения
-    ifstream database_file(database_file_name_);
+    // Далее - загрузка файла в прежнем текстовом формате (разбирается параллельно)
+    optional<TextFileRecords> text_file = ParseTextFile(database_file_name_, worker_pool_);
 
     // Если файла с базой данных нету
-    if(!database_file) {
+    if (!text_file) {
 
         // Информируем в консоль о невозможности открыть файл с базой данных,
         // будем работать с пустой базой данных (нужно для первого запуска сервера)
         cout << "[Can't open \""s << database_file_name_ << "\", database is empty]"s << endl;
 
-        // Номером/id последней записи будет id = 0 (т.е. записей ещё нету)
-        last_record_id_ = 0;
-
-        // На этом всё
+        // Публикуем пустую версию базы данных (номером/id последней записи будет id = 0, т.е. записей ещё нету), на
+        // этом всё
+        PublishSnapshot(make_shared<Snapshot>());
         return;
     }
 
+    LoadRecords(text_file->records, text_file->last_record_id, nullopt);
+
+    // Информируем в консоль об успешной загрузке данных в базу из файла
+    cout << "[Data from \""s << database_file_name_ << "\" has been loaded into the database]"s << endl;
+}
+
+// Функция параллельного разбора файла в прежнем текстовом формате
+optional<PhoneBookDatabase::TextFileRecords> PhoneBookDatabase::ParseTextFile(
+    const string& file_name, parallel_tasks::WorkerPool& worker_pool) {
+    const size_t threads_count = worker_pool.ThreadsCount() + 1;
+
+    // Отображаем файл в память (если файл не удалось открыть, возвращаем nullopt)
+    unique_ptr<database_snapshot::MappedFile> file;
+    try {
+        file = make_unique<database_snapshot::MappedFile>(file_name);
+    } catch (const exception&) {
+        return nullopt;
+    }
+    string_view text = file->Data();
+
+    TextFileRecords result;
+
+    // Разбираем первую строку с информацией о числе записей в базе данных и номере/id последней записи (в пустом
+    // файле записей нет)
+    const size_t info_end = text.find('\n');
+    const string_view info_line = text.substr(0, info_end);
+    if (info_line.empty()) {
+        return result;
+    }
+    const auto [records_count, last_record_id] = string_functions::ParseInfoStringFromFile(info_line);
+    result.last_record_id = last_record_id;
+    text.remove_prefix(info_end == text.npos ? text.size() : info_end + 1);
+
     // Замечание: для того, чтобы избежать проблемы с кавычками в имени/фамилии/отчестве/номере телефона/заметке,
-    // при сохранении данных из базы в файл все кавычки заменяются на "&quot;", а при чтении данных из файла в
-    // базу данных последовательности "&quot;" заменяются обратно на кавычки
+    // при сохранении данных в текстовый файл все кавычки заменялись на "&quot;", а при чтении данных из файла в
+    // базу данных последовательности "&quot;" заменяются обратно на кавычки (только в полях с символом '&')
+
+    // Делим остаток файла на части по границам строк и разбираем каждую часть в своём потоке
+    const vector<string_view> chunks = string_functions::SplitIntoLineChunks(text, threads_count);
+    vector<vector<pair<size_t, Record>>> chunks_records(chunks.size());
+
+    parallel_tasks::RunInParallel(worker_pool, chunks.size(), threads_count, [&](size_t chunk_index) {
+        string_view chunk = chunks[chunk_index];
+        vector<pair<size_t, Record>>& records = chunks_records[chunk_index];
+
+        string_functions::RecordStringFields fields;
+        while (!chunk.empty()) {
+            const size_t line_end = chunk.find('\n');
+            const string_view line = chunk.substr(0, line_end);
+            chunk.remove_prefix(line_end == chunk.npos ? chunk.size() : line_end + 1);
+
+            if (!string_functions::ParseRecordStringView(line, fields)) {
+                continue;
+            }
+            records.emplace_back(fields.id, Record{string_functions::UnescapeRecordField(fields.name),
+                                                   string_functions::UnescapeRecordField(fields.surname),
+                                                   string_functions::UnescapeRecordField(fields.patronymic),
+                                                   string_functions::UnescapeRecordField(fields.number),
+                                                   string_functions::UnescapeRecordField(fields.note)});
+        }
+    });
+
+    // Объединяем записи частей в порядке файла (не более числа записей из первой строки файла, как и при построчной
+    // загрузке)
+    size_t parsed_count = 0;
+    for (const auto& records : chunks_records) {
+        parsed_count += records.size();
+    }
+    result.records.reserve(min(parsed_count, records_count));
+
+    for (auto& records : chunks_records) {
+        for (auto& record : records) {
+            if (result.records.size() == records_count) {
+                return result;
+            }
+            result.records.push_back(move(record));
+        }
+        records.clear();
+        records.shrink_to_fit();
+    }
+
+    return result;
+}
+
+// Функция загрузки в базу данных записей из файла
+bool PhoneBookDatabase::LoadRecords(vector<pair<size_t, Record>>& records, size_t last_record_id,
+                                    optional<string_view> indexes) {
+
+    // Отбираем записи в порядке файла так же, как шардированная база данных: вначале из записей с одинаковым номером
+    // телефона принимается первая, затем из принятых записей с одинаковым номером/id - первая
+    // (string_view ссылаются на номера телефонов записей, поэтому записи перемещаются только после отбора)
+    vector<char> accepted(records.size(), 0);
+    {
+        unordered_set<string_view> numbers;
+        numbers.reserve(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            accepted[i] = numbers.insert(records[i].second.number).second;
+        }
+    }
+    {
+        unordered_set<size_t> records_ids;
+        records_ids.reserve(records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            if (accepted[i]) {
+                accepted[i] = records_ids.insert(records[i].first).second;
+            }
+
+            // Номер/id последней записи не должен быть меньше номера/id загруженной записи
+            if (accepted[i]) {
+                last_record_id = max(last_record_id, records[i].first);
+            }
+        }
+    }
 
-    // Буферная строка
-    string buffer;
+    size_t accepted_count = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (accepted[i]) {
+            if (accepted_count != i) {
+                records[accepted_count] = move(records[i]);
+            }
+            ++accepted_count;
+        }
+    }
+
+    // Сохранённые словари перечисляют записи в порядке таблицы записей файла, поэтому после отбрасывания записей они
+    // не подходят
+    if (accepted_count != records.size()) {
+        indexes = nullopt;
+    }
+    records.resize(accepted_count);
 
-    // Читаем в буфер первую строку с информацией о числе записей в базе данных и номере/id последней записи
-    getline(database_file, buffer);
+    // Новая версия базы данных строится из данных файла целиком и публикуется
+    // (читатели до момента публикации продолжают работать с предыдущей версией)
+    auto snapshot = make_shared<Snapshot>();
+    const bool indexes_loaded = BuildSnapshot(*snapshot, records, indexes, worker_pool_);
+    snapshot->last_record_id = last_record_id;
 
-    // Парсим строку с информацией о числе записей в базе данных и номере/id последней записи
-    auto database_info = string_functions::ParseInfoStringFromFile(buffer);
+    PublishSnapshot(move(snapshot));
 
-    // Записываем число записей в базе данных 
-    size_t number_of_records = database_info.first;
+    return indexes_loaded;
+}
 
-    // Записываем номер/id последней записи
-    last_record_id_ = database_info.second;
+// Функция загрузки в базу данных записей из файла вместе с сохранёнными словарями
+bool PhoneBookDatabase::LoadFileRecords(vector<pair<size_t, Record>>& records, optional<string_view> indexes) {
 
-    // В цикле читаем все записи из файла
-    for(size_t i = 0; i < number_of_records; ++i) {
+    // Захватываем mutex писателей
+    lock_guard lock(writer_mutex_);
 
-        // Читаем в буфер очередную строку с очередной записью для базы данных
-        getline(database_file, buffer);
+    // Номер/id последней записи - наибольший номер/id загруженной записи
+    size_t last_record_id = 0;
+    for (const auto& [record_id, record] : records) {
+        last_record_id = max(last_record_id, record_id);
+    }
 
-        // Парсим строку с очередной записью для базы данных
-        auto record_info = string_functions::ParseRecordStringFromFile(buffer);
+    auto snapshot = make_shared<Snapshot>();
+    const bool indexes_loaded = BuildSnapshot(*snapshot, records, indexes, worker_pool_);
+    snapshot->last_record_id = last_record_id;
 
-        // Номер/id записи, которую необходимо добавить
-        size_t record_id = get<0>(record_info);
+    PublishSnapshot(move(snapshot));
 
-        // Запись, которую необходимо добавить
-        Record record({get<1>(record_info), get<2>(record_info), get<3>(record_info), get<4>(record_info), get<5>(record_info)});
+    return indexes_loaded;
+}
 
-        // Добавляем запись в базу данных
-        AddRecordById(record_id, record);
+// Функция построения ещё не опубликованной пустой версии базы данных из записей
+bool PhoneBookDatabase::BuildSnapshot(Snapshot& snapshot, vector<pair<size_t, Record>>& records,
+                                      optional<string_view> indexes, parallel_tasks::WorkerPool& worker_pool) {
+    const size_t threads_count = worker_pool.ThreadsCount() + 1;
+    const size_t records_count = records.size();
+
+    // Создаём записи в heap'е (параллельно, по равной части записей на поток): ключами словарей служат строки этих
+    // записей
+    vector<pair<size_t, shared_ptr<const Record>>> stored_records(records_count);
+    parallel_tasks::RunInParallel(worker_pool, threads_count, threads_count, [&](size_t task_index) {
+        const size_t begin = records_count * task_index / threads_count;
+        const size_t end = records_count * (task_index + 1) / threads_count;
+        for (size_t i = begin; i < end; ++i) {
+            stored_records[i] = {records[i].first, make_shared<const Record>(move(records[i].second))};
+        }
+    });
+
+    // Загружаем сохранённые словари, а если их нет или они не соответствуют записям, строим словари заново в чистой
+    // версии (недостроенная из сохранённых словарей версия отбрасывается)
+    if (indexes && AddRecordsFromIndexes(snapshot, stored_records, *indexes, worker_pool)) {
+        return true;
     }
 
-    // Закрываем файл
-    database_file.close();
-    
-    // Информируем в консоль об успешной загрузке данных в базу из файла
-    cout << "[Data from \""s << database_file_name_ << "\" has been loaded into the database]"s << endl;
+    snapshot = Snapshot();
+    AddRecordsInParallel(snapshot, stored_records, worker_pool);
+    return false;
+}
+
+// Функция построения словарей ещё не опубликованной пустой версии базы данных по записям в heap'е
+void PhoneBookDatabase::AddRecordsInParallel(Snapshot& snapshot,
+                                             const vector<pair<size_t, shared_ptr<const Record>>>& records,
+                                             parallel_tasks::WorkerPool& worker_pool) {
+    const size_t threads_count = worker_pool.ThreadsCount() + 1;
+    const size_t records_count = records.size();
+
+    // Этап 1 (параллельно по равной части записей на поток): вычисляем частоты TF слов в заметках и строим векторы
+    // слов в заметках (по возрастанию, как и ключи словаря частот)
+    vector<shared_ptr<const vector<string_view>>> records_note_words(records_count);
+    vector<vector<double>> records_note_freqs(records_count);
+    vector<size_t> note_lengths(records_count);
+
+    parallel_tasks::RunInParallel(worker_pool, threads_count, threads_count, [&](size_t task_index) {
+        const size_t begin = records_count * task_index / threads_count;
+        const size_t end = records_count * (task_index + 1) / threads_count;
+        for (size_t i = begin; i < end; ++i) {
+            const map<string_view, double> word_to_freq = ComputeNoteWordsFreqs(records[i].second->note,
+                                                                                note_lengths[i]);
+            auto note_words = make_shared<vector<string_view>>();
+            note_words->reserve(word_to_freq.size());
+            records_note_freqs[i].reserve(word_to_freq.size());
+            for (const auto& [word, term_freq] : word_to_freq) {
+                note_words->push_back(word);
+                records_note_freqs[i].push_back(term_freq);
+            }
+            records_note_words[i] = move(note_words);
+        }
+    });
+
+    // Функция построения словаря index "Имя/Фамилия/Отчество -> Номера/id записей" по полю field записей (номера/id
+    // группируются по ключам, чтобы каждый ключ искался в словаре лишь однократно)
+    const auto build_field_index = [&](IndexMap<string_view, persistent_map::PersistentSet<size_t>>& index,
+                                       const string Record::*field) {
+        unordered_map<string_view, vector<size_t>> groups;
+        for (size_t i = 0; i < records_count; ++i) {
+            groups[(*records[i].second).*field].push_back(records[i].first);
+        }
+        for (const auto& [key, records_ids] : groups) {
+            index[key].InsertBatch(records_ids);
+        }
+    };
+
+    // Этап 2: каждый словарь версии строится в своей задаче (задачи изменяют разные члены версии, поэтому могут
+    // выполняться параллельно без блокировок)
+    parallel_tasks::RunInParallel(worker_pool, 5, threads_count, [&](size_t task_index) {
+        switch (task_index) {
+
+        // Словари "Номер/id записи -> записи" и "Номер телефона -> Номер/id записи"
+        case 0: {
+            vector<pair<const size_t, shared_ptr<const Record>>> records_values;
+            vector<pair<const string_view, size_t>> numbers_values;
+            records_values.reserve(records_count);
+            numbers_values.reserve(records_count);
+            for (size_t i = 0; i < records_count; ++i) {
+                records_values.emplace_back(records[i].first, records[i].second);
+                numbers_values.emplace_back(records[i].second->number, records[i].first);
+            }
+            snapshot.records.InsertBatch(records_values);
+            snapshot.number_to_record.InsertBatch(numbers_values);
+            break;
+        }
+
+        // Словари "Имя/Фамилия/Отчество -> Номера/id записей"
+        case 1:
+            build_field_index(snapshot.name_to_records, &Record::name);
+            break;
+        case 2:
+            build_field_index(snapshot.surname_to_records, &Record::surname);
+            break;
+        case 3:
+            build_field_index(snapshot.patronymic_to_records, &Record::patronymic);
+            break;
+
+        // Словари "Номер/id записи -> Слова в заметках" и "Слово в заметках -> Список записей слова" и длины заметок
+        default: {
+            vector<pair<const size_t, shared_ptr<const vector<string_view>>>> note_words_values;
+            note_words_values.reserve(records_count);
+            unordered_map<string_view, vector<pair<size_t, double>>> note_word_groups;
+
+            for (size_t i = 0; i < records_count; ++i) {
+                const size_t record_id = records[i].first;
+                const vector<string_view>& note_words = *records_note_words[i];
+                for (size_t j = 0; j < note_words.size(); ++j) {
+                    note_word_groups[note_words[j]].emplace_back(record_id, records_note_freqs[i][j]);
+                }
+                AddNoteLength(snapshot, record_id, note_lengths[i]);
+                note_words_values.emplace_back(record_id, records_note_words[i]);
+            }
+
+            snapshot.record_to_note_words.InsertBatch(note_words_values);
+            for (auto& [word, records_freqs] : note_word_groups) {
+                persistent_map::CopyOnWrite(snapshot.note_word_to_postings[word]).InsertBatch(move(records_freqs));
+            }
+            break;
+        }
+        }
+    });
+}
+
+// Функция чтения расположения словарей из заголовка секции сохранённых словарей
+optional<PhoneBookDatabase::IndexesPlacement> PhoneBookDatabase::ReadIndexesPlacement(string_view indexes) {
+    uint32_t version = 0, reserved = 0;
+    uint64_t shards_count = 0, shard_index = 0, first_record_index = 0, records_count = 0;
+    if (indexes.size() < INDEXES_HEADER_SIZE || !ReadFixed32(indexes, version) || version != INDEXES_FORMAT_VERSION) {
+        return nullopt;
+    }
+    ReadFixed32(indexes, reserved);
+    ReadFixed64(indexes, shards_count);
+    ReadFixed64(indexes, shard_index);
+    ReadFixed64(indexes, first_record_index);
+    ReadFixed64(indexes, records_count);
+
+    return IndexesPlacement{shards_count, shard_index, first_record_index, records_count};
+}
+
+// Функция загрузки словарей ещё не опубликованной пустой версии базы данных из сохранённых словарей
+bool PhoneBookDatabase::AddRecordsFromIndexes(Snapshot& snapshot,
+                                              const vector<pair<size_t, shared_ptr<const Record>>>& records,
+                                              string_view indexes, parallel_tasks::WorkerPool& worker_pool) {
+    const size_t threads_count = worker_pool.ThreadsCount() + 1;
+    const size_t records_count = records.size();
+
+    // Индексы записей в секции отсчитываются от первой записи базы данных/шарда, поэтому число записей в заголовке
+    // должно совпадать с числом переданных записей
+    const optional<IndexesPlacement> placement = ReadIndexesPlacement(indexes);
+    const optional<IndexesParts> parts = SplitIndexesParts(indexes);
+    if (!placement || !parts || placement->records_count != records_count) {
+        return false;
+    }
+
+    // Функция загрузки словаря index "Имя/Фамилия/Отчество -> Номера/id записей" по полю field записей из части part:
+    // ключ каждой группы - строка поля записи с указанным индексом, а поле каждой записи группы должно совпадать с ним
+    const auto load_field_index = [&](IndexMap<string_view, persistent_map::PersistentSet<size_t>>& index,
+                                      const string Record::*field, string_view part) {
+        uint64_t groups_count = 0;
+        if (!ReadFixed64(part, groups_count)) {
+            return false;
+        }
+
+        // Каждая запись должна входить ровно в одну группу (иначе удаление записи не нашло бы её в словаре)
+        vector<char> listed_records(records_count, 0);
+        size_t listed_records_count = 0;
+        vector<size_t> records_ids;
+        for (uint64_t i = 0; i < groups_count; ++i) {
+            uint32_t key_index = 0, group_size = 0;
+            if (!ReadFixed32(part, key_index) || !ReadFixed32(part, group_size) || key_index >= records_count
+                || group_size > part.size() / 4) {
+                return false;
+            }
+            const string_view key = (*records[key_index].second).*field;
+
+            records_ids.clear();
+            for (uint32_t j = 0; j < group_size; ++j) {
+                uint32_t record_index = 0;
+                ReadFixed32(part, record_index);
+                if (record_index >= records_count || listed_records[record_index]
+                    || (*records[record_index].second).*field != key) {
+                    return false;
+                }
+                listed_records[record_index] = 1;
+                ++listed_records_count;
+                records_ids.push_back(records[record_index].first);
+            }
+            index[key].InsertBatch(records_ids);
+        }
+
+        return part.empty() && listed_records_count == records_count;
+    };
+
+    // Функция загрузки словарей "Слово в заметках -> Список записей слова" и "Номер/id записи -> Слова в заметках" и
+    // длин заметок из словаря терминов terms_part и слов заметок записей words_part
+    const auto load_note_indexes = [&](string_view terms_part, string_view words_part) {
+        uint64_t terms_count = 0;
+        if (!ReadFixed64(terms_part, terms_count) || terms_count > terms_part.size() / 12) {
+            return false;
+        }
+
+        // Слово словаря терминов ссылается на заметку одной из записей, где оно встречается, а список записей слова
+        // восстанавливается из сжатых блоков как есть
+        vector<string_view> terms;
+        vector<pair<const string_view, shared_ptr<const posting_list::PostingList>>> postings_values;
+        terms.reserve(terms_count);
+        postings_values.reserve(terms_count);
+        for (uint64_t i = 0; i < terms_count; ++i) {
+            uint32_t record_index = 0, offset = 0, length = 0;
+            if (!ReadFixed32(terms_part, record_index) || !ReadFixed32(terms_part, offset)
+                || !ReadFixed32(terms_part, length) || record_index >= records_count) {
+                return false;
+            }
+            const string_view note = records[record_index].second->note;
+            if (length == 0 || offset > note.size() || length > note.size() - offset) {
+                return false;
+            }
+
+            optional<posting_list::PostingList> postings = posting_list::PostingList::Deserialize(terms_part);
+            if (!postings || postings->empty()) {
+                return false;
+            }
+
+            terms.push_back(note.substr(offset, length));
+            postings_values.emplace_back(terms.back(), make_shared<const posting_list::PostingList>(move(*postings)));
+        }
+        if (!terms_part.empty()) {
+            return false;
+        }
+
+        // Слова заметки записи ссылаются на её собственную заметку (тогда при удалении записи ключи словаря терминов
+        // перевешиваются так же, как и для добавленных по одной записей) и идут по возрастанию. Индексы терминов слов
+        // запоминаются (слова i-й записи - words_terms[words_starts[i]], ..., words_terms[words_starts[i + 1] - 1]),
+        // чтобы затем сверить их со списками записей слов
+        vector<pair<const size_t, shared_ptr<const vector<string_view>>>> note_words_values;
+        vector<uint32_t> words_terms;
+        vector<size_t> words_starts;
+        note_words_values.reserve(records_count);
+        words_starts.reserve(records_count + 1);
+        for (size_t i = 0; i < records_count; ++i) {
+            words_starts.push_back(words_terms.size());
+            uint32_t note_length = 0, words_count = 0;
+            if (!ReadFixed32(words_part, note_length) || !ReadFixed32(words_part, words_count)
+                || words_count > words_part.size() / 8) {
+                return false;
+            }
+
+            const string_view note = records[i].second->note;
+            auto note_words = make_shared<vector<string_view>>();
+            note_words->reserve(words_count);
+            for (uint32_t j = 0; j < words_count; ++j) {
+                uint32_t term_index = 0, offset = 0;
+                ReadFixed32(words_part, term_index);
+                ReadFixed32(words_part, offset);
+                if (term_index >= terms.size()) {
+                    return false;
+                }
+
+                const string_view term = terms[term_index];
+                if (offset > note.size() || term.size() > note.size() - offset) {
+                    return false;
+                }
+                const string_view word = note.substr(offset, term.size());
+                if (word != term || (!note_words->empty() && !(note_words->back() < word))) {
+                    return false;
+                }
+
+                note_words->push_back(word);
+                words_terms.push_back(term_index);
+            }
+
+            AddNoteLength(snapshot, records[i].first, note_length);
+            note_words_values.emplace_back(records[i].first, move(note_words));
+        }
+        if (!words_part.empty()) {
+            return false;
+        }
+
+        words_starts.push_back(words_terms.size());
+
+        // Список записей каждого слова должен состоять ровно из записей, в заметках которых встречается слово: записи
+        // обходятся по возрастанию номеров/id, тогда номер/id каждой записи должен быть текущим в курсорах списков
+        // всех её слов (курсоры только продвигаются вперёд), а в конце все курсоры должны дойти до конца списков
+        vector<size_t> records_indices_by_id(records_count);
+        iota(records_indices_by_id.begin(), records_indices_by_id.end(), size_t{0});
+        sort(records_indices_by_id.begin(), records_indices_by_id.end(), [&records](size_t lhs, size_t rhs) {
+            return records[lhs].first < records[rhs].first;
+        });
+
+        vector<posting_list::PostingList::Cursor> cursors;
+        cursors.reserve(terms.size());
+        for (const auto& [term, postings] : postings_values) {
+            cursors.push_back(postings->OpenCursor());
+        }
+        for (size_t record_index : records_indices_by_id) {
+            const size_t record_id = records[record_index].first;
+            for (size_t j = words_starts[record_index]; j < words_starts[record_index + 1]; ++j) {
+                posting_list::PostingList::Cursor& cursor = cursors[words_terms[j]];
+                if (!cursor.HasPosting() || cursor.RecordId() != record_id) {
+                    return false;
+                }
+                cursor.Next();
+            }
+        }
+        if (any_of(cursors.begin(), cursors.end(), [](const posting_list::PostingList::Cursor& cursor) {
+                return cursor.HasPosting();
+            })) {
+            return false;
+        }
+
+        // Слова словаря терминов не должны повторяться
+        snapshot.note_word_to_postings.InsertBatch(postings_values);
+        snapshot.record_to_note_words.InsertBatch(note_words_values);
+        return snapshot.note_word_to_postings.size() == terms.size();
+    };
+
+    // Каждый словарь версии загружается в своей задаче (задачи изменяют разные члены версии, поэтому могут выполняться
+    // параллельно без блокировок), флаги успешной загрузки - char, а не bool, чтобы потоки писали в разные байты
+    vector<char> loaded(5, 0);
+    parallel_tasks::RunInParallel(worker_pool, 5, threads_count, [&](size_t task_index) {
+        switch (task_index) {
+
+        // Словари "Номер/id записи -> записи" и "Номер телефона -> Номер/id записи" строятся прямо из записей
+        // (номера/id и номера телефонов должны быть уникальными, иначе запись заменила бы в словаре предыдущую)
+        case 0: {
+            vector<pair<const size_t, shared_ptr<const Record>>> records_values;
+            vector<pair<const string_view, size_t>> numbers_values;
+            records_values.reserve(records_count);
+            numbers_values.reserve(records_count);
+            for (const auto& [record_id, record] : records) {
+                records_values.emplace_back(record_id, record);
+                numbers_values.emplace_back(record->number, record_id);
+            }
+            snapshot.records.InsertBatch(records_values);
+            snapshot.number_to_record.InsertBatch(numbers_values);
+            loaded[task_index] = snapshot.records.size() == records_count
+                                 && snapshot.number_to_record.size() == records_count;
+            break;
+        }
+
+        // Словари "Имя/Фамилия/Отчество -> Номера/id записей"
+        case 1:
+            loaded[task_index] = load_field_index(snapshot.name_to_records, &Record::name, (*parts)[0]);
+            break;
+        case 2:
+            loaded[task_index] = load_field_index(snapshot.surname_to_records, &Record::surname, (*parts)[1]);
+            break;
+        case 3:
+            loaded[task_index] = load_field_index(snapshot.patronymic_to_records, &Record::patronymic, (*parts)[2]);
+            break;
+
+        // Словари "Слово в заметках -> Список записей слова" и "Номер/id записи -> Слова в заметках" и длины заметок
+        default:
+            loaded[task_index] = load_note_indexes((*parts)[3], (*parts)[4]);
+            break;
+        }
+    });
+
+    return all_of(loaded.begin(), loaded.end(), [](char task_loaded) {
+        return task_loaded != 0;
+    });
+}
+
+// Функция фиксации текущей версии базы данных для сохранения в файл
+PhoneBookDatabase::CapturedSnapshot PhoneBookDatabase::CaptureSnapshot() const {
+    return CapturedSnapshot(CurrentSnapshot());
+}
+
+// Функция добавления всех записей зафиксированной версии в писатель файла
+void PhoneBookDatabase::CapturedSnapshot::WriteRecords(database_snapshot::SnapshotWriter& writer) const {
+
+    // Порядок записей в файле не важен, так как номер/id сохраняется вместе с каждой записью, но секция словарей
+    // ссылается на записи по индексу в порядке обхода словаря записей
+    for (const auto& [record_id, record] : snapshot_->records) {
+        writer.AddRecord(record_id, record->name, record->surname, record->patronymic, record->number, record->note);
+    }
+}
+
+// Функция сериализации словарей зафиксированной версии в содержимое секции INDEXES
+string PhoneBookDatabase::CapturedSnapshot::SerializeIndexes(size_t shards_count, size_t shard_index,
+                                                             size_t first_record_index) const {
+    const Snapshot& snapshot = *snapshot_;
+    const size_t records_count = snapshot.records.size();
+
+    if (records_count > numeric_limits<uint32_t>::max()
+        || snapshot.note_word_to_postings.size() > numeric_limits<uint32_t>::max()) {
+        throw length_error("Too many records or note words for indexes section"s);
+    }
+
+    // Индексы записей в порядке обхода словаря записей (в этом же порядке записи добавляет в файл WriteRecords)
+    unordered_map<size_t, uint32_t> records_indices;
+    records_indices.reserve(records_count);
+    for (const auto& [record_id, record] : snapshot.records) {
+        records_indices.emplace(record_id, static_cast<uint32_t>(records_indices.size()));
+    }
+
+    // Заголовок (смещения частей дописываются в конце, когда они станут известны)
+    string data;
+    AppendFixed32(data, INDEXES_FORMAT_VERSION);
+    AppendFixed32(data, 0);
+    AppendFixed64(data, shards_count);
+    AppendFixed64(data, shard_index);
+    AppendFixed64(data, first_record_index);
+    AppendFixed64(data, records_count);
+    const size_t offsets_position = data.size();
+    data.resize(INDEXES_HEADER_SIZE, '\0');
+
+    array<uint64_t, INDEXES_PARTS_COUNT> offsets;
+
+    // Части 0-2: группы словарей "Имя/Фамилия/Отчество -> Номера/id записей" (ключ - поле первой записи группы)
+    const auto write_field_index = [&](const IndexMap<string_view, persistent_map::PersistentSet<size_t>>& index) {
+        AppendFixed64(data, index.size());
+        for (const auto& [key, records_ids] : index) {
+            AppendFixed32(data, records_indices.at(*records_ids.begin()));
+            AppendFixed32(data, static_cast<uint32_t>(records_ids.size()));
+            for (const size_t record_id : records_ids) {
+                AppendFixed32(data, records_indices.at(record_id));
+            }
+        }
+    };
+    offsets[0] = data.size();
+    write_field_index(snapshot.name_to_records);
+    offsets[1] = data.size();
+    write_field_index(snapshot.surname_to_records);
+    offsets[2] = data.size();
+    write_field_index(snapshot.patronymic_to_records);
+
+    // Часть 3: словарь терминов - слово (как место в заметке записи с наименьшим номером/id из его списка, слова
+    // заметки упорядочены, поэтому ищем его бинарным поиском) и его список записей слова
+    offsets[3] = data.size();
+    unordered_map<string_view, uint32_t> terms_indices;
+    terms_indices.reserve(snapshot.note_word_to_postings.size());
+    AppendFixed64(data, snapshot.note_word_to_postings.size());
+    for (const auto& [word, postings] : snapshot.note_word_to_postings) {
+        const size_t record_id = postings->FirstRecordId();
+        const string& note = snapshot.records.at(record_id)->note;
+        const vector<string_view>& note_words = *snapshot.record_to_note_words.at(record_id);
+        const string_view note_word = *lower_bound(note_words.begin(), note_words.end(), word);
+
+        AppendFixed32(data, records_indices.at(record_id));
+        AppendFixed32(data, static_cast<uint32_t>(note_word.data() - note.data()));
+        AppendFixed32(data, static_cast<uint32_t>(note_word.size()));
+        postings->Serialize(data);
+
+        terms_indices.emplace(word, static_cast<uint32_t>(terms_indices.size()));
+    }
+
+    // Часть 4: длина заметки и слова заметки каждой записи (номер слова в словаре терминов и смещение в заметке)
+    offsets[4] = data.size();
+    for (const auto& [record_id, record] : snapshot.records) {
+        const vector<string_view>& note_words = *snapshot.record_to_note_words.at(record_id);
+        AppendFixed32(data, snapshot.note_lengths.Get(record_id));
+        AppendFixed32(data, static_cast<uint32_t>(note_words.size()));
+        for (const string_view word : note_words) {
+            AppendFixed32(data, terms_indices.at(word));
+            AppendFixed32(data, static_cast<uint32_t>(word.data() - record->note.data()));
+        }
+    }
+
+    string offsets_data;
+    for (const uint64_t offset : offsets) {
+        AppendFixed64(offsets_data, offset);
+    }
+    data.replace(offsets_position, offsets_data.size(), offsets_data);
+
+    return data;
 }
 
 // Функция сохранения данных из базы в файл
 void PhoneBookDatabase::SaveToFile() const {
 
+    // Фиксируем текущую версию базы данных, она и будет сохранена в файл целиком, даже если
+    // во время сохранения писатели опубликуют новые версии
+    const CapturedSnapshot snapshot = CaptureSnapshot();
+
     // Информируем в консоль о начале сохранения данных из базы в файл
     cout << "[Starting saving data from database to \""s << database_file_name_ << "\" ...]"s << endl;
 
-    // Открываем файл для записи
-    ofstream database_file(database_file_name_);
-
-    // Замечание: для того, чтобы избежать проблемы с кавычками в имени/фамилии/отчестве/номере телефона/заметке,
-    // при сохранении данных из базы в файл все кавычки заменяются на "&quot;", а при чтении данных из файла в
-    // базу данных последовательности "&quot;" заменяются обратно на кавычки
+    // Записываем данные во временный файл в двоичном формате (поля записей пишутся как есть, без экранирования
+    // кавычек) и заменяем им прежний файл базы данных, который остаётся целым, если новый не удалось записать
+    const string temporary_file_name = database_file_name_ + ".tmp"s;
+    try {
+        database_snapshot::SnapshotWriter writer(temporary_file_name, snapshot.RecordsCount(), snapshot.LastRecordId());
 
-    // Записываем информацию о числе записей в базе данных и номере/id последней записи
-    database_file << string_functions::PackInfoStringForFile(records_.size(), last_record_id_) << endl;
+        // Записываем каждую запись из базы данных в файл, а за записями - словари версии
+        snapshot.WriteRecords(writer);
+        writer.AddSection(database_snapshot::SectionType::INDEXES, snapshot.SerializeIndexes(1, 0, 0));
 
-    // Записываем каждую запись и базы данных в файл
-    for(const auto& [record_id, record] : records_) {
-        database_file << string_functions::PackRecordStringForFile(record_id,
-                                                                   record.name,
-                                                                   record.surname,
-                                                                   record.patronymic,
-                                                                   record.number,
-                                                                   record.note) << endl;
+        writer.Finish();
+        filesystem::rename(temporary_file_name, database_file_name_);
+    } catch (const exception& e) {
+        cout << "[Can't save data to \""s << database_file_name_ << "\": "s << e.what() << "]"s << endl;
+        return;
     }
 
-    // Закрываем файл
-    database_file.close();
-
     // Информируем в консоль об успешном сохранении данных из базы в файл
     cout << "[Data from database has been saved to \""s << database_file_name_ << "\"]"s << endl;
 }
 
-// Функция добавления записи с фиксированным номером/id
+// Функция вычисления частот TF всех различных слов в заметке note
+// (возвращает словарь "Слово в заметке -> Частота TF", string_view ссылаются на строку note)
+map<string_view, double> PhoneBookDatabase::ComputeNoteWordsFreqs(string_view note, size_t& note_length) {
+
+    // Вычислим TF (Term Frequency) каждого слова в заметке по формуле:
+    //
+    // TF = Число вхождений (упоминаний) слова в заметке / Число слов в заметке
+    // (https://ru.wikipedia.org/wiki/TF-IDF)
+
+    // Вначале разделим заметку в записи на отдельные слова через символы-сепараторы
+    // (знаки препинания ".", "?", "!", ".", ":", ",", ";", кавычки, скобки "()", "[]", "{}" и пробел " ")
+    vector<string_view> note_words = string_functions::SplitIntoWords(note);
+
+    // Длина заметки в словах (нужна для ранжирования по BM25)
+    note_length = note_words.size();
+
+    // Словарь "Слово в заметке -> Частота TF". Частоты вначале накапливаются в нём, чтобы вложенный словарь
+    // частот каждого слова в версии базы данных копировался лишь однократно, даже если слово встречается в
+    // заметке несколько раз
+    map<string_view, double> word_to_freq;
+
+    // Пробежимся по всем словам в заметке записи и посчитаем число вхождений каждого слова (счётчики целые и
+    // хранятся в double точно)
+    for (string_view word : note_words) {
+        word_to_freq[word] += 1.0;
+    }
+
+    // Делим числа вхождений на число слов в заметке одним делением: равные дроби (например, 3 / 6 и 6 / 12) дают
+    // одинаковую частоту TF до последнего бита, тогда как сумма шести слагаемых 1 / 12 отличается от 0.5 в последнем
+    // бите, и после квантования частоты такие записи получали бы разную релевантность
+    const double word_count = static_cast<double>(note_words.size());
+    for (auto& [word, term_freq] : word_to_freq) {
+        term_freq /= word_count;
+    }
+
+    return word_to_freq;
+}
+
+// Функция внесения длины заметки записи в версию базы данных
+void PhoneBookDatabase::AddNoteLength(Snapshot& snapshot, size_t record_id, size_t note_length) {
+
+    // Длина заметки хранится в 2 байтах, поэтому очень длинные заметки считаются заметками наибольшей хранимой длины
+    const auto stored_note_length = static_cast<uint16_t>(min(note_length, MAX_NOTE_LENGTH));
+
+    snapshot.note_lengths.Set(record_id, stored_note_length);
+    snapshot.notes_length += stored_note_length;
+    snapshot.max_note_length = max(snapshot.max_note_length, stored_note_length);
+}
+
+// Функция добавления записи с фиксированным номером/id в ещё не опубликованную версию базы данных
 // (возвращает код ответа: 0 - запись с таким номером телефона уже существует,
 //                         1 - запись успешно добавлена)
-size_t PhoneBookDatabase::AddRecordById(size_t record_id, const Record& record) {
+size_t PhoneBookDatabase::AddRecordById(Snapshot& snapshot, size_t record_id, const Record& record) {
 
     // Если запись с таким номером телефона уже существует в базе данных, возвращаем код ответа - 0
-    if(number_to_record_.count(record.number)) {
+    if(snapshot.number_to_record.count(record.number)) {
         return 0;
     }
 
-    // Добавляем данные в словарь "Номер/id записи -> записи"
-    // (именно в этом контейнере хранятся строковые данные, в остальных лишь ссылки (string_view))
-    records_[record_id] = record;
+    // Создаём запись в heap'е и добавляем её в словарь "Номер/id записи -> записи" (именно в записях этого
+    // контейнера хранятся строковые данные, в остальных лишь ссылки (string_view)). Запись больше никогда не
+    // изменяется и будет разделяться всеми последующими версиями базы данных
+    shared_ptr<const Record> stored_record = make_shared<const Record>(record);
+    snapshot.records[record_id] = stored_record;
 
     // Для остальных словарей в качестве ключа важно использовать именно ту строку, на которую будет
-    // ссылаться string_view, т.е. строку из контейнера records_
+    // ссылаться string_view, т.е. строку из записи, лежащей в heap'е
 
     // Добавляем данные в словарь "Имя -> Номер/id записи" (для поиска записей по имени)
-    name_to_records_[records_[record_id].name].insert(record_id);
+    snapshot.name_to_records[stored_record->name].insert(record_id);
 
     // Добавляем данные в словарь "Фамилия -> Номер/id записи" (для поиска записей по фамилии)
-    surname_to_records_[records_[record_id].surname].insert(record_id);
+    snapshot.surname_to_records[stored_record->surname].insert(record_id);
 
     // Добавляем данные в словарь "Отчество -> Номер/id записи" (для поиска записей по отчеству)
-    patronymic_to_records_[records_[record_id].patronymic].insert(record_id);
+    snapshot.patronymic_to_records[stored_record->patronymic].insert(record_id);
 
     // Добавляем данные в словарь "Номер телефона -> Номер/id записи" (для поиска записей по номеру телефона)
-    number_to_record_[records_[record_id].number] = record_id;
+    snapshot.number_to_record[stored_record->number] = record_id;
 
     // Для поиска записей по содержимому заметки и получения выборки, ранжированной по TF-IDF,
-    // необходимо добавить данные о словах, содержащихся в заметке записи, для чего вычислим
-    // TF (Term Frequency) каждого слова в заметке записи по формуле:
-    //
-    // TF = Число вхождений (упоминаний) слова в заметке / Число слов в заметке
-    // (https://ru.wikipedia.org/wiki/TF-IDF)
-
-    // Вначале разделим заметку в записи на отдельные слова через символы-сепараторы
-    // (знаки препинания ".", "?", "!", ".", ":", ",", ";", кавычки, скобки "()", "[]", "{}" и пробел " ")
-    vector<string_view> note_words = string_functions::SplitIntoWords(records_[record_id].note);
+    // необходимо добавить данные о словах, содержащихся в заметке записи: вычисляем частоты TF
+    // каждого различного слова в заметке записи
+    size_t note_length = 0;
+    map<string_view, double> word_to_freq = ComputeNoteWordsFreqs(stored_record->note, note_length);
 
-    // Вычислим константу inv_word_count = 1 / Число слов в заметке
-    const double inv_word_count = 1.0 / static_cast<double>(note_words.size());
+    // Различные слова в заметке добавляемой записи (по возрастанию, как и ключи word_to_freq)
+    auto record_note_words = make_shared<vector<string_view>>();
+    record_note_words->reserve(word_to_freq.size());
 
-    // Пробежимся по всем словам в заметке записи
-    for (string_view word : note_words) {
+    // Пробежимся по всем различным словам в заметке записи
+    for (const auto& [word, term_freq] : word_to_freq) {
 
-        // Внесём данные с TF слова в словарь "Слово в заметках -> Номер/id записи -> Частота TF" следующим образом:
-        // будем добавлять каждый раз к значению TF слова (вначале инициализировано нулём) ранее вычисленную константу
-        // inv_word_count = 1 / Число слов в заметке
-        note_word_to_record_freqs_[word][record_id] += inv_word_count;
+        // Внесём данные с TF слова в список записей слова из словаря "Слово в заметках -> Список записей слова"
+        // (список копируется при записи, только если он разделяется с другими версиями, и то лишь частично)
+        persistent_map::CopyOnWrite(snapshot.note_word_to_postings[word]).Insert(record_id, term_freq);
 
-        // Также внесём слово в словарь "Номер/id записи -> Слова в заметках"
-        record_to_note_words_[record_id].insert(word);
+        // Также внесём слово в вектор слов в заметке записи
+        record_note_words->push_back(word);
     }
 
+    // Внесём вектор слов в заметке записи в словарь "Номер/id записи -> Слова в заметках"
+    snapshot.record_to_note_words[record_id] = move(record_note_words);
+
+    // Внесём длину заметки записи в массив длин заметок (для ранжирования по BM25)
+    AddNoteLength(snapshot, record_id, note_length);
+
     // Значение IDF (Inverse Document Frequency) будет вычисляться в момент
     // поиска записей по содержанию заметок
 
@@ -197,13 +966,23 @@ size_t PhoneBookDatabase::AddRecordById(size_t record_id, const Record& record)
 //                         1 - запись успешно добавлена)
 size_t PhoneBookDatabase::AddRecord(const Record& record) {
 
+    // Захватываем mutex писателей
+    lock_guard lock(writer_mutex_);
+
+    // Строим новую версию базы данных как копию текущей (копируются лишь внешние словари,
+    // записи и вложенные контейнеры разделяются с текущей версией)
+    auto snapshot = make_shared<Snapshot>(*CurrentSnapshot());
+
     // Пробуем добавить запись в базу данных с номером/id на 1 большим, чем последний номер/id записи в базе
 
     // Если запись успешно добавлена
-    if(AddRecordById(last_record_id_ + 1, record)) {
+    if(AddRecordById(*snapshot, snapshot->last_record_id + 1, record)) {
 
         // Икрементируем номер/id последней записи
-        ++last_record_id_;
+        ++snapshot->last_record_id;
+
+        // Публикуем новую версию базы данных
+        PublishSnapshot(move(snapshot));
 
         // Возвращаем код ответа - 1
         return 1;
@@ -211,33 +990,298 @@ size_t PhoneBookDatabase::AddRecord(const Record& record) {
     // Если запись не была добавлена (в базе данных уже есть запись с таким же телефонным номером)
     else {
 
-        // Возвращаем код ответа - 0
+        // Возвращаем код ответа - 0 (новая версия базы данных просто отбрасывается)
         return 0;
     }
 }
 
+// Функция добавления записи с заданным снаружи номером/id
+// (возвращает код ответа: 0 - запись с таким номером телефона или номером/id уже существует,
+//                         1 - запись успешно добавлена)
+size_t PhoneBookDatabase::AddRecordWithId(size_t record_id, const Record& record) {
+
+    // Захватываем mutex писателей
+    lock_guard lock(writer_mutex_);
+
+    // Если запись с таким номером/id уже существует в базе данных, возвращаем код ответа - 0
+    // (AddRecordById сам проверяет только номер телефона)
+    if(CurrentSnapshot()->records.count(record_id)) {
+        return 0;
+    }
+
+    // Строим новую версию базы данных как копию текущей
+    auto snapshot = make_shared<Snapshot>(*CurrentSnapshot());
+
+    // Если запись не была добавлена (в базе данных уже есть запись с таким же телефонным номером),
+    // возвращаем код ответа - 0 (новая версия базы данных просто отбрасывается)
+    if(!AddRecordById(*snapshot, record_id, record)) {
+        return 0;
+    }
+
+    // Номер/id последней записи не должен быть меньше номера/id добавленной записи
+    snapshot->last_record_id = max(snapshot->last_record_id, record_id);
+
+    // Публикуем новую версию базы данных
+    PublishSnapshot(move(snapshot));
+
+    // Возвращаем код ответа - 1
+    return 1;
+}
+
+// Функция проверки уникальности номеров телефонов пакета добавляемых записей за один проход
+// (возвращает вектор кодов ответа в порядке записей: 0 - запись с таким номером телефона уже существует в версии
+//  snapshot или встречается раньше в этом же пакете, 1 - запись можно добавить)
+vector<size_t> PhoneBookDatabase::CheckNewNumbers(const Snapshot& snapshot, const vector<const Record*>& records) {
+
+    // Вектор кодов ответа
+    vector<size_t> codes;
+    codes.reserve(records.size());
+
+    // Множество номеров телефонов, уже принятых в этом пакете
+    unordered_set<string_view> batch_numbers;
+    batch_numbers.reserve(records.size());
+
+    // Запись принимается, только если её номера телефона нет ни в базе данных, ни среди ранее принятых записей пакета
+    for (const Record* record : records) {
+        codes.push_back(!snapshot.number_to_record.count(record->number) && batch_numbers.insert(record->number).second);
+    }
+
+    return codes;
+}
+
+// Функция пакетного добавления уже проверенных записей с фиксированными номерами/id в ещё не опубликованную
+// версию базы данных (элементы всех словарей вначале собираются в векторы, а затем вставляются в словари версии
+// пакетно через InsertBatch: каждая корзина копируется лишь однократно на пакет, а ключи вставляются в неё по
+// возрастанию; записи вспомогательных словарей по имени/фамилии/отчеству/словам заметок группируются по ключам,
+// чтобы каждый ключ искался в словаре версии лишь однократно)
+void PhoneBookDatabase::AddRecordsByIds(Snapshot& snapshot, const vector<pair<size_t, const Record*>>& records) {
+
+    // Элементы словарей "Номер/id записи -> записи", "Номер телефона -> Номер/id записи" и "Номер/id записи -> Слова
+    // в заметках"
+    vector<pair<const size_t, shared_ptr<const Record>>> records_values;
+    vector<pair<const string_view, size_t>> numbers_values;
+    vector<pair<const size_t, shared_ptr<const vector<string_view>>>> note_words_values;
+    records_values.reserve(records.size());
+    numbers_values.reserve(records.size());
+    note_words_values.reserve(records.size());
+
+    // Группы номеров/id записей по имени, фамилии и отчеству, а также группы пар "Номер/id записи, частота TF" по
+    // словам в заметках (ключи ссылаются на строки записей, лежащих в heap'е)
+    unordered_map<string_view, vector<size_t>> name_groups;
+    unordered_map<string_view, vector<size_t>> surname_groups;
+    unordered_map<string_view, vector<size_t>> patronymic_groups;
+    unordered_map<string_view, vector<pair<size_t, double>>> note_word_groups;
+
+    // Пробежимся по всем записям пакета
+    for (const auto& [record_id, record] : records) {
+
+        // Создаём запись в heap'е (как и в AddRecordById, ключами остальных словарей служат строки этой записи)
+        shared_ptr<const Record> stored_record = make_shared<const Record>(*record);
+
+        // Запоминаем номер/id записи в группах её имени, фамилии и отчества
+        name_groups[stored_record->name].push_back(record_id);
+        surname_groups[stored_record->surname].push_back(record_id);
+        patronymic_groups[stored_record->patronymic].push_back(record_id);
+
+        // Вычисляем частоты TF слов в заметке записи, запоминаем их в группах слов и строим вектор слов в заметке
+        // (по возрастанию, как и ключи словаря частот)
+        size_t note_length = 0;
+        const map<string_view, double> word_to_freq = ComputeNoteWordsFreqs(stored_record->note, note_length);
+        auto record_note_words = make_shared<vector<string_view>>();
+        record_note_words->reserve(word_to_freq.size());
+
+        for (const auto& [word, term_freq] : word_to_freq) {
+            note_word_groups[word].emplace_back(record_id, term_freq);
+            record_note_words->push_back(word);
+        }
+
+        // Вносим длину заметки в массив длин заметок (блок массива копируется при записи лишь однократно на пакет)
+        AddNoteLength(snapshot, record_id, note_length);
+
+        numbers_values.emplace_back(stored_record->number, record_id);
+        note_words_values.emplace_back(record_id, move(record_note_words));
+        records_values.emplace_back(record_id, move(stored_record));
+    }
+
+    // Добавляем элементы в словари "Номер/id записи -> записи", "Номер телефона -> Номер/id записи" и "Номер/id
+    // записи -> Слова в заметках"
+    snapshot.records.InsertBatch(records_values);
+    snapshot.number_to_record.InsertBatch(numbers_values);
+    snapshot.record_to_note_words.InsertBatch(note_words_values);
+
+    // Добавляем группы в словари "Имя/Фамилия/Отчество -> Номера/id записей" (один поиск ключа в словаре версии на
+    // всю группу)
+    for (const auto& [name, records_ids] : name_groups) {
+        snapshot.name_to_records[name].InsertBatch(records_ids);
+    }
+    for (const auto& [surname, records_ids] : surname_groups) {
+        snapshot.surname_to_records[surname].InsertBatch(records_ids);
+    }
+    for (const auto& [patronymic, records_ids] : patronymic_groups) {
+        snapshot.patronymic_to_records[patronymic].InsertBatch(records_ids);
+    }
+
+    // Добавляем группы в списки записей слов словаря "Слово в заметках -> Список записей слова" (список каждого
+    // слова копируется при записи лишь однократно на пакет)
+    for (auto& [word, records_freqs] : note_word_groups) {
+        persistent_map::CopyOnWrite(snapshot.note_word_to_postings[word]).InsertBatch(move(records_freqs));
+    }
+}
+
+// Функция пакетного добавления записей
+// (возвращает вектор кодов ответа в порядке записей: 0 - запись с таким номером телефона уже существует,
+//                                                    1 - запись успешно добавлена)
+vector<size_t> PhoneBookDatabase::AddRecords(const vector<Record>& records) {
+
+    // Захватываем mutex писателей (один раз на весь пакет)
+    lock_guard lock(writer_mutex_);
+
+    // Строим новую версию базы данных как копию текущей (одна копия на весь пакет, все последующие изменения
+    // выполняются на месте в ещё не опубликованной версии)
+    auto snapshot = make_shared<Snapshot>(*CurrentSnapshot());
+
+    // Проверяем уникальность номеров телефонов всех записей пакета
+    vector<const Record*> records_pointers;
+    records_pointers.reserve(records.size());
+    for (const Record& record : records) {
+        records_pointers.push_back(&record);
+    }
+
+    vector<size_t> codes = CheckNewNumbers(*snapshot, records_pointers);
+
+    // Выдаём принятым записям номера/id подряд после номера/id последней записи
+    vector<pair<size_t, const Record*>> accepted_records;
+    accepted_records.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (codes[i]) {
+            accepted_records.emplace_back(++snapshot->last_record_id, &records[i]);
+        }
+    }
+
+    // Если принятых записей нет, новая версия базы данных просто отбрасывается
+    if (accepted_records.empty()) {
+        return codes;
+    }
+
+    // Добавляем принятые записи в новую версию базы данных и публикуем её (одна публикация на весь пакет)
+    AddRecordsByIds(*snapshot, accepted_records);
+    PublishSnapshot(move(snapshot));
+
+    return codes;
+}
+
+// Функция пакетного добавления записей с заданными снаружи номерами/id
+// (возвращает вектор кодов ответа в порядке записей: 0 - запись с таким номером телефона или номером/id уже
+//                                                        существует,
+//                                                    1 - запись успешно добавлена)
+vector<size_t> PhoneBookDatabase::AddRecordsWithIds(const vector<pair<size_t, const Record*>>& records) {
+
+    // Захватываем mutex писателей (один раз на весь пакет)
+    lock_guard lock(writer_mutex_);
+
+    // Строим новую версию базы данных как копию текущей
+    auto snapshot = make_shared<Snapshot>(*CurrentSnapshot());
+
+    // Проверяем уникальность номеров телефонов всех записей пакета
+    vector<const Record*> records_pointers;
+    records_pointers.reserve(records.size());
+    for (const auto& [record_id, record] : records) {
+        records_pointers.push_back(record);
+    }
+
+    vector<size_t> codes = CheckNewNumbers(*snapshot, records_pointers);
+
+    // Отбираем записи с уникальными номерами телефонов, номера/id которых ещё не заняты ни в версии базы данных, ни
+    // ранее в этом же пакете (иначе запись с повторяющимся номером/id заменила бы в словаре "Номер/id записи -> записи"
+    // предыдущую, на строки которой ссылаются остальные словари)
+    vector<pair<size_t, const Record*>> accepted_records;
+    accepted_records.reserve(records.size());
+    unordered_set<size_t> batch_records_ids;
+    batch_records_ids.reserve(records.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        const size_t record_id = records[i].first;
+        if (codes[i] && (snapshot->records.count(record_id) || !batch_records_ids.insert(record_id).second)) {
+            codes[i] = 0;
+        }
+        if (codes[i]) {
+            accepted_records.push_back(records[i]);
+
+            // Номер/id последней записи не должен быть меньше номера/id добавленной записи
+            snapshot->last_record_id = max(snapshot->last_record_id, records[i].first);
+        }
+    }
+
+    // Если принятых записей нет, новая версия базы данных просто отбрасывается
+    if (accepted_records.empty()) {
+        return codes;
+    }
+
+    // Добавляем принятые записи в новую версию базы данных и публикуем её
+    AddRecordsByIds(*snapshot, accepted_records);
+    PublishSnapshot(move(snapshot));
+
+    return codes;
+}
+
 // Функция удаления записи по её номеру/id
 // (возвращает код ответа: 0 - записи с таким номером/id не существует,
 //                         1 - запись успешно удалена)
 size_t PhoneBookDatabase::DeleteRecordById(size_t record_id) {
 
+    // Захватываем mutex писателей
+    lock_guard lock(writer_mutex_);
+
     // Если записи с таким номером/id не существует в базе данных, возвращаем код ответа - 0
-    if(!records_.count(record_id)) {
+    // (в этом случае не нужно строить новую версию базы данных)
+    if(!CurrentSnapshot()->records.count(record_id)) {
         return 0;
     }
 
-    // Удаляем запись из базы данных. Вначале стоит удалить упоминание записи из тех словарей, где ключом
-    // является string_view, который ссылается на строки из контейнера records_, а затем уже сами данные
-    // из контейнера records_, иначе зависимые string_view инвалидируются и удаление будет невозможно
+    // Строим новую версию базы данных как копию текущей
+    auto snapshot = make_shared<Snapshot>(*CurrentSnapshot());
+
+    // Удаляем запись из новой версии базы данных
+    size_t code = EraseRecordById(*snapshot, record_id);
+
+    // Публикуем новую версию базы данных
+    PublishSnapshot(move(snapshot));
+
+    // Возвращаем код ответа
+    return code;
+}
+
+// Функция удаления записи по её номеру/id из ещё не опубликованной версии базы данных
+// (возвращает код ответа: 0 - записи с таким номером/id не существует,
+//                         1 - запись успешно удалена)
+size_t PhoneBookDatabase::EraseRecordById(Snapshot& snapshot, size_t record_id) {
+
+    // Если записи с таким номером/id не существует в базе данных, возвращаем код ответа - 0
+    if(!snapshot.records.count(record_id)) {
+        return 0;
+    }
+
+    // Удерживаем удаляемую запись до конца функции: string_view в ключах вспомогательных словарей
+    // ссылаются на её строки, а из словаря "Номер/id записи -> записи" она будет удалена раньше, чем
+    // закончится перевешивание ключей (старые версии базы данных могут тоже удерживать её, но
+    // рассчитывать на это нельзя)
+    const shared_ptr<const Record> record = snapshot.records.at(record_id);
+
+    // Удаляем запись из словаря "Номер/id записи -> записи"
+    snapshot.records.erase(record_id);
+
+    // Удаляем длину заметки записи из массива длин заметок и суммарной длины заметок (наибольшая длина заметки
+    // не уменьшается - она остаётся верхней границей)
+    snapshot.notes_length -= snapshot.note_lengths.Get(record_id);
+    snapshot.note_lengths.Set(record_id, 0);
 
     // Удаляем данные из словаря "Имя -> Номер/id записи"
-    name_to_records_[records_[record_id].name].erase(record_id);
+    snapshot.name_to_records[record->name].erase(record_id);
     
     // Если не осталось других записей с таким же именем
-    if(name_to_records_[records_[record_id].name].empty()) {
+    if(snapshot.name_to_records[record->name].empty()) {
 
         // Удаляем упоминание этого имени из базы данных
-        name_to_records_.erase(records_[record_id].name);
+        snapshot.name_to_records.erase(record->name);
     }
     // А если остались и другие записи с таким же именем
     else {
@@ -247,37 +1291,31 @@ size_t PhoneBookDatabase::DeleteRecordById(size_t record_id) {
         // string_view ключа с именем, ключ будет инвалидирован
         //
         // Пример: клиент добавил в базу данных телефонной книги две записи с Александром Ивановым и
-        // Александром Петровым. В контейнере name_to_records_ ключ "Александр" являлся string_view,
-        // который ссылался на string Александра Иванова, который лежит в контейнере records_. Если
-        // удалить запись с Александром Ивановым, то string_view ключа "Александр" в name_to_records_
-        // будет инвалидирован, и никаких  других Александров больше найти не получится. В таком случае
-        // следует перевесить string_view на string оставшегося Александра Петрова
+        // Александром Петровым. В контейнере name_to_records ключ "Александр" являлся string_view,
+        // который ссылался на string Александра Иванова, который лежит в heap'е. Если удалить запись
+        // с Александром Ивановым, то после освобождения всех старых версий базы данных string_view ключа
+        // "Александр" в name_to_records будет инвалидирован, и никаких  других Александров больше найти
+        // не получится. В таком случае следует перевесить string_view на string оставшегося Александра Петрова
 
         // Номер/id какой-нибудь другой записи с таким же именем (будет выбрана запись с наименьшим номером/id)
-        size_t another_record_id_with_same_name = *name_to_records_[records_[record_id].name].begin();
+        size_t another_record_id_with_same_name = *snapshot.name_to_records[record->name].begin();
 
         // String_view, который будет ссылаться на string какой-нибудь другой записи с таким же именем
-        string_view new_name_key = records_[another_record_id_with_same_name].name;
-
-        // Вынимаем из словаря узел с нашем именем
-        auto map_node_handler = name_to_records_.extract(records_[record_id].name);
+        string_view new_name_key = snapshot.records.at(another_record_id_with_same_name)->name;
 
-        // Изменяем ключ у этого узла на string_view, ссылающийся на string какой-нибудь другой записи с таким же именем
-        map_node_handler.key() = new_name_key;
-
-        // Возвращаем узел обратно в словарь (так как у insert есть перегрузка с rvalue-ссылкой,
-        // передадим узел через std::move, дабы не копировать его содержимое, а переместить)
-        name_to_records_.insert(move(map_node_handler));
+        // Заменяем ключ с нашем именем на string_view, ссылающийся на string какой-нибудь другой записи (узел словаря
+        // при этом вынимается и возвращается обратно, значение не копируется)
+        snapshot.name_to_records.ReplaceKey(record->name, new_name_key);
     }
 
     // Удаляем данные из словаря "Фамилия -> Номер/id записи"
-    surname_to_records_[records_[record_id].surname].erase(record_id);
+    snapshot.surname_to_records[record->surname].erase(record_id);
 
     // Если не осталось других записей с такой же фамилией
-    if(surname_to_records_[records_[record_id].surname].empty()) {
+    if(snapshot.surname_to_records[record->surname].empty()) {
 
         // Удаляем упоминание этой фамилии из базы данных
-        surname_to_records_.erase(records_[record_id].surname);
+        snapshot.surname_to_records.erase(record->surname);
     }
     // А если остались и другие записи с такой же фамилией
     else {
@@ -287,29 +1325,23 @@ size_t PhoneBookDatabase::DeleteRecordById(size_t record_id) {
         // string_view ключа с фамилией, ключ будет инвалидирован
 
         // Номер/id какой-нибудь другой записи с такой же фамилией (будет выбрана запись с наименьшим номером/id)
-        size_t another_record_id_with_same_surname = *surname_to_records_[records_[record_id].surname].begin();
+        size_t another_record_id_with_same_surname = *snapshot.surname_to_records[record->surname].begin();
 
         // String_view, который будет ссылаться на string какой-нибудь другой записи с такой же фамилией
-        string_view new_surname_key = records_[another_record_id_with_same_surname].surname;
-
-        // Вынимаем из словаря узел с нашей фамилией
-        auto map_node_handler = surname_to_records_.extract(records_[record_id].surname);
+        string_view new_surname_key = snapshot.records.at(another_record_id_with_same_surname)->surname;
 
-        // Изменяем ключ у этого узла на string_view, ссылающийся на string какой-нибудь другой записи с такой же фамилией
-        map_node_handler.key() = new_surname_key;
-
-        // Возвращаем узел обратно в словарь (так как у insert есть перегрузка с rvalue-ссылкой,
-        // передадим узел через std::move, дабы не копировать его содержимое, а переместить)
-        surname_to_records_.insert(move(map_node_handler));
+        // Заменяем ключ с нашей фамилией на string_view, ссылающийся на string какой-нибудь другой записи (узел словаря
+        // при этом вынимается и возвращается обратно, значение не копируется)
+        snapshot.surname_to_records.ReplaceKey(record->surname, new_surname_key);
     }
 
     // Удаляем данные из словаря "Отчество -> Номер/id записи"
-    patronymic_to_records_[records_[record_id].patronymic].erase(record_id);
+    snapshot.patronymic_to_records[record->patronymic].erase(record_id);
 
     // Если не осталось других записей с таким же отчеством
-    if(patronymic_to_records_[records_[record_id].patronymic].empty()) {
+    if(snapshot.patronymic_to_records[record->patronymic].empty()) {
         // Удаляем упоминание этого отчества из базы данных
-        patronymic_to_records_.erase(records_[record_id].patronymic);
+        snapshot.patronymic_to_records.erase(record->patronymic);
     }
     // А если остались и другие записи с таким же отчеством
     else {
@@ -319,47 +1351,42 @@ size_t PhoneBookDatabase::DeleteRecordById(size_t record_id) {
         // string_view ключа с отчеством, ключ будет инвалидирован
 
         // Номер/id какой-нибудь другой записи с таким же отчеством (будет выбрана запись с наименьшим номером/id)
-        size_t another_record_id_with_same_patronymic = *patronymic_to_records_[records_[record_id].patronymic].begin();
+        size_t another_record_id_with_same_patronymic = *snapshot.patronymic_to_records[record->patronymic].begin();
 
         // String_view, который будет ссылаться на string какой-нибудь другой записи с таким же отчеством
-        string_view new_patronymic_key = records_[another_record_id_with_same_patronymic].patronymic;
-
-        // Вынимаем из словаря узел с нашем отчеством
-        auto map_node_handler = patronymic_to_records_.extract(records_[record_id].patronymic);
+        string_view new_patronymic_key = snapshot.records.at(another_record_id_with_same_patronymic)->patronymic;
 
-        // Изменяем ключ у этого узла на string_view, ссылающийся на string какой-нибудь другой записи с таким же отчеством
-        map_node_handler.key() = new_patronymic_key;
-
-        // Возвращаем узел обратно в словарь (так как у insert есть перегрузка с rvalue-ссылкой,
-        // передадим узел через std::move, дабы не копировать его содержимое, а переместить)
-        patronymic_to_records_.insert(move(map_node_handler));
+        // Заменяем ключ с нашем отчеством на string_view, ссылающийся на string какой-нибудь другой записи (узел словаря
+        // при этом вынимается и возвращается обратно, значение не копируется)
+        snapshot.patronymic_to_records.ReplaceKey(record->patronymic, new_patronymic_key);
     }
 
     // Удаляем данные из словаря "Номер телефона -> Номер/id записи"
-    number_to_record_.erase(records_[record_id].number);
+    snapshot.number_to_record.erase(record->number);
 
     // Теперь необходимо удалить данные о встречающихся в заметке к удаляемой записи словах из словарей
-    // "Номер/id записи -> Слова в заметках" и Слово в заметках -> Номер/id записи -> Частота TF"
+    // "Номер/id записи -> Слова в заметках" и "Слово в заметках -> Список записей слова"
 
-    // Слова, которые встречаются в заметке к удаляемой записи
-    set<string_view> note_words_in_record(record_to_note_words_[record_id].begin(),
-                                          record_to_note_words_[record_id].end());
+    // Слова, которые встречаются в заметке к удаляемой записи (вектор слов никогда не изменяется,
+    // поэтому достаточно удержать умный указатель на него)
+    shared_ptr<const vector<string_view>> note_words_in_record = snapshot.record_to_note_words.at(record_id);
 
     // Удаляем данные из словаря "Номер/id записи -> Слова в заметках"
-    record_to_note_words_.erase(record_id);
+    snapshot.record_to_note_words.erase(record_id);
 
-    // Удаляем данные из словаря "Слово в заметках -> Номер/id записи -> Частота TF",
+    // Удаляем данные из словаря "Слово в заметках -> Список записей слова",
     // для чего пробегаем все слова, встречавшиеся в заметке к удаляемой записи
-    for(string_view word : note_words_in_record) {
+    for(string_view word : *note_words_in_record) {
 
         // Для каждого слова удаляем упоминание о том, что оно встречалось в заметках к удаляемой записи
-        note_word_to_record_freqs_[word].erase(record_id);
+        posting_list::PostingList& word_postings = persistent_map::CopyOnWrite(snapshot.note_word_to_postings[word]);
+        word_postings.Erase(record_id);
 
         // Если так вышло, что слово больше не встречается в заметках ни к какой другой записи
-        if(note_word_to_record_freqs_[word].empty()) {
+        if(word_postings.empty()) {
 
             // Удаляем упоминание об этом слове из базы данных
-            note_word_to_record_freqs_.erase(word);
+            snapshot.note_word_to_postings.erase(word);
         }
         // А если остались и другие записи с таким же словом в заметках
         else {
@@ -368,28 +1395,21 @@ size_t PhoneBookDatabase::DeleteRecordById(size_t record_id) {
             // string_view ключа со словом, ключ будет инвалидирован
 
             // Номер/id какой-нибудь другой записи с таким же словом в заметках (будет выбрана запись с наименьшим номером/id)
-            size_t another_record_id_with_same_note_word = (*note_word_to_record_freqs_[word].begin()).first;
+            size_t another_record_id_with_same_note_word = word_postings.FirstRecordId();
 
             // String_view, который будет ссылаться на string какой-нибудь другой записи с таким же словом в заметках
-            string_view new_note_word_key = *record_to_note_words_[another_record_id_with_same_note_word].find(word);
-
-            // Вынимаем из словаря узел с нашем словом в заметках
-            auto map_node_handler = note_word_to_record_freqs_.extract(word);
+            // (слова заметки упорядочены, поэтому ищем его бинарным поиском)
+            const vector<string_view>& another_record_note_words = *snapshot.record_to_note_words.at(another_record_id_with_same_note_word);
+            string_view new_note_word_key = *lower_bound(another_record_note_words.begin(), another_record_note_words.end(), word);
 
-            // Изменяем ключ у этого узла на string_view, ссылающийся на string какой-нибудь другой записи с таким же словом в заметках
-            map_node_handler.key() = new_note_word_key;
-
-            // Возвращаем узел обратно в словарь (так как у insert есть перегрузка с rvalue-ссылкой,
-            // передадим узел через std::move, дабы не копировать его содержимое, а переместить)
-            note_word_to_record_freqs_.insert(move(map_node_handler));
+            // Заменяем ключ с нашим словом в заметках на string_view, ссылающийся на string какой-нибудь другой записи
+            // (узел словаря при этом вынимается и возвращается обратно, значение не копируется)
+            snapshot.note_word_to_postings.ReplaceKey(word, new_note_word_key);
         }
-    }  
-
-    // И вот теперь уже можно удалить данные из словаря "Номер/id записи -> записи", в котором непосредственно
-    // хранятся строковые данные, на которые ссылались string_view во вспомогательных словарях
-    records_.erase(record_id);
+    }
 
-    // Возвращаем код ответа - 1
+    // Возвращаем код ответа - 1 (сама запись будет удалена из heap'а, когда её отпустит последняя
+    // версия базы данных, в которой она есть)
     return 1;
 }
 
@@ -398,29 +1418,47 @@ size_t PhoneBookDatabase::DeleteRecordById(size_t record_id) {
 //                         1 - запись успешно удалена)
 size_t PhoneBookDatabase::DeleteRecordByNumber(const string& number) {
 
+    // Захватываем mutex писателей
+    lock_guard lock(writer_mutex_);
+
+    // Получаем текущую версию базы данных
+    shared_ptr<const Snapshot> current_snapshot = CurrentSnapshot();
+
     // Если записи с таким номером телефона не существует в базе данных, возвращаем код ответа - 0
-    if(!number_to_record_.count(number)) {
+    if(!current_snapshot->number_to_record.count(number)) {
         return 0;
     }
 
     // Получаем номер/id записи в базе данных
-    size_t record_id = number_to_record_.at(number);
+    size_t record_id = current_snapshot->number_to_record.at(number);
+
+    // Строим новую версию базы данных как копию текущей
+    auto snapshot = make_shared<Snapshot>(*current_snapshot);
+
+    // Удаляем запись из новой версии базы данных
+    size_t code = EraseRecordById(*snapshot, record_id);
+
+    // Публикуем новую версию базы данных
+    PublishSnapshot(move(snapshot));
 
-    // Вызываем функцию удаления записи по номеру/id записи
-    return DeleteRecordById(record_id);
+    // Возвращаем код ответа
+    return code;
 }
 
 // Функция поиска записи по номеру/id записи
 // (найденная запись может быть только одна или её может не быть вовсе, тогда возвращает nullopt)
 optional<PhoneBookDatabase::RecordWithId> PhoneBookDatabase::FindRecordById(size_t id) const {
 
+    // Получаем текущую версию базы данных (весь поиск выполняется по ней)
+    shared_ptr<const Snapshot> snapshot = CurrentSnapshot();
+
     // Если записи с таким номером/id не существует в базе данных, возвращаем nullopt
-    if(!records_.count(id)) {
+    if(!snapshot->records.count(id)) {
         return nullopt;
     }
 
     // Получаем константную ссылку на запись в базе данных
-    const Record& record = records_.at(id);
+    const Record& record = *snapshot->records.at(id);
 
     // Возвращаем запись вместе с её номером/id в базе данных
     return RecordWithId({id, record.name, record.surname, record.patronymic, record.number, record.note});
@@ -429,151 +1467,405 @@ optional<PhoneBookDatabase::RecordWithId> PhoneBookDatabase::FindRecordById(size
 // Функция поиска записей по имени
 // (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
 optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsByName(const string& name) const {
+    return CollectRecords(OpenRecordsByName(name));
+}
 
-    // Если записей с таким именем не существует в базе данных, возвращаем nullopt
-    if(!name_to_records_.count(name)) {
-        return nullopt;
+// Функция поиска записей по фамилии
+// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsBySurname(const string& surname) const {
+    return CollectRecords(OpenRecordsBySurname(surname));
+}
+
+// Функция поиска записей по отчеству
+// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsByPatronymic(const string& patronymic) const {
+    return CollectRecords(OpenRecordsByPatronymic(patronymic));
+}
+
+// Функция открытия курсора по записям с указанным именем
+PhoneBookDatabase::RecordsCursor PhoneBookDatabase::OpenRecordsByName(const string& name) const {
+    return OpenRecords(CurrentSnapshot(), &Snapshot::name_to_records, name);
+}
+
+// Функция открытия курсора по записям с указанной фамилией
+PhoneBookDatabase::RecordsCursor PhoneBookDatabase::OpenRecordsBySurname(const string& surname) const {
+    return OpenRecords(CurrentSnapshot(), &Snapshot::surname_to_records, surname);
+}
+
+// Функция открытия курсора по записям с указанным отчеством
+PhoneBookDatabase::RecordsCursor PhoneBookDatabase::OpenRecordsByPatronymic(const string& patronymic) const {
+    return OpenRecords(CurrentSnapshot(), &Snapshot::patronymic_to_records, patronymic);
+}
+
+// Функция открытия курсора по записям, у которых в словаре index версии snapshot есть ключ key
+PhoneBookDatabase::RecordsCursor PhoneBookDatabase::OpenRecords(shared_ptr<const Snapshot> snapshot,
+                                                                IndexMap<string_view, persistent_map::PersistentSet<size_t>> Snapshot::* index,
+                                                                string_view key) {
+
+    // Если записей с таким ключом не существует в базе данных, возвращаем пустой курсор
+    const auto& records_index = (*snapshot).*index;
+    if(!records_index.count(key)) {
+        return RecordsCursor();
     }
 
-    // Вектор найденных записей с указанным именем
-    vector<RecordWithId> result;
+    // Ссылка на множество номеров/id остаётся действительной, пока курсор удерживает версию базы данных
+    const persistent_map::PersistentSet<size_t>& records_ids = records_index.at(key);
+    return RecordsCursor(move(snapshot), records_ids);
+}
 
-    // Проходим в цикле по номерам/id всех записей, содержащих указанное имя
-    for(const size_t id : name_to_records_.at(name)) {
+// Функция поиска записей по нескольким полям сразу
+// (записи по возрастанию номера/id, удовлетворяющие всем условиям запроса; найденных записей может быть множество
+//  или не быть вовсе, тогда возвращает nullopt)
+optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsByQuery(const RecordsQuery& query) const {
+    return CollectRecords(OpenRecordsByQuery(query));
+}
 
-        // Получаем константную ссылку на запись в базе данных
-        const Record& record = records_.at(id);
+// Функция открытия курсора по записям, удовлетворяющим всем условиям запроса
+PhoneBookDatabase::RecordsCursor PhoneBookDatabase::OpenRecordsByQuery(const RecordsQuery& query) const {
 
-        // Добавляем запись вместе с её номером/id в базе данных в вектор найденных записей
-        result.push_back({id, record.name, record.surname, record.patronymic, record.number, record.note});
+    // Получаем текущую версию базы данных (пересечение вычисляется по ней, и курсор её удерживает)
+    shared_ptr<const Snapshot> snapshot = CurrentSnapshot();
+
+    // Если записей не найдено, возвращаем пустой курсор
+    vector<size_t> records_ids = IntersectRecordsIds(*snapshot, query);
+    if (records_ids.empty()) {
+        return RecordsCursor();
     }
 
-    // Возвращаем вектор найденных записей
-    return result;
+    return RecordsCursor(move(snapshot), move(records_ids));
 }
 
-// Функция поиска записей по фамилии
-// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
-optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsBySurname(const string& surname) const {
+// Отношения размера источника к числу кандидатов, начиная с которых источник не собирается в массив, а проверяет
+// каждого кандидата поиском: для множества номеров/id сбор в массив требует обхода узлов всех корзин и сортировки,
+// поэтому он выгоднее поиска в корзине, лишь пока множество не больше нескольких кандидатов, а список записей слова
+// распаковывается в массив быстро, но переход курсора к кандидату распаковывает лишь его блок из BLOCK_SIZE записей
+static constexpr size_t SET_PROBE_RATIO = 4;
+static constexpr size_t POSTINGS_PROBE_RATIO = posting_list::PostingList::BLOCK_SIZE / 2;
+
+// Структура источника номеров/id записей для поиска по нескольким полям сразу: множество номеров/id записей с
+// заданным именем/фамилией/отчеством или список записей слова заметки (задан ровно один из указателей)
+struct RecordsIdsSource {
+    const persistent_map::PersistentSet<size_t>* records_ids = nullptr; // Множество номеров/id записей
+    const posting_list::PostingList* postings = nullptr;                 // Список записей слова заметки
+    size_t size = 0;                                                     // Число номеров/id в источнике
+};
+
+// Функция сбора номеров/id источника source в отсортированный по возрастанию вектор
+static vector<size_t> CollectSourceIds(const RecordsIdsSource& source) {
+    vector<size_t> ids;
+    ids.reserve(source.size);
+
+    // Список записей слова уже упорядочен по номеру/id
+    if (source.postings != nullptr) {
+        for (posting_list::PostingList::Cursor cursor = source.postings->OpenCursor(); cursor.HasPosting(); cursor.Next()) {
+            ids.push_back(cursor.RecordId());
+        }
+        return ids;
+    }
 
-    // Если записей с такой фамилией не существует в базе данных, возвращаем nullopt
-    if(!surname_to_records_.count(surname)) {
-        return nullopt;
+    // А номера/id множества упорядочены лишь внутри корзин
+    source.records_ids->ForEachBucket([&ids](const set<size_t>& bucket) {
+        ids.insert(ids.end(), bucket.begin(), bucket.end());
+    });
+    sort(ids.begin(), ids.end());
+
+    return ids;
+}
+
+// Функция отсеивания кандидатов candidates (отсортированных по возрастанию номеров/id), которых нет в источнике source
+static void FilterCandidates(vector<size_t>& candidates, const RecordsIdsSource& source) {
+    size_t count = 0;
+
+    // Список записей слова, во много раз больший кандидатов: курсор переходит к каждому кандидату по указателям
+    // пропуска, распаковывая лишь блоки, где могут лежать кандидаты
+    if (source.postings != nullptr && source.size / POSTINGS_PROBE_RATIO >= candidates.size()) {
+        posting_list::PostingList::Cursor cursor = source.postings->OpenCursor();
+
+        for (size_t record_id : candidates) {
+            cursor.NextGEQ(record_id);
+            if (!cursor.HasPosting()) {
+                break;
+            }
+            if (cursor.RecordId() == record_id) {
+                candidates[count++] = record_id;
+            }
+        }
+    }
+    // Множество номеров/id, во много раз большее кандидатов: каждый кандидат ищется в своей корзине
+    else if (source.records_ids != nullptr && source.size / SET_PROBE_RATIO >= candidates.size()) {
+        for (size_t record_id : candidates) {
+            if (source.records_ids->Find(record_id) != nullptr) {
+                candidates[count++] = record_id;
+            }
+        }
+    }
+    // Иначе собираем источник в отсортированный массив и пересекаем с кандидатами на месте
+    else {
+        const vector<size_t> source_ids = CollectSourceIds(source);
+        count = ids_intersection::IntersectSortedIds(candidates.data(), candidates.size(),
+                                                     source_ids.data(), source_ids.size(), candidates.data());
     }
 
-    // Вектор найденных записей с указанной фамилией
-    vector<RecordWithId> result;
+    candidates.resize(count);
+}
+
+// Функция пересечения множеств номеров/id записей версии snapshot по всем условиям запроса query
+vector<size_t> PhoneBookDatabase::IntersectRecordsIds(const Snapshot& snapshot, const RecordsQuery& query) {
+
+    // Источники номеров/id всех условий запроса
+    vector<RecordsIdsSource> sources;
+
+    // Функция добавления источника для условия на имя/фамилию/отчество (value не задано - условия нет; возвращает
+    // false, если записей с таким значением нет - тогда нет и пересечения)
+    const auto add_field_source = [&snapshot, &sources](const optional<string>& value,
+                                                        IndexMap<string_view, persistent_map::PersistentSet<size_t>> Snapshot::* index) {
+        if (!value.has_value()) {
+            return true;
+        }
 
-    // Проходим в цикле по номерам/id всех записей, содержащих указанную фамилию
-    for(const size_t id : surname_to_records_.at(surname)) {
+        const auto* element = (snapshot.*index).Find(*value);
+        if (element == nullptr) {
+            return false;
+        }
 
-        // Получаем константную ссылку на запись в базе данных
-        const Record& record = records_.at(id);
+        sources.push_back({&element->second, nullptr, element->second.size()});
+        return true;
+    };
 
-        // Добавляем запись вместе с её номером/id в базе данных в вектор найденных записей
-        result.push_back({id, record.name, record.surname, record.patronymic, record.number, record.note});
+    if (!add_field_source(query.name, &Snapshot::name_to_records) ||
+        !add_field_source(query.surname, &Snapshot::surname_to_records) ||
+        !add_field_source(query.patronymic, &Snapshot::patronymic_to_records)) {
+        return {};
     }
 
-    // Возвращаем вектор найденных записей
-    return result;
+    // Каждое различное слово заметки запроса - отдельное условие (слова нет ни в одной заметке - пересечения нет)
+    for (string_view word : string_functions::SortAndRemoveDuplicates(string_functions::SplitIntoWords(query.note))) {
+        const auto* word_postings = snapshot.note_word_to_postings.Find(word);
+        if (word_postings == nullptr) {
+            return {};
+        }
+
+        sources.push_back({nullptr, word_postings->second.get(), word_postings->second->size()});
+    }
+
+    // Запрос без условий не находит ни одной записи
+    if (sources.empty()) {
+        return {};
+    }
+
+    // Упорядочиваем источники по размеру: кандидатами становятся номера/id наименьшего источника, а остальные
+    // источники отсеивают их от меньших к большим (так кандидатов становится меньше как можно раньше)
+    sort(sources.begin(), sources.end(), [](const RecordsIdsSource& lhs, const RecordsIdsSource& rhs) {
+        return lhs.size < rhs.size;
+    });
+
+    vector<size_t> candidates = CollectSourceIds(sources.front());
+
+    for (size_t i = 1; i < sources.size() && !candidates.empty(); ++i) {
+        FilterCandidates(candidates, sources[i]);
+    }
+
+    return candidates;
 }
 
-// Функция поиска записей по отчеству
-// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
-optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsByPatronymic(const string& patronymic) const {
+// Функция сбора всех записей курсора в вектор (если курсор пуст, возвращает nullopt)
+optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::CollectRecords(RecordsCursor cursor) {
 
-    // Если записей с таким отчеством не существует в базе данных, возвращаем nullopt
-    if(!patronymic_to_records_.count(patronymic)) {
+    // Если записей не найдено, возвращаем nullopt
+    if(!cursor.HasRecord()) {
         return nullopt;
     }
 
-    // Вектор найденных записей с указанным отчеством
+    // Вектор найденных записей (курсор уже выдаёт их упорядоченными по номеру/id)
     vector<RecordWithId> result;
 
-    // Проходим в цикле по номерам/id всех записей, содержащих указанное отчество
-    for(const size_t id : patronymic_to_records_.at(patronymic)) {
-
-        // Получаем константную ссылку на запись в базе данных
-        const Record& record = records_.at(id);
-
-        // Добавляем запись вместе с её номером/id в базе данных в вектор найденных записей
-        result.push_back({id, record.name, record.surname, record.patronymic, record.number, record.note});
+    for(; cursor.HasRecord(); cursor.Next()) {
+        const Record& record = cursor.CurrentRecord();
+        result.push_back({cursor.RecordId(), record.name, record.surname, record.patronymic, record.number, record.note});
     }
 
     // Возвращаем вектор найденных записей
     return result;
 }
 
+// Конструктор курсора по множеству номеров/id records_ids, принадлежащему версии snapshot
+PhoneBookDatabase::RecordsCursor::RecordsCursor(shared_ptr<const Snapshot> snapshot,
+                                                const persistent_map::PersistentSet<size_t>& records_ids) : snapshot_(move(snapshot)) {
+
+    // Кладём в кучу все непустые корзины множества номеров/id
+    records_ids.ForEachBucket([this](const set<size_t>& bucket) {
+        buckets_heap_.emplace_back(bucket.begin(), bucket.end());
+    });
+
+    make_heap(buckets_heap_.begin(), buckets_heap_.end(), BucketGreater);
+}
+
+// Конструктор курсора по отсортированному вектору номеров/id records_ids записей версии snapshot
+PhoneBookDatabase::RecordsCursor::RecordsCursor(shared_ptr<const Snapshot> snapshot, vector<size_t> records_ids) :
+    snapshot_(move(snapshot)), records_ids_(move(records_ids)) {
+}
+
+// Функция получения константной ссылки на текущую запись
+const PhoneBookDatabase::Record& PhoneBookDatabase::RecordsCursor::CurrentRecord() const {
+    return *snapshot_->records.at(RecordId());
+}
+
+// Функция перехода к следующей записи
+void PhoneBookDatabase::RecordsCursor::Next() {
+
+    // Курсор по вектору номеров/id просто сдвигает позицию (версию базы данных отпускаем сразу, как только записи
+    // закончились)
+    if(buckets_heap_.empty()) {
+        if(++position_ == records_ids_.size()) {
+            snapshot_.reset();
+        }
+        return;
+    }
+
+    // Вынимаем из кучи корзину с наименьшим номером/id и сдвигаем её итератор
+    pop_heap(buckets_heap_.begin(), buckets_heap_.end(), BucketGreater);
+    BucketRange& bucket = buckets_heap_.back();
+    ++bucket.first;
+
+    // Если в корзине ещё остались номера/id, возвращаем её в кучу, иначе убираем
+    if(bucket.first != bucket.second) {
+        push_heap(buckets_heap_.begin(), buckets_heap_.end(), BucketGreater);
+    }
+    else {
+        buckets_heap_.pop_back();
+    }
+
+    // Версию базы данных отпускаем сразу, как только записи закончились
+    if(buckets_heap_.empty()) {
+        snapshot_.reset();
+    }
+}
+
 // Функция поиска записи по номеру телефона
 // (найденная запись может быть только одна или её может не быть вовсе, тогда возвращает nullopt)
 optional<PhoneBookDatabase::RecordWithId> PhoneBookDatabase::FindRecordByNumber(const string& number) const {
 
+    // Получаем текущую версию базы данных (весь поиск выполняется по ней)
+    shared_ptr<const Snapshot> snapshot = CurrentSnapshot();
+
     // Если записи с таким номером телефона не существует в базе данных, возвращаем nullopt
-    if(!number_to_record_.count(number)) {
+    if(!snapshot->number_to_record.count(number)) {
         return nullopt;
     }
 
     // Получаем номер/id записи в базе данных
-    size_t record_id = number_to_record_.at(number);
+    size_t record_id = snapshot->number_to_record.at(number);
 
     // Получаем константную ссылку на запись в базе данных
-    const Record& record = records_.at(record_id);
+    const Record& record = *snapshot->records.at(record_id);
 
     // Возвращаем запись вместе с её номером/id в базе данных
     return RecordWithId({record_id, record.name, record.surname, record.patronymic, record.number, record.note});
 }
 
+// Функция пакетного поиска записей по номерам/id
+// (возвращает вектор найденных записей в порядке номеров/id, для ненайденных номеров/id - nullopt)
+vector<optional<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsByIds(const vector<size_t>& ids) const {
+
+    // Получаем текущую версию базы данных (весь поиск выполняется по ней)
+    shared_ptr<const Snapshot> snapshot = CurrentSnapshot();
+
+    return CollectRecordsByIds(*snapshot, ids);
+}
+
+// Функция пакетного поиска записей по номерам телефонов
+// (возвращает вектор найденных записей в порядке номеров телефонов, для ненайденных номеров телефонов - nullopt)
+vector<optional<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsByNumbers(const vector<string>& numbers) const {
+
+    // Получаем текущую версию базы данных (весь поиск выполняется по ней)
+    shared_ptr<const Snapshot> snapshot = CurrentSnapshot();
+
+    // Ищем номера/id записей по номерам телефонов (строки номеров не копируются - ключи словаря это string_view);
+    // для ненайденных номеров телефонов остаётся номер/id 0, который никогда не выдаётся записям
+    vector<string_view> keys(numbers.begin(), numbers.end());
+    vector<size_t> ids(numbers.size(), 0);
+
+    snapshot->number_to_record.FindBatch(keys, [&ids](size_t key_index, const auto* element) {
+        if (element) {
+            ids[key_index] = element->second;
+        }
+    });
+
+    // Ищем записи по найденным номерам/id в той же версии базы данных
+    return CollectRecordsByIds(*snapshot, ids);
+}
+
+// Функция пакетного поиска записей по номерам/id в версии snapshot (для ненайденных номеров/id - nullopt)
+vector<optional<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::CollectRecordsByIds(const Snapshot& snapshot, const vector<size_t>& ids) {
+
+    // Вектор найденных записей в порядке номеров/id
+    vector<optional<RecordWithId>> records(ids.size());
+
+    // Каждый номер/id ищется в словаре "Номер/id записи -> записи" лишь однократно (без отдельной проверки count)
+    snapshot.records.FindBatch(ids, [&ids, &records](size_t key_index, const auto* element) {
+        if (element) {
+            const Record& record = *element->second;
+            records[key_index] = RecordWithId({ids[key_index], record.name, record.surname, record.patronymic, record.number, record.note});
+        }
+    });
+
+    return records;
+}
+
 // Функция поиска записей по содержанию заметок
-// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
-optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsByNote(const string& note) const {
+// (возвращает топ из не более чем max_records_count самых релевантных записей; найденных записей может быть
+//  множество или не быть вовсе, тогда возвращает nullopt)
+optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecordsByNote(const string& note,
+                                                                                      size_t max_records_count,
+                                                                                      const NoteRankingParams& ranking_params) const {
+
+    // Получаем текущую версию базы данных (весь поиск выполняется по ней)
+    shared_ptr<const Snapshot> snapshot = CurrentSnapshot();
 
     // Для поиска записей по содержимому заметки будем использовать механизм ранжирования записей по TF-IDF
     // (TF - Term Frequency, IDF - Inverse Document Frequency), статья про статистическую меру TF-IDF:
-    // https://ru.wikipedia.org/wiki/TF-IDF
-
-    // Словарь "Номер/id записи -> Релевантность по TF-IDF"
-    map<size_t, double> record_to_relevance;
+    // https://ru.wikipedia.org/wiki/TF-IDF (или по BM25, если он выбран в параметрах ранжирования ranking_params)
 
     // Разделим содержание заметки note на отдельные слова, отсортируем и удалим дубликаты
     vector<string_view> words = string_functions::SortAndRemoveDuplicates(string_functions::SplitIntoWords(note));
 
-    // Пробежим все слова, заметки с наличием которых надо найти
+    // Вектор пар "Список записей слова, частота IDF" для слов, которые встречаются в заметках хотя бы одной записи
+    vector<pair<const posting_list::PostingList*, double>> postings_inverse_freqs;
+    postings_inverse_freqs.reserve(words.size());
+
+    // Логарифм числа записей в базе данных (общая для всех слов запроса часть частоты IDF, вычисляется один раз)
+    const double log_records_count = log(static_cast<double>(snapshot->records.size()));
+
+    // Ранжирование по BM25 (иначе по TF-IDF)
+    const bool bm25 = ranking_params.ranking == NoteRanking::BM25;
+
+    // Пробежим все слова, заметки с наличием которых надо найти (каждое слово ищется в словаре версии однократно)
     for (string_view word : words) {
 
-        // Если слова нету в словаре "Слово в заметках -> Номер/id записи -> Частота TF", значит
+        // Если слова нету в словаре "Слово в заметках -> Список записей слова", значит
         // нету записей, где это слово встречается в заметке, пропускаем его
-        if (!note_word_to_record_freqs_.count(word)) {
+        const auto* word_postings = snapshot->note_word_to_postings.Find(word);
+        if (word_postings == nullptr) {
             continue;
         }
 
-        // Вычисляем частоту IDF (Inverse Document Frequency) для слова
-        const double inverse_record_freq = ComputeWordInverseDocumentFreq(word);
-
-        // Если слово встречается в заметке какой-либо записи, добавляем номер/id этой записи в словарь
-        // "Номер/id записи -> Релевантность по TF-IDF" для отбора записей по релевантности, для этого
-        // перебираем в цикле все записи, где встречается конкретное слово
-        for (const auto& [record_id, term_freq] : note_word_to_record_freqs_.at(word)) {
-
-            // Добавляем в релевантность документа TF * IDF совпавшего слова в заметке
-            record_to_relevance[record_id] += term_freq * inverse_record_freq;
-        }
+        // Вычисляем частоту IDF (Inverse Document Frequency) для слова по его уже найденному списку записей
+        // (для BM25 - по своей формуле)
+        const posting_list::PostingList& postings = *word_postings->second;
+        postings_inverse_freqs.push_back(
+            {&postings, bm25 ? ComputeWordBM25InverseDocumentFreq(snapshot->records.size(), postings.size())
+                             : ComputeWordInverseDocumentFreq(log_records_count, postings.LogSize())});
     }
 
     // Замечание: можно также реализовать функционал со стоп-словами (предлоги, частицы и т.д., слова которые нужно
     // игнорировать) и минус-словами (записи, где в заметке встречаются такие слова, необходимо исключить из выборки)
 
-    // Вектор найденных записей с упоминанием в заметках необходимых слов (пара "Документ, релевантность по TF-IDF")
-    vector<pair<RecordWithId, double>> matched_records;
-
-    // Заполняем его на основе словаря "Номер/id записи -> Релевантность по TF-IDF"
-    for (const auto [record_id, relevance] : record_to_relevance) {
-
-        // Константная ссылка на запись
-        const Record& record = records_.at(record_id);
-
-        // Добавляем запись в вектор
-        matched_records.push_back({{record_id, record.name, record.surname, record.patronymic, record.number, record.note}, relevance});
-    }
+    // Вектор из не более чем max_records_count найденных записей с упоминанием в заметках необходимых слов (пара
+    // "Документ, релевантность по TF-IDF или BM25"), отсортированный по убыванию релевантности
+    const NoteScoring scoring = MakeNoteScoring(ranking_params,
+                                                static_cast<double>(snapshot->notes_length) / static_cast<double>(max(snapshot->records.size(), size_t{1})),
+                                                snapshot->max_note_length);
+    vector<pair<RecordWithId, double>> matched_records = RankRecords(*snapshot, postings_inverse_freqs, max_records_count, scoring);
 
     // Если вектор найденных записей с упоминанием в заметках необходимых слов оказался пустым, значит записей,
     // содержащих в заметках необходимые слова, не найдено - возвращаем nullopt
@@ -581,24 +1873,6 @@ optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecords
         return nullopt;
     }
 
-    // Сортируем найденные записи по убыванию релевантности по TF-IDF
-    sort(matched_records.begin(), matched_records.end(),
-        [](const pair<RecordWithId, double>& lhs, const pair<RecordWithId, double>& rhs) {
-            return lhs.second > rhs.second;
-        });
-
-    // Замечание: записи с одинаковой релевантностью (релевантностями, которые отличаются только в 6 знаке после запятой) 
-    // можно сортировать между собой по какому-нибудь другому признаку, например по имени/фамилии/номеру телефона и т.д.
-    //
-    // Замечание: если найденных записей будет очень много, можно отсечь топ из фиксированного
-    // числа записей и сформировать ответ только с ними:
-    //
-    // const size_t MAX_RESULT_RECORDS_COUNT = 10;
-    //
-    // if (matched_records.size() > MAX_RESULT_RECORDS_COUNT) {
-    //     matched_records.resize(MAX_RESULT_RECORDS_COUNT);
-    // }
-
     // Итоговый вектор найденных записей с упоминанием в заметках необходимых слов
     // (идентичен вектору matched_records, но без значений релевантности по TF-IDF)
     vector<RecordWithId> result(matched_records.size());
@@ -616,17 +1890,360 @@ optional<vector<PhoneBookDatabase::RecordWithId>> PhoneBookDatabase::FindRecords
     return result;
 }
 
+// Функция подсчёта числа записей в базе данных, суммарной длины их заметок и числа записей, где встречается каждое из
+// слов заметок (все значения берутся из одной версии базы данных)
+PhoneBookDatabase::NoteWordsCounts PhoneBookDatabase::CountNoteWords() const {
+
+    // Получаем текущую версию базы данных
+    shared_ptr<const Snapshot> snapshot = CurrentSnapshot();
+
+    NoteWordsCounts counts;
+    counts.records_count = snapshot->records.size();
+    counts.notes_length = snapshot->notes_length;
+
+    // Число записей слова - это размер его списка записей
+    counts.word_records_counts.reserve(snapshot->note_word_to_postings.size());
+    for (const auto& [word, postings] : snapshot->note_word_to_postings) {
+        counts.word_records_counts.emplace_back(string(word), postings->size());
+    }
+
+    return counts;
+}
+
+// Функция разбора заметки на различные слова так же, как при добавлении записи, с вычислением длины заметки в словах
+vector<string_view> PhoneBookDatabase::SplitNoteWords(string_view note, size_t& note_length) {
+    vector<string_view> note_words = string_functions::SplitIntoWords(note);
+
+    // Длина заметки ограничена так же, как в AddNoteLength
+    note_length = min(note_words.size(), MAX_NOTE_LENGTH);
+
+    return string_functions::SortAndRemoveDuplicates(move(note_words));
+}
+
+// Функция ранжирования записей по содержанию заметок с заданными снаружи частотами IDF слов
+// (возвращает топ в виде вектора пар "Запись, релевантность", отсортированного по убыванию релевантности)
+vector<pair<PhoneBookDatabase::RecordWithId, double>> PhoneBookDatabase::RankRecordsByNoteWords(
+    const vector<pair<string_view, double>>& words_inverse_freqs, size_t max_records_count,
+    const NoteRankingParams& ranking_params, double average_note_length) const {
+
+    // Получаем текущую версию базы данных
+    shared_ptr<const Snapshot> snapshot = CurrentSnapshot();
+
+    // Находим списки записей слов (каждое слово ищется в словаре версии однократно, отсутствующие слова пропускаются)
+    vector<pair<const posting_list::PostingList*, double>> postings_inverse_freqs;
+    postings_inverse_freqs.reserve(words_inverse_freqs.size());
+
+    for (const auto& [word, inverse_record_freq] : words_inverse_freqs) {
+        if (const auto* word_postings = snapshot->note_word_to_postings.Find(word)) {
+            postings_inverse_freqs.push_back({word_postings->second.get(), inverse_record_freq});
+        }
+    }
+
+    // Отбираем топ записей текущей версии базы данных (средняя длина заметки общая для всех шардов, а наибольшая -
+    // своя у шарда, так как она нужна лишь для верхних границ вклада слов в релевантность записей этого шарда)
+    return RankRecords(*snapshot, postings_inverse_freqs, max_records_count,
+                       MakeNoteScoring(ranking_params, average_note_length, snapshot->max_note_length));
+}
+
+// Функция округления вклада слова в релевантность до сетки с шагом RELEVANCE_GRID_STEP
+double PhoneBookDatabase::RoundRelevance(double relevance) {
+
+    // Умножение и деление на степень двойки точны, поэтому результат - ближайшее к relevance кратное шагу сетки
+    return nearbyint(relevance / RELEVANCE_GRID_STEP) * RELEVANCE_GRID_STEP;
+}
+
+// Функция сравнения записей в топе поиска по содержанию заметок
+bool PhoneBookDatabase::HigherRelevance(size_t lhs_id, double lhs_relevance, size_t rhs_id, double rhs_relevance) {
+
+    // Релевантности сравниваются точно (вклады слов округлены до сетки, и их суммы не зависят от порядка сложения),
+    // при равной релевантности записи упорядочиваются по возрастанию номера/id
+    if (lhs_relevance != rhs_relevance) {
+        return lhs_relevance > rhs_relevance;
+    }
+    return lhs_id < rhs_id;
+}
+
+// Функция отбора топа из не более чем max_records_count записей версии базы данных по содержанию заметок
+// (общая часть FindRecordsByNote и RankRecordsByNoteWords, алгоритм MaxScore)
+vector<pair<PhoneBookDatabase::RecordWithId, double>> PhoneBookDatabase::RankRecords(
+    const Snapshot& snapshot, const vector<pair<const posting_list::PostingList*, double>>& postings_inverse_freqs,
+    size_t max_records_count, const NoteScoring& scoring) {
+
+    // Число номеров/id в одном окне (плотный массив релевантностей окна - 32 КБ - целиком помещается в кэш L1/L2)
+    constexpr size_t WINDOW_SIZE = 4096;
+
+    // Слово запроса: курсор по списку записей слова, вес слова (IDF для TF-IDF, IDF * (k1 + 1) для BM25) и верхняя
+    // граница вклада в релевантность любой записи
+    struct QueryWord {
+        posting_list::PostingList::Cursor cursor;
+        double weight;
+        double max_relevance;
+    };
+
+    // Функции вычисления вклада слова query_word в релевантность записи с номером/id record_id по частоте TF, на
+    // которую указывает курсор слова, для TF-IDF и для BM25 (для BM25 добавляется чтение длины заметки из плотного
+    // массива версии без поиска ключа; вклад округляется до сетки RELEVANCE_GRID_STEP)
+    const auto tf_idf_relevance = [](const QueryWord& query_word, size_t /*record_id*/) {
+        return RoundRelevance(query_word.cursor.Freq() * query_word.weight);
+    };
+
+    const auto bm25_relevance = [&snapshot, &scoring](const QueryWord& query_word, size_t record_id) {
+        const double term_freq = query_word.cursor.Freq();
+        const double note_length = snapshot.note_lengths.Get(record_id);
+        return RoundRelevance(query_word.weight * term_freq /
+                              (term_freq + scoring.length_weight / note_length + scoring.average_weight));
+    };
+
+    const auto word_relevance = [&](const QueryWord& query_word, size_t record_id) {
+        return scoring.bm25 ? bm25_relevance(query_word, record_id) : tf_idf_relevance(query_word, record_id);
+    };
+
+    // Пара "Номер/id записи, релевантность" и порядок топа: по убыванию релевантности, а при равной релевантности -
+    // по возрастанию номера/id (чтобы топ не зависел от порядка обхода)
+    using RecordRelevance = pair<size_t, double>;
+    const auto higher_relevance = [](const RecordRelevance& lhs, const RecordRelevance& rhs) {
+        return HigherRelevance(lhs.first, lhs.second, rhs.first, rhs.second);
+    };
+
+    if (max_records_count == 0) {
+        return {};
+    }
+
+    // Открываем курсоры по спискам записей всех слов запроса
+    vector<QueryWord> query_words;
+    query_words.reserve(postings_inverse_freqs.size());
+
+    // Вклад слова растёт и по частоте TF, и (для BM25) по длине заметки, поэтому верхняя граница вклада получается
+    // подстановкой наибольшей частоты TF списка слова и наибольшей длины заметки. Граница округляется до сетки и
+    // увеличивается на один шаг сетки: вычисленное в double отношение BM25 может отклониться от точного на несколько
+    // единиц последнего разряда, и округлённый вклад записи не должен оказаться выше границы. Суммы границ тоже
+    // кратны шагу сетки, поэтому сравниваются с порогом топа точно
+    for (const auto& [postings, inverse_record_freq] : postings_inverse_freqs) {
+        if (postings->empty()) {
+            continue;
+        }
+
+        const double max_freq = postings->MaxFreq();
+
+        if (scoring.bm25) {
+            const double weight = inverse_record_freq * scoring.saturation;
+            const double max_length_weight = scoring.length_weight / scoring.max_note_length;
+            const double max_relevance = weight * max_freq / (max_freq + max_length_weight + scoring.average_weight);
+            query_words.push_back({postings->OpenCursor(), weight,
+                                   RoundRelevance(max_relevance) + RELEVANCE_GRID_STEP});
+        }
+        else {
+            query_words.push_back({postings->OpenCursor(), inverse_record_freq,
+                                   RoundRelevance(max_freq * inverse_record_freq) + RELEVANCE_GRID_STEP});
+        }
+    }
+
+    // Упорядочиваем слова по возрастанию верхних границ вклада: необязательными становятся слова из начала вектора
+    sort(query_words.begin(), query_words.end(), [](const QueryWord& lhs, const QueryWord& rhs) {
+        return lhs.max_relevance < rhs.max_relevance;
+    });
+
+    // Суммы верхних границ вклада первых i слов (столько максимум может добавить к релевантности записи досчёт по
+    // необязательным словам, если необязательны первые i слов)
+    vector<double> prefix_max_relevances(query_words.size() + 1, 0.0);
+    for (size_t i = 0; i < query_words.size(); ++i) {
+        prefix_max_relevances[i + 1] = prefix_max_relevances[i] + query_words[i].max_relevance;
+    }
+
+    // Ограниченная куча топа из не более чем max_records_count записей (наверху кучи - худшая запись топа)
+    vector<RecordRelevance> top;
+
+    // Функция получения порога топа: релевантности худшей записи заполненного топа (пока топ не заполнен, любая
+    // запись попадает в него, и порога нет)
+    const auto top_threshold = [&top, max_records_count]() {
+        return top.size() == max_records_count ? top.front().second : -1.0;
+    };
+
+    // Функция проверки, что запись с релевантностью relevance гарантированно не догонит порог топа threshold (запись
+    // с релевантностью, равной порогу, ещё может попасть в топ благодаря меньшему номеру/id)
+    const auto below_threshold = [](double relevance, double threshold) {
+        return relevance < threshold;
+    };
+
+    // Плотный массив накопленных релевантностей записей окна и битовая маска затронутых записей окна
+    vector<double> window_relevances(WINDOW_SIZE, 0.0);
+    vector<uint64_t> window_mask(WINDOW_SIZE / 64, 0);
+
+    // Функция обхода записей окна [window_begin, window_end) в списке слова query_word с накоплением вкладов слова,
+    // вычисленных функцией relevance, в плотном массиве окна (обобщённая лямбда-функция: для каждой модели
+    // ранжирования компилятор строит свой цикл, и модель не проверяется на каждую запись)
+    const auto accumulate_window = [&window_relevances, &window_mask](QueryWord& query_word, size_t window_begin,
+                                                                      size_t window_end, const auto& relevance) {
+        while (query_word.cursor.HasPosting() && query_word.cursor.RecordId() < window_end) {
+            const size_t record_id = query_word.cursor.RecordId();
+            const size_t offset = record_id - window_begin;
+
+            window_relevances[offset] += relevance(query_word, record_id);
+            window_mask[offset / 64] |= uint64_t{1} << (offset % 64);
+
+            query_word.cursor.Next();
+        }
+    };
+
+    // Число необязательных слов (слова [0, optional_words_count) досчитываются точечно, остальные обходятся целиком)
+    size_t optional_words_count = 0;
+
+    while (true) {
+
+        // Слово становится необязательным, когда сумма верхних границ необязательных слов вместе с ним уже не догоняет
+        // порог: запись, которая встречается только в списках необязательных слов, в топ не попадёт. Если же
+        // необязательными стали все слова, ни одна ещё не обойдённая запись в топ не попадёт - отбор закончен
+        const double threshold = top_threshold();
+        while (optional_words_count < query_words.size() &&
+               below_threshold(prefix_max_relevances[optional_words_count + 1], threshold)) {
+            ++optional_words_count;
+        }
+
+        // Окно начинается с наименьшего номера/id, на который указывают курсоры обязательных слов
+        size_t window_begin = numeric_limits<size_t>::max();
+        for (size_t i = optional_words_count; i < query_words.size(); ++i) {
+            if (query_words[i].cursor.HasPosting()) {
+                window_begin = min(window_begin, query_words[i].cursor.RecordId());
+            }
+        }
+
+        if (window_begin == numeric_limits<size_t>::max()) {
+            break;
+        }
+
+        const size_t window_end = window_begin + WINDOW_SIZE;
+
+        // Обходим записи окна в списках обязательных слов и накапливаем вклады слов в плотном массиве окна
+        for (size_t i = optional_words_count; i < query_words.size(); ++i) {
+            if (scoring.bm25) {
+                accumulate_window(query_words[i], window_begin, window_end, bm25_relevance);
+            }
+            else {
+                accumulate_window(query_words[i], window_begin, window_end, tf_idf_relevance);
+            }
+        }
+
+        // Пробегаем затронутые записи окна по возрастанию номера/id (по установленным битам маски), очищая окно
+        for (size_t mask_index = 0; mask_index < window_mask.size(); ++mask_index) {
+            for (uint64_t bits = window_mask[mask_index]; bits != 0; bits &= bits - 1) {
+                const size_t offset = mask_index * 64 + static_cast<size_t>(__builtin_ctzll(bits));
+                const size_t record_id = window_begin + offset;
+
+                double relevance = window_relevances[offset];
+                window_relevances[offset] = 0.0;
+
+                // Досчитываем запись по необязательным словам, начиная со слова с наибольшей границей, пока запись
+                // ещё может догнать порог топа
+                bool can_enter_top = true;
+
+                for (size_t i = optional_words_count; i > 0; --i) {
+                    if (below_threshold(relevance + prefix_max_relevances[i], top_threshold())) {
+                        can_enter_top = false;
+                        break;
+                    }
+
+                    QueryWord& query_word = query_words[i - 1];
+                    query_word.cursor.NextGEQ(record_id);
+
+                    if (query_word.cursor.HasPosting() && query_word.cursor.RecordId() == record_id) {
+                        relevance += word_relevance(query_word, record_id);
+                    }
+                }
+
+                // Предлагаем запись в топ: она попадает в кучу, только если куча не заполнена или запись лучше
+                // худшей записи топа (O(log k) на запись)
+                if (!can_enter_top) {
+                    continue;
+                }
+
+                if (top.size() < max_records_count) {
+                    top.emplace_back(record_id, relevance);
+                    push_heap(top.begin(), top.end(), higher_relevance);
+                }
+                else if (higher_relevance({record_id, relevance}, top.front())) {
+                    pop_heap(top.begin(), top.end(), higher_relevance);
+                    top.back() = {record_id, relevance};
+                    push_heap(top.begin(), top.end(), higher_relevance);
+                }
+            }
+
+            window_mask[mask_index] = 0;
+        }
+    }
+
+    // Упорядочиваем кучу топа по убыванию релевантности (O(k log k) вместо сортировки всех найденных записей)
+    sort_heap(top.begin(), top.end(), higher_relevance);
+
+    // Вектор найденных записей топа (пара "Документ, релевантность"), строки копируются только у них
+    vector<pair<RecordWithId, double>> matched_records;
+    matched_records.reserve(top.size());
+
+    for (const auto& [record_id, relevance] : top) {
+
+        // Константная ссылка на запись
+        const Record& record = *snapshot.records.at(record_id);
+
+        // Добавляем запись в вектор
+        matched_records.push_back({{record_id, record.name, record.surname, record.patronymic, record.number, record.note}, relevance});
+    }
+
+    // Возвращаем вектор найденных записей, отсортированный по убыванию релевантности
+    return matched_records;
+}
+
+// Функция вычисления частоты IDF слова для BM25
+double PhoneBookDatabase::ComputeWordBM25InverseDocumentFreq(size_t records_count, size_t word_records_count) {
+
+    // Частота IDF для BM25 вычисляется по формуле (вариант с единицей под логарифмом, который никогда не становится
+    // отрицательным даже для слов, встречающихся в заметках больше чем половины записей):
+    //
+    // IDF = log(1 + (Число записей - Число записей со словом + 0.5) / (Число записей со словом + 0.5))
+    // (https://en.wikipedia.org/wiki/Okapi_BM25)
+
+    const double records = static_cast<double>(records_count);
+    const double word_records = static_cast<double>(word_records_count);
+
+    return log(1.0 + (records - word_records + 0.5) / (word_records + 0.5));
+}
+
+// Функция построения оценки вклада слов по параметрам ранжирования
+PhoneBookDatabase::NoteScoring PhoneBookDatabase::MakeNoteScoring(const NoteRankingParams& ranking_params,
+                                                                  double average_note_length, size_t max_note_length) {
+    NoteScoring scoring;
+
+    if (ranking_params.ranking != NoteRanking::BM25) {
+        return scoring;
+    }
+
+    // Приводим параметры к допустимым значениям (k1 >= 0, 0 <= b <= 1), а среднюю и наибольшую длины заметки - к
+    // положительным (если заметок ещё нет, слов для ранжирования тоже нет, и значения длин ни на что не влияют)
+    const double k1 = max(ranking_params.bm25_k1, 0.0);
+    const double b = clamp(ranking_params.bm25_b, 0.0, 1.0);
+
+    scoring.bm25 = true;
+    scoring.saturation = k1 + 1.0;
+    scoring.length_weight = k1 * (1.0 - b);
+    scoring.average_weight = k1 * b / (average_note_length > 0.0 ? average_note_length : 1.0);
+    scoring.max_note_length = static_cast<double>(max(max_note_length, size_t{1}));
+
+    return scoring;
+}
+
 // Функция вычисления частоты IDF слова
 // (нужна для работы функции поиска записей по содержанию заметок)
-double PhoneBookDatabase::ComputeWordInverseDocumentFreq(string_view word) const {
+double PhoneBookDatabase::ComputeWordInverseDocumentFreq(double log_records_count, double log_word_records_count) {
 
     // Частота IDF (Inverse Document Frequency) для слова вычисляется по формуле:
     //
     // IDF = log(Число записей в базе данных / Число записей, где слово встречается в заметке)
     // (https://ru.wikipedia.org/wiki/TF-IDF)
+    //
+    // Логарифм частного раскладывается в разность логарифмов: логарифм числа записей в базе данных вычисляется
+    // один раз на запрос, а логарифм числа записей слова хранится в его списке записей (у шардированной базы данных -
+    // в глобальной таблице слов заметок) и пересчитывается только при изменении, поэтому здесь логарифм не вычисляется
+    // вовсе
 
-    return log(static_cast<double>(records_.size()) /
-               static_cast<double>(note_word_to_record_freqs_.at(word).size()));
+    return log_records_count - log_word_records_count;
 }
 
 }
\ No newline at end of file
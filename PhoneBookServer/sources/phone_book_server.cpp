@@ -25,24 +25,24 @@ namespace connection_processing_functions {
 // Функция обработки запроса на добавление записи (тип 1-1)
 // (клиент получает код ответа: 0 - запись с таким номером телефона уже существует,
 //                              1 - запись успешно добавлена)
-void AddRecordProcessingFunction(PhoneBookDatabase& database,
+void AddRecordProcessingFunction(ShardedPhoneBookDatabase& database,
                                  RecordRequest* request,
                                  AddRecordResponse* response,
                                  const void* handler_tag) {
 
-    // Информируем в консоль о поступлении запроса на добавление записи 
-    cout << "[1-1 handler #"s << handler_tag << "]: AddRecord request, name=\""s       << request->name()       << 
-                                                                  "\", surname=\""s    << request->surname()    <<
-                                                                  "\", patronymic=\""s << request->patronymic() <<
-                                                                  "\", number=\""s     << request->number()     <<
-                                                                  "\", note=\""s       << request->note()       << "\""s << endl;
+    // Записываем в журнал сообщение о поступлении запроса на добавление записи 
+    PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << handler_tag << "]: AddRecord request, name=\""s       << request->name()       << 
+                                                                               "\", surname=\""s    << request->surname()    <<
+                                                                               "\", patronymic=\""s << request->patronymic() <<
+                                                                               "\", number=\""s     << request->number()     <<
+                                                                               "\", note=\""s       << request->note()       << "\""s);
 
     // Записываем в структуру данные для добавления записи в базу данных
-    PhoneBookDatabase::Record record({request->name(),
-                                      request->surname(),
-                                      request->patronymic(),
-                                      request->number(),
-                                      request->note()});
+    ShardedPhoneBookDatabase::Record record({request->name(),
+                                             request->surname(),
+                                             request->patronymic(),
+                                             request->number(),
+                                             request->note()});
     
     // Добавляем запись в базу данных, получаем код ответа
     // (0 - запись с таким номером телефона уже существует, 1 - запись успешно добавлена)
@@ -52,16 +52,87 @@ void AddRecordProcessingFunction(PhoneBookDatabase& database,
     response->set_code(code);
 }
 
+// Функция приёма очередного запроса на пакетное добавление записей
+void AddRecordsAccumulator::Add(RecordRequest* request, AddRecordsResponse* response) {
+
+    // Записываем в журнал сообщение о поступлении очередной записи
+    PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << handler_tag_ << "]: AddRecords request, name=\""s       << request->name()       <<
+                                                                                 "\", surname=\""s    << request->surname()    <<
+                                                                                 "\", patronymic=\""s << request->patronymic() <<
+                                                                                 "\", number=\""s     << request->number()     <<
+                                                                                 "\", note=\""s       << request->note()       << "\""s);
+
+    // Забираем строки запроса перемещением (сообщение запроса всё равно будет очищено перед чтением следующего)
+    records_.push_back({move(*request->mutable_name()),
+                        move(*request->mutable_surname()),
+                        move(*request->mutable_patronymic()),
+                        move(*request->mutable_number()),
+                        move(*request->mutable_note())});
+
+    // Если пачка заполнена, добавляем её в базу данных
+    if (records_.size() >= BATCH_SIZE) {
+        Flush(response);
+    }
+}
+
+// Функция окончания потока запросов на пакетное добавление записей
+void AddRecordsAccumulator::Finish(AddRecordsResponse* response) {
+
+    // Добавляем в базу данных последнюю неполную пачку
+    if (!records_.empty()) {
+        Flush(response);
+    }
+
+    // Записываем в журнал итоги пакетного добавления
+    PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << handler_tag_ << "]: AddRecords finished, added="s << response->added_count() <<
+                         ", rejected="s << response->rejected_count());
+}
+
+// Функция добавления накопленной пачки записей в базу данных и дописывания её кодов ответа в ответ
+void AddRecordsAccumulator::Flush(AddRecordsResponse* response) {
+
+    // Добавляем пачку в базу данных, получаем коды ответа по каждой записи
+    // (0 - запись с таким номером телефона уже существует, 1 - запись успешно добавлена)
+    const vector<size_t> codes = database_.AddRecords(records_);
+
+    // Дописываем коды ответа в ответ и обновляем итоговые счётчики
+    response->mutable_codes()->Reserve(response->codes_size() + static_cast<int>(codes.size()));
+
+    size_t added_count = 0;
+    for (size_t code : codes) {
+        response->add_codes(static_cast<uint32_t>(code));
+        added_count += code;
+    }
+
+    response->set_added_count(response->added_count() + static_cast<uint32_t>(added_count));
+    response->set_rejected_count(response->rejected_count() + static_cast<uint32_t>(codes.size() - added_count));
+
+    // Очищаем пачку (память вектора сохраняется для следующей пачки)
+    records_.clear();
+}
+
+// Функция обработки запроса на пакетное добавление записей (тип M-1)
+// (клиент получает коды ответа по каждой записи: 0 - запись с таким номером телефона уже существует,
+//                                                1 - запись успешно добавлена,
+//  а также число добавленных и число отклонённых записей)
+AddRecordsAccumulator AddRecordsProcessingFunction(ShardedPhoneBookDatabase& database, const void* handler_tag) {
+
+    // Записываем в журнал сообщение об открытии потока запросов на пакетное добавление записей
+    PHONE_BOOK_LOG_DEBUG("[M-1 handler #"s << handler_tag << "]: AddRecords stream has been opened"s);
+
+    return AddRecordsAccumulator(database, handler_tag);
+}
+
 // Функция обработки запроса на удаление записи по номеру записи (тип 1-1)
 // (клиент получает код ответа: 0 - записи с таким номером/id не существует,
 //                              1 - запись успешно удалена)
-void DeleteRecordByIdProcessingFunction(PhoneBookDatabase& database,
+void DeleteRecordByIdProcessingFunction(ShardedPhoneBookDatabase& database,
                                         DeleteRecordByIdRequest* request,
                                         DeleteRecordResponse* response,
                                         const void* handler_tag) {
 
-    // Информируем в консоль о поступлении запроса на удаление записи по номеру записи
-    cout << "[1-1 handler #"s << handler_tag << "]: DeleteRecordById request, id=\""s << request->id() << "\""s << endl;
+    // Записываем в журнал сообщение о поступлении запроса на удаление записи по номеру записи
+    PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << handler_tag << "]: DeleteRecordById request, id=\""s << request->id() << "\""s);
 
     // Удаляем запись из базы данных, получаем код ответа
     // (0 - записи с таким номером/id не существует, 1 - запись успешно удалена)
@@ -74,13 +145,13 @@ void DeleteRecordByIdProcessingFunction(PhoneBookDatabase& database,
 // Функция обработки запроса на удаление записи по номеру телефона (тип 1-1)
 // (клиент получает код ответа: 0 - записи с таким номером телефона не существует,
 //                              1 - запись успешно удалена)
-void DeleteRecordByNumberProcessingFunction(PhoneBookDatabase& database,
+void DeleteRecordByNumberProcessingFunction(ShardedPhoneBookDatabase& database,
                                             DeleteRecordByNumberRequest* request,
                                             DeleteRecordResponse* response,
                                             const void* handler_tag) {
 
-    // Информируем в консоль о поступлении запроса на удаление записи по номеру телефона
-    cout << "[1-1 handler #"s << handler_tag << "]: DeleteRecordByNumber request, number=\""s << request->number() << "\""s << endl;
+    // Записываем в журнал сообщение о поступлении запроса на удаление записи по номеру телефона
+    PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << handler_tag << "]: DeleteRecordByNumber request, number=\""s << request->number() << "\""s);
 
     // Удаляем запись из базы данных, получаем код ответа
     // (0 - записи с таким номером телефона не существует, 1 - запись успешно удалена)
@@ -92,16 +163,16 @@ void DeleteRecordByNumberProcessingFunction(PhoneBookDatabase& database,
 
 // Функция обработки запроса на поиск записи по номеру/id записи (тип 1-1)
 // (найденная запись может быть только одна или её может не быть вовсе, тогда формируем пустой ответ с id = 0)
-void FindRecordByIdProcessingFunction(PhoneBookDatabase& database,
+void FindRecordByIdProcessingFunction(ShardedPhoneBookDatabase& database,
                                       FindRecordByIdRequest* request,
                                       RecordResponse* response,
                                       const void* handler_tag) {
 
-    // Информируем в консоль о поступлении запроса на поиск записи по номеру/id записи
-    cout << "[1-1 handler #"s << handler_tag << "]: FindRecordById request, id=\""s << request->id() << "\""s << endl;
+    // Записываем в журнал сообщение о поступлении запроса на поиск записи по номеру/id записи
+    PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << handler_tag << "]: FindRecordById request, id=\""s << request->id() << "\""s);
 
     // Ищем запись в базе данных, если её нет - получаем nullopt
-    optional<PhoneBookDatabase::RecordWithId> record = database.FindRecordById(request->id());
+    optional<ShardedPhoneBookDatabase::RecordWithId> record = database.FindRecordById(request->id());
 
     // Если запись была найдена, формируем ответ клиенту с ней
     if(record.has_value()) {
@@ -116,114 +187,123 @@ void FindRecordByIdProcessingFunction(PhoneBookDatabase& database,
     // Иначе формируем пустую запись с id = 0, для этого ничего не надо делать
 }
 
-// Функция обработки запроса на поиск записей по имени (тип 1-M)
-// (найденных записей может быть множество или не быть вовсе, тогда формируем пустой вектор ответов)
-void FindRecordsByNameProcessingFunction(PhoneBookDatabase& database,
-                                         FindRecordsByNameRequest* request,
-                                         vector<RecordResponse>* response,
-                                         const void* handler_tag) {
-
-    // Информируем в консоль о поступлении запроса на поиск записи по имени
-    cout << "[1-M handler #"s << handler_tag << "]: FindRecordsByName request, name=\""s << request->name() << "\""s << endl;
-
-    // Ищем записи в базе данных, если их нет - получаем nullopt
-    optional<vector<PhoneBookDatabase::RecordWithId>> records = database.FindRecordsByName(request->name());
-
-    // Если записи были найдены, формируем ответ клиенту с ними
-    if(records.has_value()) {
-        for(const PhoneBookDatabase::RecordWithId& record : records.value()) {
-            RecordResponse response_element;
-
-            response_element.set_id        (record.id        );
-            response_element.set_name      (record.name      );
-            response_element.set_surname   (record.surname   );
-            response_element.set_patronymic(record.patronymic);
-            response_element.set_number    (record.number    );
-            response_element.set_note      (record.note      );
-
-            response->push_back(response_element);
-        }
+// Функция заполнения очередного ответа курсором ответов по записям из курсора базы данных
+// (возвращает false, если записи закончились)
+bool RecordsCursorResponses::Next(RecordResponse* response) {
+
+    // Если записи взяты из общего вектора, отвечаем по нему
+    if (shared_records_.Next(response)) {
+        return true;
     }
 
-    // Иначе формируем пустой вектор ответов, для этого ничего не надо делать
+    // Если записи закончились, ответов больше нет
+    if(!cursor_.HasRecord()) {
+        return false;
+    }
+
+    // Заполняем ответ текущей записью (запись не копируется, строки копируются сразу в ответ)
+    const ShardedPhoneBookDatabase::Record& record = cursor_.CurrentRecord();
+
+    response->set_id        (cursor_.RecordId());
+    response->set_name      (record.name       );
+    response->set_surname   (record.surname    );
+    response->set_patronymic(record.patronymic );
+    response->set_number    (record.number     );
+    response->set_note      (record.note       );
+
+    // Переходим к следующей записи
+    cursor_.Next();
+    return true;
 }
 
-// Функция обработки запроса на поиск записей по фамилии (тип 1-M)
-// (найденных записей может быть множество или не быть вовсе, тогда формируем пустой вектор ответов)
-void FindRecordsBySurnameProcessingFunction(PhoneBookDatabase& database,
-                                            FindRecordsBySurnameRequest* request,
-                                            vector<RecordResponse>* response,
-                                            const void* handler_tag) {
+// Функция заполнения очередного ответа курсором ответов по вектору записей
+// (возвращает false, если записи закончились)
+bool RecordsVectorResponses::Next(RecordResponse* response) {
 
-    // Информируем в консоль о поступлении запроса на поиск записи по фамилии
-    cout << "[1-M handler #"s << handler_tag << "]: FindRecordsBySurname request, surname=\""s << request->surname() << "\""s << endl;
+    // Если записей нет или они закончились, ответов больше нет
+    if(!records_ || position_ == records_->size()) {
+        return false;
+    }
 
-    // Ищем записи в базе данных, если их нет - получаем nullopt
-    optional<vector<PhoneBookDatabase::RecordWithId>> records = database.FindRecordsBySurname(request->surname());
+    // Заполняем ответ очередной записью (вектор общий для одинаковых одновременных запросов, поэтому строки копируются)
+    const ShardedPhoneBookDatabase::RecordWithId& record = (*records_)[position_++];
 
-    // Если записи были найдены, формируем ответ клиенту с ними
-    if(records.has_value()) {
-        for(const PhoneBookDatabase::RecordWithId& record : records.value()) {
-            RecordResponse response_element;
+    response->set_id        (record.id        );
+    response->set_name      (record.name      );
+    response->set_surname   (record.surname   );
+    response->set_patronymic(record.patronymic);
+    response->set_number    (record.number    );
+    response->set_note      (record.note      );
 
-            response_element.set_id        (record.id        );
-            response_element.set_name      (record.name      );
-            response_element.set_surname   (record.surname   );
-            response_element.set_patronymic(record.patronymic);
-            response_element.set_number    (record.number    );
-            response_element.set_note      (record.note      );
+    return true;
+}
 
-            response->push_back(response_element);
-        }
+// Функция обработки запроса на поиск записей по имени (тип 1-M)
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsCursorResponses FindRecordsByNameProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                           FindRecordsByNameRequest* request,
+                                                           const void* handler_tag) {
+
+    // Записываем в журнал сообщение о поступлении запроса на поиск записи по имени
+    PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << handler_tag << "]: FindRecordsByName request, name=\""s << request->name() << "\""s);
+
+    // Небольшой результат берём из общего вектора записей (одинаковые одновременные запросы выполняются один раз)
+    if (ShardedPhoneBookDatabase::SharedRecords records = database.ShareRecordsByName(request->name())) {
+        return RecordsCursorResponses(move(records));
+    }
+
+    // Иначе открываем курсор по найденным записям (записи будут читаться из базы данных по одной при отправке ответов)
+    return RecordsCursorResponses(database.OpenRecordsByName(request->name()));
+}
+
+// Функция обработки запроса на поиск записей по фамилии (тип 1-M)
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsCursorResponses FindRecordsBySurnameProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                              FindRecordsBySurnameRequest* request,
+                                                              const void* handler_tag) {
+
+    // Записываем в журнал сообщение о поступлении запроса на поиск записи по фамилии
+    PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << handler_tag << "]: FindRecordsBySurname request, surname=\""s << request->surname() << "\""s);
+
+    // Небольшой результат берём из общего вектора записей (одинаковые одновременные запросы выполняются один раз)
+    if (ShardedPhoneBookDatabase::SharedRecords records = database.ShareRecordsBySurname(request->surname())) {
+        return RecordsCursorResponses(move(records));
     }
 
-    // Иначе формируем пустой вектор ответов, для этого ничего не надо делать
+    // Иначе открываем курсор по найденным записям (записи будут читаться из базы данных по одной при отправке ответов)
+    return RecordsCursorResponses(database.OpenRecordsBySurname(request->surname()));
 }
 
 // Функция обработки запроса на поиск записей по отчеству (тип 1-M)
-// (найденных записей может быть множество или не быть вовсе, тогда формируем пустой вектор ответов)
-void FindRecordsByPatronymicProcessingFunction(PhoneBookDatabase& database,
-                                               FindRecordsByPatronymicRequest* request,
-                                               vector<RecordResponse>* response,
-                                               const void* handler_tag) {
-
-    // Информируем в консоль о поступлении запроса на поиск записи по отчеству
-    cout << "[1-M handler #"s << handler_tag << "]: FindRecordsByPatronymic request, patronymic=\""s << request->patronymic() << "\""s << endl;
-
-    // Ищем записи в базе данных, если их нет - получаем nullopt
-    optional<vector<PhoneBookDatabase::RecordWithId>> records = database.FindRecordsByPatronymic(request->patronymic());
-
-    // Если записи были найдены, формируем ответ клиенту с ними
-    if(records.has_value()) {
-        for(const PhoneBookDatabase::RecordWithId& record : records.value()) {
-            RecordResponse response_element;
-
-            response_element.set_id        (record.id        );
-            response_element.set_name      (record.name      );
-            response_element.set_surname   (record.surname   );
-            response_element.set_patronymic(record.patronymic);
-            response_element.set_number    (record.number    );
-            response_element.set_note      (record.note      );
-
-            response->push_back(response_element);
-        }
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsCursorResponses FindRecordsByPatronymicProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                                 FindRecordsByPatronymicRequest* request,
+                                                                 const void* handler_tag) {
+
+    // Записываем в журнал сообщение о поступлении запроса на поиск записи по отчеству
+    PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << handler_tag << "]: FindRecordsByPatronymic request, patronymic=\""s << request->patronymic() << "\""s);
+
+    // Небольшой результат берём из общего вектора записей (одинаковые одновременные запросы выполняются один раз)
+    if (ShardedPhoneBookDatabase::SharedRecords records = database.ShareRecordsByPatronymic(request->patronymic())) {
+        return RecordsCursorResponses(move(records));
     }
 
-    // Иначе формируем пустой вектор ответов, для этого ничего не надо делать
+    // Иначе открываем курсор по найденным записям (записи будут читаться из базы данных по одной при отправке ответов)
+    return RecordsCursorResponses(database.OpenRecordsByPatronymic(request->patronymic()));
 }
 
 // Функция обработки запроса на поиск записи по номеру телефона (тип 1-1)
 // (найденная запись может быть только одна или её может не быть вовсе, тогда формируем пустой ответ с id = 0)
-void FindRecordByNumberProcessingFunction(PhoneBookDatabase& database,
+void FindRecordByNumberProcessingFunction(ShardedPhoneBookDatabase& database,
                                           FindRecordByNumberRequest* request,
                                           RecordResponse* response,
                                           const void* handler_tag) {
 
-    // Информируем в консоль о поступлении запроса на поиск записи по номеру/id записи
-    cout << "[1-1 handler #"s << handler_tag << "]: FindRecordByNumber request, number=\""s << request->number() << "\""s << endl;
+    // Записываем в журнал сообщение о поступлении запроса на поиск записи по номеру/id записи
+    PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << handler_tag << "]: FindRecordByNumber request, number=\""s << request->number() << "\""s);
 
     // Ищем запись в базе данных, если её нет - получаем nullopt
-    optional<PhoneBookDatabase::RecordWithId> record = database.FindRecordByNumber(request->number());
+    optional<ShardedPhoneBookDatabase::RecordWithId> record = database.FindRecordByNumber(request->number());
 
     // Если запись была найдена, формируем ответ клиенту с ней
     if(record.has_value()) {
@@ -238,50 +318,181 @@ void FindRecordByNumberProcessingFunction(PhoneBookDatabase& database,
     // Иначе формируем пустую запись с id = 0, для этого ничего не надо делать
 }
 
-// Функция обработки запроса на поиск записей по заметке (тип 1-M)
-// (найденных записей может быть множество или не быть вовсе, тогда формируем пустой вектор ответов)
-void FindRecordsByNoteProcessingFunction(PhoneBookDatabase& database,
-                                         FindRecordsByNoteRequest* request,
-                                         vector<RecordResponse>* response,
-                                         const void* handler_tag) {
-
-    // Информируем в консоль о поступлении запроса на поиск записи по заметке
-    cout << "[1-M handler #"s << handler_tag << "]: FindRecordsByNote request, note=\""s << request->note() << "\""s << endl;
-
-    // Ищем записи в базе данных, если их нет - получаем nullopt
-    optional<vector<PhoneBookDatabase::RecordWithId>> records = database.FindRecordsByNote(request->note());
-
-    // Если записи были найдены, формируем ответ клиенту с ними
-    if(records.has_value()) {
-        for(const PhoneBookDatabase::RecordWithId& record : records.value()) {
-            RecordResponse response_element;
-
-            response_element.set_id        (record.id        );
-            response_element.set_name      (record.name      );
-            response_element.set_surname   (record.surname   );
-            response_element.set_patronymic(record.patronymic);
-            response_element.set_number    (record.number    );
-            response_element.set_note      (record.note      );
-
-            response->push_back(response_element);
+// Функция заполнения пачки найденными записями в порядке ключей запроса (для ненайденного ключа в пачку добавляется
+// пустая запись с id = 0; строки записей больше не нужны, поэтому перемещаются в ответ)
+static void FillRecordBatch(vector<optional<ShardedPhoneBookDatabase::RecordWithId>> records, RecordBatch* response) {
+    response->mutable_records()->Reserve(static_cast<int>(records.size()));
+
+    for (optional<ShardedPhoneBookDatabase::RecordWithId>& record : records) {
+        RecordResponse* record_response = response->add_records();
+
+        if (record.has_value()) {
+            record_response->set_id        (     record->id         );
+            record_response->set_name      (move(record->name      ));
+            record_response->set_surname   (move(record->surname   ));
+            record_response->set_patronymic(move(record->patronymic));
+            record_response->set_number    (move(record->number    ));
+            record_response->set_note      (move(record->note      ));
         }
     }
+}
+
+// Функция обработки запроса на пакетный поиск записей по номерам/id записей (тип 1-1)
+// (ответ содержит по одной записи на каждый номер/id в порядке запроса, для ненайденного - пустую запись с id = 0)
+void FindRecordsByIdsProcessingFunction(ShardedPhoneBookDatabase& database,
+                                        FindRecordsByIdsRequest* request,
+                                        RecordBatch* response,
+                                        const void* handler_tag) {
 
-    // Иначе формируем пустой вектор ответов, для этого ничего не надо делать
+    // Записываем в журнал сообщение о поступлении запроса на пакетный поиск записей по номерам/id записей
+    PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << handler_tag << "]: FindRecordsByIds request, "s << request->ids_size() << " ids"s);
+
+    // Ищем записи в базе данных одним пакетным запросом
+    const vector<size_t> ids(request->ids().begin(), request->ids().end());
+    FillRecordBatch(database.FindRecordsByIds(ids), response);
 }
 
+// Функция обработки запроса на пакетный поиск записей по номерам телефонов (тип 1-1)
+// (ответ содержит по одной записи на каждый номер телефона в порядке запроса, для ненайденного - пустую запись с id = 0)
+void FindRecordsByNumbersProcessingFunction(ShardedPhoneBookDatabase& database,
+                                            FindRecordsByNumbersRequest* request,
+                                            RecordBatch* response,
+                                            const void* handler_tag) {
+
+    // Записываем в журнал сообщение о поступлении запроса на пакетный поиск записей по номерам телефонов
+    PHONE_BOOK_LOG_DEBUG("[1-1 handler #"s << handler_tag << "]: FindRecordsByNumbers request, "s << request->numbers_size() << " numbers"s);
+
+    // Забираем номера телефонов из запроса перемещением (запрос больше не нужен) и ищем записи в базе данных одним
+    // пакетным запросом
+    vector<string> numbers;
+    numbers.reserve(request->numbers_size());
+    for (string& number : *request->mutable_numbers()) {
+        numbers.push_back(move(number));
+    }
+
+    FillRecordBatch(database.FindRecordsByNumbers(numbers), response);
+}
+
+// Функция обработки запроса на поиск записей по заметке (тип 1-M)
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsVectorResponses FindRecordsByNoteProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                           FindRecordsByNoteRequest* request,
+                                                           const void* handler_tag) {
+
+    // Записываем в журнал сообщение о поступлении запроса на поиск записи по заметке
+    PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << handler_tag << "]: FindRecordsByNote request, note=\""s << request->note()
+                         << "\", limit="s << request->limit() << ", ranking="s << phone_book_proto::NoteRanking_Name(request->ranking()));
+
+    // Максимальное число записей в ответе (нулевое ограничение в запросе означает, что нужны все найденные записи)
+    const size_t max_records_count = request->limit() == 0 ? numeric_limits<size_t>::max() : request->limit();
+
+    // Параметры ранжирования (не заданные в запросе параметры BM25 остаются значениями по умолчанию)
+    NoteRankingParams ranking_params;
+    if (request->ranking() == phone_book_proto::BM25) {
+        ranking_params.ranking = phone_book_database::NoteRanking::BM25;
+    }
+    if (request->has_bm25_k1()) {
+        ranking_params.bm25_k1 = request->bm25_k1();
+    }
+    if (request->has_bm25_b()) {
+        ranking_params.bm25_b = request->bm25_b();
+    }
+
+    // Ищем топ записей в базе данных (их необходимо вначале ранжировать по релевантности; одинаковые одновременные
+    // запросы выполняются один раз и получают общий топ), если их нет - получаем nullptr
+    ShardedPhoneBookDatabase::SharedRecords records = database.ShareRecordsByNote(request->note(), max_records_count, ranking_params);
+
+    // Возвращаем курсор ответов по найденным записям (или пустой курсор, если записей не найдено)
+    return RecordsVectorResponses(move(records));
+}
+
+// Функция обработки запроса на поиск записей по нескольким полям сразу (тип 1-M)
+// (найденных записей может быть множество или не быть вовсе, тогда курсор ответов сразу пуст)
+RecordsCursorResponses FindRecordsProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                     FindRecordsRequest* request,
+                                                     const void* handler_tag) {
+
+    // Записываем в журнал сообщение о поступлении запроса на поиск записей по нескольким полям сразу (незаданные
+    // поля отмечаются как "*")
+    PHONE_BOOK_LOG_DEBUG("[1-M handler #"s << handler_tag << "]: FindRecords request, name="s
+                         << (request->has_name() ? "\""s + request->name() + "\""s : "*"s) << ", surname="s
+                         << (request->has_surname() ? "\""s + request->surname() + "\""s : "*"s) << ", patronymic="s
+                         << (request->has_patronymic() ? "\""s + request->patronymic() + "\""s : "*"s) << ", note=\""s
+                         << request->note() << "\""s);
+
+    // Забираем условия из запроса перемещением (запрос больше не нужен)
+    phone_book_database::RecordsQuery query;
+    if (request->has_name()) {
+        query.name = move(*request->mutable_name());
+    }
+    if (request->has_surname()) {
+        query.surname = move(*request->mutable_surname());
+    }
+    if (request->has_patronymic()) {
+        query.patronymic = move(*request->mutable_patronymic());
+    }
+    query.note = move(*request->mutable_note());
+
+    // Открываем курсор по пересечению (пересечение вычисляется сразу, а записи будут читаться из базы данных по одной
+    // при отправке ответов)
+    return RecordsCursorResponses(database.OpenRecordsByQuery(query));
+}
+
+
+// Функция обработки пакетного варианта запроса на поиск записей по имени (тип 1-M)
+RecordBatchResponses<RecordsCursorResponses> FindRecordsByNameBatchedProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                                                        FindRecordsByNameRequest* request,
+                                                                                        const void* handler_tag) {
+    return RecordBatchResponses<RecordsCursorResponses>(FindRecordsByNameProcessingFunction(database, request, handler_tag),
+                                                        request->batch_limits());
+}
+
+// Функция обработки пакетного варианта запроса на поиск записей по фамилии (тип 1-M)
+RecordBatchResponses<RecordsCursorResponses> FindRecordsBySurnameBatchedProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                                                           FindRecordsBySurnameRequest* request,
+                                                                                           const void* handler_tag) {
+    return RecordBatchResponses<RecordsCursorResponses>(FindRecordsBySurnameProcessingFunction(database, request, handler_tag),
+                                                        request->batch_limits());
+}
+
+// Функция обработки пакетного варианта запроса на поиск записей по отчеству (тип 1-M)
+RecordBatchResponses<RecordsCursorResponses> FindRecordsByPatronymicBatchedProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                                                              FindRecordsByPatronymicRequest* request,
+                                                                                              const void* handler_tag) {
+    return RecordBatchResponses<RecordsCursorResponses>(FindRecordsByPatronymicProcessingFunction(database, request, handler_tag),
+                                                        request->batch_limits());
+}
+
+// Функция обработки пакетного варианта запроса на поиск записей по заметке (тип 1-M)
+RecordBatchResponses<RecordsVectorResponses> FindRecordsByNoteBatchedProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                                                        FindRecordsByNoteRequest* request,
+                                                                                        const void* handler_tag) {
+    return RecordBatchResponses<RecordsVectorResponses>(FindRecordsByNoteProcessingFunction(database, request, handler_tag),
+                                                        request->batch_limits());
 }
 
-// Конструктор сервера принимает IP-адрес сервера, порт для работы сервера и неконстантную ссылку на базу
-// данных телефонной книги, инициализирует nullptr'ом указатель на поток выполнения сервера и 
+// Функция обработки пакетного варианта запроса на поиск записей по нескольким полям сразу (тип 1-M)
+RecordBatchResponses<RecordsCursorResponses> FindRecordsBatchedProcessingFunction(ShardedPhoneBookDatabase& database,
+                                                                                  FindRecordsRequest* request,
+                                                                                  const void* handler_tag) {
+    return RecordBatchResponses<RecordsCursorResponses>(FindRecordsProcessingFunction(database, request, handler_tag),
+                                                        request->batch_limits());
+}
+}
+
+// Конструктор сервера принимает IP-адрес сервера, порт для работы сервера, неконстантную ссылку на базу
+// данных телефонной книги, число очередей handler'ов и число потоков, обслуживающих одну очередь, и
 // устанавливает статус сервера в CREATED
 PhoneBookServer::PhoneBookServer(const string& ip,
                                  uint16_t port,
-                                 PhoneBookDatabase& database) : ip_(ip),
-                                                                port_(port),
-                                                                database_(database),
-                                                                server_thread_(nullptr),
-                                                                server_status_(ServerStatus::CREATED) { }
+                                 ShardedPhoneBookDatabase& database,
+                                 size_t queues_count,
+                                 size_t threads_per_queue_count) : ip_(ip),
+                                                                   port_(port),
+                                                                   queues_count_(max<size_t>(queues_count, 1)),
+                                                                   threads_per_queue_count_(max<size_t>(threads_per_queue_count, 1)),
+                                                                   server_status_(ServerStatus::CREATED),
+                                                                   database_(database) { }
 
 // Деструктор сервера
 PhoneBookServer::~PhoneBookServer() {
@@ -294,7 +505,7 @@ PhoneBookServer::~PhoneBookServer() {
     // Сохраняем данные из базы данных в файл
     database_.SaveToFile();
 
-    // Помимо этого, умные указатели (RAII-объекты) на объект gRPC-сервера и объект очереди handler'ов соединений
+    // Помимо этого, умные указатели (RAII-объекты) на объект gRPC-сервера и объекты очередей handler'ов соединений
     // уничтожат объекты, на которые они ссылаются, высвобождая ресурсы в heap'е
 }
 
@@ -323,8 +534,8 @@ void PhoneBookServer::RunInNewThread() {
     // Полный адрес сервера с портом
     string address = ip_ + ":"s + to_string(port_);
 
-    // Информируем в консоль о начале запуска сервера на указанном адресе
-    cout << "[Starting server listening on "s << address << " ...]"s << endl;
+    // Записываем в журнал сообщение о начале запуска сервера на указанном адресе
+    PHONE_BOOK_LOG_INFO("[Starting server listening on "s << address << " ...]"s);
 
     // Factory/builder для создания gRPC-сервера
     ServerBuilder builder;
@@ -335,8 +546,10 @@ void PhoneBookServer::RunInNewThread() {
     // Зарегистрируем наш сервис асинхронной gRPC-коммуникации за нашим gRPC-сервером
     builder.RegisterService(&service_);
 
-    // Зарегистрируем нашу очередь handler'ов за нашим gRPC-сервером
-    handlers_queue_ = builder.AddCompletionQueue();
+    // Зарегистрируем наши очереди handler'ов за нашим gRPC-сервером
+    for(size_t i = 0; i < queues_count_; ++i) {
+        handlers_queues_.push_back(builder.AddCompletionQueue());
+    }
 
     // Создаём и запускаем gRPC-сервер
     server_ = builder.BuildAndStart();
@@ -344,31 +557,51 @@ void PhoneBookServer::RunInNewThread() {
     // Меняем статус сервера на RUNNING
     server_status_ = ServerStatus::RUNNING;
 
-    // Вызываем функцию инициализации очереди handler'ов
-    HandlerQueueInitialization();
+    // Записываем в журнал сообщение о числе очередей handler'ов и потоков, которые будут их обслуживать
+    PHONE_BOOK_LOG_INFO("[Server uses "s << queues_count_ << " handlers queue(s) with "s << threads_per_queue_count_ << " thread(s) per queue]"s);
 
-    // Вызываем функцию циклического итерирования по очереди handler'ов (для данного экземпляра
-    // класса сервера) в отдельном потоке и записываем указатель на него в server_thread_
-    server_thread_ = new thread(&PhoneBookServer::HandlerQueueLoop, this);
+    // Вызываем функцию инициализации для каждой очереди handler'ов
+    for(const auto& handlers_queue : handlers_queues_) {
+        HandlerQueueInitialization(handlers_queue.get());
+    }
+
+    // Для каждой очереди handler'ов (для данного экземпляра класса сервера) запускаем функцию циклического
+    // итерирования по очереди в нужном числе отдельных потоков и сохраняем эти потоки в server_threads_
+    for(const auto& handlers_queue : handlers_queues_) {
+        for(size_t i = 0; i < threads_per_queue_count_; ++i) {
+            server_threads_.emplace_back(&PhoneBookServer::HandlerQueueLoop, this, handlers_queue.get());
+        }
+    }
 }
 
 // Функция остановки сервера
 void PhoneBookServer::Shutdown() {
-    // Информируем в консоль о том, что начата остановка работы сервера
-    cout << "[Shutdowning the server ...]"s << endl;
+    // Записываем в журнал сообщение о том, что начата остановка работы сервера
+    PHONE_BOOK_LOG_INFO("[Shutdowning the server ...]"s);
 
     // Устанавливаем статус сервера в SHUTTING_DOWN
     server_status_ = ServerStatus::SHUTTING_DOWN;
 
-    server_->Shutdown();         // Остановка gRPC-сервера
-    handlers_queue_->Shutdown(); // Остановка очереди handler'ов соединений
+    // Остановка gRPC-сервера
+    server_->Shutdown();
+
+    // Остановка очередей handler'ов соединений
+    for(const auto& handlers_queue : handlers_queues_) {
+        handlers_queue->Shutdown();
+    }
+
+    // Дожидаемся, пока все потоки выполнения сервера обработают оставшиеся в очередях события и завершатся
+    for(thread& server_thread : server_threads_) {
+        server_thread.join();
+    }
+    server_threads_.clear();
 
     // Устанавливаем статус сервера в SHUTDOWNED
     server_status_ = ServerStatus::SHUTDOWNED;
 }
 
 // Функция инициализации очереди handler'ов
-void PhoneBookServer::HandlerQueueInitialization() {
+void PhoneBookServer::HandlerQueueInitialization(ServerCompletionQueue* handlers_queue) {
     // Подключаем пространство имён с функциями, обрабатывающими соединения
     using namespace connection_processing_functions;
 
@@ -378,71 +611,120 @@ void PhoneBookServer::HandlerQueueInitialization() {
     //
     // Замечание: возможно, генерацию кода по созданию handler'ов можно запустить при помощи макросов
 
-    // Информируем в консоль о начале создания первых handler'ов для обработки всех типов соединений
-    cout << "[Creating first handlers for each connection type ...]"s << endl;
+    // Записываем в журнал сообщение о начале создания первых handler'ов для обработки всех типов соединений
+    PHONE_BOOK_LOG_INFO("[Creating first handlers for each connection type ...]"s);
 
     // Создаём первый handler для обработок запросов AddRecord (тип 1-1)
     new OneToOneConnectionHandler <RecordRequest,
                                    AddRecordResponse,
                                    &AsyncService::RequestAddRecord,
-                                   AddRecordProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                   AddRecordProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    // Создаём первый handler для обработок запросов AddRecords (тип M-1)
+    new ManyToOneConnectionHandler <RecordRequest,
+                                    AddRecordsResponse,
+                                    &AsyncService::RequestAddRecords,
+                                    AddRecordsProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
     // Создаём первый handler для обработок запросов DeleteRecordById (тип 1-1)
     new OneToOneConnectionHandler <DeleteRecordByIdRequest,
                                    DeleteRecordResponse,
                                    &AsyncService::RequestDeleteRecordById,
-                                   DeleteRecordByIdProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                   DeleteRecordByIdProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
     // Создаём первый handler для обработок запросов DeleteRecordByNumber (тип 1-1)
     new OneToOneConnectionHandler <DeleteRecordByNumberRequest,
                                    DeleteRecordResponse,
                                    &AsyncService::RequestDeleteRecordByNumber,
-                                   DeleteRecordByNumberProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                   DeleteRecordByNumberProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
     // Создаём первый handler для обработок запросов FindRecordById (тип 1-1)
     new OneToOneConnectionHandler <FindRecordByIdRequest,
                                    RecordResponse,
                                    &AsyncService::RequestFindRecordById,
-                                   FindRecordByIdProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                   FindRecordByIdProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
     // Создаём первый handler для обработок запросов FindRecordsByName (тип 1-M)
     new OneToManyConnectionHandler <FindRecordsByNameRequest,
                                     RecordResponse,
                                     &AsyncService::RequestFindRecordsByName,
-                                    FindRecordsByNameProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                    FindRecordsByNameProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
     // Создаём первый handler для обработок запросов FindRecordsBySurname (тип 1-M)
     new OneToManyConnectionHandler <FindRecordsBySurnameRequest,
                                     RecordResponse,
                                     &AsyncService::RequestFindRecordsBySurname,
-                                    FindRecordsBySurnameProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                    FindRecordsBySurnameProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
     // Создаём первый handler для обработок запросов FindRecordsByPatronymic (тип 1-M)
     new OneToManyConnectionHandler <FindRecordsByPatronymicRequest,
                                     RecordResponse,
                                     &AsyncService::RequestFindRecordsByPatronymic,
-                                    FindRecordsByPatronymicProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                    FindRecordsByPatronymicProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
     // Создаём первый handler для обработок запросов FindRecordByNumber (тип 1-1)
     new OneToOneConnectionHandler <FindRecordByNumberRequest,
                                    RecordResponse,
                                    &AsyncService::RequestFindRecordByNumber,
-                                   FindRecordByNumberProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                   FindRecordByNumberProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    // Создаём первые handler'ы для обработок запросов на пакетный поиск записей FindRecordsByIds и FindRecordsByNumbers (тип 1-1)
+    new OneToOneConnectionHandler <FindRecordsByIdsRequest,
+                                   RecordBatch,
+                                   &AsyncService::RequestFindRecordsByIds,
+                                   FindRecordsByIdsProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    new OneToOneConnectionHandler <FindRecordsByNumbersRequest,
+                                   RecordBatch,
+                                   &AsyncService::RequestFindRecordsByNumbers,
+                                   FindRecordsByNumbersProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
     // Создаём первый handler для обработок запросов FindRecordsByNote (тип 1-M)
     new OneToManyConnectionHandler <FindRecordsByNoteRequest,
                                     RecordResponse,
                                     &AsyncService::RequestFindRecordsByNote,
-                                    FindRecordsByNoteProcessingFunction>(&service_, handlers_queue_.get(), server_status_, database_);
+                                    FindRecordsByNoteProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    // Создаём первые handler'ы для обработок пакетных вариантов запросов на поиск записей (тип 1-M)
+    new OneToManyConnectionHandler <FindRecordsByNameRequest,
+                                    RecordBatch,
+                                    &AsyncService::RequestFindRecordsByNameBatched,
+                                    FindRecordsByNameBatchedProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    new OneToManyConnectionHandler <FindRecordsBySurnameRequest,
+                                    RecordBatch,
+                                    &AsyncService::RequestFindRecordsBySurnameBatched,
+                                    FindRecordsBySurnameBatchedProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    new OneToManyConnectionHandler <FindRecordsByPatronymicRequest,
+                                    RecordBatch,
+                                    &AsyncService::RequestFindRecordsByPatronymicBatched,
+                                    FindRecordsByPatronymicBatchedProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    new OneToManyConnectionHandler <FindRecordsByNoteRequest,
+                                    RecordBatch,
+                                    &AsyncService::RequestFindRecordsByNoteBatched,
+                                    FindRecordsByNoteBatchedProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    // Создаём первые handler'ы для обработок запросов FindRecords и FindRecordsBatched (тип 1-M)
+    new OneToManyConnectionHandler <FindRecordsRequest,
+                                    RecordResponse,
+                                    &AsyncService::RequestFindRecords,
+                                    FindRecordsProcessingFunction>(&service_, handlers_queue, server_status_, database_);
+
+    new OneToManyConnectionHandler <FindRecordsRequest,
+                                    RecordBatch,
+                                    &AsyncService::RequestFindRecordsBatched,
+                                    FindRecordsBatchedProcessingFunction>(&service_, handlers_queue, server_status_, database_);
 
-    // Информируем в консоль об успешном создании первых handler'ов для обработки всех типов соединений
-    cout << "[The first handlers were created for each connection type]"s << endl;
+    // Записываем в журнал сообщение об успешном создании первых handler'ов для обработки всех типов соединений
+    PHONE_BOOK_LOG_INFO("[The first handlers were created for each connection type]"s);
 }
 
 // Функция циклического итерирования по очереди handler'ов (основной цикл сервера)
-void PhoneBookServer::HandlerQueueLoop() {
-    // Информируем в консоль о запуске основного цикла сервера
-    cout << "[The main server loop has started]"s << endl;
+void PhoneBookServer::HandlerQueueLoop(ServerCompletionQueue* handlers_queue) {
+    // Записываем в журнал сообщение о запуске основного цикла сервера
+    PHONE_BOOK_LOG_INFO("[The main server loop has started for handlers queue #"s << handlers_queue << "]"s);
 
     // Указатель (tag) на handler для итерирования по очереди (выступает в роли итератора)
     void* handler_iterator_tag;
@@ -451,7 +733,7 @@ void PhoneBookServer::HandlerQueueLoop() {
     bool event_ok;
         
     // Итерируемся по handler'ам в очереди запросов в бесконечном цикле
-    while (handlers_queue_->Next(&handler_iterator_tag, &event_ok)) {
+    while (handlers_queue->Next(&handler_iterator_tag, &event_ok)) {
 
         // Вызываем у очереди handler'ов метод Next, который блокирует выполнение цикла до тех пор, пока в очереди handler'ов
         // не произойдёт какое-либо событие, т.е. event (например, от клиента пришёл запрос определённого типа, необходимо, чтобы
@@ -464,23 +746,24 @@ void PhoneBookServer::HandlerQueueLoop() {
         // остановкой работы очереди handler'ов и вернёт false, тогда мы выйдем из цикла.
         //
         // Также метод Next получает указатель на булево значение event_ok, куда записывает false, если у клиента на
-        // writer'е request'а был вызван метод Finish, а иначе true. Такой функционал нужен для поддержки соединений
-        // типа M-1 и M-M, которые не используются в сервере для телефонной книги.
+        // writer'е request'а был вызван метод Finish (поток запросов закончен), а иначе true. Такой функционал нужен для
+        // поддержки соединений типа M-1 (пакетное добавление записей), поэтому флаг передаётся handler'у.
         
         // После того, как метод Next отработал и разблокировал дальнейшее выполнение цикла, записав в handler_iterator_tag
         // void*-указатель на hander, для которого произошёл event, необходимо вызвать у этого handler'а функцию обработки.
         //
         // Upcats'им указатель на этот handler до указателя на базовый класс BaseConnectionHandler и вызываем у него метод
-        // обработки Proceed. Благодаря механизму динамического полиморфизма будет вызван метод наследника (классов
-        // OneToOneConnectionHandler или OneToManyConnectionHandler с подставленными параметрами шаблона), т.е. функция
-        // обработки для handler'а конкретного типа соединения
-        static_cast<BaseConnectionHandler*>(handler_iterator_tag)->Proceed();
+        // обработки ProceedEvent, который запоминает флаг event_ok и вызывает Proceed. Благодаря механизму динамического
+        // полиморфизма будет вызван метод наследника (классов OneToOneConnectionHandler, OneToManyConnectionHandler или
+        // ManyToOneConnectionHandler с подставленными параметрами шаблона), т.е. функция обработки для handler'а
+        // конкретного типа соединения
+        static_cast<BaseConnectionHandler*>(handler_iterator_tag)->ProceedEvent(event_ok);
     }
 
     // Если мы вышли из цикла, значит метод Next вернул false, а это значит, что сервер был остановлен
     
-    // Информируем в консоль о том, что сервер был остановлен
-    cout << "[The server has been shutdowned]"s << endl;
+    // Записываем в журнал сообщение о том, что основной цикл сервера для этой очереди handler'ов был остановлен
+    PHONE_BOOK_LOG_INFO("[The main server loop has been shutdowned for handlers queue #"s << handlers_queue << "]"s);
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,580 @@
+// Единица трансляции posting_list.cpp описывает работу неизменяемого списка записей слова (posting list) для поиска
+// записей по содержанию заметок
+
+// Подключим библиотеку algorithm для использования стандартных алгоритмов (бинарный поиск, сортировка), библиотеку
+// cmath для округления частоты TF при квантовании и логарифма числа записей и библиотеку utility для построения
+// таблицы функций распаковки по последовательности индексов
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+// Подключим заголовочный файл списка записей слова
+#include "posting_list.h"
+
+// Подключим заголовочный файл неизменяемых контейнеров (используем его функцию копирования сегментов при записи)
+#include "persistent_map.h"
+
+// Подключим заголовочный файл функций двоичного кодирования (функции записи и чтения чисел фиксированной длины для
+// сериализации списка)
+#include "binary_encoding.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён списков записей слов
+namespace posting_list {
+
+// Функция квантования частоты TF (ненулевая частота не обращается в ноль)
+uint16_t PostingList::QuantizeFreq(double term_freq) {
+    const long quantized_freq = lround(term_freq * FREQ_SCALE);
+    return static_cast<uint16_t>(clamp(quantized_freq, 1L, static_cast<long>(FREQ_SCALE)));
+}
+
+// Функция перехода к началу блока с номером block_index в сегменте с номером segment_index с его распаковкой (или в
+// конец списка, если такого блока нет)
+void PostingList::Cursor::SetBlock(size_t segment_index, size_t block_index) {
+    const auto& segments = list_->segments_;
+
+    // Блоки сегмента закончились - переходим к первому блоку следующего сегмента
+    if (segment_index < segments.size() && block_index == segments[segment_index]->blocks.size()) {
+        ++segment_index;
+        block_index = 0;
+    }
+
+    segment_index_ = segment_index;
+    block_index_ = block_index;
+    position_ = 0;
+
+    if (segment_index_ == segments.size()) {
+        block_size_ = 0;
+        return;
+    }
+
+    // Распаковываются только номера/id, а частоты TF читаются из блока по мере надобности
+    const Block& block = *segments[segment_index_]->blocks[block_index_];
+    DecodeRecordsIds(block, records_ids_.data());
+    freqs_words_ = FreqsWords(block);
+    block_size_ = block.size;
+}
+
+// Функция перехода к первой записи с номером/id не меньше record_id (курсор только продвигается вперёд)
+void PostingList::Cursor::NextGEQ(size_t record_id) {
+
+    // Если записи закончились или курсор уже указывает на подходящую запись, никуда не двигаемся
+    if (!HasPosting() || records_ids_[position_] >= record_id) {
+        return;
+    }
+
+    // Если искомая запись дальше текущего блока, пропускаем блоки по указателям пропуска и распаковываем только
+    // найденный блок: если запись дальше и текущего сегмента, вначале бинарным поиском среди наибольших номеров/id
+    // оставшихся сегментов находится сегмент, а затем в нём - блок
+    if (list_->segments_[segment_index_]->blocks_last_ids[block_index_] < record_id) {
+        size_t segment_index = segment_index_;
+        size_t first_block_index = block_index_ + 1;
+
+        if (list_->segments_last_ids_[segment_index] < record_id) {
+            const auto begin = list_->segments_last_ids_.begin();
+            segment_index = static_cast<size_t>(lower_bound(begin + segment_index + 1, list_->segments_last_ids_.end(),
+                                                            record_id) - begin);
+            first_block_index = 0;
+        }
+
+        if (segment_index == list_->segments_.size()) {
+            SetBlock(segment_index, 0);
+            return;
+        }
+
+        // В найденном сегменте точно есть блок с наибольшим номером/id не меньше record_id
+        const vector<size_t>& blocks_last_ids = list_->segments_[segment_index]->blocks_last_ids;
+        const auto begin = blocks_last_ids.begin();
+        SetBlock(segment_index,
+                 static_cast<size_t>(lower_bound(begin + first_block_index, blocks_last_ids.end(), record_id) - begin));
+    }
+
+    // Ищем запись внутри распакованного блока бинарным поиском (в блоке точно есть номер/id не меньше record_id)
+    const auto begin = records_ids_.begin();
+    position_ = static_cast<size_t>(lower_bound(begin + position_, begin + block_size_, record_id) - begin);
+}
+
+// Функция поиска частоты TF слова в заметке записи с номером/id record_id (если записи нет в списке, возвращает nullopt)
+optional<double> PostingList::Find(size_t record_id) const {
+    const auto [segment_index, block_index] = BlockPosition(record_id);
+
+    if (segment_index == segments_.size()) {
+        return nullopt;
+    }
+
+    const Block& block = *segments_[segment_index]->blocks[block_index];
+    RecordsIds records_ids;
+    DecodeRecordsIds(block, records_ids.data());
+
+    auto it = lower_bound(records_ids.begin(), records_ids.begin() + block.size, record_id);
+
+    if (it == records_ids.begin() + block.size || *it != record_id) {
+        return nullopt;
+    }
+
+    return DecodeFreq(PackedFreq(FreqsWords(block), static_cast<size_t>(it - records_ids.begin())));
+}
+
+// Функция добавления записи в список (если запись уже есть в списке, её частота TF заменяется)
+void PostingList::Insert(size_t record_id, double term_freq) {
+    InsertQuantized(record_id, QuantizeFreq(term_freq));
+    UpdateLogSize();
+}
+
+// Функция добавления записи с уже квантованной частотой в список без пересчёта логарифма числа записей
+void PostingList::InsertQuantized(size_t record_id, uint16_t quantized_freq) {
+
+    // Верхняя граница считается по уже квантованной частоте (иначе округление вверх могло бы сделать частоту записи
+    // чуть больше границы)
+    max_freq_ = max(max_freq_, quantized_freq);
+
+    // Номер/id записи больше всех номеров/id списка, а последний блок заполнен (или блоков нет): начинаем новый блок
+    // из одной записи
+    if (segments_.empty()
+        || (segments_last_ids_.back() < record_id && segments_.back()->blocks.back()->size == BLOCK_SIZE)) {
+        AppendBlock(EncodeBlock(&record_id, &quantized_freq, 1), record_id);
+        ++size_;
+        return;
+    }
+
+    // Иначе распаковываем блок, в котором должна лежать запись (при добавлении в конец списка - последний блок),
+    // вставляем в него запись и упаковываем его заново
+    auto [segment_index, block_index] = BlockPosition(record_id);
+    if (segment_index == segments_.size()) {
+        segment_index = segments_.size() - 1;
+        block_index = segments_.back()->blocks.size() - 1;
+    }
+
+    RecordsIds records_ids;
+    Freqs freqs;
+    const size_t size = DecodeBlock(*segments_[segment_index]->blocks[block_index], records_ids.data(), freqs.data());
+
+    auto it = lower_bound(records_ids.begin(), records_ids.begin() + size, record_id);
+    const size_t position = static_cast<size_t>(it - records_ids.begin());
+
+    // Если запись уже есть в списке, заменяем её частоту
+    if (position < size && *it == record_id) {
+        freqs[position] = quantized_freq;
+        ReplaceBlock(segment_index, block_index, records_ids.data(), freqs.data(), size);
+        return;
+    }
+
+    copy_backward(records_ids.begin() + position, records_ids.begin() + size, records_ids.begin() + size + 1);
+    copy_backward(freqs.begin() + position, freqs.begin() + size, freqs.begin() + size + 1);
+    records_ids[position] = record_id;
+    freqs[position] = quantized_freq;
+    ++size_;
+
+    ReplaceBlock(segment_index, block_index, records_ids.data(), freqs.data(), size + 1);
+}
+
+// Функция пакетного добавления записей в список
+void PostingList::InsertBatch(vector<pair<size_t, double>> postings) {
+
+    // Упорядочиваем пары по номеру/id и оставляем из пар с одинаковым номером/id последнюю (как если бы пары
+    // вставлялись по одной)
+    sort(postings.begin(), postings.end());
+    auto unique_end = unique(postings.rbegin(), postings.rend(),
+                             [](const pair<size_t, double>& lhs, const pair<size_t, double>& rhs) {
+                                 return lhs.first == rhs.first;
+                             });
+    postings.erase(postings.begin(), unique_end.base());
+
+    // Записи пакета с номерами/id не больше наибольшего номера/id списка (редкий случай) вставляются по одной
+    auto tail = postings.begin();
+    if (!segments_.empty()) {
+        tail = upper_bound(postings.begin(), postings.end(), segments_last_ids_.back(),
+                           [](size_t record_id, const pair<size_t, double>& posting) {
+                               return record_id < posting.first;
+                           });
+
+        for (auto it = postings.begin(); it != tail; ++it) {
+            InsertQuantized(it->first, QuantizeFreq(it->second));
+        }
+    }
+
+    if (tail == postings.end()) {
+        UpdateLogSize();
+        return;
+    }
+
+    // Остальные записи дописываются в конец списка: неполный последний блок распаковывается один раз, дополняется
+    // записями пакета до BLOCK_SIZE пар и упаковывается заново, а следующие записи упаковываются сразу в новые блоки
+    RecordsIds records_ids;
+    Freqs freqs;
+    size_t size = 0;
+
+    if (!segments_.empty() && segments_.back()->blocks.back()->size < BLOCK_SIZE) {
+        const Segment& last_segment = *segments_.back();
+        size = DecodeBlock(*last_segment.blocks.back(), records_ids.data(), freqs.data());
+        ReplaceBlock(segments_.size() - 1, last_segment.blocks.size() - 1, nullptr, nullptr, 0);
+    }
+
+    for (auto it = tail; it != postings.end(); ++it) {
+        records_ids[size] = it->first;
+        freqs[size] = QuantizeFreq(it->second);
+        max_freq_ = max(max_freq_, freqs[size]);
+        ++size_;
+
+        if (++size == BLOCK_SIZE) {
+            AppendBlock(EncodeBlock(records_ids.data(), freqs.data(), size), records_ids[size - 1]);
+            size = 0;
+        }
+    }
+
+    if (size > 0) {
+        AppendBlock(EncodeBlock(records_ids.data(), freqs.data(), size), records_ids[size - 1]);
+    }
+
+    UpdateLogSize();
+}
+
+// Функция удаления записи из списка (если записи нет в списке, ничего не делает)
+void PostingList::Erase(size_t record_id) {
+    const auto [segment_index, block_index] = BlockPosition(record_id);
+
+    if (segment_index == segments_.size()) {
+        return;
+    }
+
+    RecordsIds records_ids;
+    Freqs freqs;
+    const size_t size = DecodeBlock(*segments_[segment_index]->blocks[block_index], records_ids.data(), freqs.data());
+
+    auto it = lower_bound(records_ids.begin(), records_ids.begin() + size, record_id);
+    const size_t position = static_cast<size_t>(it - records_ids.begin());
+
+    if (position == size || *it != record_id) {
+        return;
+    }
+
+    copy(records_ids.begin() + position + 1, records_ids.begin() + size, records_ids.begin() + position);
+    copy(freqs.begin() + position + 1, freqs.begin() + size, freqs.begin() + position);
+    --size_;
+
+    ReplaceBlock(segment_index, block_index, records_ids.data(), freqs.data(), size - 1);
+    UpdateLogSize();
+}
+
+// Функция поиска номеров сегмента и блока в нём, в котором лежит (или должна лежать) запись с номером/id record_id
+pair<size_t, size_t> PostingList::BlockPosition(size_t record_id) const {
+    const size_t segment_index = static_cast<size_t>(
+        lower_bound(segments_last_ids_.begin(), segments_last_ids_.end(), record_id) - segments_last_ids_.begin());
+
+    if (segment_index == segments_.size()) {
+        return {segment_index, 0};
+    }
+
+    const vector<size_t>& blocks_last_ids = segments_[segment_index]->blocks_last_ids;
+    return {segment_index, static_cast<size_t>(lower_bound(blocks_last_ids.begin(), blocks_last_ids.end(), record_id)
+                                               - blocks_last_ids.begin())};
+}
+
+// Функция пересчёта логарифма числа записей в списке
+void PostingList::UpdateLogSize() {
+    log_size_ = size_ > 0 ? log(static_cast<double>(size_)) : 0.0;
+}
+
+// Функция упаковки size пар (номера/id по возрастанию и квантованные частоты) в новый сжатый блок
+shared_ptr<const PostingList::Block> PostingList::EncodeBlock(const size_t* records_ids, const uint16_t* freqs, size_t size) {
+    auto block = make_shared<Block>();
+    block->first_record_id = records_ids[0];
+    block->size = static_cast<uint8_t>(size);
+
+    // Ширина упаковки - число бит наибольшей разности (за вычетом единицы) соседних номеров/id блока
+    uint64_t deltas_bits_union = 0;
+    for (size_t i = 1; i < size; ++i) {
+        deltas_bits_union |= records_ids[i] - records_ids[i - 1] - 1;
+    }
+
+    size_t delta_bits = 0;
+    while (delta_bits < 64 && (deltas_bits_union >> delta_bits) != 0) {
+        ++delta_bits;
+    }
+    block->delta_bits = static_cast<uint8_t>(delta_bits);
+
+    // Разности упаковываются подряд по delta_bits бит (разность может переходить через границу 64-битных слов),
+    // а за ними по 4 на слово идут квантованные частоты
+    const size_t deltas_words = ((size - 1) * delta_bits + 63) / 64;
+    block->words.assign(deltas_words + (size + 3) / 4, 0);
+
+    for (size_t i = 1; i < size; ++i) {
+        const uint64_t delta = records_ids[i] - records_ids[i - 1] - 1;
+        const size_t bit = (i - 1) * delta_bits;
+        const size_t offset = bit % 64;
+
+        block->words[bit / 64] |= delta << offset;
+        if (offset + delta_bits > 64) {
+            block->words[bit / 64 + 1] |= delta >> (64 - offset);
+        }
+    }
+
+    for (size_t i = 0; i < size; ++i) {
+        block->words[deltas_words + i / 4] |= static_cast<uint64_t>(freqs[i]) << (i % 4 * 16);
+    }
+
+    return block;
+}
+
+// Функция распаковки 64 подряд идущих разностей шириной DeltaBits бит, начинающихся с начала слова words, в номера/id
+// records_ids[0..63] (номер/id records_ids[-1] уже распакован): 64 разности занимают ровно DeltaBits слов, поэтому
+// при полностью развёрнутом цикле номер слова и сдвиг каждой разности известны при компиляции, и распаковка
+// обходится без вычисления позиций и без ветвлений
+template <size_t DeltaBits>
+static void UnpackDeltasGroup(const uint64_t* words, size_t* records_ids) {
+    constexpr uint64_t mask = (uint64_t{1} << DeltaBits) - 1;
+
+    size_t record_id = records_ids[-1];
+
+#pragma GCC unroll 64
+    for (size_t i = 0; i < 64; ++i) {
+        const size_t bit = i * DeltaBits;
+        const size_t offset = bit % 64;
+
+        uint64_t delta = 0;
+        if constexpr (DeltaBits > 0) {
+            delta = words[bit / 64] >> offset;
+            if (offset + DeltaBits > 64) {
+                delta |= words[bit / 64 + 1] << (64 - offset);
+            }
+        }
+
+        record_id += (delta & mask) + 1;
+        records_ids[i] = record_id;
+    }
+}
+
+// Функция распаковки номеров/id полного блока (BLOCK_SIZE пар) с шириной разностей DeltaBits бит: BLOCK_SIZE - 1
+// разностей распаковываются двумя группами по 64, и последняя "разность" второй группы читается из нулевого
+// дополнения последнего слова разностей (полный блок занимает 2 * DeltaBits слов разностей) - её номер/id пишется в
+// лишнюю ячейку за последним номером/id блока
+template <size_t DeltaBits>
+static void UnpackFullBlock(const uint64_t* words, size_t* records_ids) {
+    static_assert(PostingList::BLOCK_SIZE == 128);
+
+    UnpackDeltasGroup<DeltaBits>(words, records_ids + 1);
+    UnpackDeltasGroup<DeltaBits>(words + DeltaBits, records_ids + 65);
+}
+
+// Таблица функций распаковки номеров/id полного блока для каждой ширины разностей от 0 до MAX_UNROLLED_DELTA_BITS
+template <size_t... DeltasBits>
+static constexpr array<void (*)(const uint64_t*, size_t*), sizeof...(DeltasBits)> MakeFullBlockUnpackers(
+    index_sequence<DeltasBits...>) {
+    return {&UnpackFullBlock<DeltasBits>...};
+}
+
+// Функция распаковки номеров/id сжатого блока в массив records_ids
+void PostingList::DecodeRecordsIds(const Block& block, size_t* records_ids) {
+    static constexpr auto FULL_BLOCK_UNPACKERS =
+        MakeFullBlockUnpackers(make_index_sequence<MAX_UNROLLED_DELTA_BITS + 1>());
+
+    const size_t size = block.size;
+    const size_t delta_bits = block.delta_bits;
+    const uint64_t* words = block.words.data();
+
+    records_ids[0] = block.first_record_id;
+
+    // Полные блоки (а при добавлении записей по возрастанию номеров/id таковы все блоки, кроме последнего)
+    // распаковываются развёрнутым кодом для своей ширины разностей
+    if (size == BLOCK_SIZE && delta_bits <= MAX_UNROLLED_DELTA_BITS) {
+        FULL_BLOCK_UNPACKERS[delta_bits](words, records_ids);
+        return;
+    }
+
+    // У нулевой ширины все разности равны нулю, т.е. номера/id идут подряд
+    if (delta_bits == 0) {
+        for (size_t i = 1; i < size; ++i) {
+            records_ids[i] = records_ids[i - 1] + 1;
+        }
+        return;
+    }
+
+    // Остальные блоки распаковываются общим циклом сдвигов и масок без ветвлений: старшие биты разности, переходящей
+    // через границу слов, берутся из следующего слова (сдвиг в два приёма не бывает шире 63 бит, а если разность не
+    // переходит через границу, он даёт ноль; следующее слово есть всегда - за разностями идут частоты TF)
+    const uint64_t mask = delta_bits == 64 ? ~uint64_t{0} : (uint64_t{1} << delta_bits) - 1;
+
+    size_t bit = 0;
+    for (size_t i = 1; i < size; ++i, bit += delta_bits) {
+        const size_t offset = bit % 64;
+        const uint64_t* word = words + bit / 64;
+
+        const uint64_t delta = ((word[0] >> offset) | ((word[1] << 1) << (63 - offset))) & mask;
+        records_ids[i] = records_ids[i - 1] + delta + 1;
+    }
+}
+
+// Функция распаковки сжатого блока в массивы номеров/id и квантованных частот (возвращает число пар)
+size_t PostingList::DecodeBlock(const Block& block, size_t* records_ids, uint16_t* freqs) {
+    DecodeRecordsIds(block, records_ids);
+
+    const uint64_t* freqs_words = FreqsWords(block);
+    for (size_t i = 0; i < block.size; ++i) {
+        freqs[i] = PackedFreq(freqs_words, i);
+    }
+
+    return block.size;
+}
+
+// Функция дописывания блока block с наибольшим номером/id last_record_id в конец списка
+void PostingList::AppendBlock(shared_ptr<const Block> block, size_t last_record_id) {
+
+    // Заполненный последний сегмент не изменяется (он, скорее всего, разделяется с предыдущими версиями списка) -
+    // начинаем новый сегмент
+    if (segments_.empty() || segments_.back()->blocks.size() == SEGMENT_SIZE) {
+        segments_.push_back(make_shared<Segment>());
+        segments_last_ids_.push_back(last_record_id);
+    }
+
+    Segment& segment = persistent_map::CopyOnWrite(segments_.back());
+    segment.blocks.push_back(move(block));
+    segment.blocks_last_ids.push_back(last_record_id);
+    segments_last_ids_.back() = last_record_id;
+}
+
+// Функция замены блока с номером block_index в сегменте с номером segment_index на блоки, упакованные из size пар
+void PostingList::ReplaceBlock(size_t segment_index, size_t block_index, const size_t* records_ids,
+                               const uint16_t* freqs, size_t size) {
+    Segment& segment = persistent_map::CopyOnWrite(segments_[segment_index]);
+    const auto block_offset = static_cast<ptrdiff_t>(block_index);
+
+    // Опустевший блок удаляем из сегмента, а опустевший сегмент - из списка
+    if (size == 0) {
+        segment.blocks.erase(segment.blocks.begin() + block_offset);
+        segment.blocks_last_ids.erase(segment.blocks_last_ids.begin() + block_offset);
+
+        if (segment.blocks.empty()) {
+            segments_.erase(segments_.begin() + static_cast<ptrdiff_t>(segment_index));
+            segments_last_ids_.erase(segments_last_ids_.begin() + static_cast<ptrdiff_t>(segment_index));
+        }
+        else {
+            segments_last_ids_[segment_index] = segment.blocks_last_ids.back();
+        }
+        return;
+    }
+
+    // Переполненный блок делим пополам: вторая половина переезжает в новый блок сразу за ним
+    if (size > BLOCK_SIZE) {
+        const size_t half = size / 2;
+
+        segment.blocks.insert(segment.blocks.begin() + block_offset + 1,
+                              EncodeBlock(records_ids + half, freqs + half, size - half));
+        segment.blocks_last_ids.insert(segment.blocks_last_ids.begin() + block_offset + 1, records_ids[size - 1]);
+        size = half;
+    }
+
+    segment.blocks[block_index] = EncodeBlock(records_ids, freqs, size);
+    segment.blocks_last_ids[block_index] = records_ids[size - 1];
+    segments_last_ids_[segment_index] = segment.blocks_last_ids.back();
+
+    // Переполненный сегмент так же делим пополам: вторая половина блоков переезжает в новый сегмент сразу за ним
+    if (segment.blocks.size() > SEGMENT_SIZE) {
+        const auto half = static_cast<ptrdiff_t>(segment.blocks.size() / 2);
+
+        auto second_segment = make_shared<Segment>();
+        second_segment->blocks.assign(segment.blocks.begin() + half, segment.blocks.end());
+        second_segment->blocks_last_ids.assign(segment.blocks_last_ids.begin() + half, segment.blocks_last_ids.end());
+        segment.blocks.erase(segment.blocks.begin() + half, segment.blocks.end());
+        segment.blocks_last_ids.erase(segment.blocks_last_ids.begin() + half, segment.blocks_last_ids.end());
+
+        const size_t second_segment_last_id = second_segment->blocks_last_ids.back();
+        segments_last_ids_[segment_index] = segment.blocks_last_ids.back();
+        segments_.insert(segments_.begin() + static_cast<ptrdiff_t>(segment_index) + 1, move(second_segment));
+        segments_last_ids_.insert(segments_last_ids_.begin() + static_cast<ptrdiff_t>(segment_index) + 1,
+                                  second_segment_last_id);
+    }
+}
+
+// Функция дописывания сериализованного списка в конец буфера
+void PostingList::Serialize(string& buffer) const {
+    binary_encoding::AppendFixed64(buffer, size_);
+    binary_encoding::AppendFixed32(buffer, max_freq_);
+
+    // Сегменты в файле не сохраняются: блоки всех сегментов записываются подряд
+    size_t blocks_count = 0;
+    for (const shared_ptr<const Segment>& segment : segments_) {
+        blocks_count += segment->blocks.size();
+    }
+    binary_encoding::AppendFixed32(buffer, static_cast<uint32_t>(blocks_count));
+
+    for (const shared_ptr<const Segment>& segment : segments_) {
+        for (size_t i = 0; i < segment->blocks.size(); ++i) {
+            const Block& block = *segment->blocks[i];
+            binary_encoding::AppendFixed64(buffer, block.first_record_id);
+            binary_encoding::AppendFixed64(buffer, segment->blocks_last_ids[i]);
+            binary_encoding::AppendFixed32(buffer, block.size);
+            binary_encoding::AppendFixed32(buffer, block.delta_bits);
+            for (const uint64_t word : block.words) {
+                binary_encoding::AppendFixed64(buffer, word);
+            }
+        }
+    }
+}
+
+// Функция восстановления списка из начала сериализованных данных
+optional<PostingList> PostingList::Deserialize(string_view& data) {
+    PostingList list;
+
+    uint64_t size = 0;
+    uint32_t max_freq = 0, blocks_count = 0;
+    if (!binary_encoding::ReadFixed64(data, size) || !binary_encoding::ReadFixed32(data, max_freq)
+        || !binary_encoding::ReadFixed32(data, blocks_count) || max_freq > FREQ_SCALE) {
+        return nullopt;
+    }
+
+    // Заголовок блока занимает 24 байта, поэтому число блоков не может быть больше оставшихся байтов / 24 (проверяем
+    // до выделения памяти под блоки)
+    if (blocks_count > data.size() / 24) {
+        return nullopt;
+    }
+    list.segments_.reserve((blocks_count + SEGMENT_SIZE - 1) / SEGMENT_SIZE);
+    list.segments_last_ids_.reserve((blocks_count + SEGMENT_SIZE - 1) / SEGMENT_SIZE);
+
+    uint64_t pairs_count = 0;
+    for (uint32_t i = 0; i < blocks_count; ++i) {
+        uint64_t first_record_id = 0, last_record_id = 0;
+        uint32_t block_size = 0, delta_bits = 0;
+        if (!binary_encoding::ReadFixed64(data, first_record_id) || !binary_encoding::ReadFixed64(data, last_record_id)
+            || !binary_encoding::ReadFixed32(data, block_size) || !binary_encoding::ReadFixed32(data, delta_bits)) {
+            return nullopt;
+        }
+
+        // Блок не пуст, его номера/id возрастают и больше номеров/id предыдущего блока, а слов хватает для
+        // распаковки (иначе курсор читал бы за пределами блока)
+        if (block_size == 0 || block_size > BLOCK_SIZE || delta_bits > 64 || last_record_id < first_record_id
+            || last_record_id - first_record_id < block_size - 1
+            || (!list.segments_last_ids_.empty() && first_record_id <= list.segments_last_ids_.back())) {
+            return nullopt;
+        }
+        const size_t words_count = ((block_size - 1) * delta_bits + 63) / 64 + (block_size + 3) / 4;
+        if (words_count > data.size() / 8) {
+            return nullopt;
+        }
+
+        auto block = make_shared<Block>();
+        block->first_record_id = first_record_id;
+        block->size = static_cast<uint8_t>(block_size);
+        block->delta_bits = static_cast<uint8_t>(delta_bits);
+        block->words.resize(words_count);
+        for (uint64_t& word : block->words) {
+            binary_encoding::ReadFixed64(data, word);
+        }
+
+        list.AppendBlock(move(block), last_record_id);
+        pairs_count += block_size;
+    }
+
+    if (pairs_count != size) {
+        return nullopt;
+    }
+
+    list.size_ = size;
+    list.max_freq_ = static_cast<uint16_t>(max_freq);
+    list.UpdateLogSize();
+
+    return list;
+}
+
+}
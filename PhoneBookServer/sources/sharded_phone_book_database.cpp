@@ -0,0 +1,1494 @@
+// Единица трансляции sharded_phone_book_database.cpp описывает работу шардированной базы данных для телефонной
+// книги, которая разбивает записи на несколько независимых баз данных (шардов) PhoneBookDatabase и
+// предоставляет серверу тот же функционал по хранению, изменению и поиску данных
+
+// Подключим библиотеку iostream для работы стандартного потока вывода в консоль для отображения статуса
+// работы базы данных, библиотеку thread для числа ядер процессора (рабочих потоков пула),
+// библиотеку cmath для использования математических функций (требуется функция логарифма), библиотеку algorithm для
+// использования стандартных алгоритмов, библиотеку mutex для работы с блокировками mutex'ов, библиотеку
+// queue для использования кучи (priority_queue), библиотеку tuple для работы с кортежами, библиотеку
+// functional для использования стандартного hash'а строк, библиотеку iterator для использования back_inserter,
+// библиотеку limits для работы с предельными значениями типов, библиотеку stdexcept для исключений, библиотеку
+// unordered_set для проверки уникальности номеров телефонов пакета добавляемых записей, библиотеку filesystem для
+// замены файла базы данных сохранённым временным файлом и библиотеку chrono для измерения длительности сохранения
+#include <iostream>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include <mutex>
+#include <queue>
+#include <tuple>
+#include <functional>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <unordered_set>
+#include <filesystem>
+#include <chrono>
+
+// Подключим заголовочный файл шардированной базы данных для телефонной книги
+#include "sharded_phone_book_database.h"
+
+// Подключаем заголовочный файл с функциями для работы со строками
+#include "string_functions.h"
+
+// Подключим заголовочный файл двоичного формата файла базы данных
+#include "database_snapshot.h"
+
+// Подключим заголовочный файл функций двоичного кодирования (функции записи и чтения чисел фиксированной длины в
+// содержимом кадров журнала упреждающей записи)
+#include "binary_encoding.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён базы данных для телефонной книги
+namespace phone_book_database {
+
+// Типы кадров журнала упреждающей записи (первый байт содержимого кадра)
+//
+// Содержимое кадра добавления записи: тип, номер/id записи (8 байт) и поля записи (имя, фамилия, отчество, номер
+// телефона, заметка - каждое длиной из 4 байт и байтами строки). Содержимое кадра удаления записи: тип и номер/id
+// удалённой записи (8 байт). Удаление по номеру телефона журналируется номером/id найденной записи
+enum class LogEntryType : char {
+    ADD_RECORD = 1,
+    DELETE_RECORD = 2
+};
+
+// Функция дописывания строки (длина из 4 байт и байты строки) в содержимое кадра журнала
+static void AppendLogString(string& payload, string_view str) {
+    binary_encoding::AppendFixed32(payload, static_cast<uint32_t>(str.size()));
+    payload.append(str);
+}
+
+// Функция чтения строки (длина из 4 байт и байты строки) из начала содержимого кадра журнала (payload сдвигается за
+// прочитанную строку; возвращает false, если байтов не хватает)
+static bool ReadLogString(string_view& payload, string& str) {
+    uint32_t size = 0;
+    if (!binary_encoding::ReadFixed32(payload, size) || payload.size() < size) {
+        return false;
+    }
+
+    str.assign(payload.substr(0, size));
+    payload.remove_prefix(size);
+    return true;
+}
+
+// Конструктор шардированной базы данных принимает имя файла (полное имя с путём до файла) с базой данных
+// телефонной книги, число шардов и параметры журнала упреждающей записи, запоминает имя файла, открывает журнал и
+// загружает данные в базу из файла (воспроизводя поверх них журнал)
+ShardedPhoneBookDatabase::ShardedPhoneBookDatabase(const string& database_file_name, size_t shards_count,
+                                                   size_t note_search_cache_capacity,
+                                                   const write_ahead_log::Options& wal_options,
+                                                   const CheckpointOptions& checkpoint_options) :
+    database_file_name_(database_file_name),
+    worker_pool_(max<size_t>(shards_count, max<size_t>(thread::hardware_concurrency(), 1)) - 1),
+    note_search_cache_(note_search_cache_capacity),
+    checkpoint_options_(checkpoint_options) {
+
+    // Проверяем, что число шардов корректно
+    if (shards_count == 0) {
+        throw logic_error("Sharded phone book database requires at least one shard"s);
+    }
+
+    // Создаём пустые шарды, полосы словаря номеров телефонов и полосы таблицы слов заметок (по одной на шард)
+    for (size_t i = 0; i < shards_count; ++i) {
+        shards_.push_back(make_unique<PhoneBookDatabase>());
+        number_stripes_.push_back(make_unique<NumberStripe>());
+        note_word_stripes_.push_back(make_unique<NoteWordStripe>());
+    }
+
+    // Открываем журнал упреждающей записи, если он задан
+    if (!wal_options.file_name.empty()) {
+        wal_ = make_unique<write_ahead_log::WriteAheadLog>(wal_options);
+    }
+
+    // Загружаем данные в базу из файла и строим по загруженным шардам глобальную таблицу слов заметок
+    LoadFromFile();
+    BuildNoteWordsStats();
+
+    // Запускаем фоновый поток сохранения, если задан период сохранения (после загрузки, чтобы не сохранить в файл
+    // недозагруженную базу данных)
+    if (checkpoint_options_.interval.count() > 0) {
+        checkpoint_thread_ = thread(&ShardedPhoneBookDatabase::CheckpointLoop, this);
+    }
+}
+
+// Деструктор останавливает фоновый поток сохранения
+ShardedPhoneBookDatabase::~ShardedPhoneBookDatabase() {
+    {
+        lock_guard lock(checkpoint_mutex_);
+        checkpoint_stop_ = true;
+    }
+    checkpoint_stop_requested_.notify_all();
+    if (checkpoint_thread_.joinable()) {
+        checkpoint_thread_.join();
+    }
+}
+
+// Функция получения шарда, в котором лежит запись с номером/id record_id
+PhoneBookDatabase& ShardedPhoneBookDatabase::ShardByRecordId(size_t record_id) const {
+    return *shards_[record_id % shards_.size()];
+}
+
+// Функция получения полосы глобального словаря номеров телефонов, в которой лежит номер телефона number
+ShardedPhoneBookDatabase::NumberStripe& ShardedPhoneBookDatabase::StripeByNumber(const string& number) const {
+    return *number_stripes_[StripeIndexByNumber(number)];
+}
+
+// Функция получения индекса полосы глобального словаря номеров телефонов, в которой лежит номер телефона number
+// (hash string_view совпадает с hash'ем string с теми же символами, поэтому номер телефона из отображённого в память
+//  файла попадает в ту же полосу, что и номер телефона записи)
+size_t ShardedPhoneBookDatabase::StripeIndexByNumber(string_view number) const {
+    return hash<string_view>{}(number) % number_stripes_.size();
+}
+
+// Функция получения полосы глобальной таблицы слов заметок для слова word
+ShardedPhoneBookDatabase::NoteWordStripe& ShardedPhoneBookDatabase::StripeByNoteWord(string_view word) const {
+    return *note_word_stripes_[hash<string_view>{}(word) % note_word_stripes_.size()];
+}
+
+// Функция загрузки данных в базу из файла
+void ShardedPhoneBookDatabase::LoadFromFile() {
+
+    // Заменяем шарды и полосы словаря номеров телефонов пустыми (данные из файла заменяют данные базы целиком)
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        shards_[i] = make_unique<PhoneBookDatabase>();
+        number_stripes_[i] = make_unique<NumberStripe>();
+    }
+
+    // Результаты поиска по заметкам прежних шардов больше не нужны
+    note_search_cache_.Clear();
+
+    // Информируем в консоль о начале загрузке данных в базу из файла
+    cout << "[Starting loading data from \""s << database_file_name_ << "\" into the database ("s
+         << shards_.size() << " shards) ...]"s << endl;
+
+    // Файл в двоичном формате загружаем без разбора текста (формат определяется по сигнатуре в начале файла, файл в
+    // прежнем текстовом формате разбирается построчно ниже)
+    if (database_snapshot::MappedSnapshot::IsSnapshotFile(database_file_name_)) {
+        LoadFromSnapshotFile();
+
+        // Информируем в консоль об успешной загрузке данных в базу из файла
+        cout << "[Data from \""s << database_file_name_ << "\" has been loaded into the database]"s << endl;
+
+        // Воспроизводим поверх данных из файла журнал упреждающей записи
+        ReplayWriteAheadLog();
+        return;
+    }
+
+    // Файл в прежнем текстовом формате разбираем параллельно (в пуле рабочих потоков)
+    optional<PhoneBookDatabase::TextFileRecords> text_file =
+        PhoneBookDatabase::ParseTextFile(database_file_name_, worker_pool_);
+
+    // Если файла с базой данных нету
+    if (!text_file) {
+
+        // Информируем в консоль о невозможности открыть файл с базой данных,
+        // будем работать с пустой базой данных (нужно для первого запуска сервера)
+        cout << "[Can't open \""s << database_file_name_ << "\", database is empty]"s << endl;
+
+        // Номером/id последней записи будет id = 0 (т.е. записей ещё нету)
+        last_record_id_ = 0;
+
+        // Воспроизводим журнал упреждающей записи (изменения, сделанные до аварийного завершения, могли остаться только
+        // в нём)
+        ReplayWriteAheadLog();
+        return;
+    }
+
+    // Строим шарды и полосы словаря номеров телефонов из разобранных записей так же, как из двоичного файла
+    const vector<pair<size_t, Record>>& records = text_file->records;
+    LoadRecords(records.size(), text_file->last_record_id, {}, [&records](size_t index) {
+        const auto& [record_id, record] = records[index];
+        return database_snapshot::RecordView{record_id, record.name, record.surname, record.patronymic, record.number,
+                                             record.note};
+    });
+
+    // Информируем в консоль об успешной загрузке данных в базу из файла
+    cout << "[Data from \""s << database_file_name_ << "\" has been loaded into the database]"s << endl;
+
+    // Воспроизводим поверх данных из файла журнал упреждающей записи
+    ReplayWriteAheadLog();
+}
+
+// Функция загрузки данных в базу из файла в двоичном формате
+void ShardedPhoneBookDatabase::LoadFromSnapshotFile() {
+
+    // Отображаем файл в память (конструктор проверяет контрольные суммы и выбрасывает исключение, если файл повреждён)
+    const database_snapshot::MappedSnapshot snapshot(database_file_name_);
+
+    const vector<string_view> indexes_sections = snapshot.FindSections(database_snapshot::SectionType::INDEXES);
+    const size_t loaded_shards_count = LoadRecords(
+        snapshot.RecordsCount(), snapshot.LastRecordId(), indexes_sections, [&snapshot](size_t index) {
+            return snapshot.GetRecord(index);
+        });
+
+    if (loaded_shards_count != shards_.size()) {
+        cout << "[Indexes of "s << shards_.size() - loaded_shards_count << " shards in \""s << database_file_name_
+             << "\" are missing or stale, they have been rebuilt]"s << endl;
+    }
+}
+
+// Функция загрузки в базу данных записей из файла
+template <typename GetRecord>
+size_t ShardedPhoneBookDatabase::LoadRecords(size_t records_count, size_t last_record_id,
+                                             const vector<string_view>& indexes_sections, GetRecord get_record) {
+    const size_t tasks_count = shards_.size();
+
+    // Вычисляем индексы полос словаря номеров телефонов для номеров телефонов всех записей (параллельно, по равной
+    // части таблицы записей на поток)
+    vector<uint32_t> stripes_indices(records_count);
+    parallel_tasks::RunInParallel(worker_pool_, tasks_count, tasks_count, [&](size_t task_index) {
+        const size_t begin = records_count * task_index / tasks_count;
+        const size_t end = records_count * (task_index + 1) / tasks_count;
+        for (size_t i = begin; i < end; ++i) {
+            stripes_indices[i] = static_cast<uint32_t>(StripeIndexByNumber(get_record(i).number));
+        }
+    });
+
+    // Каждая полоса (в своём потоке) принимает номера телефонов своих записей в порядке файла: из записей с
+    // одинаковым номером телефона принимается первая, как и при построчной загрузке текстового файла
+    // (флаги принятых записей - char, а не bool, чтобы потоки писали в разные байты)
+    vector<char> accepted(records_count, 0);
+    parallel_tasks::RunInParallel(worker_pool_, tasks_count, tasks_count, [&](size_t stripe_index) {
+        NumberStripe& stripe = *number_stripes_[stripe_index];
+        stripe.number_to_record.reserve(records_count / number_stripes_.size());
+        for (size_t i = 0; i < records_count; ++i) {
+            if (stripes_indices[i] != stripe_index) {
+                continue;
+            }
+            const database_snapshot::RecordView record = get_record(i);
+            if (stripe.number_to_record.emplace(record.number, record.id).second) {
+                accepted[i] = 1;
+            }
+        }
+    });
+
+    // Каждый шард (в своём потоке) загружает свои принятые записи одной новой версией шарда. Шард пропускает записи с
+    // повторяющимся номером/id, их номера телефонов убираются из словаря номеров телефонов после завершения всех
+    // потоков (полосы общие для всех шардов). Словари шарда загружаются из его секции, если она сохранена для того же
+    // числа шардов, а записи шарда в файле лежат подряд на указанном в ней месте и ни одна из них не отброшена
+    // (флаги загруженных из секций словарей - char, а не bool, чтобы потоки писали в разные байты)
+    vector<vector<string>> rejected_numbers(shards_.size());
+    vector<size_t> max_records_ids(shards_.size(), 0);
+    vector<char> indexes_loaded(shards_.size(), 0);
+    parallel_tasks::RunInParallel(worker_pool_, tasks_count, tasks_count, [&](size_t shard_index) {
+        optional<string_view> indexes;
+        optional<PhoneBookDatabase::IndexesPlacement> placement;
+        for (const string_view section : indexes_sections) {
+            placement = PhoneBookDatabase::ReadIndexesPlacement(section);
+            if (placement && placement->shards_count == shards_.size() && placement->shard_index == shard_index) {
+                indexes = section;
+                break;
+            }
+        }
+
+        vector<pair<size_t, Record>> records;
+        unordered_set<size_t> records_ids;
+        for (size_t i = 0; i < records_count; ++i) {
+            if (!accepted[i]) {
+                continue;
+            }
+            const database_snapshot::RecordView record = get_record(i);
+            if (record.id % shards_.size() != shard_index) {
+                continue;
+            }
+            if (!records_ids.insert(record.id).second) {
+                rejected_numbers[shard_index].emplace_back(record.number);
+                indexes = nullopt;
+                continue;
+            }
+            if (indexes && (i < placement->first_record_index
+                            || i - placement->first_record_index >= placement->records_count)) {
+                indexes = nullopt;
+            }
+            records.emplace_back(record.id, Record{string(record.name), string(record.surname),
+                                                   string(record.patronymic), string(record.number),
+                                                   string(record.note)});
+            max_records_ids[shard_index] = max<size_t>(max_records_ids[shard_index], record.id);
+        }
+        if (indexes && records.size() != placement->records_count) {
+            indexes = nullopt;
+        }
+
+        indexes_loaded[shard_index] = shards_[shard_index]->LoadFileRecords(records, indexes);
+    });
+
+    for (const vector<string>& numbers : rejected_numbers) {
+        for (const string& number : numbers) {
+            StripeByNumber(number).number_to_record.erase(number);
+        }
+    }
+
+    // Номер/id последней записи не меньше номера/id любой загруженной записи (даже если заголовок файла отстаёт)
+    last_record_id_ = max(last_record_id, *max_element(max_records_ids.begin(), max_records_ids.end()));
+
+    return static_cast<size_t>(count(indexes_loaded.begin(), indexes_loaded.end(), 1));
+}
+
+// Функция воспроизведения журнала упреждающей записи поверх загруженных из файла данных
+void ShardedPhoneBookDatabase::ReplayWriteAheadLog() {
+    if (!wal_) {
+        return;
+    }
+
+    cout << "[Starting replaying the write-ahead log ...]"s << endl;
+
+    // Добавляемые записи, отложенные до следующего кадра удаления или конца журнала
+    vector<pair<size_t, Record>> added_records;
+
+    const size_t entries_count = wal_->Replay([this, &added_records](string_view payload) {
+        ApplyLogEntry(payload, added_records);
+    });
+    ApplyAddedRecords(added_records);
+
+    cout << "["s << entries_count << " changes have been replayed from the write-ahead log]"s << endl;
+
+    // Воспроизведённые изменения лежат только в журнале, поэтому первое фоновое сохранение не пропускается, даже если
+    // новых изменений не будет
+    lock_guard lock(checkpoint_mutex_);
+    log_replayed_ = entries_count > 0;
+}
+
+// Функция применения к базе данных одного кадра журнала упреждающей записи с содержимым payload
+void ShardedPhoneBookDatabase::ApplyLogEntry(string_view payload, vector<pair<size_t, Record>>& added_records) {
+
+    // Читаем тип кадра и номер/id записи (кадр с целой контрольной суммой, но неизвестного формата пропускаем)
+    if (payload.empty()) {
+        return;
+    }
+    const LogEntryType type = static_cast<LogEntryType>(payload.front());
+    payload.remove_prefix(1);
+
+    uint64_t record_id = 0;
+    if (!binary_encoding::ReadFixed64(payload, record_id)) {
+        return;
+    }
+
+    if (type == LogEntryType::ADD_RECORD) {
+        Record record;
+        if (!ReadLogString(payload, record.name) || !ReadLogString(payload, record.surname) ||
+            !ReadLogString(payload, record.patronymic) || !ReadLogString(payload, record.number) ||
+            !ReadLogString(payload, record.note)) {
+            return;
+        }
+
+        // Номер/id был выдан, даже если запись уже есть в базе данных, поэтому повторно его выдавать нельзя
+        last_record_id_ = max<size_t>(last_record_id_, record_id);
+
+        // Если записи с таким номером телефона ещё нет (ни в базе данных, ни среди отложенных), вносим номер телефона
+        // в словарь номеров телефонов сразу, а запись откладываем до добавления пакетом
+        NumberStripe& stripe = StripeByNumber(record.number);
+        if (stripe.number_to_record.emplace(record.number, record_id).second) {
+            added_records.emplace_back(record_id, move(record));
+        }
+    }
+    else if (type == LogEntryType::DELETE_RECORD) {
+
+        // Удаляемая запись может быть среди отложенных, поэтому вначале добавляем их
+        ApplyAddedRecords(added_records);
+
+        // Если запись ещё есть в базе данных, удаляем её из шарда и из словаря номеров телефонов
+        PhoneBookDatabase& shard = ShardByRecordId(record_id);
+        if (optional<RecordWithId> record = shard.FindRecordById(record_id)) {
+            StripeByNumber(record->number).number_to_record.erase(record->number);
+            shard.DeleteRecordById(record_id);
+        }
+    }
+}
+
+// Функция добавления отложенных при воспроизведении журнала упреждающей записи записей added_records в шарды
+void ShardedPhoneBookDatabase::ApplyAddedRecords(vector<pair<size_t, Record>>& added_records) {
+
+    // Распределяем записи по шардам
+    vector<vector<pair<size_t, const Record*>>> shards_records(shards_.size());
+    for (const auto& [record_id, record] : added_records) {
+        shards_records[record_id % shards_.size()].emplace_back(record_id, &record);
+    }
+
+    for (size_t i = 0; i < shards_.size(); ++i) {
+        if (shards_records[i].empty()) {
+            continue;
+        }
+
+        // Шард пропускает записи с уже существующим номером/id - их номера телефонов убираем из словаря номеров
+        // телефонов обратно
+        const vector<size_t> codes = shards_[i]->AddRecordsWithIds(shards_records[i]);
+        for (size_t j = 0; j < codes.size(); ++j) {
+            if (!codes[j]) {
+                StripeByNumber(shards_records[i][j].second->number).number_to_record.erase(shards_records[i][j].second->number);
+            }
+        }
+    }
+
+    added_records.clear();
+}
+
+// Функции дописывания в журнал упреждающей записи кадров добавления записей records
+size_t ShardedPhoneBookDatabase::LogAddedRecords(const vector<pair<size_t, const Record*>>& records) {
+    if (!wal_) {
+        return 0;
+    }
+
+    // Упаковываем кадры всех записей в один буфер и дописываем его в журнал одним Append
+    string frames, payload;
+    for (const auto& [record_id, record] : records) {
+        payload.clear();
+        payload.push_back(static_cast<char>(LogEntryType::ADD_RECORD));
+        binary_encoding::AppendFixed64(payload, record_id);
+        AppendLogString(payload, record->name);
+        AppendLogString(payload, record->surname);
+        AppendLogString(payload, record->patronymic);
+        AppendLogString(payload, record->number);
+        AppendLogString(payload, record->note);
+
+        write_ahead_log::WriteAheadLog::AppendFrame(frames, payload);
+    }
+
+    return wal_->Append(frames);
+}
+
+// Функция дописывания в журнал упреждающей записи кадра удаления записи с номером/id record_id
+size_t ShardedPhoneBookDatabase::LogDeletedRecord(size_t record_id) {
+    if (!wal_) {
+        return 0;
+    }
+
+    string payload, frames;
+    payload.push_back(static_cast<char>(LogEntryType::DELETE_RECORD));
+    binary_encoding::AppendFixed64(payload, record_id);
+    write_ahead_log::WriteAheadLog::AppendFrame(frames, payload);
+
+    return wal_->Append(frames);
+}
+
+// Функция ожидания долговечности кадров журнала упреждающей записи до позиции lsn
+void ShardedPhoneBookDatabase::CommitLog(size_t lsn) {
+    if (wal_) {
+        wal_->Commit(lsn);
+    }
+}
+
+// Конструктор охраны изменения базы данных
+ShardedPhoneBookDatabase::MutationGuard::MutationGuard(const ShardedPhoneBookDatabase& database) {
+
+    // Увеличиваем счётчик текущей эпохи и проверяем, что эпоха не сменилась за это время: иначе сохранение могло уже
+    // проверить счётчик прежней эпохи, не увидев нашего изменения, и изменение нужно отнести к новой эпохе
+    while (true) {
+        const uint64_t epoch = database.mutations_epoch_.load();
+        in_flight_ = &database.mutations_in_flight_[epoch % 2];
+        in_flight_->fetch_add(1);
+        if (database.mutations_epoch_.load() == epoch) {
+            return;
+        }
+        in_flight_->fetch_sub(1);
+    }
+}
+
+// Деструктор охраны изменения базы данных
+ShardedPhoneBookDatabase::MutationGuard::~MutationGuard() {
+    in_flight_->fetch_sub(1);
+}
+
+// Функция ожидания публикации изменений, начатых до её вызова
+void ShardedPhoneBookDatabase::WaitForMutations() const {
+
+    // Сохранения выполняются по одному, и каждое дожидается конца изменений своей эпохи, поэтому к моменту смены эпохи
+    // на epoch + 1 счётчик той же чётности, что и epoch + 1, пуст
+    const uint64_t epoch = mutations_epoch_.fetch_add(1);
+    while (mutations_in_flight_[epoch % 2].load() != 0) {
+        this_thread::yield();
+    }
+}
+
+// Функция ожидания добавления в шард записи с номером/id record_id, если её пакет AddRecords ещё добавляет записи в
+// шарды
+void ShardedPhoneBookDatabase::WaitForPendingRecord(size_t record_id) const {
+    unique_lock lock(pending_batches_mutex_);
+    pending_batch_added_.wait(lock, [this, record_id]() {
+        return none_of(pending_batches_.begin(), pending_batches_.end(),
+                       [record_id](const pair<size_t, size_t>& batch) {
+                           return batch.first <= record_id && record_id < batch.second;
+                       });
+    });
+}
+
+// Функция сохранения данных из базы в файл
+void ShardedPhoneBookDatabase::SaveToFile() const {
+
+    // Сохранения выполняются по одному (все они пишут один и тот же временный файл)
+    lock_guard save_lock(save_mutex_);
+
+    // Информируем в консоль о начале сохранения данных из базы в файл
+    cout << "[Starting saving data from database to \""s << database_file_name_ << "\" ...]"s << endl;
+
+    // Запоминаем время начала сохранения и объём кадров, дописанных в журнал упреждающей записи к этому моменту
+    const auto start_time = chrono::steady_clock::now();
+    const size_t log_bytes = wal_ ? wal_->GetStats().bytes : 0;
+
+    // Пауза на пути запросов и объём записанного файла
+    chrono::microseconds pause{0};
+    size_t bytes = 0;
+
+    // Записываем данные во временный файл в двоичном формате (прежний файл базы данных остаётся целым, пока новый не
+    // сохранён полностью; если файл не удалось записать, прежний файл базы данных и сегменты журнала остаются
+    // нетронутыми), заменяем им прежний файл базы данных и синхронизируем каталог, и только после этого удаляем
+    // сегменты журнала, изменения которых попали в файл
+    const string temporary_file_name = database_file_name_ + ".tmp"s;
+    try {
+        // Переходим к новому сегменту журнала упреждающей записи до сбора записей и дожидаемся публикации изменений,
+        // кадры которых успели попасть в прежние сегменты (писатели при этом не ждут): тогда изменения прежних
+        // сегментов уже внесены в шарды и попадут в файл, а изменения, сделанные во время сохранения, останутся в новом
+        // сегменте. Ожидание не останавливает запросы, поэтому в паузу на пути запросов не входит
+        const uint64_t wal_segment = wal_ ? wal_->StartNewSegment() : 0;
+        const auto switched_time = chrono::steady_clock::now();
+        WaitForMutations();
+        const auto capture_time = chrono::steady_clock::now();
+
+        // Фиксируем версии всех шардов (версии неизменяемы, поэтому ничего не копируется), так как число записей в
+        // файле должно быть записано до самих записей, а записи и словари каждого шарда должны браться из одной его
+        // версии, хотя шарды могут изменяться во время сохранения
+        vector<PhoneBookDatabase::CapturedSnapshot> snapshots;
+        snapshots.reserve(shards_.size());
+        size_t records_count = 0;
+        for (const auto& shard : shards_) {
+            snapshots.push_back(shard->CaptureSnapshot());
+            records_count += snapshots.back().RecordsCount();
+        }
+
+        // Номер/id последней записи запоминаем после сбора записей, чтобы он был не меньше номера/id любой из них
+        const size_t last_record_id = last_record_id_;
+
+        // Дальше сохранение работает только с зафиксированными версиями и не мешает запросам: на их пути были лишь
+        // переход журнала к новому сегменту (писатели ждали его на mutex'е журнала) и фиксация версий шардов
+        pause = chrono::duration_cast<chrono::microseconds>(switched_time - start_time + chrono::steady_clock::now()
+                                                            - capture_time);
+
+        database_snapshot::SnapshotWriter writer(temporary_file_name, records_count, last_record_id);
+
+        // Записываем записи шардов в файл подряд, шард за шардом, а за ними - словари каждого шарда своей секцией с
+        // индексом первой записи шарда в таблице записей
+        for (const PhoneBookDatabase::CapturedSnapshot& snapshot : snapshots) {
+            snapshot.WriteRecords(writer);
+        }
+        size_t first_record_index = 0;
+        for (size_t i = 0; i < snapshots.size(); ++i) {
+            writer.AddSection(database_snapshot::SectionType::INDEXES,
+                              snapshots[i].SerializeIndexes(snapshots.size(), i, first_record_index));
+            first_record_index += snapshots[i].RecordsCount();
+        }
+
+        // Дописываем каталог секций и заголовок и синхронизируем временный файл с диском
+        writer.Finish();
+        bytes = static_cast<size_t>(filesystem::file_size(temporary_file_name));
+
+        filesystem::rename(temporary_file_name, database_file_name_);
+        write_ahead_log::SyncFile(write_ahead_log::DirectoryOf(database_file_name_));
+
+        if (wal_) {
+            wal_->RemoveSegmentsBefore(wal_segment);
+        }
+    } catch (const exception& e) {
+        cout << "[Can't save data to \""s << database_file_name_ << "\": "s << e.what() << "]"s << endl;
+
+        lock_guard lock(checkpoint_mutex_);
+        ++checkpoint_stats_.failures;
+        return;
+    }
+
+    // Обновляем статистику сохранений
+    const auto duration = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start_time);
+    {
+        lock_guard lock(checkpoint_mutex_);
+        ++checkpoint_stats_.checkpoints;
+        checkpoint_stats_.last_duration = duration;
+        checkpoint_stats_.last_pause = pause;
+        checkpoint_stats_.max_pause = max(checkpoint_stats_.max_pause, pause);
+        checkpoint_stats_.last_bytes = bytes;
+        checkpoint_stats_.total_bytes += bytes;
+        checkpoint_log_bytes_ = log_bytes;
+        log_replayed_ = false;
+    }
+
+    // Информируем в консоль об успешном сохранении данных из базы в файл
+    cout << "[Data from database has been saved to \""s << database_file_name_ << "\" ("s << bytes << " bytes in "s
+         << duration.count() / 1000 << " ms, requests paused for "s << pause.count() << " us)]"s << endl;
+}
+
+// Функция фонового потока сохранения
+void ShardedPhoneBookDatabase::CheckpointLoop() {
+    unique_lock lock(checkpoint_mutex_);
+
+    while (!checkpoint_stop_) {
+        checkpoint_stop_requested_.wait_for(lock, checkpoint_options_.interval, [this]() { return checkpoint_stop_; });
+        if (checkpoint_stop_) {
+            break;
+        }
+
+        // Пропускаем сохранение, если с прошлого сохранения база данных почти не изменилась (по объёму кадров журнала)
+        if (wal_ && !log_replayed_
+            && wal_->GetStats().bytes - checkpoint_log_bytes_ < checkpoint_options_.min_log_bytes) {
+            ++checkpoint_stats_.skipped;
+            continue;
+        }
+
+        // Сохраняем базу данных без mutex'а статистики (SaveToFile сам захватывает его, чтобы обновить статистику)
+        lock.unlock();
+        SaveToFile();
+        lock.lock();
+    }
+}
+
+// Функция получения статистики сохранений базы данных в файл
+ShardedPhoneBookDatabase::CheckpointStats ShardedPhoneBookDatabase::GetCheckpointStats() const {
+    lock_guard lock(checkpoint_mutex_);
+    return checkpoint_stats_;
+}
+
+// Функция добавления записи
+// (возвращает код ответа: 0 - запись с таким номером телефона уже существует,
+//                         1 - запись успешно добавлена)
+size_t ShardedPhoneBookDatabase::AddRecord(const Record& record) {
+
+    // Захватываем на запись полосу словаря номеров телефонов для номера телефона записи
+    NumberStripe& stripe = StripeByNumber(record.number);
+    unique_lock lock(stripe.mutex);
+
+    // Если запись с таким номером телефона уже существует в базе данных, возвращаем код ответа - 0
+    if (stripe.number_to_record.count(record.number)) {
+        return 0;
+    }
+
+    // Выдаём записи новый номер/id (атомарный инкремент, поэтому номера/id уникальны для всех шардов)
+    const size_t record_id = ++last_record_id_;
+
+    // Дописываем добавление записи в журнал упреждающей записи до её публикации (пока полоса захвачена; если журнал
+    // неисправен, выбрасывается исключение, и запись не добавляется), а его долговечности дожидаемся уже после
+    // освобождения полосы
+    size_t lsn;
+    {
+        const MutationGuard mutation(*this);
+        lsn = LogAddedRecords({{record_id, &record}});
+
+        // Добавляем запись в её шард (номер телефона уникален, так как полоса захвачена, а номер/id новый, поэтому
+        // добавление всегда успешно), а затем вносим слова её заметки в таблицу слов заметок
+        ShardByRecordId(record_id).AddRecordWithId(record_id, record);
+        UpdateNoteWordsStats({&record.note}, true);
+
+        // Добавляем данные в словарь "Номер телефона -> Номер/id записи"
+        stripe.number_to_record.emplace(record.number, record_id);
+    }
+    lock.unlock();
+    CommitLog(lsn);
+
+    // Возвращаем код ответа - 1
+    return 1;
+}
+
+// Функция пакетного добавления записей
+// (возвращает вектор кодов ответа в порядке записей: 0 - запись с таким номером телефона уже существует,
+//                                                    1 - запись успешно добавлена)
+vector<size_t> ShardedPhoneBookDatabase::AddRecords(const vector<Record>& records) {
+
+    // Индексы полос словаря номеров телефонов для номеров телефонов записей пакета
+    vector<size_t> stripes_indices;
+    stripes_indices.reserve(records.size());
+
+    // Флаги полос, которые затрагивает пакет
+    vector<bool> stripes_used(number_stripes_.size(), false);
+
+    for (const Record& record : records) {
+        stripes_indices.push_back(StripeIndexByNumber(record.number));
+        stripes_used[stripes_indices.back()] = true;
+    }
+
+    // Захватываем на запись все затронутые полосы в порядке возрастания их индексов (остальные методы держат не
+    // более одной полосы, поэтому единый порядок захвата исключает взаимную блокировку)
+    vector<unique_lock<shared_mutex>> stripes_locks;
+    for (size_t i = 0; i < number_stripes_.size(); ++i) {
+        if (stripes_used[i]) {
+            stripes_locks.emplace_back(number_stripes_[i]->mutex);
+        }
+    }
+
+    // Проверяем уникальность номеров телефонов за один проход: номера телефона не должно быть ни в глобальном
+    // словаре номеров телефонов, ни среди ранее принятых записей пакета
+    vector<size_t> codes;
+    codes.reserve(records.size());
+
+    unordered_set<string_view> batch_numbers;
+    batch_numbers.reserve(records.size());
+
+    size_t accepted_count = 0;
+    for (size_t i = 0; i < records.size(); ++i) {
+        const bool accepted = !number_stripes_[stripes_indices[i]]->number_to_record.count(records[i].number) &&
+                              batch_numbers.insert(records[i].number).second;
+        codes.push_back(accepted);
+        accepted_count += accepted;
+    }
+
+    // Если принятых записей нет, возвращаем коды ответа (номера/id не расходуются)
+    if (accepted_count == 0) {
+        return codes;
+    }
+
+    // Выдаём принятым записям номера/id одним атомарным сложением (блок подряд идущих номеров/id)
+    const size_t first_record_id = last_record_id_.fetch_add(accepted_count) + 1;
+    size_t record_id = first_record_id;
+
+    // Распределяем принятые записи по шардам в порядке их номеров/id
+    vector<pair<size_t, const Record*>> added_records;
+    added_records.reserve(accepted_count);
+    vector<vector<pair<size_t, const Record*>>> shards_records(shards_.size());
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (codes[i]) {
+            added_records.emplace_back(record_id, &records[i]);
+            shards_records[record_id % shards_.size()].emplace_back(record_id, &records[i]);
+            ++record_id;
+        }
+    }
+
+    // Дописываем добавление всех принятых записей в журнал упреждающей записи одним буфером до их публикации (пока
+    // полосы захвачены; если журнал неисправен, выбрасывается исключение, и ни одна запись пакета не добавляется)
+    size_t lsn;
+    {
+        const MutationGuard mutation(*this);
+        lsn = LogAddedRecords(added_records);
+
+        // Вносим номера телефонов принятых записей в полосы словаря номеров телефонов
+        for (size_t i = 0, j = 0; i < records.size(); ++i) {
+            if (codes[i]) {
+                const size_t added_record_id = added_records[j++].first;
+                number_stripes_[stripes_indices[i]]->number_to_record.emplace(records[i].number, added_record_id);
+            }
+        }
+
+        // Отмечаем номера/id пакета как добавляемые в шарды и освобождаем полосы: номера телефонов пакета уже заняты в
+        // полосах, поэтому их уникальность больше не зависит от полос, а запросы к номерам телефонов тех же полос не
+        // ждут добавления записей в шарды (удаление по номеру телефона записи пакета дождётся его окончания)
+        const pair<size_t, size_t> batch_ids(first_record_id, first_record_id + accepted_count);
+        {
+            lock_guard pending_lock(pending_batches_mutex_);
+            pending_batches_.push_back(batch_ids);
+        }
+        stripes_locks.clear();
+
+        // Функция снятия отметки пакета (и при успешном добавлении, и при исключении, чтобы ожидающие не зависли)
+        const auto finish_pending_batch = [this, &batch_ids]() {
+            {
+                lock_guard pending_lock(pending_batches_mutex_);
+                pending_batches_.erase(find(pending_batches_.begin(), pending_batches_.end(), batch_ids));
+            }
+            pending_batch_added_.notify_all();
+        };
+
+        // Добавляем записи в шарды параллельно в пуле рабочих потоков, каждый шард - одним пакетом (номера телефонов
+        // заняты пакетом в полосах, а номера/id новые, поэтому добавление всегда успешно), и тем же потоком вносим
+        // слова заметок записей шарда в таблицу слов заметок
+        try {
+            parallel_tasks::RunInParallel(worker_pool_, shards_.size(), shards_.size(), [&](size_t shard_index) {
+                const vector<pair<size_t, const Record*>>& shard_records = shards_records[shard_index];
+                if (shard_records.empty()) {
+                    return;
+                }
+                shards_[shard_index]->AddRecordsWithIds(shard_records);
+
+                vector<const string*> notes;
+                notes.reserve(shard_records.size());
+                for (const auto& [added_record_id, added_record] : shard_records) {
+                    notes.push_back(&added_record->note);
+                }
+                UpdateNoteWordsStats(notes, true);
+            });
+        } catch (...) {
+            finish_pending_batch();
+            throw;
+        }
+        finish_pending_batch();
+    }
+
+    // Дожидаемся долговечности кадров пакета уже после освобождения полос
+    CommitLog(lsn);
+
+    return codes;
+}
+
+// Функция удаления записи по её номеру/id
+// (возвращает код ответа: 0 - записи с таким номером/id не существует,
+//                         1 - запись успешно удалена)
+size_t ShardedPhoneBookDatabase::DeleteRecordById(size_t record_id) {
+
+    // Шард, в котором лежит запись
+    PhoneBookDatabase& shard = ShardByRecordId(record_id);
+
+    // Находим запись, чтобы узнать её номер телефона, и если записи с таким номером/id не существует в базе
+    // данных, возвращаем код ответа - 0
+    optional<RecordWithId> record = shard.FindRecordById(record_id);
+    if (!record) {
+        return 0;
+    }
+
+    // Захватываем на запись полосу словаря номеров телефонов для номера телефона записи
+    NumberStripe& stripe = StripeByNumber(record->number);
+    unique_lock lock(stripe.mutex);
+
+    // Если пока полоса не была захвачена, запись успел удалить другой поток, возвращаем код ответа - 0
+    // (номера/id никогда не выдаются повторно, поэтому достаточно сравнить номер/id в словаре номеров телефонов)
+    auto it = stripe.number_to_record.find(record->number);
+    if (it == stripe.number_to_record.end() || it->second != record_id) {
+        return 0;
+    }
+
+    // Если запись принадлежит пакету AddRecords, который ещё вносит слова заметок своих записей в таблицу слов
+    // заметок, дожидаемся конца пакета, чтобы удаление попало в таблицу после добавления
+    WaitForPendingRecord(record_id);
+
+    // Дописываем удаление записи в журнал упреждающей записи до его публикации (пока полоса захвачена; если журнал
+    // неисправен, выбрасывается исключение, и запись не удаляется), а его долговечности дожидаемся уже после
+    // освобождения полосы
+    size_t lsn;
+    {
+        const MutationGuard mutation(*this);
+        lsn = LogDeletedRecord(record_id);
+
+        // Удаляем запись из её шарда, слова её заметки - из таблицы слов заметок, а запись - из словаря "Номер
+        // телефона -> Номер/id записи"
+        shard.DeleteRecordById(record_id);
+        UpdateNoteWordsStats({&record->note}, false);
+        stripe.number_to_record.erase(it);
+    }
+    lock.unlock();
+    CommitLog(lsn);
+
+    // Возвращаем код ответа - 1
+    return 1;
+}
+
+// Функция удаления записи по номеру телефона
+// (возвращает код ответа: 0 - записи с таким номером телефона не существует,
+//                         1 - запись успешно удалена)
+size_t ShardedPhoneBookDatabase::DeleteRecordByNumber(const string& number) {
+
+    // Захватываем на запись полосу словаря номеров телефонов для номера телефона
+    NumberStripe& stripe = StripeByNumber(number);
+    unique_lock lock(stripe.mutex);
+
+    // Если записи с таким номером телефона не существует в базе данных, возвращаем код ответа - 0
+    auto it = stripe.number_to_record.find(number);
+    if (it == stripe.number_to_record.end()) {
+        return 0;
+    }
+
+    // Если запись принадлежит пакету AddRecords, который ещё добавляет записи в шарды, дожидаемся её добавления
+    // (пакет уже не захватывает полосы, поэтому ожидание под полосой не приводит к взаимной блокировке)
+    const size_t record_id = it->second;
+    WaitForPendingRecord(record_id);
+
+    // Находим запись, чтобы узнать её заметку (запись есть в шарде, пока полоса захвачена: её номер телефона в полосе)
+    PhoneBookDatabase& shard = ShardByRecordId(record_id);
+    const optional<RecordWithId> record = shard.FindRecordById(record_id);
+
+    // Дописываем удаление записи в журнал упреждающей записи по её номеру/id до его публикации (пока полоса захвачена;
+    // если журнал неисправен, выбрасывается исключение, и запись не удаляется), а его долговечности дожидаемся уже
+    // после освобождения полосы
+    size_t lsn;
+    {
+        const MutationGuard mutation(*this);
+        lsn = LogDeletedRecord(record_id);
+
+        // Удаляем запись из её шарда, слова её заметки - из таблицы слов заметок, а запись - из словаря "Номер
+        // телефона -> Номер/id записи"
+        shard.DeleteRecordById(record_id);
+        if (record) {
+            UpdateNoteWordsStats({&record->note}, false);
+        }
+        stripe.number_to_record.erase(it);
+    }
+    lock.unlock();
+    CommitLog(lsn);
+
+    // Возвращаем код ответа - 1
+    return 1;
+}
+
+// Функция поиска записи по номеру/id записи (запрос в один шард)
+// (найденная запись может быть только одна или её может не быть вовсе, тогда возвращает nullopt)
+optional<ShardedPhoneBookDatabase::RecordWithId> ShardedPhoneBookDatabase::FindRecordById(size_t id) const {
+    return ShardByRecordId(id).FindRecordById(id);
+}
+
+// Функция поиска записей по имени (запрос во все шарды параллельно)
+// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+optional<vector<ShardedPhoneBookDatabase::RecordWithId>> ShardedPhoneBookDatabase::FindRecordsByName(const string& name) const {
+    return MergeById(FanOut([&name](const PhoneBookDatabase& shard) {
+        return shard.FindRecordsByName(name);
+    }));
+}
+
+// Функция поиска записей по фамилии (запрос во все шарды параллельно)
+// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+optional<vector<ShardedPhoneBookDatabase::RecordWithId>> ShardedPhoneBookDatabase::FindRecordsBySurname(const string& surname) const {
+    return MergeById(FanOut([&surname](const PhoneBookDatabase& shard) {
+        return shard.FindRecordsBySurname(surname);
+    }));
+}
+
+// Функция поиска записей по отчеству (запрос во все шарды параллельно)
+// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+optional<vector<ShardedPhoneBookDatabase::RecordWithId>> ShardedPhoneBookDatabase::FindRecordsByPatronymic(const string& patronymic) const {
+    return MergeById(FanOut([&patronymic](const PhoneBookDatabase& shard) {
+        return shard.FindRecordsByPatronymic(patronymic);
+    }));
+}
+
+// Функция поиска записи по номеру телефона (запрос в одну полосу словаря номеров телефонов и один шард)
+// (найденная запись может быть только одна или её может не быть вовсе, тогда возвращает nullopt)
+optional<ShardedPhoneBookDatabase::RecordWithId> ShardedPhoneBookDatabase::FindRecordByNumber(const string& number) const {
+
+    // Номер/id записи с таким номером телефона
+    size_t record_id;
+
+    // Захватываем на чтение полосу словаря номеров телефонов только на время поиска номера/id
+    {
+        const NumberStripe& stripe = StripeByNumber(number);
+        shared_lock lock(stripe.mutex);
+
+        // Если записи с таким номером телефона не существует в базе данных, возвращаем nullopt
+        auto it = stripe.number_to_record.find(number);
+        if (it == stripe.number_to_record.end()) {
+            return nullopt;
+        }
+
+        record_id = it->second;
+    }
+
+    // Ищем запись в её шарде (если её успели удалить, шард вернёт nullopt)
+    return ShardByRecordId(record_id).FindRecordById(record_id);
+}
+
+// Функция пакетного поиска записей по номерам/id
+// (возвращает вектор найденных записей в порядке номеров/id, для ненайденных номеров/id - nullopt)
+vector<optional<ShardedPhoneBookDatabase::RecordWithId>> ShardedPhoneBookDatabase::FindRecordsByIds(const vector<size_t>& ids) const {
+
+    // Раскладываем номера/id по шардам, запоминая их позиции в исходном векторе
+    vector<vector<size_t>> shards_ids(shards_.size());
+    vector<vector<size_t>> shards_positions(shards_.size());
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        const size_t shard_index = ids[i] % shards_.size();
+        shards_ids[shard_index].push_back(ids[i]);
+        shards_positions[shard_index].push_back(i);
+    }
+
+    // Вектор найденных записей в порядке номеров/id
+    vector<optional<RecordWithId>> records(ids.size());
+
+    // Ищем записи в каждом шарде одним пакетным запросом и раскладываем их по исходным позициям
+    for (size_t shard_index = 0; shard_index < shards_.size(); ++shard_index) {
+        if (shards_ids[shard_index].empty()) {
+            continue;
+        }
+
+        vector<optional<RecordWithId>> shard_records = shards_[shard_index]->FindRecordsByIds(shards_ids[shard_index]);
+        for (size_t i = 0; i < shard_records.size(); ++i) {
+            records[shards_positions[shard_index][i]] = move(shard_records[i]);
+        }
+    }
+
+    return records;
+}
+
+// Функция пакетного поиска записей по номерам телефонов
+// (возвращает вектор найденных записей в порядке номеров телефонов, для ненайденных номеров телефонов - nullopt)
+vector<optional<ShardedPhoneBookDatabase::RecordWithId>> ShardedPhoneBookDatabase::FindRecordsByNumbers(const vector<string>& numbers) const {
+
+    // Раскладываем позиции номеров телефонов по полосам словаря номеров телефонов
+    vector<vector<size_t>> stripes_positions(number_stripes_.size());
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        stripes_positions[StripeIndexByNumber(numbers[i])].push_back(i);
+    }
+
+    // Номера/id записей с такими номерами телефонов (для ненайденных номеров телефонов остаётся номер/id 0, который
+    // никогда не выдаётся записям)
+    vector<size_t> ids(numbers.size(), 0);
+
+    // Захватываем на чтение каждую полосу один раз на все её номера телефонов и только на время поиска номеров/id
+    for (size_t stripe_index = 0; stripe_index < number_stripes_.size(); ++stripe_index) {
+        if (stripes_positions[stripe_index].empty()) {
+            continue;
+        }
+
+        const NumberStripe& stripe = *number_stripes_[stripe_index];
+        shared_lock lock(stripe.mutex);
+
+        for (size_t position : stripes_positions[stripe_index]) {
+            auto it = stripe.number_to_record.find(numbers[position]);
+            if (it != stripe.number_to_record.end()) {
+                ids[position] = it->second;
+            }
+        }
+    }
+
+    // Ищем записи по найденным номерам/id в шардах (если запись успели удалить, шард вернёт nullopt)
+    return FindRecordsByIds(ids);
+}
+
+// Функция поиска записей по содержанию заметок (запрос во все шарды параллельно с глобальными частотами IDF)
+// (возвращает топ из не более чем max_records_count самых релевантных записей; найденных записей может быть
+//  множество или не быть вовсе, тогда возвращает nullopt)
+optional<vector<ShardedPhoneBookDatabase::RecordWithId>> ShardedPhoneBookDatabase::FindRecordsByNote(const string& note,
+                                                                                                    size_t max_records_count,
+                                                                                                    const NoteRankingParams& ranking_params) const {
+
+    // Ищем общий топ записей (одинаковые одновременные запросы выполняются один раз) и копируем его
+    SharedRecords records = ShareRecordsByNote(note, max_records_count, ranking_params);
+    if (!records) {
+        return nullopt;
+    }
+
+    return *records;
+}
+
+// Функция поиска записей по содержанию заметок с объединением одинаковых одновременных запросов
+// (возвращает общий топ записей или nullptr, если записей не найдено)
+ShardedPhoneBookDatabase::SharedRecords ShardedPhoneBookDatabase::ShareRecordsByNote(const string& note, size_t max_records_count,
+                                                                                     const NoteRankingParams& ranking_params) const {
+
+    // Разделим содержание заметки note на отдельные слова, отсортируем и удалим дубликаты
+    vector<string_view> words = string_functions::SortAndRemoveDuplicates(string_functions::SplitIntoWords(note));
+
+    // Ключ запроса (общий для кэша результатов и объединения одновременных запросов): слова запроса, ограничение на
+    // число записей и параметры ранжирования
+    string key = NoteSearchCache::MakeKey(words, max_records_count, ranking_params);
+
+    // Запрос выполняет лишь первый из одинаковых одновременных запросов, остальные получают его результат
+    return note_flights_.Do(key, [&]() {
+        return ComputeRecordsByNote(words, key, max_records_count, ranking_params);
+    });
+}
+
+// Функция поиска записей по содержанию заметок по отсортированным различным словам запроса words (сначала в кэше
+// результатов, затем в шардах)
+// (возвращает общий топ записей или nullptr, если записей не найдено)
+ShardedPhoneBookDatabase::SharedRecords ShardedPhoneBookDatabase::ComputeRecordsByNote(const vector<string_view>& words,
+                                                                                       string cache_key,
+                                                                                       size_t max_records_count,
+                                                                                       const NoteRankingParams& ranking_params) const {
+
+    // Первый этап: читаем из глобальной таблицы слов заметок число записей, суммарную длину заметок, а для каждого
+    // слова запроса - число записей, где оно встречается, и поколение (каждое слово ищется в таблице один раз, шарды
+    // на этом этапе не опрашиваются)
+    vector<NoteWordStats> words_stats;
+    NoteSearchCache::DataVersion version = ReadNoteWordsStats(words, words_stats);
+    const size_t records_count = version.records_count;
+    const size_t notes_length = version.notes_length;
+
+    // Если такой же запрос уже выполнялся и слова запроса с тех пор не изменились, возвращаем топ из кэша
+    if (SharedRecords cached_records = note_search_cache_.Find(cache_key, version)) {
+        return cached_records;
+    }
+
+    // Вычисляем глобальную частоту IDF (Inverse Document Frequency) для каждого слова, которое встречается
+    // в заметках хотя бы одной записи, по той же формуле, что и у PhoneBookDatabase:
+    //
+    // IDF = log(Число записей в базе данных) - log(Число записей, где слово встречается в заметке)
+    //
+    // (логарифм числа записей слова хранится в таблице и пересчитывается только при изменении слова; для BM25 -
+    //  по формуле BM25, общей с PhoneBookDatabase)
+    const bool bm25 = ranking_params.ranking == NoteRanking::BM25;
+    const double log_records_count = log(static_cast<double>(records_count));
+    vector<pair<string_view, double>> words_inverse_freqs;
+
+    for (size_t i = 0; i < words.size(); ++i) {
+        const NoteWordStats& stats = words_stats[i];
+        if (stats.records_count == 0) {
+            continue;
+        }
+
+        words_inverse_freqs.push_back(
+            {words[i], bm25 ? PhoneBookDatabase::ComputeWordBM25InverseDocumentFreq(records_count, stats.records_count)
+                            : PhoneBookDatabase::ComputeWordInverseDocumentFreq(log_records_count,
+                                                                                 stats.log_records_count)});
+    }
+
+    // Глобальная средняя длина заметки (нужна только для BM25)
+    const double average_note_length = static_cast<double>(notes_length) / static_cast<double>(max(records_count, size_t{1}));
+
+    // Если ни одно слово не встречается в заметках, записей не найдено - возвращаем nullptr
+    if (words_inverse_freqs.empty()) {
+        return nullptr;
+    }
+
+    // Второй этап: каждый шард отбирает свой топ записей по выбранной модели ранжирования с глобальными частотами
+    // IDF и средней длиной заметки
+    vector<vector<pair<RecordWithId, double>>> shards_records = FanOut([&](const PhoneBookDatabase& shard) {
+        return shard.RankRecordsByNoteWords(words_inverse_freqs, max_records_count, ranking_params, average_note_length);
+    });
+
+    // Сливаем топы шардов в глобальный топ
+    vector<RecordWithId> result = MergeByRelevance(move(shards_records), max_records_count);
+
+    // Если вектор найденных записей оказался пустым (шарды успели удалить записи между этапами), возвращаем nullptr
+    if (result.empty()) {
+        return nullptr;
+    }
+
+    SharedRecords records = make_shared<const vector<RecordWithId>>(move(result));
+
+    // Кладём топ в кэш с версией данных первого этапа без повторного подсчёта: таблица слов заметок обновляется
+    // только после того, как шард опубликовал изменение, поэтому шарды ранжировали данные не старше этой версии, а
+    // если слова запроса изменились за время второго этапа, их поколения в таблице уже другие (поколения не
+    // повторяются), и сохранённый топ не совпадёт ни с одной последующей версией
+    note_search_cache_.Insert(move(cache_key), move(version), records);
+
+    // Возвращаем общий топ найденных записей
+    return records;
+}
+
+// Функции поиска записей по имени/фамилии/отчеству с объединением одинаковых одновременных запросов
+// (возвращают общий вектор записей или nullptr, если записей больше MAX_SHARED_RECORDS)
+ShardedPhoneBookDatabase::SharedRecords ShardedPhoneBookDatabase::ShareRecordsByName(const string& name) const {
+    return ShareRecords(name_flights_, name, &ShardedPhoneBookDatabase::OpenRecordsByName);
+}
+
+ShardedPhoneBookDatabase::SharedRecords ShardedPhoneBookDatabase::ShareRecordsBySurname(const string& surname) const {
+    return ShareRecords(surname_flights_, surname, &ShardedPhoneBookDatabase::OpenRecordsBySurname);
+}
+
+ShardedPhoneBookDatabase::SharedRecords ShardedPhoneBookDatabase::ShareRecordsByPatronymic(const string& patronymic) const {
+    return ShareRecords(patronymic_flights_, patronymic, &ShardedPhoneBookDatabase::OpenRecordsByPatronymic);
+}
+
+// Функция поиска записей по ключу key курсором open_records с объединением одинаковых одновременных запросов группы
+// flights
+ShardedPhoneBookDatabase::SharedRecords ShardedPhoneBookDatabase::ShareRecords(
+    SearchFlights& flights, const string& key,
+    RecordsCursor (ShardedPhoneBookDatabase::*open_records)(const string&) const) const {
+
+    return flights.Do(key, [&]() -> SharedRecords {
+
+        // Собираем записи курсора в вектор, но не более MAX_SHARED_RECORDS (больший результат в общий вектор не
+        // собираем: каждый запрос прочитает его своим курсором, не занимая память под все записи сразу)
+        vector<RecordWithId> records;
+
+        for (RecordsCursor cursor = (this->*open_records)(key); cursor.HasRecord(); cursor.Next()) {
+            if (records.size() == MAX_SHARED_RECORDS) {
+                return nullptr;
+            }
+
+            const Record& record = cursor.CurrentRecord();
+            records.push_back({cursor.RecordId(), record.name, record.surname, record.patronymic, record.number, record.note});
+        }
+
+        return make_shared<const vector<RecordWithId>>(move(records));
+    });
+}
+
+// Функция получения статистики объединения одинаковых одновременных запросов поиска (суммарно по всем группам)
+ShardedPhoneBookDatabase::SearchFlights::Stats ShardedPhoneBookDatabase::GetSearchFlightsStats() const {
+    SearchFlights::Stats stats;
+
+    for (const SearchFlights* flights : {&note_flights_, &name_flights_, &surname_flights_, &patronymic_flights_}) {
+        const SearchFlights::Stats flights_stats = flights->GetStats();
+        stats.executed += flights_stats.executed;
+        stats.coalesced += flights_stats.coalesced;
+    }
+
+    return stats;
+}
+
+// Функция чтения из глобальной таблицы слов заметок числа записей, суммарной длины заметок и статистики каждого из
+// слов words в words_stats (возвращает версию данных для кэша результатов поиска по заметкам)
+// (полосы таблицы захватываются на чтение по одной на слово; слово, которого нет в таблице, получает нулевую
+//  статистику и нулевое поколение)
+NoteSearchCache::DataVersion ShardedPhoneBookDatabase::ReadNoteWordsStats(const vector<string_view>& words,
+                                                                          vector<NoteWordStats>& words_stats) const {
+    NoteSearchCache::DataVersion version;
+    version.records_count = note_records_count_.load();
+    version.notes_length = notes_length_.load();
+    version.word_generations.assign(words.size(), 0);
+    words_stats.assign(words.size(), NoteWordStats{});
+
+    for (size_t i = 0; i < words.size(); ++i) {
+        const NoteWordStripe& stripe = StripeByNoteWord(words[i]);
+        shared_lock lock(stripe.mutex);
+
+        const auto it = stripe.word_to_entry.find(words[i]);
+        if (it != stripe.word_to_entry.end()) {
+            words_stats[i] = it->second->stats;
+            version.word_generations[i] = it->second->stats.generation;
+        }
+    }
+
+    return version;
+}
+
+// Функция внесения в глобальную таблицу слов заметок добавления (added == true) или удаления записей с заметками
+// notes (вызывается после того, как шард опубликовал изменение)
+// (изменения сначала суммируются по словам всех заметок, затем каждая затронутая полоса таблицы захватывается на
+//  запись один раз; изменённое слово получает новое поколение, а слово, которого не осталось ни в одной заметке,
+//  удаляется из таблицы)
+void ShardedPhoneBookDatabase::UpdateNoteWordsStats(const vector<const string*>& notes, bool added) {
+
+    // Подсчитываем число заметок с каждым словом и суммарную длину заметок
+    unordered_map<string_view, size_t> word_deltas;
+    size_t notes_length = 0;
+    for (const string* note : notes) {
+        size_t note_length = 0;
+        for (string_view word : PhoneBookDatabase::SplitNoteWords(*note, note_length)) {
+            ++word_deltas[word];
+        }
+        notes_length += note_length;
+    }
+
+    // Раскладываем изменения слов по полосам таблицы
+    vector<vector<pair<string_view, size_t>>> stripes_deltas(note_word_stripes_.size());
+    for (const auto& [word, delta] : word_deltas) {
+        stripes_deltas[hash<string_view>{}(word) % note_word_stripes_.size()].emplace_back(word, delta);
+    }
+
+    // Вносим изменения в полосы таблицы
+    for (size_t i = 0; i < stripes_deltas.size(); ++i) {
+        if (stripes_deltas[i].empty()) {
+            continue;
+        }
+
+        NoteWordStripe& stripe = *note_word_stripes_[i];
+        unique_lock lock(stripe.mutex);
+
+        for (const auto& [word, delta] : stripes_deltas[i]) {
+            auto it = stripe.word_to_entry.find(word);
+            if (it == stripe.word_to_entry.end()) {
+                // Ключ словаря ссылается на слово внутри элемента таблицы (адрес элемента не меняется)
+                auto entry = make_unique<NoteWordEntry>();
+                entry->word = string(word);
+                const string_view key = entry->word;
+                it = stripe.word_to_entry.emplace(key, move(entry)).first;
+            }
+
+            NoteWordStats& stats = it->second->stats;
+            if (added) {
+                stats.records_count += delta;
+            } else {
+                stats.records_count -= delta;
+            }
+            if (stats.records_count == 0) {
+                stripe.word_to_entry.erase(it);
+                continue;
+            }
+            stats.log_records_count = log(static_cast<double>(stats.records_count));
+            stats.generation = ++note_words_generation_;
+        }
+    }
+
+    if (added) {
+        note_records_count_ += notes.size();
+        notes_length_ += notes_length;
+    } else {
+        note_records_count_ -= notes.size();
+        notes_length_ -= notes_length;
+    }
+}
+
+// Функция построения глобальной таблицы слов заметок по всем шардам (вызывается в конструкторе после загрузки данных,
+// когда к базе данных ещё нет других обращений)
+void ShardedPhoneBookDatabase::BuildNoteWordsStats() {
+    size_t records_count = 0;
+    size_t notes_length = 0;
+
+    // Суммируем числа записей слов по всем шардам
+    for (const unique_ptr<PhoneBookDatabase>& shard : shards_) {
+        PhoneBookDatabase::NoteWordsCounts shard_counts = shard->CountNoteWords();
+        records_count += shard_counts.records_count;
+        notes_length += shard_counts.notes_length;
+
+        for (auto& [word, word_records_count] : shard_counts.word_records_counts) {
+            NoteWordStripe& stripe = StripeByNoteWord(word);
+            auto it = stripe.word_to_entry.find(word);
+            if (it == stripe.word_to_entry.end()) {
+                auto entry = make_unique<NoteWordEntry>();
+                entry->word = move(word);
+                const string_view key = entry->word;
+                it = stripe.word_to_entry.emplace(key, move(entry)).first;
+            }
+            it->second->stats.records_count += word_records_count;
+        }
+    }
+
+    // Вычисляем логарифмы чисел записей слов и выдаём словам первые поколения
+    for (const unique_ptr<NoteWordStripe>& stripe : note_word_stripes_) {
+        for (auto& [word, entry] : stripe->word_to_entry) {
+            entry->stats.log_records_count = log(static_cast<double>(entry->stats.records_count));
+            entry->stats.generation = ++note_words_generation_;
+        }
+    }
+
+    note_records_count_ = records_count;
+    notes_length_ = notes_length;
+}
+
+// Функция открытия курсора по записям с указанным именем во всех шардах
+ShardedPhoneBookDatabase::RecordsCursor ShardedPhoneBookDatabase::OpenRecordsByName(const string& name) const {
+    vector<PhoneBookDatabase::RecordsCursor> shards_cursors;
+    shards_cursors.reserve(shards_.size());
+
+    for (const unique_ptr<PhoneBookDatabase>& shard : shards_) {
+        shards_cursors.push_back(shard->OpenRecordsByName(name));
+    }
+
+    return RecordsCursor(move(shards_cursors));
+}
+
+// Функция открытия курсора по записям с указанной фамилией во всех шардах
+ShardedPhoneBookDatabase::RecordsCursor ShardedPhoneBookDatabase::OpenRecordsBySurname(const string& surname) const {
+    vector<PhoneBookDatabase::RecordsCursor> shards_cursors;
+    shards_cursors.reserve(shards_.size());
+
+    for (const unique_ptr<PhoneBookDatabase>& shard : shards_) {
+        shards_cursors.push_back(shard->OpenRecordsBySurname(surname));
+    }
+
+    return RecordsCursor(move(shards_cursors));
+}
+
+// Функция открытия курсора по записям с указанным отчеством во всех шардах
+ShardedPhoneBookDatabase::RecordsCursor ShardedPhoneBookDatabase::OpenRecordsByPatronymic(const string& patronymic) const {
+    vector<PhoneBookDatabase::RecordsCursor> shards_cursors;
+    shards_cursors.reserve(shards_.size());
+
+    for (const unique_ptr<PhoneBookDatabase>& shard : shards_) {
+        shards_cursors.push_back(shard->OpenRecordsByPatronymic(patronymic));
+    }
+
+    return RecordsCursor(move(shards_cursors));
+}
+
+// Функция поиска записей по нескольким полям сразу (запрос во все шарды параллельно)
+// (найденных записей может быть множество или не быть вовсе, тогда возвращает nullopt)
+optional<vector<ShardedPhoneBookDatabase::RecordWithId>> ShardedPhoneBookDatabase::FindRecordsByQuery(const RecordsQuery& query) const {
+    return MergeById(FanOut([&query](const PhoneBookDatabase& shard) {
+        return shard.FindRecordsByQuery(query);
+    }));
+}
+
+// Функция открытия курсора по записям, удовлетворяющим всем условиям запроса, во всех шардах
+// (в отличие от курсоров по имени/фамилии/отчеству открытие курсора шарда вычисляет пересечение, поэтому шарды
+//  опрашиваются параллельно)
+ShardedPhoneBookDatabase::RecordsCursor ShardedPhoneBookDatabase::OpenRecordsByQuery(const RecordsQuery& query) const {
+    return RecordsCursor(FanOut([&query](const PhoneBookDatabase& shard) {
+        return shard.OpenRecordsByQuery(query);
+    }));
+}
+
+// Конструктор курсора, объединяющего курсоры шардов
+ShardedPhoneBookDatabase::RecordsCursor::RecordsCursor(vector<PhoneBookDatabase::RecordsCursor> shards_cursors) :
+    shards_cursors_(move(shards_cursors)) {
+
+    // Кладём в кучу номера курсоров тех шардов, в которых нашлись записи
+    for (size_t i = 0; i < shards_cursors_.size(); ++i) {
+        if (shards_cursors_[i].HasRecord()) {
+            shards_heap_.push_back(i);
+        }
+    }
+
+    make_heap(shards_heap_.begin(), shards_heap_.end(), [this](size_t lhs, size_t rhs) { return ShardGreater(lhs, rhs); });
+}
+
+// Функция перехода к следующей записи
+void ShardedPhoneBookDatabase::RecordsCursor::Next() {
+    const auto shard_greater = [this](size_t lhs, size_t rhs) { return ShardGreater(lhs, rhs); };
+
+    // Вынимаем из кучи курсор шарда с наименьшим номером/id записи и сдвигаем его
+    pop_heap(shards_heap_.begin(), shards_heap_.end(), shard_greater);
+    PhoneBookDatabase::RecordsCursor& shard_cursor = shards_cursors_[shards_heap_.back()];
+    shard_cursor.Next();
+
+    // Если в шарде ещё остались записи, возвращаем его курсор в кучу, иначе убираем
+    if (shard_cursor.HasRecord()) {
+        push_heap(shards_heap_.begin(), shards_heap_.end(), shard_greater);
+    }
+    else {
+        shards_heap_.pop_back();
+    }
+}
+
+// Функция объединения результатов поиска по шардам в один вектор, упорядоченный по номеру/id записи
+// (если записей не найдено ни в одном шарде, возвращает nullopt)
+optional<vector<ShardedPhoneBookDatabase::RecordWithId>> ShardedPhoneBookDatabase::MergeById(vector<optional<vector<RecordWithId>>> shards_records) {
+
+    // Вектор найденных записей всех шардов
+    vector<RecordWithId> result;
+
+    // Перемещаем в него найденные записи каждого шарда
+    for (optional<vector<RecordWithId>>& shard_records : shards_records) {
+        if (shard_records) {
+            move(shard_records->begin(), shard_records->end(), back_inserter(result));
+        }
+    }
+
+    // Если записей не найдено ни в одном шарде, возвращаем nullopt
+    if (result.empty()) {
+        return nullopt;
+    }
+
+    // Упорядочиваем найденные записи по номеру/id (так же, как их упорядочивает PhoneBookDatabase)
+    sort(result.begin(), result.end(), [](const RecordWithId& lhs, const RecordWithId& rhs) {
+        return lhs.id < rhs.id;
+    });
+
+    // Возвращаем вектор найденных записей
+    return result;
+}
+
+// Функция слияния отсортированных по убыванию релевантности результатов ранжирования шардов в глобальный
+// топ из не более чем max_records_count записей (k-way merge через кучу)
+vector<ShardedPhoneBookDatabase::RecordWithId> ShardedPhoneBookDatabase::MergeByRelevance(
+    vector<vector<pair<RecordWithId, double>>> shards_records, size_t max_records_count) {
+
+    // Элемент кучи: кортеж "Релевантность по TF-IDF, индекс шарда, позиция в результатах шарда"
+    using HeapItem = tuple<double, size_t, size_t>;
+
+    // Порядок кучи совпадает с порядком топов шардов (PhoneBookDatabase::HigherRelevance): по убыванию релевантности,
+    // а при равной релевантности - по возрастанию номера/id записи (наверху кучи лежит элемент, который должен идти в
+    // топе раньше)
+    const auto lower_in_top = [&shards_records](const HeapItem& lhs, const HeapItem& rhs) {
+        const auto& [lhs_relevance, lhs_shard_index, lhs_position] = lhs;
+        const auto& [rhs_relevance, rhs_shard_index, rhs_position] = rhs;
+
+        const size_t lhs_id = shards_records[lhs_shard_index][lhs_position].first.id;
+        const size_t rhs_id = shards_records[rhs_shard_index][rhs_position].first.id;
+
+        return PhoneBookDatabase::HigherRelevance(rhs_id, rhs_relevance, lhs_id, lhs_relevance);
+    };
+
+    // Куча с наибольшей релевантностью наверху, в которой лежит по одной (лучшей ещё не взятой) записи каждого шарда
+    priority_queue<HeapItem, vector<HeapItem>, decltype(lower_in_top)> heap(lower_in_top);
+
+    for (size_t i = 0; i < shards_records.size(); ++i) {
+        if (!shards_records[i].empty()) {
+            heap.push({shards_records[i][0].second, i, 0});
+        }
+    }
+
+    // Итоговый вектор найденных записей
+    vector<RecordWithId> result;
+
+    // Пока не набран топ и в куче есть записи, забираем запись с наибольшей релевантностью и кладём в кучу
+    // следующую запись того же шарда
+    while (!heap.empty() && result.size() < max_records_count) {
+        auto [relevance, shard_index, position] = heap.top();
+        heap.pop();
+
+        result.push_back(move(shards_records[shard_index][position].first));
+
+        if (position + 1 < shards_records[shard_index].size()) {
+            heap.push({shards_records[shard_index][position + 1].second, shard_index, position + 1});
+        }
+    }
+
+    // Возвращаем вектор найденных записей
+    return result;
+}
+
+}
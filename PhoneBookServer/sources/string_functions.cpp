@@ -1,7 +1,18 @@
 // Единица трансляции string_functions.cpp содержит в себе функции для работы со строками
 
-// Подключим библиотеку algorithm для использования стандартных алгоритмов
+// Подключим библиотеку algorithm для использования стандартных алгоритмов, библиотеку array для таблицы
+// символов-сепараторов, библиотеку cstdint для 64-битных масок сепараторов и библиотеку charconv для разбора чисел без
+// выделения памяти (from_chars)
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <charconv>
+
+// Подключим заголовочный файл с intrinsic-функциями SSE2 и AVX2 (только для процессоров x86, сами функции
+// компилируются для своего набора инструкций через атрибут target и вызываются, только если процессор его поддерживает)
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
 
 // Подключим заголовочный файл с функциями для работы со строками
 #include "string_functions.h"
@@ -80,35 +91,191 @@ string ConverteQuotesToAmpersandSequences(string_view str) {
     return result;
 }
 
+
+// Символы-сепараторы слов
+static constexpr string_view SEPARATOR_CHARS = "!?.:,;\"()[]{} "sv;
+
+// Таблица "Байт -> Является ли байт символом-сепаратором" (строится при компиляции)
+static constexpr array<bool, 256> SEPARATORS_TABLE = []() {
+    array<bool, 256> table{};
+    for (char c : SEPARATOR_CHARS) {
+        table[static_cast<unsigned char>(c)] = true;
+    }
+    return table;
+}();
+
+// Функция построения 64-битной маски сепараторов для 64 байт строки по таблице (бит i равен единице, если байт i -
+// символ-сепаратор)
+static uint64_t SeparatorsMaskScalar(const char* data) {
+    uint64_t mask = 0;
+    for (size_t i = 0; i < 64; ++i) {
+        mask |= static_cast<uint64_t>(SEPARATORS_TABLE[static_cast<unsigned char>(data[i])]) << i;
+    }
+    return mask;
 }
 
-// Функция разделения строки на слова через символы-сепараторы
-// (знаки препинания ".", "?", "!", ".", ":", ",", ";", кавычки, скобки "()", "[]", "{}" и пробел " ")
-// (возвращает вектор string_view, ссылающихся на оригинальную строку)
-vector<string_view> SplitIntoWords(string_view str) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+// Функция построения 64-битной маски сепараторов для 64 байт строки через SSE2 (в SSE2 нет перестановки байт по
+// таблице, поэтому каждые 16 байт сравниваются с сепараторами). Сепараторы попарно отличаются одним битом, поэтому
+// 14 сепараторов проверяются 8 сравнениями: после обнуления бита 0 - пары пробел/"!", "("/")", ":"/";", после
+// обнуления бита 1 - пара ","/".", после установки бита 5 - пары "["/"{" и "]"/"}", а кавычка и "?" - отдельно
+__attribute__((target("sse2")))
+static uint64_t SeparatorsMaskSSE2(const char* data) {
+    const __m128i clear_bit0 = _mm_set1_epi8(static_cast<char>(0xFE));
+    const __m128i clear_bit1 = _mm_set1_epi8(static_cast<char>(0xFD));
+    const __m128i set_bit5 = _mm_set1_epi8(0x20);
+
+    uint64_t mask = 0;
+
+    for (size_t part = 0; part < 4; ++part) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + part * 16));
+        const __m128i bytes_bit0 = _mm_and_si128(bytes, clear_bit0);
+        const __m128i bytes_bit5 = _mm_or_si128(bytes, set_bit5);
+
+        __m128i separators = _mm_cmpeq_epi8(bytes_bit0, _mm_set1_epi8(' '));
+        separators = _mm_or_si128(separators, _mm_cmpeq_epi8(bytes_bit0, _mm_set1_epi8('(')));
+        separators = _mm_or_si128(separators, _mm_cmpeq_epi8(bytes_bit0, _mm_set1_epi8(':')));
+        separators = _mm_or_si128(separators, _mm_cmpeq_epi8(_mm_and_si128(bytes, clear_bit1), _mm_set1_epi8(',')));
+        separators = _mm_or_si128(separators, _mm_cmpeq_epi8(bytes_bit5, _mm_set1_epi8('{')));
+        separators = _mm_or_si128(separators, _mm_cmpeq_epi8(bytes_bit5, _mm_set1_epi8('}')));
+        separators = _mm_or_si128(separators, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('"')));
+        separators = _mm_or_si128(separators, _mm_cmpeq_epi8(bytes, _mm_set1_epi8('?')));
+
+        mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(separators))) << (part * 16);
+    }
 
-    // Вектор с разделёнными словами
-    vector<string_view> words;
+    return mask;
+}
 
-    // Символы-сепараторы:
-    const static string separator_chars = "!?.:,;\"()[]{} "s;
+// Функция построения 64-битной маски сепараторов для 64 байт строки через AVX2: каждые 32 байта классифицируются
+// двумя перестановками байт по таблицам (vpshufb) - по младшей и по старшей тетраде (nibble) байта.
+//
+// Сепараторы разбиты на классы по старшей тетраде: класс 1 - 0x2? (пробел, "!", кавычка, "(", ")", ",", "."),
+// класс 2 - 0x3? (":", ";", "?"), класс 4 - 0x5? и 0x7? ("[", "]", "{", "}"). Таблица по старшей тетраде выдаёт
+// бит класса (для байт от 0x80, т.е. байт UTF-8 кириллицы, - ноль), а таблица по младшей тетраде - биты классов, в
+// которых есть сепаратор с такой младшей тетрадой. Байт - сепаратор, если у двух результатов есть общий бит
+__attribute__((target("avx2")))
+static uint64_t SeparatorsMaskAVX2(const char* data) {
+    const __m256i low_table = _mm256_setr_epi8(
+        1, 1, 1, 0, 0, 0, 0, 0, 1, 1, 2, 6, 1, 4, 1, 2,
+        1, 1, 1, 0, 0, 0, 0, 0, 1, 1, 2, 6, 1, 4, 1, 2);
+    const __m256i high_table = _mm256_setr_epi8(
+        0, 0, 1, 2, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 1, 2, 0, 4, 0, 4, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+
+    uint64_t mask = 0;
+
+    for (size_t part = 0; part < 2; ++part) {
+        const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + part * 32));
+
+        const __m256i low_classes = _mm256_shuffle_epi8(low_table, _mm256_and_si256(bytes, nibble_mask));
+        const __m256i high_classes = _mm256_shuffle_epi8(high_table, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble_mask));
+        const __m256i not_separators = _mm256_cmpeq_epi8(_mm256_and_si256(low_classes, high_classes), _mm256_setzero_si256());
+
+        mask |= static_cast<uint64_t>(~static_cast<uint32_t>(_mm256_movemask_epi8(not_separators))) << (part * 32);
+    }
 
-    // В бесконечном цикле ищем следующий символ-сепаратор в строке и откусываем от неё часть от начала
-    // до символа-сепаратора, таким образом разделяя строку на слова через символы-сепараторы, и так до
-    // тех пор, пока не дойдём до конца строки
-    while (true) {
-        size_t separator_pos = str.find_first_of(separator_chars);
-        string_view word = str.substr(0, separator_pos);
+    return mask;
+}
+
+#endif
 
-        if (!word.empty()) words.push_back(str.substr(0, separator_pos));
-        if (separator_pos == str.npos) break;
-        else str.remove_prefix(separator_pos + 1);
+// Функция разделения строки на слова по маскам сепараторов, которые строит функция separators_mask по 64 байта
+// (общая часть всех реализаций SplitIntoWords)
+//
+// Слово - максимальный отрезок строки без сепараторов. По маске блока находятся начала слов (не сепаратор, перед
+// которым сепаратор) и концы слов (сепаратор, перед которым не сепаратор), и они перебираются поочерёдно через
+// число младших нулевых бит, поэтому время не зависит от длины слов. Последний неполный блок копируется в буфер,
+// а его байты за концом строки считаются сепараторами, чтобы последнее слово закрылось
+static vector<string_view> SplitIntoWordsByMasks(string_view str, uint64_t (*separators_mask)(const char*)) {
+    vector<string_view> words;
+
+    const char* data = str.data();
+    size_t word_start = 0;
+    bool in_word = false;
+
+    // Функция обработки маски сепараторов блока, начинающегося с позиции base
+    const auto process_mask = [&](uint64_t mask, size_t base) {
+        const uint64_t previous_separators = (mask << 1) | static_cast<uint64_t>(!in_word);
+        uint64_t starts = ~mask & previous_separators;
+        uint64_t ends = mask & ~previous_separators;
+
+        while (true) {
+            if (in_word) {
+                if (ends == 0) break;
+                const size_t end = base + static_cast<size_t>(__builtin_ctzll(ends));
+                ends &= ends - 1;
+                words.push_back(str.substr(word_start, end - word_start));
+                in_word = false;
+            } else {
+                if (starts == 0) break;
+                word_start = base + static_cast<size_t>(__builtin_ctzll(starts));
+                starts &= starts - 1;
+                in_word = true;
+            }
+        }
+    };
+
+    // Полные блоки по 64 байта
+    size_t base = 0;
+    for (; base + 64 <= str.size(); base += 64) {
+        process_mask(separators_mask(data + base), base);
     }
 
-    // Возвращаем вектор с разделёнными словами
+    // Последний неполный блок (или пустой блок, если длина строки кратна 64, - он только закрывает последнее слово)
+    char tail[64] = {};
+    const size_t tail_size = str.size() - base;
+    copy(data + base, data + str.size(), tail);
+    process_mask(separators_mask(tail) | (~uint64_t{0} << tail_size), base);
+
     return words;
 }
 
+// Функции разделения строки на слова через символы-сепараторы (скалярная, SSE2 и AVX2 реализации; SSE2 и AVX2 можно
+// вызывать, только если процессор их поддерживает)
+vector<string_view> SplitIntoWordsScalar(string_view str) {
+    return SplitIntoWordsByMasks(str, SeparatorsMaskScalar);
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+vector<string_view> SplitIntoWordsSSE2(string_view str) {
+    return SplitIntoWordsByMasks(str, SeparatorsMaskSSE2);
+}
+
+vector<string_view> SplitIntoWordsAVX2(string_view str) {
+    return SplitIntoWordsByMasks(str, SeparatorsMaskAVX2);
+}
+
+#endif
+
+// Функция выбора реализации SplitIntoWords по возможностям процессора
+vector<string_view> (*ChooseSplitIntoWords())(string_view) {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SplitIntoWordsAVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return SplitIntoWordsSSE2;
+    }
+#endif
+    return SplitIntoWordsScalar;
+}
+}
+
+// Функция разделения строки на слова через символы-сепараторы
+// (знаки препинания ".", "?", "!", ".", ":", ",", ";", кавычки, скобки "()", "[]", "{}" и пробел " ")
+// (возвращает вектор string_view, ссылающихся на оригинальную строку)
+//
+// Реализация выбирается один раз при первом вызове по возможностям процессора: AVX2, SSE2 или скалярная
+vector<string_view> SplitIntoWords(string_view str) {
+    static const auto split_into_words = detail::ChooseSplitIntoWords();
+    return split_into_words(str);
+}
+
 // Функция сортировки и удаления дубликатов в векторе слов
 // (возвращает отсортированный вектор слов с удалёнными дубликатами, string_view в возвращённом
 // векторе ссылаются на те же string'и, что и в оригинальном векторе, переданным в качестве
@@ -190,6 +357,76 @@ tuple<size_t, string, string, string, string, string> ParseRecordStringFromFile(
     return {id, name, surname, patronymic, number, note};
 }
 
+// Функция парсинга строки с записью для базы данных без выделения памяти
+bool ParseRecordStringView(string_view str, RecordStringFields& fields) {
+
+    // Пример строки: <id="2" name="Александр" surname="Петров" patronymic="Иванович" number="+79754213275" note="C++ junior developer at &quot;Lesta Games&quot;">
+
+    // Кавычки внутри полей заменены на "&quot;", поэтому значения полей - это ровно текст между парами кавычек: находим
+    // 6 пар кавычек по порядку, не собирая позиции в вектор
+    string_view values[6];
+    size_t pos = 0;
+    for (string_view& value : values) {
+        const size_t open_pos = str.find('"', pos);
+        if (open_pos == str.npos) {
+            return false;
+        }
+        const size_t close_pos = str.find('"', open_pos + 1);
+        if (close_pos == str.npos) {
+            return false;
+        }
+        value = str.substr(open_pos + 1, close_pos - open_pos - 1);
+        pos = close_pos + 1;
+    }
+
+    // Получаем номер/id записи (число должно занимать всё значение поля)
+    const auto [end, error] = from_chars(values[0].data(), values[0].data() + values[0].size(), fields.id);
+    if (error != errc() || end != values[0].data() + values[0].size()) {
+        return false;
+    }
+
+    fields.name = values[1];
+    fields.surname = values[2];
+    fields.patronymic = values[3];
+    fields.number = values[4];
+    fields.note = values[5];
+    return true;
+}
+
+// Функция получения значения поля строки с записью
+string UnescapeRecordField(string_view field) {
+
+    // В большинстве полей нет ни одного символа '&', и поле просто копируется без поиска "&quot;"
+    if (field.find('&') == field.npos) {
+        return string(field);
+    }
+    return detail::ConverteAmpersandSequencesToQuotes(field);
+}
+
+// Функция разделения текста на части по границам строк
+vector<string_view> SplitIntoLineChunks(string_view text, size_t chunks_count) {
+    vector<string_view> chunks;
+    chunks_count = max<size_t>(chunks_count, 1);
+    chunks.reserve(chunks_count);
+
+    // Конец каждой части сдвигаем от равномерной границы вперёд до ближайшего конца строки
+    size_t begin = 0;
+    for (size_t i = 1; i <= chunks_count && begin < text.size(); ++i) {
+        size_t end = text.size();
+        if (i < chunks_count) {
+            end = max(begin, text.size() / chunks_count * i);
+            const size_t line_end = text.find('\n', end);
+            end = line_end == text.npos ? text.size() : line_end + 1;
+        }
+        if (end > begin) {
+            chunks.push_back(text.substr(begin, end - begin));
+        }
+        begin = end;
+    }
+
+    return chunks;
+}
+
 // Функция упаковки строки с информацией о числе записей в базе данных и номере/id последней записи
 // (используется при сохранении данных из базы в файл)
 string PackInfoStringForFile(size_t records_count, size_t last_record_id) {
@@ -0,0 +1,431 @@
+// Единица трансляции write_ahead_log.cpp описывает работу журнала упреждающей записи (write-ahead log, WAL) базы
+// данных для телефонной книги
+
+// Подключим библиотеку fstream для чтения сегментов журнала, библиотеку filesystem для поиска сегментов журнала в
+// каталоге, библиотеку algorithm для использования стандартных алгоритмов, библиотеку cstring для текста ошибок
+// системных вызовов, библиотеку cerrno для кодов ошибок системных вызовов, библиотеку stdexcept для исключений и
+// библиотеку limits для работы с предельными значениями типов
+#include <fstream>
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <limits>
+
+// Подключим заголовочные файлы POSIX для работы с файловыми дескрипторами (open, write, fdatasync, ftruncate, close)
+#include <fcntl.h>
+#include <unistd.h>
+
+// Подключим заголовочный файл журнала упреждающей записи
+#include "write_ahead_log.h"
+
+// Подключим заголовочный файл функций двоичного кодирования (контрольная сумма CRC-32C и числа фиксированной длины
+// в заголовке кадра)
+#include "binary_encoding.h"
+
+// Подключим заголовочный файл асинхронного журнала сервера (для сообщений о состоянии журнала упреждающей записи)
+#include "async_logger.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Пространство имён журнала упреждающей записи
+namespace write_ahead_log {
+
+using binary_encoding::AppendFixed32;
+using binary_encoding::ReadFixed32;
+using binary_encoding::Crc32c;
+
+// Функция записи всех байтов data в файл (повторяет write после частичной записи и прерывания сигналом;
+// возвращает false при ошибке, её код остаётся в errno)
+static bool WriteAll(int file_descriptor, string_view data) {
+    while (!data.empty()) {
+        const ssize_t written = write(file_descriptor, data.data(), data.size());
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data.remove_prefix(static_cast<size_t>(written));
+    }
+    return true;
+}
+
+// Функция чтения кадров сегмента журнала: вызывает function(payload) для каждого целого кадра с начала файла до
+// первого обрезанного или повреждённого кадра (возвращает число кадров и длину целой части файла)
+static pair<size_t, size_t> ReadSegmentFrames(const string& file_name, const function<void(string_view)>& function) {
+
+    // Открываем файл для чтения
+    ifstream segment_file(file_name, ios::binary);
+
+    // Узнаём длину файла, чтобы длина кадра из повреждённого заголовка не заставила выделить лишнюю память
+    segment_file.seekg(0, ios::end);
+    const size_t file_size = static_cast<size_t>(max<streamoff>(segment_file.tellg(), 0));
+    segment_file.seekg(0, ios::beg);
+
+    size_t frames_count = 0;
+    size_t valid_size = 0;
+
+    // Буферы заголовка и содержимого кадра
+    string header(WriteAheadLog::FRAME_HEADER_SIZE, '\0');
+    string payload;
+
+    while (segment_file.read(header.data(), header.size())) {
+
+        // Разбираем заголовок кадра: длину содержимого и контрольную сумму
+        string_view header_view = header;
+        uint32_t payload_size = 0, checksum = 0;
+        ReadFixed32(header_view, payload_size);
+        ReadFixed32(header_view, checksum);
+
+        // Кадр не помещается в остаток файла - он обрезан (или повреждена его длина)
+        if (payload_size > file_size - valid_size - WriteAheadLog::FRAME_HEADER_SIZE) {
+            break;
+        }
+
+        // Читаем содержимое кадра и сверяем контрольную сумму длины и содержимого
+        payload.resize(payload_size);
+        if (!segment_file.read(payload.data(), payload_size) ||
+            Crc32c(payload, Crc32c(string_view(header).substr(0, 4))) != checksum) {
+            break;
+        }
+
+        function(payload);
+        ++frames_count;
+        valid_size += WriteAheadLog::FRAME_HEADER_SIZE + payload_size;
+    }
+
+    return {frames_count, valid_size};
+}
+
+// Конструктор журнала принимает параметры журнала, находит его сегменты, отрезает от последнего из них обрезанный
+// или повреждённый хвост (или создаёт первый сегмент) и открывает его для дописывания кадров
+WriteAheadLog::WriteAheadLog(const Options& options) : options_(options) {
+
+    const vector<uint64_t> segments = ListSegments();
+
+    // Если сегментов нет, создаём первый (нужно для первого запуска сервера) и синхронизируем каталог, чтобы на
+    // диске оказался и сам файл сегмента
+    if (segments.empty()) {
+        OpenSegment(1);
+        SyncFile(DirectoryOf(options_.file_name));
+    }
+    // Иначе продолжаем дописывать последний сегмент, отрезав от него хвост после последнего целого кадра (кадр,
+    // который не успели дописать целиком, никогда не подтверждался писателю)
+    else {
+        const string segment_file_name = SegmentFileName(segments.back());
+        const size_t valid_size = ReadSegmentFrames(segment_file_name, [](string_view) { }).second;
+        const size_t file_size = static_cast<size_t>(filesystem::file_size(segment_file_name));
+
+        OpenSegment(segments.back());
+
+        if (valid_size < file_size) {
+            if (ftruncate(file_descriptor_, static_cast<off_t>(valid_size)) != 0) {
+                close(file_descriptor_);
+                throw runtime_error("Can't truncate write-ahead log segment \""s + segment_file_name + "\""s);
+            }
+            PHONE_BOOK_LOG_WARNING("Write-ahead log segment \""s << segment_file_name << "\" had a torn tail of "s
+                                   << file_size - valid_size << " bytes, it has been cut"s);
+        }
+    }
+
+    // В режиме BATCHED запускаем фоновый поток синхронизации
+    if (options_.durability == Durability::BATCHED) {
+        sync_thread_ = thread(&WriteAheadLog::SyncLoop, this);
+    }
+}
+
+// Деструктор записывает и синхронизирует с диском оставшиеся кадры, останавливает фоновый поток и закрывает файл
+WriteAheadLog::~WriteAheadLog() {
+
+    // Останавливаем фоновый поток синхронизации
+    {
+        lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    stop_requested_.notify_all();
+    if (sync_thread_.joinable()) {
+        sync_thread_.join();
+    }
+
+    // Записываем и синхронизируем оставшиеся кадры (деструктор не выбрасывает исключений - если журнал уже
+    // неисправен, записывать нечего)
+    unique_lock lock(mutex_);
+    try {
+        Flush(lock, appended_lsn_, true);
+    } catch (const exception& e) {
+        PHONE_BOOK_LOG_ERROR("Write-ahead log can't be flushed on close: "s << e.what());
+    }
+
+    close(file_descriptor_);
+}
+
+// Функция упаковки кадра с содержимым payload в конец буфера frames
+void WriteAheadLog::AppendFrame(string& frames, string_view payload) {
+
+    // Длина содержимого должна помещаться в 4 байта заголовка
+    if (payload.size() > numeric_limits<uint32_t>::max()) {
+        throw length_error("Write-ahead log frame is too large"s);
+    }
+
+    // Дописываем длину, затем контрольную сумму длины и содержимого, затем само содержимое
+    const size_t header_position = frames.size();
+    AppendFixed32(frames, static_cast<uint32_t>(payload.size()));
+    const uint32_t checksum = Crc32c(payload, Crc32c(string_view(frames).substr(header_position, 4)));
+    AppendFixed32(frames, checksum);
+    frames.append(payload);
+}
+
+// Функция воспроизведения журнала: вызывает function(payload) для содержимого каждого целого кадра всех сегментов
+// по порядку до первого повреждённого кадра
+size_t WriteAheadLog::Replay(const function<void(string_view)>& function) const {
+    size_t frames_count = 0;
+
+    const vector<uint64_t> segments = ListSegments();
+    for (size_t i = 0; i < segments.size(); ++i) {
+        const string segment_file_name = SegmentFileName(segments[i]);
+        const auto [segment_frames_count, valid_size] = ReadSegmentFrames(segment_file_name, function);
+        frames_count += segment_frames_count;
+
+        if (valid_size == filesystem::file_size(segment_file_name)) {
+            continue;
+        }
+
+        // Повреждённым может быть только хвост последнего сегмента (кадр, который не успели дописать целиком; его
+        // отрезает конструктор). Прежние сегменты перед переходом к следующему синхронизировались с диском целиком,
+        // поэтому их повреждение - потеря подтверждённых изменений: кадры следующих сегментов нельзя применять поверх
+        // пропуска, и база данных не запускается
+        if (i + 1 < segments.size()) {
+            throw runtime_error("Write-ahead log segment \""s + segment_file_name + "\" is damaged after "s +
+                                to_string(valid_size) + " bytes, but it is not the last segment: "s +
+                                "acknowledged changes are lost, the database can't be recovered from the log"s);
+        }
+
+        PHONE_BOOK_LOG_WARNING("Write-ahead log segment \""s << segment_file_name << "\" is damaged after "s
+                               << valid_size << " bytes, the rest of it is skipped"s);
+        break;
+    }
+
+    return frames_count;
+}
+
+// Функция дописывания упакованных кадров frames в буфер журнала
+size_t WriteAheadLog::Append(string_view frames) {
+    lock_guard lock(mutex_);
+
+    // После ошибки ввода-вывода кадры уже не станут долговечными, поэтому изменение отвергается до его публикации
+    if (failed_) {
+        throw runtime_error("Write-ahead log has failed, changes can't be made durable: "s + failure_);
+    }
+
+    pending_.append(frames);
+    appended_lsn_ += frames.size();
+
+    ++stats_.appends;
+    stats_.bytes += frames.size();
+
+    return appended_lsn_;
+}
+
+// Функция ожидания долговечности кадров до позиции lsn по режиму долговечности журнала
+void WriteAheadLog::Commit(size_t lsn) {
+    unique_lock lock(mutex_);
+    Flush(lock, lsn, options_.durability == Durability::PER_REQUEST);
+}
+
+// Функция записи кадров до позиции lsn (и их синхронизации с диском, если sync)
+void WriteAheadLog::Flush(unique_lock<mutex>& lock, size_t lsn, bool sync) {
+    while (true) {
+        if (failed_) {
+            throw runtime_error("Write-ahead log has failed, changes can't be made durable: "s + failure_);
+        }
+
+        // Кадры до lsn уже записаны (и синхронизированы) - своим или чужим лидером
+        if (written_lsn_ >= lsn && (!sync || synced_lsn_ >= lsn)) {
+            return;
+        }
+
+        // Другой лидер сейчас записывает кадры - ждём его, затем проверяем снова (наши кадры могли попасть в его запись,
+        // а синхронизацию выполнит следующий лидер)
+        if (flushing_) {
+            sync_requested_ |= sync;
+            flushed_.wait(lock);
+            continue;
+        }
+
+        // Становимся лидером: забираем кадры всех писателей, успевших сделать Append, и записываем их без mutex'а,
+        // чтобы следующие писатели в это время продолжали дописывать кадры в буфер
+        flushing_ = true;
+        string frames;
+        frames.swap(pending_);
+        const size_t end_lsn = appended_lsn_;
+        const int file_descriptor = file_descriptor_;
+        const bool synchronize = sync || sync_requested_;
+        sync_requested_ = false;
+
+        lock.unlock();
+        const bool written = WriteAll(file_descriptor, frames);
+        const bool succeeded = written && (!synchronize || fdatasync(file_descriptor) == 0);
+        const int error = succeeded ? 0 : errno;
+        lock.lock();
+
+        flushing_ = false;
+
+        // Запоминаем первую ошибку: её текст получат все последующие Append и Commit, в том числе после неудачной
+        // синхронизации в фоновом потоке, которую никто из писателей не ждал
+        if (!succeeded) {
+            failed_ = true;
+            failure_ = "can't "s + (written ? "sync"s : "write"s) + " segment \""s + SegmentFileName(segment_) +
+                       "\": "s + strerror(error);
+            flushed_.notify_all();
+            throw runtime_error("Write-ahead log has failed: "s + failure_);
+        }
+
+        written_lsn_ = end_lsn;
+        if (synchronize) {
+            synced_lsn_ = end_lsn;
+        }
+
+        stats_.writes += !frames.empty();
+        stats_.syncs += synchronize;
+
+        // Возвращаем память записанного буфера, если новых кадров ещё нет (буфер не выделяется заново на каждую пачку)
+        if (pending_.empty()) {
+            frames.clear();
+            pending_.swap(frames);
+        }
+
+        flushed_.notify_all();
+    }
+}
+
+// Функция фонового потока синхронизации (режим BATCHED)
+void WriteAheadLog::SyncLoop() {
+    unique_lock lock(mutex_);
+
+    while (!stop_) {
+        stop_requested_.wait_for(lock, options_.sync_interval, [this]() { return stop_; });
+
+        // Синхронизируем с диском кадры, записанные с прошлой синхронизации (запись кадров в файл остаётся за
+        // писателями, которые ждут её в Commit)
+        // (ошибка необратима: Flush уже перевёл журнал в неисправное состояние, и все последующие Append и Commit
+        //  выбрасывают исключение с её текстом, поэтому поток лишь сообщает о ней в журнал сервера и завершается)
+        if (!stop_ && synced_lsn_ < written_lsn_) {
+            try {
+                Flush(lock, written_lsn_, true);
+            } catch (const exception& e) {
+                PHONE_BOOK_LOG_ERROR("Write-ahead log can't be synced, changes are rejected from now on: "s
+                                     << e.what());
+                return;
+            }
+        }
+    }
+}
+
+// Функция перехода к новому сегменту
+uint64_t WriteAheadLog::StartNewSegment() {
+    unique_lock lock(mutex_);
+
+    // Записываем и синхронизируем все дописанные кадры и дожидаемся, пока никто не записывает кадры в прежний
+    // сегмент (Flush возвращается с захваченным mutex'ом, поэтому после выхода из цикла новых кадров нет и лидера нет)
+    while (true) {
+        Flush(lock, appended_lsn_, true);
+        if (!flushing_) {
+            break;
+        }
+        flushed_.wait(lock);
+    }
+
+    // Закрываем прежний сегмент и открываем следующий (mutex удерживается, поэтому писатели в это время только ждут)
+    close(file_descriptor_);
+    file_descriptor_ = -1;
+    OpenSegment(segment_ + 1);
+    SyncFile(DirectoryOf(options_.file_name));
+
+    return segment_;
+}
+
+// Функция удаления сегментов с номерами меньше segment
+void WriteAheadLog::RemoveSegmentsBefore(uint64_t segment) {
+    bool removed = false;
+
+    for (uint64_t old_segment : ListSegments()) {
+        if (old_segment < segment) {
+            removed |= filesystem::remove(SegmentFileName(old_segment));
+        }
+    }
+
+    // Синхронизируем каталог, чтобы удаление сегментов тоже оказалось на диске
+    if (removed) {
+        SyncFile(DirectoryOf(options_.file_name));
+    }
+}
+
+// Функция получения статистики журнала
+WriteAheadLog::Stats WriteAheadLog::GetStats() const {
+    lock_guard lock(mutex_);
+    return stats_;
+}
+
+// Функция получения имени файла сегмента с номером segment
+string WriteAheadLog::SegmentFileName(uint64_t segment) const {
+    return options_.file_name + "."s + to_string(segment);
+}
+
+// Функция получения отсортированных по возрастанию номеров всех сегментов журнала на диске
+vector<uint64_t> WriteAheadLog::ListSegments() const {
+    const filesystem::path journal_path(options_.file_name);
+    const string prefix = journal_path.filename().string() + "."s;
+
+    vector<uint64_t> segments;
+
+    // Сегменты - файлы каталога журнала с именем "<имя журнала>.<номер сегмента>" (если каталога нет, сегментов нет)
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(DirectoryOf(options_.file_name), error)) {
+        const string name = entry.path().filename().string();
+        if (name.size() > prefix.size() && name.compare(0, prefix.size(), prefix) == 0 &&
+            all_of(name.begin() + prefix.size(), name.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            segments.push_back(stoull(name.substr(prefix.size())));
+        }
+    }
+
+    sort(segments.begin(), segments.end());
+    return segments;
+}
+
+// Функция открытия сегмента с номером segment для дописывания кадров
+void WriteAheadLog::OpenSegment(uint64_t segment) {
+    const string segment_file_name = SegmentFileName(segment);
+
+    file_descriptor_ = open(segment_file_name.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (file_descriptor_ < 0) {
+        throw runtime_error("Can't open write-ahead log segment \""s + segment_file_name + "\": "s + strerror(errno));
+    }
+
+    segment_ = segment;
+}
+
+// Функция синхронизации с диском файла или каталога с именем file_name
+void SyncFile(const string& file_name) {
+    const int file_descriptor = open(file_name.c_str(), O_RDONLY | O_CLOEXEC);
+    if (file_descriptor < 0) {
+        throw runtime_error("Can't open \""s + file_name + "\" for sync: "s + strerror(errno));
+    }
+
+    const bool succeeded = fsync(file_descriptor) == 0;
+    close(file_descriptor);
+
+    if (!succeeded) {
+        throw runtime_error("Can't sync \""s + file_name + "\": "s + strerror(errno));
+    }
+}
+
+// Функция получения имени каталога, в котором лежит файл file_name
+string DirectoryOf(const string& file_name) {
+    const filesystem::path directory = filesystem::path(file_name).parent_path();
+    return directory.empty() ? "."s : directory.string();
+}
+
+}
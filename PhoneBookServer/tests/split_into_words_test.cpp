@@ -0,0 +1,154 @@
+// Единица трансляции split_into_words_test.cpp описывает тест реализаций разделения строки на слова: скалярная, SSE2 и
+// AVX2 реализации SplitIntoWords и выбранная по процессору реализация сравниваются с прежней реализацией через
+// string::find_first_of на всех парах байтов и на случайных строках (в том числе с русскими буквами в UTF-8 и
+// невыровненным началом строки)
+//
+// (возвращает 0, если все реализации совпали с прежней на всех строках, иначе 1)
+
+// Подключим библиотеку iostream для вывода результатов, библиотеку random для генерации случайных строк, библиотеки
+// string, string_view и vector для работы со строками и векторами и библиотеку utility для пар
+#include <iostream>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+
+// Подключим заголовочный файл функций для работы со строками
+#include "string_functions.h"
+
+// Подключим пространство имён std
+using namespace std;
+
+// Тип функции разделения строки на слова
+using SplitFunction = vector<string_view> (*)(string_view);
+
+// Прежняя реализация разделения строки на слова через символы-сепараторы (поиск каждого следующего сепаратора через
+// find_first_of), с которой сравниваются все реализации
+vector<string_view> SplitIntoWordsReference(string_view str) {
+    vector<string_view> words;
+    const static string separator_chars = "!?.:,;\"()[]{} "s;
+
+    while (true) {
+        size_t separator_pos = str.find_first_of(separator_chars);
+        string_view word = str.substr(0, separator_pos);
+
+        if (!word.empty()) words.push_back(word);
+        if (separator_pos == str.npos) break;
+        else str.remove_prefix(separator_pos + 1);
+    }
+
+    return words;
+}
+
+// Функция получения реализаций, доступных на этом процессоре (векторные реализации вызываются, только если процессор
+// поддерживает их набор инструкций)
+vector<pair<string, SplitFunction>> AvailableImplementations() {
+    vector<pair<string, SplitFunction>> implementations = {
+        {"scalar"s, string_functions::detail::SplitIntoWordsScalar},
+        {"dispatch"s, string_functions::SplitIntoWords},
+    };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    if (__builtin_cpu_supports("sse2")) {
+        implementations.emplace_back("sse2"s, string_functions::detail::SplitIntoWordsSSE2);
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        implementations.emplace_back("avx2"s, string_functions::detail::SplitIntoWordsAVX2);
+    }
+#endif
+
+    return implementations;
+}
+
+// Функция сравнения результатов: слова должны совпадать не только по содержимому, но и по положению в исходной строке
+bool SameWords(const vector<string_view>& lhs, const vector<string_view>& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        if (lhs[i].data() != rhs[i].data() || lhs[i].size() != rhs[i].size()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Класс проверки строк всеми реализациями с подсчётом проверок и расхождений
+class Checker {
+public:
+    explicit Checker(vector<pair<string, SplitFunction>> implementations) : implementations_(move(implementations)) { }
+
+    // Функция проверки строки str всеми реализациями (о первых расхождениях сообщается в консоль)
+    void Check(string_view str) {
+        const vector<string_view> expected = SplitIntoWordsReference(str);
+
+        for (const auto& [name, split] : implementations_) {
+            ++checks_;
+            if (!SameWords(split(str), expected)) {
+                if (++mismatches_ <= MAX_REPORTED_MISMATCHES) {
+                    cout << "[Mismatch: "s << name << " on string of length "s << str.size() << "]"s << endl;
+                }
+            }
+        }
+    }
+
+    size_t Checks() const {
+        return checks_;
+    }
+
+    size_t Mismatches() const {
+        return mismatches_;
+    }
+
+private:
+    static constexpr size_t MAX_REPORTED_MISMATCHES = 10;
+
+    vector<pair<string, SplitFunction>> implementations_;
+    size_t checks_ = 0;
+    size_t mismatches_ = 0;
+};
+
+int main() {
+    Checker checker(AvailableImplementations());
+
+    // Все пары байтов (a, b) в строках, длины которых попадают на границы векторов SSE2 (16 байт) и AVX2 (32 байта):
+    // a и b стоят в начале и в конце строки и рядом в её середине, остальные символы - буква
+    for (int a = 0; a < 256; ++a) {
+        for (int b = 0; b < 256; ++b) {
+            for (size_t length : {2, 3, 15, 16, 17, 31, 32, 33, 63, 64, 65, 97}) {
+                string str(length, 'x');
+                str.front() = static_cast<char>(a);
+                str.back() = static_cast<char>(b);
+                checker.Check(str);
+
+                str.assign(length, 'x');
+                str[length / 2 - 1] = static_cast<char>(a);
+                str[length / 2] = static_cast<char>(b);
+                checker.Check(str);
+            }
+        }
+    }
+    const size_t pairs_checks = checker.Checks();
+
+    // Случайные строки из сепараторов, латинских и русских букв (UTF-8), управляющих символов и произвольных байтов,
+    // начинающиеся с произвольного смещения в буфере (невыровненное начало)
+    mt19937 generator(5);
+    const string alphabet = "!?.:,;\"()[]{} abcАБВабвгдёЁ\t\n-_0123\x80\xff"s + '\0';
+    for (size_t i = 0; i < 200000; ++i) {
+        const size_t length = generator() % 300;
+        const size_t offset = generator() % 32;
+        string buffer(offset + length, '\0');
+
+        for (size_t j = offset; j < buffer.size(); ++j) {
+            buffer[j] = generator() % 4 == 0 ? static_cast<char>(generator() % 256)
+                                             : alphabet[generator() % alphabet.size()];
+        }
+        checker.Check(string_view(buffer).substr(offset));
+    }
+
+    cout << "[SplitIntoWords: "s << pairs_checks << " byte pair checks, "s << checker.Checks() - pairs_checks
+         << " random string checks, "s << checker.Mismatches() << " mismatches]"s << endl;
+
+    return checker.Mismatches() == 0 ? 0 : 1;
+}